@@ -0,0 +1,219 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "arena.h"
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+namespace game {
+
+LinearArena::LinearArena(size_t chunkSize) : m_ChunkSize(chunkSize)
+{
+	GAME_DEBUG_ASSERT(chunkSize > 0);
+}
+
+LinearArena::~LinearArena() noexcept
+{
+	for (Chunk &chunk : m_Chunks)
+		delete[] chunk.Data;
+}
+
+void *LinearArena::allocate(size_t size, size_t alignment)
+{
+	GAME_DEBUG_ASSERT(alignment && !(alignment & (alignment - 1)));
+	for (;;)
+	{
+		if (m_Chunk < m_Chunks.size())
+		{
+			const Chunk &chunk = m_Chunks[m_Chunk];
+			uintptr_t base = (uintptr_t)chunk.Data;
+			size_t offset = (size_t)(((base + m_Offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+			if (offset + size <= chunk.Size)
+			{
+				m_Offset = offset + size;
+				return chunk.Data + offset;
+			}
+			if (m_Chunk + 1 < m_Chunks.size())
+			{
+				// Reuse a chunk kept from before a rewind
+				++m_Chunk;
+				m_Offset = 0;
+				continue;
+			}
+		}
+
+		// Grow
+		size_t chunkSize = std::max(m_ChunkSize, size + alignment);
+		m_Chunks.push_back({ null, chunkSize });
+		m_Chunks.back().Data = new char[chunkSize];
+		m_Chunk = m_Chunks.size() - 1;
+		m_Offset = 0;
+	}
+}
+
+void LinearArena::reset()
+{
+	if (m_Chunks.size() > 1)
+	{
+		size_t total = capacity();
+		for (Chunk &chunk : m_Chunks)
+			delete[] chunk.Data;
+		m_Chunks.clear();
+		m_Chunks.push_back({ null, total });
+		m_Chunks.back().Data = new char[total];
+	}
+	m_Chunk = 0;
+	m_Offset = 0;
+}
+
+void LinearArena::rewind(Marker marker)
+{
+	GAME_DEBUG_ASSERT(marker.Chunk < m_Chunk || (marker.Chunk == m_Chunk && marker.Offset <= m_Offset));
+	m_Chunk = marker.Chunk;
+	m_Offset = marker.Offset;
+}
+
+size_t LinearArena::used() const
+{
+	size_t res = m_Offset;
+	for (size_t i = 0; i < m_Chunk && i < m_Chunks.size(); ++i)
+		res += m_Chunks[i].Size;
+	return res;
+}
+
+size_t LinearArena::capacity() const
+{
+	size_t res = 0;
+	for (const Chunk &chunk : m_Chunks)
+		res += chunk.Size;
+	return res;
+}
+
+namespace /* anonymous */ {
+
+thread_local LinearArena s_ScratchArena;
+
+} /* anonymous namespace */
+
+ScratchScope::ScratchScope() : m_Arena(&s_ScratchArena), m_Marker(s_ScratchArena.mark())
+{
+
+}
+
+ScratchScope::~ScratchScope() noexcept
+{
+	m_Arena->rewind(m_Marker);
+}
+
+#ifdef GAME_DEBUG
+
+namespace /* anonymous */ {
+
+std::atomic<int64_t> s_HeapAllocations;
+
+} /* anonymous namespace */
+
+int64_t heapAllocationCount()
+{
+	return s_HeapAllocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+int64_t heapAllocationCount()
+{
+	return -1;
+}
+
+#endif
+
+} /* namespace game */
+
+#ifdef GAME_DEBUG
+
+// Count all allocations through the global operators, aligned variants are not replaced
+void *operator new(size_t size)
+{
+	game::s_HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *ptr = malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	game::s_HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	free(ptr);
+}
+
+#endif
+
+/* end of file */
@@ -0,0 +1,159 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Linear arena and scoped stack allocators.
+Allocation bumps an offset in the current chunk, and memory is only
+released all at once, by resetting the arena or rewinding it to a marker.
+
+The frame arena is reset once per frame, after the swap. Scratch scopes
+take temporary memory from a per-thread arena, and give it back when they
+go out of scope. Both can back STL containers through `ArenaAllocator`,
+whose deallocate does nothing.
+
+In debug builds the global heap allocations are counted,
+to verify that steady state frames don't allocate.
+
+*/
+
+#pragma once
+#ifndef GAME_ARENA_H
+#define GAME_ARENA_H
+
+#include "platform.h"
+
+#include <vector>
+
+namespace game {
+
+class LinearArena
+{
+public:
+	struct Marker
+	{
+		size_t Chunk;
+		size_t Offset;
+	};
+
+	LinearArena(size_t chunkSize = 64 * 1024);
+	~LinearArena() noexcept;
+
+	LinearArena(const LinearArena &other) = delete;
+	LinearArena &operator=(const LinearArena &other) = delete;
+
+	[[nodiscard]] void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template<typename T>
+	[[nodiscard]] inline T *allocate(size_t count) { return (T *)allocate(sizeof(T) * count, alignof(T)); }
+
+	// Release everything, chunks are merged into one that fits the peak,
+	// so the next cycle doesn't allocate from the heap
+	void reset();
+
+	// Release everything allocated after the marker
+	inline Marker mark() const { return { m_Chunk, m_Offset }; }
+	void rewind(Marker marker);
+
+	// Bytes in use, and bytes in all chunks
+	size_t used() const;
+	size_t capacity() const;
+
+private:
+	struct Chunk
+	{
+		char *Data;
+		size_t Size;
+	};
+
+	std::vector<Chunk> m_Chunks;
+	size_t m_Chunk = 0;
+	size_t m_Offset = 0;
+	size_t m_ChunkSize;
+
+};
+
+// Temporary memory from the arena of the calling thread, released at the end of the scope
+class ScratchScope
+{
+public:
+	ScratchScope();
+	~ScratchScope() noexcept;
+
+	ScratchScope(const ScratchScope &other) = delete;
+	ScratchScope &operator=(const ScratchScope &other) = delete;
+
+	inline LinearArena &arena() { return *m_Arena; }
+
+	template<typename T>
+	[[nodiscard]] inline T *allocate(size_t count) { return m_Arena->allocate<T>(count); }
+
+private:
+	LinearArena *m_Arena;
+	LinearArena::Marker m_Marker;
+
+};
+
+// STL allocator on an arena, the container must not outlive the memory
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	inline ArenaAllocator(LinearArena &arena) noexcept : m_Arena(&arena) { }
+	template<typename U>
+	inline ArenaAllocator(const ArenaAllocator<U> &other) noexcept : m_Arena(other.arena()) { }
+
+	[[nodiscard]] inline T *allocate(size_t count) { return m_Arena->allocate<T>(count); }
+	inline void deallocate(T *, size_t) noexcept { }
+
+	inline LinearArena *arena() const { return m_Arena; }
+
+	template<typename U>
+	inline bool operator==(const ArenaAllocator<U> &other) const { return m_Arena == other.arena(); }
+	template<typename U>
+	inline bool operator!=(const ArenaAllocator<U> &other) const { return m_Arena != other.arena(); }
+
+private:
+	LinearArena *m_Arena;
+
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Global heap allocations since startup, or -1 when not counted in this build
+int64_t heapAllocationCount();
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_ARENA_H */
+
+/* end of file */
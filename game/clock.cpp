@@ -0,0 +1,83 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "clock.h"
+
+namespace game {
+
+#ifdef _WIN32
+
+namespace /* anonymous */ {
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// One timer per thread, null when high resolution timers are not supported
+struct WaitableTimer
+{
+	WaitableTimer() : Handle(CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS)) { }
+	~WaitableTimer() noexcept { if (Handle) CloseHandle(Handle); }
+	HANDLE Handle;
+};
+
+thread_local WaitableTimer s_WaitableTimer;
+
+} /* anonymous namespace */
+
+void SteadyClock::sleep(int64_t ns)
+{
+	if (ns <= 0)
+		return;
+	if (s_WaitableTimer.Handle)
+	{
+		LARGE_INTEGER due;
+		due.QuadPart = -(ns + 99) / 100; // Relative, in 100 ns units
+		if (SetWaitableTimerEx(s_WaitableTimer.Handle, &due, 0, NULL, NULL, NULL, 0))
+		{
+			WaitForSingleObject(s_WaitableTimer.Handle, INFINITE);
+			return;
+		}
+	}
+	Sleep((DWORD)((ns + 999999) / 1000000));
+}
+
+#else
+
+void SteadyClock::sleep(int64_t ns)
+{
+	if (ns > 0)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+}
+
+#endif
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,106 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Time sources for the game loop, in nanoseconds from an arbitrary origin.
+`SteadyClock` reads the high resolution monotonic timer, and sleeps on
+a high resolution waitable timer where the platform has one.
+`ManualClock` only moves when told to, or when sleeping, so that timing
+dependent code runs deterministically in tests and benchmarks.
+
+*/
+
+#pragma once
+#ifndef GAME_CLOCK_H
+#define GAME_CLOCK_H
+
+#include "platform.h"
+
+#include <chrono>
+#include <thread>
+
+namespace game {
+
+class Clock
+{
+public:
+	virtual ~Clock() noexcept { }
+
+	// Never decreases
+	[[nodiscard]] virtual int64_t now() = 0;
+
+	// Block the calling thread for at least the duration, usually somewhat more
+	virtual void sleep(int64_t ns) = 0;
+
+	// Give up the rest of the time slice while spinning on `now()`
+	virtual void yield() = 0;
+
+};
+
+class SteadyClock : public Clock
+{
+public:
+	[[nodiscard]] virtual int64_t now() override
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	virtual void sleep(int64_t ns) override;
+	virtual void yield() override { std::this_thread::yield(); }
+
+};
+
+class ManualClock : public Clock
+{
+public:
+	[[nodiscard]] virtual int64_t now() override { return m_Now; }
+
+	// Sleeps take as long as requested plus the overshoot, and yields take the yield time
+	virtual void sleep(int64_t ns) override { advance(ns + m_SleepOvershoot); }
+	virtual void yield() override { advance(m_YieldTime); }
+
+	inline void advance(int64_t ns) { GAME_DEBUG_ASSERT(ns >= 0); m_Now += ns; }
+
+	// Simulated timer behaviour
+	inline void setSleepOvershoot(int64_t ns) { m_SleepOvershoot = ns; }
+	inline void setYieldTime(int64_t ns) { m_YieldTime = ns; }
+
+private:
+	int64_t m_Now = 0;
+	int64_t m_SleepOvershoot = 0;
+	int64_t m_YieldTime = 1000;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_CLOCK_H */
+
+/* end of file */
@@ -0,0 +1,364 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "ecs.h"
+#include "exception.h"
+
+#include <new>
+#include <mutex>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr size_t ChunkAlignment = 64;
+constexpr uint32_t ArrayAlignment = 16;
+
+std::mutex s_ComponentTypeMutex;
+ComponentType s_ComponentTypes[MaxComponentTypes];
+int s_ComponentTypeCount;
+
+inline uint32_t alignUp(uint32_t value, uint32_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Bytes used by a chunk of the given capacity, fills in the array offsets
+uint32_t layoutChunk(Archetype *archetype, uint32_t capacity)
+{
+	uint32_t offset = (uint32_t)sizeof(Entity) * capacity;
+	for (int id : archetype->Components)
+	{
+		const ComponentType &type = s_ComponentTypes[id];
+		offset = alignUp(offset, std::max(type.Alignment, ArrayAlignment));
+		archetype->Offsets[id] = offset;
+		offset += type.Size * capacity;
+	}
+	return offset;
+}
+
+} /* anonymous namespace */
+
+int registerComponentType(size_t size, size_t alignment)
+{
+	std::unique_lock<std::mutex> lock(s_ComponentTypeMutex);
+	if (s_ComponentTypeCount >= MaxComponentTypes)
+		GAME_THROW(Exception("Too many component types"sv, 1));
+	if (alignment > ChunkAlignment)
+		GAME_THROW(Exception("Component alignment exceeds the chunk alignment"sv, 1));
+	s_ComponentTypes[s_ComponentTypeCount] = { (uint32_t)size, (uint32_t)alignment };
+	return s_ComponentTypeCount++;
+}
+
+const ComponentType &componentType(int id)
+{
+	GAME_DEBUG_ASSERT(id >= 0 && id < MaxComponentTypes);
+	return s_ComponentTypes[id];
+}
+
+World::World()
+{
+	m_Empty = archetype(0);
+}
+
+World::~World() noexcept
+{
+	for (std::unique_ptr<Archetype> &archetype : m_Archetypes)
+		for (uint8_t *chunk : archetype->Chunks)
+			::operator delete(chunk, std::align_val_t(ChunkAlignment));
+}
+
+Archetype *World::archetype(ComponentMask mask)
+{
+	auto it = m_ArchetypeMap.find(mask);
+	if (it != m_ArchetypeMap.end())
+		return it->second;
+
+	std::unique_ptr<Archetype> archetype = std::make_unique<Archetype>();
+	archetype->Mask = mask;
+	for (int id = 0; id < MaxComponentTypes; ++id)
+		if (mask & (ComponentMask(1) << id))
+			archetype->Components.push_back(id);
+
+	// Largest capacity that fits, starting from the estimate without padding
+	uint32_t entitySize = (uint32_t)sizeof(Entity);
+	for (int id : archetype->Components)
+		entitySize += s_ComponentTypes[id].Size;
+	uint32_t capacity = (uint32_t)EcsChunkSize / entitySize;
+	while (capacity && layoutChunk(archetype.get(), capacity) > EcsChunkSize)
+		--capacity;
+	if (!capacity)
+		GAME_THROW(Exception("Components don't fit in a chunk"sv, 1));
+	archetype->Capacity = capacity;
+
+	Archetype *res = archetype.get();
+	m_Archetypes.push_back(std::move(archetype));
+	m_ArchetypeMap[mask] = res;
+	return res;
+}
+
+void World::reserveRow(Archetype *archetype)
+{
+	if (archetype->Count < archetype->Chunks.size() * archetype->Capacity)
+		return;
+	archetype->Chunks.reserve(archetype->Chunks.size() + 1);
+	archetype->Chunks.push_back((uint8_t *)::operator new(EcsChunkSize, std::align_val_t(ChunkAlignment)));
+}
+
+size_t World::allocateRow(Archetype *archetype, Entity entity)
+{
+	GAME_DEBUG_ASSERT(archetype->Count < archetype->Chunks.size() * archetype->Capacity);
+	size_t row = archetype->Count++;
+	entityAt(archetype, row) = entity;
+	return row;
+}
+
+void World::removeRow(Archetype *archetype, size_t row)
+{
+	size_t last = archetype->Count - 1;
+	if (row != last)
+	{
+		// Fill the hole with the last entity
+		for (int id : archetype->Components)
+			memcpy(component(archetype, row, id), component(archetype, last, id), componentType(id).Size);
+		Entity moved = entityAt(archetype, last);
+		entityAt(archetype, row) = moved;
+		m_Entities.get(moved)->Row = row;
+	}
+	--archetype->Count;
+}
+
+void World::move(Entity entity, Location &location, Archetype *to)
+{
+	Archetype *from = location.Owner;
+	size_t fromRow = location.Row;
+	reserveRow(to);
+	size_t row = allocateRow(to, entity);
+	for (int id : to->Components)
+	{
+		if (from->Mask & (ComponentMask(1) << id))
+			memcpy(component(to, row, id), component(from, fromRow, id), componentType(id).Size);
+		else
+			memset(component(to, row, id), 0, componentType(id).Size);
+	}
+	removeRow(from, fromRow);
+	location.Owner = to;
+	location.Row = row;
+}
+
+Entity World::create(ComponentMask mask)
+{
+	GAME_DEBUG_ASSERT(!m_Iterating);
+	Archetype *archetype = this->archetype(mask);
+	reserveRow(archetype);
+	Entity entity = m_Entities.create({ archetype, archetype->Count });
+	size_t row = allocateRow(archetype, entity);
+	for (int id : archetype->Components)
+		memset(component(archetype, row, id), 0, componentType(id).Size);
+	return entity;
+}
+
+void World::destroy(Entity entity)
+{
+	GAME_DEBUG_ASSERT(!m_Iterating);
+	Location *location = m_Entities.get(entity);
+	if (!location)
+		return;
+	removeRow(location->Owner, location->Row);
+	m_Entities.destroy(entity);
+}
+
+void *World::get(Entity entity, int component)
+{
+	Location *location = m_Entities.get(entity);
+	if (!location || !(location->Owner->Mask & (ComponentMask(1) << component)))
+		return null;
+	return World::component(location->Owner, location->Row, component);
+}
+
+ComponentMask World::mask(Entity entity) const
+{
+	const Location *location = m_Entities.get(entity);
+	return location ? location->Owner->Mask : 0;
+}
+
+void *World::add(Entity entity, int component)
+{
+	GAME_DEBUG_ASSERT(!m_Iterating);
+	Location *location = m_Entities.get(entity);
+	if (!location)
+		GAME_THROW(Exception("Invalid entity"sv, 1));
+	Archetype *from = location->Owner;
+	if (!(from->Mask & (ComponentMask(1) << component)))
+	{
+		Archetype *&to = from->AddEdges[component];
+		if (!to)
+			to = archetype(from->Mask | (ComponentMask(1) << component));
+		move(entity, *location, to);
+	}
+	return World::component(location->Owner, location->Row, component);
+}
+
+void World::remove(Entity entity, int component)
+{
+	GAME_DEBUG_ASSERT(!m_Iterating);
+	Location *location = m_Entities.get(entity);
+	if (!location)
+		return;
+	Archetype *from = location->Owner;
+	if (!(from->Mask & (ComponentMask(1) << component)))
+		return;
+	Archetype *&to = from->RemoveEdges[component];
+	if (!to)
+		to = archetype(from->Mask & ~(ComponentMask(1) << component));
+	move(entity, *location, to);
+}
+
+void World::clear()
+{
+	GAME_DEBUG_ASSERT(!m_Iterating);
+	for (std::unique_ptr<Archetype> &archetype : m_Archetypes)
+		archetype->Count = 0;
+	m_Entities.clear();
+}
+
+size_t World::chunkCount(EntityQuery &query)
+{
+	refresh(query);
+	return query.m_Chunks.size();
+}
+
+void World::refresh(EntityQuery &query)
+{
+	if (query.m_World != this)
+	{
+		query.m_World = this;
+		query.m_ArchetypesSeen = 0;
+		query.m_Archetypes.clear();
+	}
+
+	// Only archetypes created since the last refresh are matched
+	for (; query.m_ArchetypesSeen < m_Archetypes.size(); ++query.m_ArchetypesSeen)
+	{
+		Archetype *archetype = m_Archetypes[query.m_ArchetypesSeen].get();
+		if ((archetype->Mask & query.m_All) == query.m_All && !(archetype->Mask & query.m_None))
+			query.m_Archetypes.push_back(archetype);
+	}
+
+	query.m_Chunks.clear();
+	for (const Archetype *archetype : query.m_Archetypes)
+	{
+		size_t chunkCount = archetype->chunkCount();
+		for (size_t i = 0; i < chunkCount; ++i)
+			query.m_Chunks.emplace_back(archetype, i);
+	}
+}
+
+void EntityCommandBuffer::writeHeader(Command op, Entity entity, uint32_t componentCount)
+{
+	Header header = { op, componentCount, entity };
+	size_t offset = m_Data.size();
+	m_Data.resize(offset + sizeof(header));
+	memcpy(&m_Data[offset], &header, sizeof(header));
+}
+
+void EntityCommandBuffer::writeComponent(int id, const void *value)
+{
+	uint32_t size = value ? componentType(id).Size : 0;
+	size_t offset = m_Data.size();
+	m_Data.resize(offset + sizeof(id) + size);
+	memcpy(&m_Data[offset], &id, sizeof(id));
+	if (value)
+		memcpy(&m_Data[offset + sizeof(id)], value, size);
+}
+
+void EntityCommandBuffer::apply(World &world)
+{
+	GAME_FINALLY([&]() -> void { m_Data.clear(); });
+	const uint8_t *data = m_Data.data();
+	const uint8_t *end = data + m_Data.size();
+	while (data < end)
+	{
+		Header header;
+		memcpy(&header, data, sizeof(header));
+		data += sizeof(header);
+		switch (header.Op)
+		{
+		case Command::Create:
+		{
+			// The mask first, so the entity is created in its final archetype
+			ComponentMask mask = 0;
+			const uint8_t *components = data;
+			for (uint32_t i = 0; i < header.ComponentCount; ++i)
+			{
+				int id;
+				memcpy(&id, data, sizeof(id));
+				mask |= ComponentMask(1) << id;
+				data += sizeof(id) + componentType(id).Size;
+			}
+			Entity entity = world.create(mask);
+			data = components;
+			for (uint32_t i = 0; i < header.ComponentCount; ++i)
+			{
+				int id;
+				memcpy(&id, data, sizeof(id));
+				data += sizeof(id);
+				memcpy(world.get(entity, id), data, componentType(id).Size);
+				data += componentType(id).Size;
+			}
+			break;
+		}
+		case Command::Destroy:
+			world.destroy(header.Target);
+			break;
+		case Command::Add:
+		{
+			int id;
+			memcpy(&id, data, sizeof(id));
+			data += sizeof(id);
+			if (world.valid(header.Target))
+				memcpy(world.add(header.Target, id), data, componentType(id).Size);
+			data += componentType(id).Size;
+			break;
+		}
+		case Command::Remove:
+		{
+			int id;
+			memcpy(&id, data, sizeof(id));
+			data += sizeof(id);
+			world.remove(header.Target, id);
+			break;
+		}
+		}
+	}
+}
+
+} /* namespace game */
+
+/* end of file */
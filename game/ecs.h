@@ -0,0 +1,359 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Archetype entity component system.
+Entities with the same set of component types share an archetype, which
+stores them in 16 KB chunks, one array per component type in each chunk,
+so iterating a component touches consecutive memory only. Removing an
+entity moves the last entity of its archetype into the hole, so chunks
+stay dense, and emptied chunks are kept for reuse.
+
+Components are trivially copyable structs, identified by a small integer
+that is assigned on first use, so a set of component types is a 64-bit
+mask. Queries cache the archetypes that match their mask, and only look
+at archetypes created since their last use.
+
+The world is not synchronized. Jobs iterating chunks in parallel may
+write the components of their own chunk, and record structural changes
+into an `EntityCommandBuffer` per job, which is applied at a sync point
+on a single thread.
+
+*/
+
+#pragma once
+#ifndef GAME_ECS_H
+#define GAME_ECS_H
+
+#include "platform.h"
+#include "handle_pool.h"
+#include "job_system.h"
+
+#include <vector>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <type_traits>
+
+namespace game {
+
+typedef Handle<struct EntityTag> Entity;
+typedef uint64_t ComponentMask;
+
+constexpr size_t EcsChunkSize = 16 * 1024;
+constexpr int MaxComponentTypes = 64;
+
+struct ComponentType
+{
+	uint32_t Size;
+	uint32_t Alignment;
+};
+
+// Called once per component type, throws when there are too many types
+int registerComponentType(size_t size, size_t alignment);
+const ComponentType &componentType(int id);
+
+template<typename T>
+inline int componentId()
+{
+	static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "Components are moved by memcpy");
+	static const int id = registerComponentType(sizeof(T), alignof(T));
+	return id;
+}
+
+template<typename... Ts>
+inline ComponentMask componentMask()
+{
+	return (ComponentMask(0) | ... | (ComponentMask(1) << componentId<Ts>()));
+}
+
+// Entities with the same component types, the layout of each chunk is
+// the entity array followed by one array per component type
+struct Archetype
+{
+	ComponentMask Mask;
+	uint32_t Capacity; // Entities per chunk
+	uint32_t Offsets[MaxComponentTypes]; // Array offset in the chunk by component id
+	std::vector<int> Components; // Component ids in the mask
+	std::vector<uint8_t *> Chunks; // Kept when emptied
+	size_t Count = 0; // Entities, the first chunks are full
+
+	// Cached archetype transitions by component id
+	Archetype *AddEdges[MaxComponentTypes] = { };
+	Archetype *RemoveEdges[MaxComponentTypes] = { };
+
+	inline size_t chunkCount() const { return (Count + Capacity - 1) / Capacity; }
+};
+
+// One chunk of an archetype while iterating
+class ArchetypeChunk
+{
+public:
+	ArchetypeChunk(const Archetype *archetype, size_t chunk)
+		: m_Archetype(archetype), m_Data(archetype->Chunks[chunk])
+		, m_Count((uint32_t)std::min<size_t>(archetype->Count - chunk * archetype->Capacity, archetype->Capacity)) { }
+
+	inline uint32_t count() const { return m_Count; }
+	inline const Entity *entities() const { return (const Entity *)m_Data; }
+
+	template<typename T>
+	inline bool has() const { return m_Archetype->Mask & (ComponentMask(1) << componentId<T>()); }
+
+	// Array of `count()` components, the chunk must have the type
+	template<typename T>
+	inline T *get() const
+	{
+		GAME_DEBUG_ASSERT(has<T>());
+		return (T *)(m_Data + m_Archetype->Offsets[componentId<T>()]);
+	}
+
+private:
+	const Archetype *m_Archetype;
+	uint8_t *m_Data;
+	uint32_t m_Count;
+
+};
+
+// Entities that have all of the `all` components and none of the `none` components
+class EntityQuery
+{
+public:
+	EntityQuery(ComponentMask all, ComponentMask none = 0) : m_All(all), m_None(none) { }
+
+	template<typename... Ts>
+	static EntityQuery of() { return EntityQuery(componentMask<Ts...>()); }
+
+	inline ComponentMask all() const { return m_All; }
+	inline ComponentMask none() const { return m_None; }
+
+private:
+	friend class World;
+
+	ComponentMask m_All;
+	ComponentMask m_None;
+
+	// Cache of the world it was last used with
+	const class World *m_World = null;
+	size_t m_ArchetypesSeen = 0;
+	std::vector<Archetype *> m_Archetypes;
+	std::vector<ArchetypeChunk> m_Chunks;
+
+};
+
+class World
+{
+public:
+	World();
+	~World() noexcept;
+
+	World(const World &other) = delete;
+	World &operator=(const World &other) = delete;
+
+	// Create an entity with zeroed components
+	[[nodiscard]] Entity create(ComponentMask mask);
+
+	template<typename... Ts>
+	inline Entity create(const Ts &...values)
+	{
+		Entity entity = create(componentMask<Ts...>());
+		((*get<Ts>(entity) = values), ...);
+		return entity;
+	}
+
+	// Stale handles are ignored
+	void destroy(Entity entity);
+	inline bool valid(Entity entity) const { return m_Entities.valid(entity); }
+
+	// Null when the entity is stale or doesn't have the component
+	void *get(Entity entity, int component);
+	ComponentMask mask(Entity entity) const;
+
+	// Add a zeroed component, or return the existing one, the entity must be valid
+	void *add(Entity entity, int component);
+	void remove(Entity entity, int component);
+
+	template<typename T>
+	inline T *get(Entity entity) { return (T *)get(entity, componentId<T>()); }
+	template<typename T>
+	inline bool has(Entity entity) const { return mask(entity) & (ComponentMask(1) << componentId<T>()); }
+	template<typename T>
+	inline T *add(Entity entity, const T &value) { T *res = (T *)add(entity, componentId<T>()); *res = value; return res; }
+	template<typename T>
+	inline void remove(Entity entity) { remove(entity, componentId<T>()); }
+
+	// Destroy all entities, chunks and archetypes are kept
+	void clear();
+
+	inline size_t size() const { return m_Entities.size(); }
+	inline size_t archetypeCount() const { return m_Archetypes.size(); }
+
+	// Chunks matching the query, valid until the next structural change
+	size_t chunkCount(EntityQuery &query);
+
+	// Call `f(chunk)` for each chunk matching the query, no structural changes are allowed meanwhile
+	template<typename TFunc>
+	void forEachChunk(EntityQuery &query, TFunc &&f)
+	{
+		refresh(query);
+		IterationScope scope(this);
+		for (const ArchetypeChunk &chunk : query.m_Chunks)
+			f(chunk);
+	}
+
+	// Call `f(chunk, index)` for each chunk on the job system, the index is
+	// consecutive from zero in the order of `forEachChunk`, and waits for all
+	template<typename TFunc>
+	void forEachChunk(JobSystem &jobs, EntityQuery &query, TFunc &&f)
+	{
+		refresh(query);
+		IterationScope scope(this);
+		const std::vector<ArchetypeChunk> &chunks = query.m_Chunks;
+		jobs.parallelFor(0, (int64_t)chunks.size(), 1, [&](int64_t begin, int64_t end) -> void {
+			for (int64_t i = begin; i < end; ++i)
+				f(chunks[i], (size_t)i);
+		});
+	}
+
+	// Call `f(entity, components...)` for each entity matching the query
+	template<typename... Ts, typename TFunc>
+	void forEach(EntityQuery &query, TFunc &&f)
+	{
+		forEachChunk(query, [&](const ArchetypeChunk &chunk) -> void {
+			const Entity *entities = chunk.entities();
+			std::tuple<Ts *...> arrays(chunk.get<Ts>()...);
+			for (uint32_t i = 0; i < chunk.count(); ++i)
+				f(entities[i], std::get<Ts *>(arrays)[i]...);
+		});
+	}
+
+private:
+	struct Location
+	{
+		Archetype *Owner;
+		size_t Row;
+	};
+
+	struct IterationScope
+	{
+		IterationScope(World *world) : m_World(world) { ++m_World->m_Iterating; }
+		~IterationScope() noexcept { --m_World->m_Iterating; }
+		World *m_World;
+	};
+
+	Archetype *archetype(ComponentMask mask);
+	void reserveRow(Archetype *archetype); // So that allocating the row doesn't throw
+	size_t allocateRow(Archetype *archetype, Entity entity);
+	void removeRow(Archetype *archetype, size_t row);
+	void move(Entity entity, Location &location, Archetype *to);
+	void refresh(EntityQuery &query);
+
+	static inline uint8_t *component(const Archetype *archetype, size_t row, int id)
+	{
+		return archetype->Chunks[row / archetype->Capacity]
+			+ archetype->Offsets[id]
+			+ (row % archetype->Capacity) * componentType(id).Size;
+	}
+
+	static inline Entity &entityAt(const Archetype *archetype, size_t row)
+	{
+		return ((Entity *)archetype->Chunks[row / archetype->Capacity])[row % archetype->Capacity];
+	}
+
+private:
+	HandlePool<Entity, Location> m_Entities;
+	std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+	std::unordered_map<ComponentMask, Archetype *> m_ArchetypeMap;
+	Archetype *m_Empty;
+	int m_Iterating = 0;
+
+};
+
+// Structural changes recorded for later, applied in order at a sync point,
+// commands on entities that are stale by then are ignored
+class EntityCommandBuffer
+{
+public:
+	template<typename... Ts>
+	void create(const Ts &...values)
+	{
+		writeHeader(Command::Create, Entity(), sizeof...(Ts));
+		(writeComponent(componentId<Ts>(), &values), ...);
+	}
+
+	inline void destroy(Entity entity) { writeHeader(Command::Destroy, entity, 0); }
+
+	template<typename T>
+	void add(Entity entity, const T &value)
+	{
+		writeHeader(Command::Add, entity, 1);
+		writeComponent(componentId<T>(), &value);
+	}
+
+	template<typename T>
+	void remove(Entity entity)
+	{
+		writeHeader(Command::Remove, entity, 1);
+		writeComponent(componentId<T>(), null);
+	}
+
+	// Apply and clear, memory is kept for the next frame
+	void apply(World &world);
+
+	inline bool empty() const { return m_Data.empty(); }
+	inline void clear() { m_Data.clear(); }
+
+private:
+	enum class Command : uint8_t
+	{
+		Create,
+		Destroy,
+		Add,
+		Remove,
+	};
+
+	struct Header
+	{
+		Command Op;
+		uint32_t ComponentCount;
+		Entity Target;
+	};
+
+	void writeHeader(Command op, Entity entity, uint32_t componentCount);
+	void writeComponent(int id, const void *value); // Value is null for removal
+
+	std::vector<uint8_t> m_Data;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_ECS_H */
+
+/* end of file */
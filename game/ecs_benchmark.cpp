@@ -0,0 +1,242 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Entity component system benchmark.
+Measures the entities per second updated by chunk iteration, on one
+thread and on the job system, against heap allocated objects with a
+virtual update, and the cost of structural changes, directly and through
+a command buffer.
+
+Usage: game_ecs_benchmark [--entities N] [--repeat N] [--jobs N]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "ecs.h"
+#include "job_system.h"
+#include "simd_math.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+int64_t s_EntityCount = 1 << 17;
+int s_Repeat = 5;
+int s_Jobs = 0;
+
+constexpr float DeltaTime = 1.0f / 60.0f;
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--entities"sv)
+			s_EntityCount = atoll(value);
+		else if (arg == "--repeat"sv)
+			s_Repeat = atoi(value);
+		else if (arg == "--jobs"sv)
+			s_Jobs = atoi(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_EntityCount <= 0 || s_Repeat <= 0 || s_Jobs < 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+struct Position
+{
+	Float3 Value;
+};
+
+struct Velocity
+{
+	Float3 Value;
+};
+
+struct Health
+{
+	float Value;
+};
+
+struct Tag
+{
+	uint32_t Value;
+};
+
+// Conventional game object, allocated one by one
+class Object
+{
+public:
+	virtual ~Object() { }
+	virtual void update(float dt) { Position = Position + Velocity * dt; }
+
+	Float3 Position;
+	Float3 Velocity;
+	float Health;
+	char Name[32];
+};
+
+// Best of the repeats, in seconds
+template<typename TFunc>
+double measure(TFunc &&f)
+{
+	double best = 0.0;
+	for (int r = 0; r < s_Repeat; ++r)
+	{
+		auto start = std::chrono::steady_clock::now();
+		f();
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!r || s < best)
+			best = s;
+	}
+	return best;
+}
+
+void integrate(const ArchetypeChunk &chunk)
+{
+	Position *positions = chunk.get<Position>();
+	const Velocity *velocities = chunk.get<Velocity>();
+	for (uint32_t i = 0; i < chunk.count(); ++i)
+		positions[i].Value = positions[i].Value + velocities[i].Value * DeltaTime;
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+		JobSystem jobs(s_Jobs);
+		std::mt19937 rng(1);
+
+		// A quarter of the entities have health, so the query spans two archetypes
+		World world;
+		std::vector<Entity> entities;
+		entities.reserve(s_EntityCount);
+		for (int64_t i = 0; i < s_EntityCount; ++i)
+		{
+			Position position = { { (float)i, 0.0f, 0.0f } };
+			Velocity velocity = { { 1.0f, 2.0f, 3.0f } };
+			entities.push_back((i & 3) ? world.create(position, velocity) : world.create(position, velocity, Health { 1.0f }));
+		}
+
+		// Objects allocated in shuffled order, as after a while of gameplay
+		std::vector<std::unique_ptr<Object>> objects(s_EntityCount);
+		std::vector<int64_t> order(s_EntityCount);
+		for (int64_t i = 0; i < s_EntityCount; ++i)
+			order[i] = i;
+		std::shuffle(order.begin(), order.end(), rng);
+		for (int64_t i : order)
+		{
+			objects[i] = std::make_unique<Object>();
+			objects[i]->Position = { (float)i, 0.0f, 0.0f };
+			objects[i]->Velocity = { 1.0f, 2.0f, 3.0f };
+		}
+
+		fmt::print("Entities: {}, repeat: {}, jobs: {}, archetypes: {}\n", s_EntityCount, s_Repeat, jobs.workerCount(), world.archetypeCount());
+		fmt::print("case, million entities per second\n");
+		auto report = [](std::string_view name, double s) -> void {
+			fmt::print("{}, {:.1f}\n", name, (double)s_EntityCount / s * 1e-6);
+		};
+
+		EntityQuery moving = EntityQuery::of<Position, Velocity>();
+		report("objects, virtual update"sv, measure([&]() -> void {
+			for (std::unique_ptr<Object> &object : objects)
+				object->update(DeltaTime);
+		}));
+		report("chunks"sv, measure([&]() -> void {
+			world.forEachChunk(moving, integrate);
+		}));
+		report("chunks, per entity callback"sv, measure([&]() -> void {
+			world.forEach<Position, Velocity>(moving, [](Entity, Position &position, const Velocity &velocity) -> void {
+				position.Value = position.Value + velocity.Value * DeltaTime;
+			});
+		}));
+		report("chunks, parallel"sv, measure([&]() -> void {
+			world.forEachChunk(jobs, moving, [](const ArchetypeChunk &chunk, size_t) -> void { integrate(chunk); });
+		}));
+
+		// Churn, each entity moves to another archetype and back
+		report("add and remove component"sv, measure([&]() -> void {
+			for (Entity entity : entities)
+				world.add(entity, Tag { 1 });
+			for (Entity entity : entities)
+				world.remove<Tag>(entity);
+		}) * 0.5);
+		EntityCommandBuffer commands;
+		report("add and remove component, command buffer"sv, measure([&]() -> void {
+			for (Entity entity : entities)
+				commands.add(entity, Tag { 1 });
+			commands.apply(world);
+			for (Entity entity : entities)
+				commands.remove<Tag>(entity);
+			commands.apply(world);
+		}) * 0.5);
+		report("destroy and create"sv, measure([&]() -> void {
+			for (Entity &entity : entities)
+			{
+				world.destroy(entity);
+				entity = world.create(Position { }, Velocity { { 1.0f, 2.0f, 3.0f } });
+			}
+		}));
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
@@ -0,0 +1,248 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "egl_context.h"
+#include "exception.h"
+#include "gl_exception.h"
+#include "gl_renderer.h"
+#include "log.h"
+
+#include <EGL/eglext.h>
+
+#define GAME_THROW_EGL_ERROR(msg) GAME_THROW(Exception(fmt::format(msg "\nEGL error: 0x{:04x}", eglGetError())))
+
+namespace game {
+
+namespace /* anonymous */ {
+
+bool hasExtension(const char *extensions, std::string_view name)
+{
+	if (!extensions)
+		return false;
+	std::string_view exts = extensions;
+	size_t pos = 0;
+	while ((pos = exts.find(name, pos)) != std::string_view::npos)
+	{
+		size_t end = pos + name.size();
+		if ((!pos || exts[pos - 1] == ' ') && (end == exts.size() || exts[end] == ' '))
+			return true;
+		pos = end;
+	}
+	return false;
+}
+
+EGLDisplay getDisplay()
+{
+	// Prefer the Mesa surfaceless platform, it needs neither X11 nor a DRM device
+	const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"sv))
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (eglGetPlatformDisplayEXT)
+		{
+			EGLDisplay display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, null);
+			if (display != EGL_NO_DISPLAY)
+				return display;
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+} /* anonymous namespace */
+
+EglContext::EglContext()
+{
+	GAME_FINALLY([&]() -> void {
+		if (!m_Context && m_Display != EGL_NO_DISPLAY)
+		{
+			// Failed to initialize
+			if (m_Surface != EGL_NO_SURFACE)
+				eglDestroySurface(m_Display, m_Surface);
+			eglTerminate(m_Display);
+		}
+	});
+
+	m_Display = getDisplay();
+	if (m_Display == EGL_NO_DISPLAY)
+		GAME_THROW_EGL_ERROR("Failed to get EGL display.");
+	EGLint major, minor;
+	if (!eglInitialize(m_Display, &major, &minor))
+	{
+		m_Display = EGL_NO_DISPLAY;
+		GAME_THROW_EGL_ERROR("Failed to initialize EGL.");
+	}
+	if (!eglBindAPI(EGL_OPENGL_API))
+		GAME_THROW_EGL_ERROR("OpenGL is not supported by EGL.");
+
+	const char *extensions = eglQueryString(m_Display, EGL_EXTENSIONS);
+	bool surfaceless = hasExtension(extensions, "EGL_KHR_surfaceless_context"sv);
+	if (!hasExtension(extensions, "EGL_KHR_create_context"sv) && (major < 1 || (major == 1 && minor < 5)))
+		throw Exception("Missing extension `EGL_KHR_create_context`.");
+	GAME_LOG_INFO("EGL {}.{}, vendor: {}", major, minor, eglQueryString(m_Display, EGL_VENDOR));
+	GAME_LOG_DEBUG("EGL extensions: {}", extensions);
+
+	const EGLint attribs[] = {
+		EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(m_Display, attribs, &config, 1, &numConfigs) || !numConfigs)
+		GAME_THROW_EGL_ERROR("Failed to choose EGL config.");
+
+	if (!surfaceless)
+	{
+		// Framebuffer object is used for rendering, the surface only exists to make the context current
+		const EGLint pbufferAttribs[] = {
+			EGL_WIDTH, 1,
+			EGL_HEIGHT, 1,
+			EGL_NONE
+		};
+		m_Surface = eglCreatePbufferSurface(m_Display, config, pbufferAttribs);
+		if (m_Surface == EGL_NO_SURFACE)
+			GAME_THROW_EGL_ERROR("Failed to create EGL pbuffer surface.");
+	}
+
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, GAME_GL_MAJOR,
+		EGL_CONTEXT_MINOR_VERSION_KHR, GAME_GL_MINOR,
+		EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE_BIT_KHR | (GAME_GL_DEBUG_CONTEXT ? EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR : 0),
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_NONE
+	};
+
+	EGLContext context = eglCreateContext(m_Display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT)
+		GAME_THROW_EGL_ERROR("Failed to create OpenGL " GAME_STR(GAME_GL_MAJOR) "." GAME_STR(GAME_GL_MINOR) " core context.");
+	GAME_FINALLY([&]() -> void { if (context != EGL_NO_CONTEXT) eglDestroyContext(m_Display, context); });
+	if (!eglMakeCurrent(m_Display, m_Surface, m_Surface, context))
+		GAME_THROW_EGL_ERROR("Failed to make EGL context current.");
+
+	// Initialize GL
+	if (gl3wInit2((GL3WGetProcAddressProc)eglGetProcAddress))
+		throw Exception("OpenGL failed to initialize."sv, 1);
+	if (!gl3wIsSupported(GAME_GL_MAJOR, GAME_GL_MINOR))
+		throw Exception("OpenGL " GAME_STR(GAME_GL_MAJOR) "." GAME_STR(GAME_GL_MINOR)
+			" is not supported by the installed graphics drivers."sv, 1);
+	GAME_THROW_IF_GL_ERROR(); // Should not happen, but flush it anyway!
+
+	initGlContext();
+
+	m_Context = context;
+	context = EGL_NO_CONTEXT;
+}
+
+EglContext::~EglContext() noexcept
+{
+	if (eglMakeCurrent(m_Display, m_Surface, m_Surface, m_Context))
+		releaseFramebuffer();
+	eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(m_Display, m_Context);
+	if (m_Surface != EGL_NO_SURFACE)
+		eglDestroySurface(m_Display, m_Surface);
+	eglTerminate(m_Display);
+}
+
+void EglContext::makeCurrent(int width, int height)
+{
+	if (eglGetCurrentContext() != m_Context
+		&& !eglMakeCurrent(m_Display, m_Surface, m_Surface, m_Context))
+		GAME_THROW_EGL_ERROR("Failed to make EGL context current.");
+	if (width != m_Width || height != m_Height)
+		resize(width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+}
+
+void EglContext::swapBuffers()
+{
+	// No presentation engine to throttle against,
+	// wait for the frame so that frame times include the driver work
+	glFinish();
+}
+
+void EglContext::releaseCurrent()
+{
+	if (eglGetCurrentContext() == m_Context
+		&& !eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT))
+		GAME_THROW_EGL_ERROR("Failed to release EGL context.");
+}
+
+void EglContext::resize(int width, int height)
+{
+	releaseFramebuffer();
+
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	GAME_FINALLY([&]() -> void { GAME_SAFE_GL_DELETE_ONE(glDeleteFramebuffers, framebuffer); });
+	GLuint renderbuffers[2];
+	glGenRenderbuffers(2, renderbuffers);
+	GAME_FINALLY([&]() -> void { GAME_SAFE_GL_DELETE_ALL(glDeleteRenderbuffers, renderbuffers); });
+	{
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		GAME_CHECK_GL_ERROR_SCOPE();
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+			GAME_THROW(Exception(fmt::format("Offscreen framebuffer is not complete\nStatus: 0x{:04x}", status)));
+	}
+
+	m_Framebuffer = framebuffer;
+	framebuffer = 0;
+	m_Renderbuffers[0] = renderbuffers[0];
+	m_Renderbuffers[1] = renderbuffers[1];
+	renderbuffers[0] = 0;
+	renderbuffers[1] = 0;
+	m_Width = width;
+	m_Height = height;
+}
+
+void EglContext::releaseFramebuffer() noexcept
+{
+	if (m_Framebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GAME_SAFE_GL_DELETE_ONE(glDeleteFramebuffers, m_Framebuffer);
+	}
+	GAME_SAFE_GL_DELETE_ALL(glDeleteRenderbuffers, m_Renderbuffers);
+	m_Width = 0;
+	m_Height = 0;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,88 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Offscreen GL context for hosts without a window system, or without a GPU.
+Creates the same core profile context as the Win32 build through EGL,
+preferring the Mesa surfaceless platform, and renders into a framebuffer object.
+
+*/
+
+#pragma once
+#ifndef GAME_EGL_CONTEXT_H
+#define GAME_EGL_CONTEXT_H
+
+#include "platform.h"
+
+#include <EGL/egl.h>
+
+namespace game {
+
+class EglContext
+{
+public:
+	EglContext();
+	~EglContext() noexcept;
+
+	EglContext(const EglContext &other) = delete;
+	EglContext &operator=(const EglContext &other) = delete;
+
+	// Make the context current, and bind the offscreen framebuffer at the requested size
+	void makeCurrent(int width, int height);
+
+	// Finish the frame, there is nothing to present
+	void swapBuffers();
+
+	// Release the context from the calling thread, so it can be made current on another
+	void releaseCurrent();
+
+	inline GLuint framebuffer() const { return m_Framebuffer; }
+
+private:
+	void resize(int width, int height);
+	void releaseFramebuffer() noexcept;
+
+private:
+	EGLDisplay m_Display = EGL_NO_DISPLAY;
+	EGLContext m_Context = EGL_NO_CONTEXT;
+	EGLSurface m_Surface = EGL_NO_SURFACE; // Pbuffer, only when surfaceless contexts are not supported
+
+	GLuint m_Framebuffer = 0;
+	GLuint m_Renderbuffers[2] = { }; // sRGB color, depth stencil
+	int m_Width = 0;
+	int m_Height = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_EGL_CONTEXT_H */
+
+/* end of file */
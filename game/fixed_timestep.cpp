@@ -0,0 +1,72 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "fixed_timestep.h"
+#include "exception.h"
+
+namespace game {
+
+FixedTimestep::FixedTimestep(Clock *clock, int stepsPerSecond, int maxSteps)
+	: m_Clock(clock), m_MaxSteps(maxSteps)
+{
+	if (stepsPerSecond <= 0 || maxSteps <= 0)
+		GAME_THROW(Exception("Invalid fixed timestep"sv, 1));
+	m_Step = 1000000000 / stepsPerSecond;
+	m_Last = m_Clock->now();
+}
+
+int FixedTimestep::advance()
+{
+	int64_t now = m_Clock->now();
+	m_Accumulator += now - m_Last;
+	m_Last = now;
+
+	int64_t steps = m_Accumulator / m_Step;
+	if (steps > m_MaxSteps)
+	{
+		// Fallen behind, catch up no further than the cap and keep the fraction
+		int64_t dropped = (steps - m_MaxSteps) * m_Step;
+		m_Dropped += dropped;
+		m_Accumulator -= dropped;
+		steps = m_MaxSteps;
+	}
+	m_Accumulator -= steps * m_Step;
+	m_Steps += steps;
+	return (int)steps;
+}
+
+void FixedTimestep::reset()
+{
+	m_Last = m_Clock->now();
+	m_Accumulator = 0;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,89 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Fixed step simulation clock.
+Each frame, the time elapsed on the clock is added to an accumulator,
+and the simulation runs as many whole steps as fit in it, zero or more.
+The remainder, as a fraction of a step, is the interpolation alpha
+between the last two simulation states for rendering.
+
+When the simulation falls behind, at most `maxSteps` steps run in one
+frame and the excess time is dropped, so that a frame that is slow
+because of the simulation doesn't cause ever more steps in the next.
+
+*/
+
+#pragma once
+#ifndef GAME_FIXED_TIMESTEP_H
+#define GAME_FIXED_TIMESTEP_H
+
+#include "platform.h"
+#include "clock.h"
+
+namespace game {
+
+class FixedTimestep
+{
+public:
+	FixedTimestep(Clock *clock, int stepsPerSecond = 60, int maxSteps = 4);
+
+	// Steps to run this frame, from the time elapsed since the previous call
+	[[nodiscard]] int advance();
+
+	// Restart timing from now, for example after loading or a pause
+	void reset();
+
+	// Fraction of a step between the last step and now, in [0, 1)
+	inline float alpha() const { return (float)((double)m_Accumulator / (double)m_Step); }
+
+	inline int64_t stepNs() const { return m_Step; }
+	inline float stepSeconds() const { return (float)((double)m_Step * 1e-9); }
+
+	// Totals since construction, for statistics
+	inline int64_t steps() const { return m_Steps; }
+	inline int64_t droppedNs() const { return m_Dropped; }
+
+private:
+	Clock *m_Clock;
+	int64_t m_Step;
+	int m_MaxSteps;
+	int64_t m_Last;
+	int64_t m_Accumulator = 0;
+	int64_t m_Steps = 0;
+	int64_t m_Dropped = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_FIXED_TIMESTEP_H */
+
+/* end of file */
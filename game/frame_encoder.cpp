@@ -0,0 +1,536 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "frame_encoder.h"
+#include "exception.h"
+#include "profiler.h"
+
+#include <chrono>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+FrameFormat formatOf(std::string_view path)
+{
+	size_t dot = path.find_last_of('.');
+	std::string_view ext = dot == std::string_view::npos ? std::string_view() : path.substr(dot);
+	if (ext == ".png"sv)
+		return FrameFormat::Png;
+	if (ext == ".y4m"sv)
+		return FrameFormat::Y4m;
+	return FrameFormat::Yuv;
+}
+
+/*
+
+PNG, as RGB with the Up filter, compressed with a single fixed Huffman deflate
+block and greedy LZ77 matching on a three byte hash. The compression is far from
+the best, but it's fast, and flat rendered frames still compress well.
+
+*/
+
+const uint32_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint32_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint32_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint32_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+constexpr int MaxMatch = 258;
+constexpr size_t MaxDistance = 32768;
+constexpr int HashBits = 15;
+constexpr int MaxInsert = 16; // Longer matches don't insert their positions into the hash
+
+struct HuffmanCode
+{
+	uint16_t Bits; // Reversed, deflate writes codes from the most significant bit
+	uint8_t Length;
+};
+
+struct DeflateTables
+{
+	HuffmanCode Literals[288];
+	HuffmanCode Distances[30];
+	uint8_t LengthCodes[MaxMatch + 1]; // By match length
+	uint8_t DistanceCodes[512]; // By distance - 1 below 256, else 256 + ((distance - 1) >> 7)
+	uint32_t Crc[256];
+
+	DeflateTables()
+	{
+		for (int symbol = 0; symbol < 288; ++symbol)
+		{
+			if (symbol < 144)
+				Literals[symbol] = code(0x30 + symbol, 8);
+			else if (symbol < 256)
+				Literals[symbol] = code(0x190 + symbol - 144, 9);
+			else if (symbol < 280)
+				Literals[symbol] = code(symbol - 256, 7);
+			else
+				Literals[symbol] = code(0xC0 + symbol - 280, 8);
+		}
+		for (int i = 0; i < 30; ++i)
+		{
+			Distances[i] = code(i, 5);
+			for (uint32_t distance = DistanceBase[i]; distance < DistanceBase[i] + (1u << DistanceExtra[i]); ++distance)
+			{
+				uint32_t d = distance - 1;
+				DistanceCodes[d < 256 ? d : 256 + (d >> 7)] = (uint8_t)i;
+			}
+		}
+		for (int i = 0; i < 29; ++i)
+		{
+			for (uint32_t length = LengthBase[i]; length < LengthBase[i] + (1u << LengthExtra[i]) && length <= MaxMatch; ++length)
+				LengthCodes[length] = (uint8_t)i;
+		}
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			Crc[n] = c;
+		}
+	}
+
+	static HuffmanCode code(int bits, int length)
+	{
+		uint16_t reversed = 0;
+		for (int i = 0; i < length; ++i)
+			reversed |= (uint16_t)(((bits >> i) & 1) << (length - 1 - i));
+		return { reversed, (uint8_t)length };
+	}
+};
+
+const DeflateTables s_Deflate;
+
+class BitWriter
+{
+public:
+	BitWriter(std::vector<uint8_t> &out) : m_Out(out) { }
+
+	inline void write(uint32_t bits, uint32_t count)
+	{
+		m_Bits |= (uint64_t)bits << m_Count;
+		m_Count += count;
+		while (m_Count >= 8)
+		{
+			m_Out.push_back((uint8_t)m_Bits);
+			m_Bits >>= 8;
+			m_Count -= 8;
+		}
+	}
+
+	inline void write(const HuffmanCode &code) { write(code.Bits, code.Length); }
+
+	void flush()
+	{
+		if (m_Count)
+			m_Out.push_back((uint8_t)m_Bits);
+		m_Bits = 0;
+		m_Count = 0;
+	}
+
+private:
+	std::vector<uint8_t> &m_Out;
+	uint64_t m_Bits = 0;
+	uint32_t m_Count = 0;
+
+};
+
+inline uint32_t hash3(const uint8_t *p)
+{
+	return (((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | (uint32_t)p[2]) * 2654435761u) >> (32 - HashBits);
+}
+
+// Appends a zlib stream, the head table holds the last position of each hash plus one
+void deflate(const uint8_t *data, size_t size, std::vector<int32_t> &head, std::vector<uint8_t> &out)
+{
+	head.assign((size_t)1 << HashBits, 0);
+	out.push_back(0x78); // Deflate, 32K window
+	out.push_back(0x01); // Fastest
+	BitWriter bits(out);
+	bits.write(1, 1); // Final block
+	bits.write(1, 2); // Fixed Huffman codes
+	size_t pos = 0;
+	while (pos + 3 <= size)
+	{
+		uint32_t h = hash3(&data[pos]);
+		size_t candidate = (size_t)head[h];
+		head[h] = (int32_t)(pos + 1);
+		if (candidate && pos - (candidate - 1) <= MaxDistance
+			&& !memcmp(&data[candidate - 1], &data[pos], 3))
+		{
+			const uint8_t *match = &data[candidate - 1];
+			size_t maxLength = std::min<size_t>(MaxMatch, size - pos);
+			size_t length = 3;
+			while (length < maxLength && match[length] == data[pos + length])
+				++length;
+			uint32_t distance = (uint32_t)(&data[pos] - match);
+			int lengthCode = s_Deflate.LengthCodes[length];
+			bits.write(s_Deflate.Literals[257 + lengthCode]);
+			bits.write((uint32_t)length - LengthBase[lengthCode], LengthExtra[lengthCode]);
+			uint32_t d = distance - 1;
+			int distanceCode = s_Deflate.DistanceCodes[d < 256 ? d : 256 + (d >> 7)];
+			bits.write(s_Deflate.Distances[distanceCode]);
+			bits.write(distance - DistanceBase[distanceCode], DistanceExtra[distanceCode]);
+			if (length <= MaxInsert)
+			{
+				for (size_t i = 1; i < length && pos + i + 3 <= size; ++i)
+					head[hash3(&data[pos + i])] = (int32_t)(pos + i + 1);
+			}
+			pos += length;
+		}
+		else
+		{
+			bits.write(s_Deflate.Literals[data[pos]]);
+			++pos;
+		}
+	}
+	for (; pos < size; ++pos)
+		bits.write(s_Deflate.Literals[data[pos]]);
+	bits.write(s_Deflate.Literals[256]); // End of block
+	bits.flush();
+
+	// Adler-32, summed in runs that can't overflow
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < size;)
+	{
+		size_t end = std::min<size_t>(size, i + 5552);
+		for (; i < end; ++i)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	uint32_t adler = (b << 16) | a;
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back((uint8_t)(adler >> shift));
+}
+
+void appendU32(std::vector<uint8_t> &out, uint32_t value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back((uint8_t)(value >> shift));
+}
+
+// Chunk length, type and data are in place from the offset, appends the CRC
+void endChunk(std::vector<uint8_t> &out, size_t offset)
+{
+	uint32_t length = (uint32_t)(out.size() - offset - 8);
+	for (int i = 0; i < 4; ++i)
+		out[offset + i] = (uint8_t)(length >> (24 - 8 * i));
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = offset + 4; i < out.size(); ++i)
+		crc = s_Deflate.Crc[(crc ^ out[i]) & 0xFF] ^ (crc >> 8);
+	appendU32(out, crc ^ 0xFFFFFFFFu);
+}
+
+void beginChunk(std::vector<uint8_t> &out, const char type[4])
+{
+	appendU32(out, 0); // Length, filled in by endChunk
+	out.insert(out.end(), type, type + 4);
+}
+
+// BT.709 limited range, from sRGB encoded values, chroma averaged over 2x2 pixels
+void convertI420(const uint8_t *rgba, int width, int height, uint8_t *planes)
+{
+	const int chromaWidth = (width + 1) / 2;
+	const int chromaHeight = (height + 1) / 2;
+	uint8_t *yPlane = planes;
+	uint8_t *uPlane = yPlane + (size_t)width * height;
+	uint8_t *vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+	const size_t stride = (size_t)width * 4;
+	for (int y = 0; y < height; ++y)
+	{
+		const uint8_t *row = rgba + (size_t)(height - 1 - y) * stride; // Bottom up
+		uint8_t *out = yPlane + (size_t)y * width;
+		for (int x = 0; x < width; ++x)
+		{
+			const uint8_t *p = row + (size_t)x * 4;
+			out[x] = (uint8_t)(((47 * p[0] + 157 * p[1] + 16 * p[2] + 128) >> 8) + 16);
+		}
+	}
+	for (int cy = 0; cy < chromaHeight; ++cy)
+	{
+		const uint8_t *row0 = rgba + (size_t)(height - 1 - cy * 2) * stride;
+		const uint8_t *row1 = rgba + (size_t)(height - 1 - std::min(cy * 2 + 1, height - 1)) * stride;
+		for (int cx = 0; cx < chromaWidth; ++cx)
+		{
+			const size_t x0 = (size_t)cx * 8;
+			const size_t x1 = (size_t)std::min(cx * 2 + 1, width - 1) * 4;
+			int r = (row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2;
+			int g = (row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1] + 2) >> 2;
+			int b = (row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2] + 2) >> 2;
+			const size_t i = (size_t)cy * chromaWidth + cx;
+			uPlane[i] = (uint8_t)((-26 * r - 86 * g + 112 * b + 32896) >> 8);
+			vPlane[i] = (uint8_t)((112 * r - 102 * g - 10 * b + 32896) >> 8);
+		}
+	}
+}
+
+} /* anonymous namespace */
+
+FrameEncoder::FrameEncoder(std::string_view path, int threads, int frameRate, int buffers)
+	: m_Format(formatOf(path)), m_Path(path), m_FrameRate(std::max(frameRate, 1))
+{
+	if (m_Format == FrameFormat::Png)
+	{
+		m_Path.resize(m_Path.size() - 4); // Numbered files are named after the stem
+	}
+	else
+	{
+		m_File = fopen(m_Path.c_str(), "wb");
+		if (!m_File)
+			GAME_THROW(Exception(fmt::format("Failed to open `{}`", m_Path)));
+	}
+	buffers = std::max(buffers, 1);
+	m_Frames.reserve(buffers);
+	m_Free.reserve(buffers);
+	m_Queue.resize(buffers);
+	for (int i = 0; i < buffers; ++i)
+	{
+		m_Frames.push_back(std::make_unique<Frame>());
+		m_Free.push_back(m_Frames.back().get());
+	}
+	threads = std::max(threads, 1);
+	m_Threads.reserve(threads);
+	for (int i = 0; i < threads; ++i)
+		m_Threads.push_back(std::thread(&FrameEncoder::threadMain, this));
+}
+
+FrameEncoder::~FrameEncoder() noexcept
+{
+	GAME_DEBUG_ASSERT(!m_Acquired);
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Exit = true;
+	}
+	m_QueueCondition.notify_all();
+	for (std::thread &thread : m_Threads)
+		thread.join();
+	if (m_File)
+		fclose(m_File);
+}
+
+[[nodiscard]] uint8_t *FrameEncoder::acquire(int width, int height)
+{
+	GAME_DEBUG_ASSERT(!m_Acquired);
+	Frame *frame;
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_Free.empty())
+		{
+			auto start = std::chrono::steady_clock::now();
+			m_FreeCondition.wait(lock, [&]() -> bool { return !m_Free.empty(); });
+			++m_Stats.Stalls;
+			m_Stats.StallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+		frame = m_Free.back();
+		m_Free.pop_back();
+	}
+	frame->Width = width;
+	frame->Height = height;
+	frame->Pixels.resize((size_t)width * height * 4); // Only allocates when the frame grows
+	m_Acquired = frame;
+	return frame->Pixels.data();
+}
+
+void FrameEncoder::submit()
+{
+	GAME_DEBUG_ASSERT(m_Acquired);
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Acquired->Index = m_Submitted++;
+		m_Queue[(m_QueueHead + m_QueueCount) % m_Queue.size()] = m_Acquired;
+		++m_QueueCount;
+		++m_Busy;
+		++m_Stats.Submitted;
+	}
+	m_Acquired = null;
+	m_QueueCondition.notify_one();
+}
+
+void FrameEncoder::finish()
+{
+	std::exception_ptr ex;
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_FreeCondition.wait(lock, [&]() -> bool { return !m_Busy; });
+		std::swap(ex, m_Exception);
+	}
+	if (m_File)
+		fflush(m_File);
+	if (ex)
+		std::rethrow_exception(ex);
+}
+
+[[nodiscard]] FrameEncoderStats FrameEncoder::stats()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+void FrameEncoder::threadMain()
+{
+	GAME_PROFILE_THREAD("Encoder");
+	for (;;)
+	{
+		Frame *frame;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_QueueCondition.wait(lock, [&]() -> bool { return m_Exit || m_QueueCount; });
+			if (!m_QueueCount)
+				return; // Exit once all frames are written
+			frame = m_Queue[m_QueueHead];
+			m_QueueHead = (m_QueueHead + 1) % m_Queue.size();
+			--m_QueueCount;
+		}
+		auto start = std::chrono::steady_clock::now();
+		std::exception_ptr ex;
+		int64_t bytes = 0;
+		try
+		{
+			bytes = m_Format == FrameFormat::Png ? encodePng(*frame) : encodeVideo(*frame);
+		}
+		catch (...)
+		{
+			ex = std::current_exception();
+		}
+		auto end = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			if (ex && !m_Exception)
+				m_Exception = ex;
+			if (bytes > 0)
+			{
+				++m_Stats.Written;
+				m_Stats.Bytes += bytes;
+			}
+			else if (!ex)
+			{
+				++m_Stats.Skipped;
+			}
+			m_Stats.EncodeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+			m_Free.push_back(frame);
+			--m_Busy;
+		}
+		m_FreeCondition.notify_all();
+	}
+}
+
+int64_t FrameEncoder::encodePng(Frame &frame)
+{
+	// Filtered rows, top down, each prefixed by its filter type
+	const size_t rowSize = (size_t)frame.Width * 3 + 1;
+	frame.Scratch.resize(rowSize * frame.Height);
+	const size_t stride = (size_t)frame.Width * 4;
+	for (int y = 0; y < frame.Height; ++y)
+	{
+		const uint8_t *row = &frame.Pixels[(size_t)(frame.Height - 1 - y) * stride];
+		const uint8_t *above = y ? row + stride : null;
+		uint8_t *out = &frame.Scratch[rowSize * y];
+		*out++ = 2; // Up
+		for (int x = 0; x < frame.Width; ++x)
+		{
+			const size_t i = (size_t)x * 4;
+			for (int c = 0; c < 3; ++c)
+				*out++ = (uint8_t)(row[i + c] - (above ? above[i + c] : 0));
+		}
+	}
+
+	std::vector<uint8_t> &out = frame.Encoded;
+	out.clear();
+	out.reserve(frame.Scratch.size() + frame.Scratch.size() / 8 + 1024); // Fixed codes take up to nine bits per byte
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.insert(out.end(), signature, signature + sizeof(signature));
+	size_t chunk = out.size();
+	beginChunk(out, "IHDR");
+	appendU32(out, (uint32_t)frame.Width);
+	appendU32(out, (uint32_t)frame.Height);
+	const uint8_t header[] = { 8, 2, 0, 0, 0 }; // 8-bit RGB, deflate, adaptive filtering, not interlaced
+	out.insert(out.end(), header, header + sizeof(header));
+	endChunk(out, chunk);
+	chunk = out.size();
+	beginChunk(out, "IDAT");
+	deflate(frame.Scratch.data(), frame.Scratch.size(), frame.Hash, out);
+	endChunk(out, chunk);
+	chunk = out.size();
+	beginChunk(out, "IEND");
+	endChunk(out, chunk);
+
+	std::string path = fmt::format("{}_{:06}.png", m_Path, frame.Index);
+	std::FILE *f = fopen(path.c_str(), "wb");
+	if (!f)
+		GAME_THROW(Exception(fmt::format("Failed to open `{}`", path)));
+	size_t written = fwrite(out.data(), 1, out.size(), f);
+	if (fclose(f) || written != out.size())
+		GAME_THROW(Exception(fmt::format("Failed to write `{}`", path)));
+	return (int64_t)out.size();
+}
+
+int64_t FrameEncoder::encodeVideo(Frame &frame)
+{
+	std::exception_ptr ex;
+	const size_t size = (size_t)frame.Width * frame.Height + (size_t)((frame.Width + 1) / 2) * ((frame.Height + 1) / 2) * 2;
+	try
+	{
+		frame.Scratch.resize(size);
+		convertI420(frame.Pixels.data(), frame.Width, frame.Height, frame.Scratch.data());
+	}
+	catch (...)
+	{
+		ex = std::current_exception();
+	}
+
+	// Converted in parallel, written in order, a failed frame still passes its turn on
+	std::unique_lock<std::mutex> lock(m_WriteMutex);
+	m_WriteCondition.wait(lock, [&]() -> bool { return m_NextWrite == frame.Index; });
+	GAME_FINALLY([&]() -> void { ++m_NextWrite; m_WriteCondition.notify_all(); });
+	if (ex)
+		std::rethrow_exception(ex);
+	int64_t bytes = 0;
+	if (!m_VideoWidth)
+	{
+		m_VideoWidth = frame.Width;
+		m_VideoHeight = frame.Height;
+		if (m_Format == FrameFormat::Y4m)
+			bytes += fprintf(m_File, "YUV4MPEG2 W%i H%i F%i:1 Ip A1:1 C420jpeg\n", m_VideoWidth, m_VideoHeight, m_FrameRate);
+	}
+	if (frame.Width != m_VideoWidth || frame.Height != m_VideoHeight)
+		return 0;
+	if (m_Format == FrameFormat::Y4m)
+		bytes += fprintf(m_File, "FRAME\n");
+	if (fwrite(frame.Scratch.data(), 1, size, m_File) != size)
+		GAME_THROW(Exception(fmt::format("Failed to write `{}`", m_Path)));
+	return bytes + (int64_t)size;
+}
+
+} /* namespace game */
+
+/* end of file */
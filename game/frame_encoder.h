@@ -0,0 +1,155 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Encodes captured frames to disk on dedicated threads.
+Frames are copied into one of a fixed number of buffers, and queued to the
+encoder threads, so the thread that captures only pays for the copy. It only
+waits when all buffers are still queued, which counts as a stall.
+
+The format follows the extension of the path. `.png` writes a numbered
+image per frame next to the path, `.y4m` writes a YUV4MPEG2 stream, and any
+other extension writes raw I420 frames. Video frames are converted in parallel
+and written in order, frames that differ in size from the first are skipped.
+
+*/
+
+#pragma once
+#ifndef GAME_FRAME_ENCODER_H
+#define GAME_FRAME_ENCODER_H
+
+#include "platform.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace game {
+
+enum class FrameFormat
+{
+	Png,
+	Y4m,
+	Yuv, // Raw I420
+};
+
+struct FrameEncoderStats
+{
+	int64_t Submitted;
+	int64_t Written; // Files or video frames
+	int64_t Skipped; // Size differs from the first video frame
+	int64_t Bytes; // Written
+	int64_t EncodeNs; // Over all encoder threads
+	int64_t Stalls; // Acquires that waited for a free buffer
+	int64_t StallNs;
+};
+
+class FrameEncoder
+{
+public:
+	// The frame rate is only stored in the video header
+	FrameEncoder(std::string_view path, int threads = 2, int frameRate = 60, int buffers = 4);
+	~FrameEncoder() noexcept; // Encodes the frames still queued
+
+	FrameEncoder(const FrameEncoder &other) = delete;
+	FrameEncoder &operator=(const FrameEncoder &other) = delete;
+
+	// Buffer for the next frame, 8-bit RGBA rows from the bottom up, as read from GL,
+	// blocks while all buffers are queued, from one thread at a time
+	[[nodiscard]] uint8_t *acquire(int width, int height);
+
+	// Queue the acquired frame
+	void submit();
+
+	// Wait until the queued frames are written, rethrows the first encoding failure
+	void finish();
+
+	[[nodiscard]] FrameEncoderStats stats();
+	inline FrameFormat format() const { return m_Format; }
+
+private:
+	struct Frame
+	{
+		int64_t Index;
+		int Width;
+		int Height;
+		std::vector<uint8_t> Pixels;
+		std::vector<uint8_t> Scratch; // Filtered rows, or planes
+		std::vector<uint8_t> Encoded;
+		std::vector<int32_t> Hash; // Match positions
+	};
+
+	void threadMain();
+
+	// Bytes written, zero when skipped
+	int64_t encodePng(Frame &frame);
+	int64_t encodeVideo(Frame &frame);
+
+private:
+	FrameFormat m_Format;
+	std::string m_Path;
+	int m_FrameRate;
+
+	std::vector<std::unique_ptr<Frame>> m_Frames;
+	std::vector<Frame *> m_Free;
+	std::vector<Frame *> m_Queue; // Ring of all buffers
+	size_t m_QueueHead = 0;
+	size_t m_QueueCount = 0;
+	Frame *m_Acquired = null;
+	int64_t m_Submitted = 0;
+	int64_t m_Busy = 0; // Frames queued or being encoded
+
+	std::vector<std::thread> m_Threads;
+	std::mutex m_Mutex;
+	std::condition_variable m_QueueCondition;
+	std::condition_variable m_FreeCondition;
+	std::exception_ptr m_Exception; // First failure, rethrown by finish
+	bool m_Exit = false;
+	FrameEncoderStats m_Stats = { };
+
+	// Video frames are written in submission order
+	std::mutex m_WriteMutex;
+	std::condition_variable m_WriteCondition;
+	std::FILE *m_File = null;
+	int64_t m_NextWrite = 0;
+	int m_VideoWidth = 0;
+	int m_VideoHeight = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_FRAME_ENCODER_H */
+
+/* end of file */
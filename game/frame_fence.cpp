@@ -0,0 +1,104 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "frame_fence.h"
+#include "gl_exception.h"
+
+namespace game {
+
+GlFrameFence::GlFrameFence()
+{
+
+}
+
+GlFrameFence::~GlFrameFence() noexcept
+{
+	GAME_DEBUG_ASSERT(!m_Count);
+}
+
+void GlFrameFence::signal(int64_t frame)
+{
+	if (m_Count == MaxFences)
+		waitOldest(); // More frames in flight than expected
+	GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!sync)
+		GAME_THROW_GL_ERROR(glGetError());
+	m_Fences[(m_First + m_Count) % MaxFences] = { frame, sync };
+	++m_Count;
+}
+
+[[nodiscard]] int64_t GlFrameFence::completed()
+{
+	while (m_Count)
+	{
+		Fence &oldest = m_Fences[m_First];
+		GLenum res = glClientWaitSync(oldest.Sync, 0, 0);
+		if (res == GL_TIMEOUT_EXPIRED)
+			break;
+		if (res == GL_WAIT_FAILED)
+			GAME_THROW_GL_ERROR(glGetError());
+		glDeleteSync(oldest.Sync);
+		m_Completed = oldest.Frame;
+		m_First = (m_First + 1) % MaxFences;
+		--m_Count;
+	}
+	return m_Completed;
+}
+
+void GlFrameFence::wait(int64_t frame)
+{
+	GAME_DEBUG_ASSERT(frame < this->frame());
+	while (m_Completed < frame && m_Count)
+		waitOldest();
+}
+
+void GlFrameFence::waitOldest()
+{
+	Fence &oldest = m_Fences[m_First];
+	if (glClientWaitSync(oldest.Sync, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED) == GL_WAIT_FAILED)
+		GAME_THROW_GL_ERROR(glGetError());
+	glDeleteSync(oldest.Sync);
+	m_Completed = oldest.Frame;
+	m_First = (m_First + 1) % MaxFences;
+	--m_Count;
+}
+
+void GlFrameFence::release() noexcept
+{
+	for (; m_Count; --m_Count)
+	{
+		glDeleteSync(m_Fences[m_First].Sync);
+		m_First = (m_First + 1) % MaxFences;
+	}
+	m_Completed = frame() - 1;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,130 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Fences on the end of each frame, to know when the GPU is done with
+the resources that a frame used. Frames are numbered from zero,
+and complete in order.
+
+`GlFrameFence` is backed by `glFenceSync`, `ManualFrameFence` completes
+frames when told to, to run fenced allocators without a GPU.
+
+*/
+
+#pragma once
+#ifndef GAME_FRAME_FENCE_H
+#define GAME_FRAME_FENCE_H
+
+#include "platform.h"
+
+namespace game {
+
+class FrameFence
+{
+public:
+	virtual ~FrameFence() noexcept { }
+
+	// Frame being recorded
+	inline int64_t frame() const { return m_Frame; }
+
+	// Fence the commands of the current frame, and start the next one
+	inline void endFrame() { signal(m_Frame); ++m_Frame; }
+
+	// Last frame whose commands have completed, or -1
+	[[nodiscard]] virtual int64_t completed() = 0;
+
+	// Block until the frame has completed, the frame must have ended
+	virtual void wait(int64_t frame) = 0;
+
+	// Forget all fences, everything is treated as completed
+	virtual void release() noexcept = 0;
+
+protected:
+	virtual void signal(int64_t frame) = 0;
+
+private:
+	int64_t m_Frame = 0;
+
+};
+
+class GlFrameFence : public FrameFence
+{
+public:
+	GlFrameFence();
+	virtual ~GlFrameFence() noexcept;
+
+	[[nodiscard]] virtual int64_t completed() override;
+	virtual void wait(int64_t frame) override;
+	virtual void release() noexcept override;
+
+protected:
+	virtual void signal(int64_t frame) override;
+
+private:
+	static const int MaxFences = 8; // Waits on the oldest fence beyond this
+
+	struct Fence
+	{
+		int64_t Frame;
+		GLsync Sync;
+	};
+
+	void waitOldest();
+
+	Fence m_Fences[MaxFences];
+	int m_First = 0;
+	int m_Count = 0;
+	int64_t m_Completed = -1;
+
+};
+
+class ManualFrameFence : public FrameFence
+{
+public:
+	// Complete all frames up to and including this one, must have ended
+	inline void complete(int64_t frame) { GAME_DEBUG_ASSERT(frame < this->frame()); m_Completed = std::max(m_Completed, frame); }
+
+	[[nodiscard]] virtual int64_t completed() override { return m_Completed; }
+	virtual void wait(int64_t frame) override { complete(frame); }
+	virtual void release() noexcept override { m_Completed = frame() - 1; }
+
+protected:
+	virtual void signal(int64_t) override { }
+
+private:
+	int64_t m_Completed = -1;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_FRAME_FENCE_H */
+
+/* end of file */
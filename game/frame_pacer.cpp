@@ -0,0 +1,153 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "frame_pacer.h"
+
+#include <cmath>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr int64_t MinSpinMargin = 50000;
+constexpr int64_t MaxSpinMargin = 4000000;
+constexpr int64_t InitialOvershoot = 1000000; // Until measured, typical of coarse timers
+
+} /* anonymous namespace */
+
+FramePacer::FramePacer(Clock *clock, PacingWait mode)
+	: m_Clock(clock), m_Mode(mode), m_Overshoot(InitialOvershoot), m_SpinMargin(InitialOvershoot + MinSpinMargin)
+{
+
+}
+
+void FramePacer::setInterval(int64_t ns)
+{
+	m_Interval = std::max<int64_t>(ns, 0);
+	m_Deadline = -1;
+}
+
+void FramePacer::sleepUntil(int64_t deadline)
+{
+	int64_t start = m_Clock->now();
+	int64_t duration = deadline - start;
+	if (duration <= 0)
+		return;
+	m_Clock->sleep(duration);
+	int64_t end = m_Clock->now();
+	m_Slept += end - start;
+
+	// Decaying peak, so one bad wake raises the margin for a while
+	int64_t overshoot = std::max<int64_t>(end - deadline, 0);
+	m_Overshoot = std::max(overshoot, m_Overshoot - m_Overshoot / 64);
+	m_SpinMargin = std::clamp(m_Overshoot + MinSpinMargin, MinSpinMargin, MaxSpinMargin);
+}
+
+void FramePacer::spinUntil(int64_t deadline)
+{
+	int64_t start = m_Clock->now();
+	int64_t now = start;
+	while (now < deadline)
+	{
+		m_Clock->yield();
+		now = m_Clock->now();
+	}
+	m_Spun += now - start;
+}
+
+void FramePacer::wait()
+{
+	int64_t now = m_Clock->now();
+	int64_t lateness = 0;
+	if (m_Interval)
+	{
+		if (m_Deadline < 0 || now - m_Deadline > m_Interval)
+		{
+			// First frame, or too far behind to catch up
+			m_Deadline = now;
+		}
+		else
+		{
+			switch (m_Mode)
+			{
+			case PacingWait::Hybrid:
+				sleepUntil(m_Deadline - m_SpinMargin);
+				spinUntil(m_Deadline);
+				break;
+			case PacingWait::Sleep:
+				sleepUntil(m_Deadline);
+				break;
+			case PacingWait::Spin:
+				spinUntil(m_Deadline);
+				break;
+			}
+			now = m_Clock->now();
+			lateness = std::max<int64_t>(now - m_Deadline, 0);
+		}
+		m_Deadline += m_Interval;
+	}
+
+	if (m_LastStart >= 0)
+	{
+		int i = (int)(m_Frames % HistorySize);
+		m_FrameTimes[i] = now - m_LastStart;
+		m_Lateness[i] = lateness;
+		++m_Frames;
+	}
+	m_LastStart = now;
+}
+
+FramePacingStats FramePacer::stats() const
+{
+	FramePacingStats res = { };
+	res.Frames = (int)std::min<int64_t>(m_Frames, HistorySize);
+	if (!res.Frames)
+		return res;
+	double sum = 0.0, sumSquares = 0.0, lateSum = 0.0;
+	res.FrameMin = (double)m_FrameTimes[0] * 1e-3;
+	for (int i = 0; i < res.Frames; ++i)
+	{
+		double t = (double)m_FrameTimes[i] * 1e-3;
+		double late = (double)m_Lateness[i] * 1e-3;
+		sum += t;
+		sumSquares += t * t;
+		res.FrameMin = std::min(res.FrameMin, t);
+		res.FrameMax = std::max(res.FrameMax, t);
+		lateSum += late;
+		res.LateMax = std::max(res.LateMax, late);
+	}
+	res.FrameMean = sum / (double)res.Frames;
+	res.FrameStdDev = sqrt(std::max(sumSquares / (double)res.Frames - res.FrameMean * res.FrameMean, 0.0));
+	res.LateMean = lateSum / (double)res.Frames;
+	return res;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,129 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Frame pacing for when presentation doesn't block, such as with vsync
+off. Frames start on a fixed grid of deadlines, at a target rate or at
+a whole number of display refreshes. When a frame misses its deadline
+by more than a frame, the grid restarts from now instead of running
+frames back to back to catch up.
+
+Waiting sleeps until shortly before the deadline, and spins the rest.
+The spin margin follows the largest recent sleep overshoot of the
+clock, so that the wait wakes late as rarely as with spinning alone,
+at a fraction of the processor time.
+
+Frame times and wake lateness are tracked over the last frames.
+
+*/
+
+#pragma once
+#ifndef GAME_FRAME_PACER_H
+#define GAME_FRAME_PACER_H
+
+#include "platform.h"
+#include "clock.h"
+
+namespace game {
+
+enum class PacingWait
+{
+	Hybrid,
+	Sleep, // Sleep for the whole wait, wakes late by the timer overshoot
+	Spin, // Spin for the whole wait, keeps a core busy
+};
+
+// Over the recent frames, in microseconds
+struct FramePacingStats
+{
+	int Frames;
+	double FrameMean;
+	double FrameStdDev;
+	double FrameMin;
+	double FrameMax;
+	double LateMean; // Wake time past the deadline
+	double LateMax;
+};
+
+class FramePacer
+{
+public:
+	FramePacer(Clock *clock, PacingWait mode = PacingWait::Hybrid);
+
+	// Time between frame starts, zero to not wait at all
+	void setInterval(int64_t ns);
+	inline void setRate(double hz) { setInterval(hz > 0.0 ? (int64_t)(1e9 / hz) : 0); }
+	inline void setRefreshRelative(double refreshHz, int refreshes = 1) { setRate(refreshHz / (double)std::max(refreshes, 1)); }
+	inline int64_t interval() const { return m_Interval; }
+
+	inline void setMode(PacingWait mode) { m_Mode = mode; }
+	inline PacingWait mode() const { return m_Mode; }
+
+	// Call once per frame, after submitting it, blocks until the next frame is due
+	void wait();
+
+	FramePacingStats stats() const;
+
+	// Totals since construction
+	inline int64_t sleptNs() const { return m_Slept; }
+	inline int64_t spunNs() const { return m_Spun; }
+	inline int64_t spinMarginNs() const { return m_SpinMargin; }
+
+private:
+	static const int HistorySize = 128;
+
+	void sleepUntil(int64_t deadline);
+	void spinUntil(int64_t deadline);
+
+	Clock *m_Clock;
+	PacingWait m_Mode;
+	int64_t m_Interval = 0;
+	int64_t m_Deadline = -1; // Start of the next frame, or -1 to restart the grid
+
+	// Sleep overshoot, decaying peak
+	int64_t m_Overshoot;
+	int64_t m_SpinMargin;
+
+	int64_t m_Slept = 0;
+	int64_t m_Spun = 0;
+
+	// Recent frames
+	int64_t m_LastStart = -1;
+	int64_t m_FrameTimes[HistorySize];
+	int64_t m_Lateness[HistorySize];
+	int64_t m_Frames = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_FRAME_PACER_H */
+
+/* end of file */
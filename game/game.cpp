@@ -0,0 +1,219 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "game.h"
+#include "renderer.h"
+#include "render_queue.h"
+#include "job_system.h"
+#include "arena.h"
+#include "ecs.h"
+#include "fixed_timestep.h"
+#include "resolution_controller.h"
+#include "perf_counters.h"
+#include "simd_math.h"
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+namespace game {
+
+int DisplayWidth;
+int DisplayHeight;
+int DrawCount = 1;
+int SimulationRate = 60;
+int64_t FrameBudget = 0;
+
+namespace /* anonymous */ {
+
+Renderer *s_Renderer;
+JobSystem *s_Jobs;
+std::unique_ptr<FixedTimestep> s_Timestep;
+Mesh s_TriMesh;
+RenderQueue s_RenderQueue;
+LinearArena s_FrameArena;
+World s_World;
+ResolutionController s_Resolution;
+int64_t s_LastGpuFrame = -1;
+
+struct Drawable
+{
+	Mesh Geometry;
+	float Depth;
+};
+
+// Clip space offset of the mesh after the last two steps
+struct Transform
+{
+	Float3 Previous;
+	Float3 Current;
+};
+
+EntityQuery s_Drawables = EntityQuery::of<Drawable, Transform>();
+EntityQuery s_Transforms = EntityQuery::of<Transform>();
+
+constexpr float OrbitSeconds = 8.0f; // Time for one turn around the center
+
+// One fixed step of the simulation, turns every transform around the center
+void update()
+{
+	GAME_PROFILE_COUNTED_SCOPE("update");
+	const float angle = 6.2831853f / (OrbitSeconds * (float)SimulationRate);
+	const float c = cosf(angle);
+	const float s = sinf(angle);
+	s_World.forEachChunk(*s_Jobs, s_Transforms, [c, s](const ArchetypeChunk &chunk, size_t) -> void {
+		Transform *transforms = chunk.get<Transform>();
+		for (uint32_t i = 0; i < chunk.count(); ++i)
+		{
+			Transform &transform = transforms[i];
+			const Float3 &p = transform.Current;
+			transform.Previous = p;
+			transform.Current = { p.X * c - p.Y * s, p.X * s + p.Y * c, p.Z };
+		}
+	});
+}
+
+// Alpha is the fraction of a step since the last update, transforms are blended with it,
+// returns the CPU time since the frame started until it was submitted, which leaves out
+// the time the renderer spends ending the frame and waiting on the swap
+int64_t render(float alpha, std::chrono::steady_clock::time_point frameStart)
+{
+	GAME_PROFILE_COUNTED_SCOPE("render");
+	s_Renderer->beginFrame(DisplayWidth, DisplayHeight, s_Resolution.scale());
+
+	// Clear background
+	static const float bg[4] = { 0.0f, 0.125f, 0.25f, 1.0f };
+	s_Renderer->clear(bg);
+
+	// Draw entities, recorded in parallel with one command buffer per chunk
+	s_RenderQueue.resize((int)std::max<size_t>(s_World.chunkCount(s_Drawables), 1));
+	s_World.forEachChunk(*s_Jobs, s_Drawables, [alpha](const ArchetypeChunk &chunk, size_t index) -> void {
+		CommandBuffer &commands = s_RenderQueue.buffer((int)index);
+		const Drawable *drawables = chunk.get<Drawable>();
+		const Transform *transforms = chunk.get<Transform>();
+		for (uint32_t i = 0; i < chunk.count(); ++i)
+		{
+			const Drawable &drawable = drawables[i];
+			const Transform &transform = transforms[i];
+			const Float3 p = transform.Previous + (transform.Current - transform.Previous) * alpha;
+			const DrawConstants constants = { { p.X, p.Y, p.Z, 0.0f } };
+			commands.draw(makeSortKey(0, 0, drawable.Geometry, depthKey(drawable.Depth)), drawable.Geometry, constants);
+		}
+	});
+	s_RenderQueue.sort(s_FrameArena);
+	s_RenderQueue.submit(s_Renderer);
+	int64_t cpuNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frameStart).count();
+
+	// Swap
+	s_Renderer->endFrame();
+
+	// Frame memory is no longer referenced after the swap
+	s_FrameArena.reset();
+	return cpuNs;
+}
+
+} /* anonymous namespace */
+
+void init(Renderer *renderer, JobSystem *jobs, Clock *clock)
+{
+	renderer->init();
+	GAME_FINALLY([&]() -> void { if (!s_Renderer) renderer->release(); });
+
+	static const float positions[] = {
+		0.25f, -0.25f, 0.5f, 1.0f,
+		-0.25f, -0.25f, 0.5f, 1.0f,
+		0.25f, 0.25f, 0.5f, 1.0f,
+	};
+
+	static const float colors[] = {
+		1.0f, 0.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		0.0f, 0.0f, 1.0f, 1.0f,
+	};
+
+	s_Timestep = std::make_unique<FixedTimestep>(clock, SimulationRate);
+	s_TriMesh = renderer->createMesh(positions, colors, 3);
+	for (int i = 0; i < DrawCount; ++i)
+	{
+		// Spread around a circle
+		float angle = 6.2831853f * (float)i / (float)DrawCount;
+		Float3 position = { 0.5f * cosf(angle), 0.5f * sinf(angle), 0.0f };
+		s_World.create(Drawable { s_TriMesh, (float)i / (float)DrawCount }, Transform { position, position });
+	}
+	s_Jobs = jobs;
+	s_Renderer = renderer;
+}
+
+void frame()
+{
+	GAME_PROFILE_FRAME();
+	GAME_PROFILE_COUNTED_SCOPE("frame");
+	auto start = std::chrono::steady_clock::now();
+	int steps = s_Timestep->advance();
+	for (int i = 0; i < steps; ++i)
+		update();
+	int64_t cpuNs = render(s_Timestep->alpha(), start);
+
+	// Scale of the next frame, GPU times are only fed once
+	if (s_Resolution.budget() != FrameBudget)
+		s_Resolution.setBudget(FrameBudget);
+	GpuFrameTime gpu = s_Renderer->gpuFrameTime();
+	bool measured = gpu.Frame > s_LastGpuFrame;
+	s_LastGpuFrame = std::max(s_LastGpuFrame, gpu.Frame);
+	s_Resolution.update({ cpuNs, measured ? gpu.Ns : -1, gpu.RenderScale });
+}
+
+int64_t simulationSteps()
+{
+	return s_Timestep ? s_Timestep->steps() : 0;
+}
+
+const ResolutionController &resolutionController()
+{
+	return s_Resolution;
+}
+
+void release()
+{
+	if (!s_Renderer)
+		return;
+	s_World.clear();
+	s_Renderer->destroyMesh(s_TriMesh);
+	s_TriMesh = Mesh();
+	s_Renderer->release();
+	s_Renderer = null;
+	s_Jobs = null;
+	s_Timestep.reset();
+	s_Resolution.reset();
+	s_LastGpuFrame = -1;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,73 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Game loop entry points, independent of the platform.
+The caller owns the renderer, the job system, the clock and the display size.
+Each frame runs the fixed simulation steps that are due on the clock,
+and then renders once, at a render scale picked from the frame timings
+to keep the GPU time inside the frame budget.
+
+*/
+
+#pragma once
+#ifndef GAME_GAME_H
+#define GAME_GAME_H
+
+#include "platform.h"
+
+namespace game {
+
+class Renderer;
+class JobSystem;
+class Clock;
+class ResolutionController;
+
+extern int DisplayWidth;
+extern int DisplayHeight;
+extern int DrawCount; // Triangle draws per frame, for benchmarking
+extern int SimulationRate; // Fixed simulation steps per second
+extern int64_t FrameBudget; // Nanoseconds of GPU time per frame to fit the render scale to, zero for full resolution
+
+void init(Renderer *renderer, JobSystem *jobs, Clock *clock);
+void frame();
+void release();
+
+// Simulation steps run since init
+int64_t simulationSteps();
+
+// Render scale of the next frame, and the timings it was picked from
+const ResolutionController &resolutionController();
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GAME_H */
+
+/* end of file */
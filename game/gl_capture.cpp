@@ -0,0 +1,1249 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_capture.h"
+#include "gl_intercept.h"
+#include "exception.h"
+
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr uint32_t TraceMagic = 0x544C4747; // GGLT
+constexpr uint32_t TraceVersion = 2;
+constexpr uint32_t TraceHeaderSize = 20;
+
+// Records that are not calls follow the entry points
+constexpr uint64_t FrameEndRecord = GlFunctionCount;
+constexpr uint64_t MappedWriteRecord = GlFunctionCount + 1;
+
+constexpr size_t MappingBlock = 256; // Granularity of the persistent mapping comparison
+
+enum class GlObject : int
+{
+	None,
+	Buffer,
+	Framebuffer,
+	Query,
+	Renderbuffer,
+	Texture,
+	VertexArray,
+	Program,
+	Shader,
+	Sync,
+	Count,
+};
+
+// Kind of object name passed as an argument of a call that only takes values
+constexpr GlObject argObject(GlFunction function, size_t index)
+{
+	switch (function)
+	{
+	case GlFunction::AttachShader:
+	case GlFunction::DetachShader:
+		return index == 0 ? GlObject::Program : GlObject::Shader;
+	case GlFunction::BeginQuery:
+		return index == 1 ? GlObject::Query : GlObject::None;
+	case GlFunction::BindBuffer:
+		return index == 1 ? GlObject::Buffer : GlObject::None;
+	case GlFunction::BindBufferRange:
+		return index == 2 ? GlObject::Buffer : GlObject::None;
+	case GlFunction::BindFramebuffer:
+		return index == 1 ? GlObject::Framebuffer : GlObject::None;
+	case GlFunction::BindRenderbuffer:
+		return index == 1 ? GlObject::Renderbuffer : GlObject::None;
+	case GlFunction::BindTexture:
+		return index == 1 ? GlObject::Texture : GlObject::None;
+	case GlFunction::BindVertexArray:
+		return GlObject::VertexArray;
+	case GlFunction::CompileShader:
+	case GlFunction::DeleteShader:
+		return GlObject::Shader;
+	case GlFunction::DeleteProgram:
+	case GlFunction::LinkProgram:
+	case GlFunction::UseProgram:
+		return GlObject::Program;
+	case GlFunction::FramebufferRenderbuffer:
+		return index == 3 ? GlObject::Renderbuffer : GlObject::None;
+	case GlFunction::FramebufferTexture2D:
+		return index == 3 ? GlObject::Texture : GlObject::None;
+	default:
+		return GlObject::None;
+	}
+}
+
+} /* anonymous namespace */
+
+struct GlReplay::State
+{
+	std::vector<uint8_t> Data;
+	size_t Pos;
+	int Width;
+	int Height;
+	int Frames;
+	int Frame;
+	std::vector<size_t> FrameOffsets; // Start of each frame replayed so far
+	GL3WglProc Procs[GlFunctionCount];
+	std::unordered_map<uint64_t, uint64_t> Names[(int)GlObject::Count]; // Captured to replayed
+	std::unordered_map<uint64_t, std::pair<uint8_t *, size_t>> Mappings; // By capture id
+	GLuint DefaultFramebuffer;
+	std::vector<uint8_t> Scratch; // Outputs that are not kept
+	int64_t Calls;
+	int64_t Unmapped;
+
+	uint64_t readVarint()
+	{
+		uint64_t v = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (Pos >= Data.size())
+				GAME_THROW(Exception("GL trace is truncated"sv, 1));
+			uint8_t byte = Data[Pos++];
+			v |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return v;
+		}
+		GAME_THROW(Exception("GL trace is corrupt"sv, 1));
+	}
+
+	const uint8_t *readBytes(uint64_t size)
+	{
+		if (size > Data.size() - Pos)
+			GAME_THROW(Exception("GL trace is truncated"sv, 1));
+		const uint8_t *bytes = &Data[Pos];
+		Pos += (size_t)size;
+		return bytes;
+	}
+
+	template <typename T>
+	T read()
+	{
+		static_assert(std::is_arithmetic_v<T>);
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			T v;
+			memcpy(&v, readBytes(sizeof(T)), sizeof(T));
+			return v;
+		}
+		else if constexpr (std::is_signed_v<T>)
+		{
+			uint64_t v = readVarint();
+			return (T)(int64_t)((v >> 1) ^ (~(v & 1) + 1));
+		}
+		else
+		{
+			return (T)readVarint();
+		}
+	}
+
+	// Size of an array that follows in the trace, each element takes at least a byte
+	size_t readCount()
+	{
+		uint64_t count = readVarint();
+		if (count > Data.size() - Pos)
+			GAME_THROW(Exception("GL trace is corrupt"sv, 1));
+		return (size_t)count;
+	}
+
+	uint64_t map(GlObject object, uint64_t name)
+	{
+		if (!name)
+			return object == GlObject::Framebuffer ? DefaultFramebuffer : 0;
+		auto &names = Names[(int)object];
+		auto it = names.find(name);
+		if (it == names.end())
+		{
+			++Unmapped;
+			return 0;
+		}
+		return it->second;
+	}
+
+	template <typename T>
+	T mapArg(GlObject object, T value)
+	{
+		if (object == GlObject::None)
+			return value;
+		return (T)map(object, (uint64_t)value);
+	}
+
+	void bind(GlObject object, uint64_t captured, uint64_t name)
+	{
+		Names[(int)object][captured] = name;
+	}
+
+	void *scratch(size_t size)
+	{
+		if (Scratch.size() < size)
+			Scratch.resize(size);
+		return Scratch.data();
+	}
+};
+
+namespace /* anonymous */ {
+
+using State = GlReplay::State;
+
+struct BufferRange
+{
+	GLuint Buffer;
+	size_t Offset;
+	size_t Size;
+};
+
+struct Mapping
+{
+	uint64_t Id;
+	GLuint Buffer;
+	uint8_t *Pointer;
+	size_t Length;
+	bool Persistent;
+	std::vector<uint8_t> Shadow; // Contents as last recorded, of persistent mappings
+};
+
+bool s_Capturing;
+int s_CaptureFrames; // Requested
+int s_Frames; // Recorded
+int s_Width;
+int s_Height;
+GL3WglProc s_Originals[GlFunctionCount];
+std::vector<uint8_t> s_Trace;
+std::unordered_map<GLenum, GLuint> s_BufferBindings;
+std::unordered_map<GLuint, std::vector<std::pair<GLuint, GLuint>>> s_VertexArrayBuffers; // Attribute and array buffer, by vertex array
+GLuint s_VertexArray;
+std::vector<BufferRange> s_UniformRanges; // By uniform buffer binding index
+std::vector<Mapping> s_Mappings; // Writable mappings
+uint64_t s_NextMapping = 1;
+
+void writeVarint(uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		s_Trace.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	s_Trace.push_back((uint8_t)v);
+}
+
+void writeBytes(const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	s_Trace.insert(s_Trace.end(), bytes, bytes + size);
+}
+
+template <typename T>
+void writeValue(T v)
+{
+	static_assert(std::is_arithmetic_v<T>, "Arguments behind pointers need a `GlTrace` specialization");
+	if constexpr (std::is_floating_point_v<T>)
+		writeBytes(&v, sizeof(T));
+	else if constexpr (std::is_signed_v<T>)
+		writeVarint(((uint64_t)(int64_t)v << 1) ^ (uint64_t)((int64_t)v >> 63));
+	else
+		writeVarint((uint64_t)v);
+}
+
+void writeHandle(const void *handle)
+{
+	writeVarint((uint64_t)(uintptr_t)handle);
+}
+
+void writeMapped(const Mapping &mapping, size_t begin, size_t end)
+{
+	writeVarint(MappedWriteRecord);
+	writeVarint(mapping.Id);
+	writeVarint(begin);
+	writeVarint(end - begin);
+	writeBytes(mapping.Pointer + begin, end - begin);
+}
+
+// Record the blocks of a persistent mapping that changed since they were last recorded,
+// within the blocks that overlap the range
+void flushMapping(Mapping &mapping, size_t begin, size_t end)
+{
+	end = std::min(end, mapping.Length);
+	size_t run = SIZE_MAX;
+	size_t offset = begin - begin % MappingBlock;
+	for (; offset < end; offset += MappingBlock)
+	{
+		size_t size = std::min(MappingBlock, mapping.Length - offset);
+		if (memcmp(mapping.Pointer + offset, &mapping.Shadow[offset], size))
+		{
+			memcpy(&mapping.Shadow[offset], mapping.Pointer + offset, size);
+			if (run == SIZE_MAX)
+				run = offset;
+		}
+		else if (run != SIZE_MAX)
+		{
+			writeMapped(mapping, run, offset);
+			run = SIZE_MAX;
+		}
+	}
+	if (run != SIZE_MAX)
+		writeMapped(mapping, run, std::min(offset, mapping.Length));
+}
+
+void flushMapping(Mapping &mapping)
+{
+	flushMapping(mapping, 0, mapping.Length);
+}
+
+// Only the buffers the draw reads, through the attributes of the bound vertex array,
+// and the ranges bound to uniform blocks
+void flushMappings()
+{
+	auto it = s_VertexArrayBuffers.find(s_VertexArray);
+	for (Mapping &mapping : s_Mappings)
+	{
+		if (!mapping.Persistent)
+			continue;
+		if (it != s_VertexArrayBuffers.end())
+		{
+			for (const std::pair<GLuint, GLuint> &attribute : it->second)
+			{
+				if (attribute.second == mapping.Buffer)
+				{
+					flushMapping(mapping);
+					break;
+				}
+			}
+		}
+		for (const BufferRange &range : s_UniformRanges)
+		{
+			if (range.Buffer == mapping.Buffer)
+				flushMapping(mapping, range.Offset, range.Offset + range.Size);
+		}
+	}
+}
+
+// All persistent mappings, before a fence or at the end of the frame, for the
+// writes that no draw reads through a vertex array, such as uniforms and indices
+void flushAllMappings()
+{
+	for (Mapping &mapping : s_Mappings)
+	{
+		if (mapping.Persistent)
+			flushMapping(mapping);
+	}
+}
+
+// Returns the id of a writable mapping, or zero
+uint64_t addMapping(GLenum target, void *pointer, size_t length, bool write, bool persistent)
+{
+	if (!pointer)
+		return 0;
+	uint64_t id = s_NextMapping++;
+	if (write)
+	{
+		Mapping mapping = { id, s_BufferBindings[target], (uint8_t *)pointer, length, persistent };
+		if (persistent)
+			mapping.Shadow.resize(length); // Contents start undefined, blocks that are still zero are not recorded
+		s_Mappings.push_back(std::move(mapping));
+	}
+	return id;
+}
+
+// Deleted buffers are unmapped and unbound
+void forgetBuffers(GLsizei n, const GLuint *buffers)
+{
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		if (!buffers[i])
+			continue;
+		s_Mappings.erase(std::remove_if(s_Mappings.begin(), s_Mappings.end(),
+			[&](const Mapping &mapping) -> bool { return mapping.Buffer == buffers[i]; }), s_Mappings.end());
+		for (auto &it : s_BufferBindings)
+			if (it.second == buffers[i])
+				it.second = 0;
+		for (BufferRange &range : s_UniformRanges)
+			if (range.Buffer == buffers[i])
+				range = { };
+		for (auto &it : s_VertexArrayBuffers)
+			for (std::pair<GLuint, GLuint> &attribute : it.second)
+				if (attribute.second == buffers[i])
+					attribute.second = 0;
+	}
+}
+
+// Deleted vertex arrays are unbound
+void forgetVertexArrays(GLsizei n, const GLuint *arrays)
+{
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		if (!arrays[i])
+			continue;
+		s_VertexArrayBuffers.erase(arrays[i]);
+		if (s_VertexArray == arrays[i])
+			s_VertexArray = 0;
+	}
+}
+
+// Calls that only take values, and object names
+template <GlFunction F>
+struct GlTraceValues
+{
+	template <typename R, typename... Args>
+	static R capture(R (APIENTRY *proc)(Args...), Args... args)
+	{
+		writeVarint((uint64_t)F);
+		(writeValue(args), ...);
+		return proc(args...);
+	}
+
+	template <typename R, typename... Args>
+	static void replay(State &state, R (APIENTRY *proc)(Args...))
+	{
+		replay(state, proc, std::index_sequence_for<Args...>());
+	}
+
+	template <typename R, typename... Args, size_t... I>
+	static void replay(State &state, R (APIENTRY *proc)(Args...), std::index_sequence<I...>)
+	{
+		std::tuple<Args...> args { state.read<Args>()... }; // In order within braces
+		proc(state.mapArg(argObject(F, I), std::get<I>(args))...);
+	}
+};
+
+template <GlFunction F>
+struct GlTrace : GlTraceValues<F>
+{
+};
+
+template <>
+struct GlTrace<GlFunction::BindBuffer> : GlTraceValues<GlFunction::BindBuffer>
+{
+	static void capture(PFNGLBINDBUFFERPROC proc, GLenum target, GLuint buffer)
+	{
+		s_BufferBindings[target] = buffer;
+		GlTraceValues::capture(proc, target, buffer);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::BindBufferRange> : GlTraceValues<GlFunction::BindBufferRange>
+{
+	static void capture(PFNGLBINDBUFFERRANGEPROC proc, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		s_BufferBindings[target] = buffer;
+		if (target == GL_UNIFORM_BUFFER)
+		{
+			if (index >= s_UniformRanges.size())
+				s_UniformRanges.resize((size_t)index + 1);
+			s_UniformRanges[index] = { buffer, (size_t)offset, (size_t)size };
+		}
+		GlTraceValues::capture(proc, target, index, buffer, offset, size);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::BindVertexArray> : GlTraceValues<GlFunction::BindVertexArray>
+{
+	static void capture(PFNGLBINDVERTEXARRAYPROC proc, GLuint array)
+	{
+		s_VertexArray = array;
+		GlTraceValues::capture(proc, array);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::DrawArrays> : GlTraceValues<GlFunction::DrawArrays>
+{
+	static void capture(PFNGLDRAWARRAYSPROC proc, GLenum mode, GLint first, GLsizei count)
+	{
+		flushMappings();
+		GlTraceValues::capture(proc, mode, first, count);
+	}
+};
+
+// Buffer data or storage, the last argument is the usage or the flags
+template <GlFunction F>
+struct GlBufferTrace
+{
+	template <typename Proc>
+	static void capture(Proc proc, GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+	{
+		writeVarint((uint64_t)F);
+		writeValue(target);
+		writeValue(size);
+		writeValue<uint8_t>(data != null);
+		if (data)
+			writeBytes(data, (size_t)size);
+		writeValue(usage);
+		proc(target, size, data, usage);
+	}
+
+	template <typename Proc>
+	static void replay(State &state, Proc proc)
+	{
+		GLenum target = state.read<GLenum>();
+		GLsizeiptr size = state.read<GLsizeiptr>();
+		const void *data = state.read<uint8_t>() ? state.readBytes((uint64_t)size) : null;
+		GLenum usage = state.read<GLenum>();
+		proc(target, size, data, usage);
+	}
+};
+
+template <> struct GlTrace<GlFunction::BufferData> : GlBufferTrace<GlFunction::BufferData> { };
+template <> struct GlTrace<GlFunction::BufferStorage> : GlBufferTrace<GlFunction::BufferStorage> { };
+
+template <>
+struct GlTrace<GlFunction::ClearBufferfv>
+{
+	static void capture(PFNGLCLEARBUFFERFVPROC proc, GLenum buffer, GLint drawbuffer, const GLfloat *value)
+	{
+		writeVarint((uint64_t)GlFunction::ClearBufferfv);
+		writeValue(buffer);
+		writeValue(drawbuffer);
+		writeBytes(value, sizeof(GLfloat) * (buffer == GL_COLOR ? 4 : 1));
+		proc(buffer, drawbuffer, value);
+	}
+
+	static void replay(State &state, PFNGLCLEARBUFFERFVPROC proc)
+	{
+		GLenum buffer = state.read<GLenum>();
+		GLint drawbuffer = state.read<GLint>();
+		GLfloat value[4];
+		memcpy(value, state.readBytes(sizeof(GLfloat) * (buffer == GL_COLOR ? 4 : 1)), sizeof(GLfloat) * (buffer == GL_COLOR ? 4 : 1));
+		proc(buffer, drawbuffer, value);
+	}
+};
+
+template <GlFunction F, GlObject O>
+struct GlGenTrace
+{
+	template <typename Proc>
+	static void capture(Proc proc, GLsizei n, GLuint *names)
+	{
+		proc(n, names);
+		writeVarint((uint64_t)F);
+		writeVarint((uint64_t)n);
+		for (GLsizei i = 0; i < n; ++i)
+			writeValue(names[i]);
+	}
+
+	template <typename Proc>
+	static void replay(State &state, Proc proc)
+	{
+		GLsizei n = (GLsizei)state.readCount();
+		GLuint *names = (GLuint *)state.scratch(sizeof(GLuint) * (size_t)n);
+		proc(n, names);
+		for (GLsizei i = 0; i < n; ++i)
+			state.bind(O, state.read<GLuint>(), names[i]);
+	}
+};
+
+template <GlFunction F, GlObject O>
+struct GlDeleteTrace
+{
+	template <typename Proc>
+	static void capture(Proc proc, GLsizei n, const GLuint *names)
+	{
+		writeVarint((uint64_t)F);
+		writeVarint((uint64_t)n);
+		for (GLsizei i = 0; i < n; ++i)
+			writeValue(names[i]);
+		if constexpr (O == GlObject::Buffer)
+			forgetBuffers(n, names);
+		if constexpr (O == GlObject::VertexArray)
+			forgetVertexArrays(n, names);
+		proc(n, names);
+	}
+
+	template <typename Proc>
+	static void replay(State &state, Proc proc)
+	{
+		GLsizei n = (GLsizei)state.readCount();
+		GLuint *names = (GLuint *)state.scratch(sizeof(GLuint) * (size_t)n);
+		for (GLsizei i = 0; i < n; ++i)
+			names[i] = (GLuint)state.map(O, state.read<GLuint>());
+		proc(n, names);
+	}
+};
+
+template <> struct GlTrace<GlFunction::GenBuffers> : GlGenTrace<GlFunction::GenBuffers, GlObject::Buffer> { };
+template <> struct GlTrace<GlFunction::GenFramebuffers> : GlGenTrace<GlFunction::GenFramebuffers, GlObject::Framebuffer> { };
+template <> struct GlTrace<GlFunction::GenQueries> : GlGenTrace<GlFunction::GenQueries, GlObject::Query> { };
+template <> struct GlTrace<GlFunction::GenRenderbuffers> : GlGenTrace<GlFunction::GenRenderbuffers, GlObject::Renderbuffer> { };
+template <> struct GlTrace<GlFunction::GenTextures> : GlGenTrace<GlFunction::GenTextures, GlObject::Texture> { };
+template <> struct GlTrace<GlFunction::GenVertexArrays> : GlGenTrace<GlFunction::GenVertexArrays, GlObject::VertexArray> { };
+template <> struct GlTrace<GlFunction::DeleteBuffers> : GlDeleteTrace<GlFunction::DeleteBuffers, GlObject::Buffer> { };
+template <> struct GlTrace<GlFunction::DeleteFramebuffers> : GlDeleteTrace<GlFunction::DeleteFramebuffers, GlObject::Framebuffer> { };
+template <> struct GlTrace<GlFunction::DeleteQueries> : GlDeleteTrace<GlFunction::DeleteQueries, GlObject::Query> { };
+template <> struct GlTrace<GlFunction::DeleteRenderbuffers> : GlDeleteTrace<GlFunction::DeleteRenderbuffers, GlObject::Renderbuffer> { };
+template <> struct GlTrace<GlFunction::DeleteTextures> : GlDeleteTrace<GlFunction::DeleteTextures, GlObject::Texture> { };
+template <> struct GlTrace<GlFunction::DeleteVertexArrays> : GlDeleteTrace<GlFunction::DeleteVertexArrays, GlObject::VertexArray> { };
+
+template <>
+struct GlTrace<GlFunction::CreateProgram>
+{
+	static GLuint capture(PFNGLCREATEPROGRAMPROC proc)
+	{
+		GLuint program = proc();
+		writeVarint((uint64_t)GlFunction::CreateProgram);
+		writeValue(program);
+		return program;
+	}
+
+	static void replay(State &state, PFNGLCREATEPROGRAMPROC proc)
+	{
+		GLuint program = proc();
+		state.bind(GlObject::Program, state.read<GLuint>(), program);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::CreateShader>
+{
+	static GLuint capture(PFNGLCREATESHADERPROC proc, GLenum type)
+	{
+		GLuint shader = proc(type);
+		writeVarint((uint64_t)GlFunction::CreateShader);
+		writeValue(type);
+		writeValue(shader);
+		return shader;
+	}
+
+	static void replay(State &state, PFNGLCREATESHADERPROC proc)
+	{
+		GLuint shader = proc(state.read<GLenum>());
+		state.bind(GlObject::Shader, state.read<GLuint>(), shader);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::FenceSync>
+{
+	static GLsync capture(PFNGLFENCESYNCPROC proc, GLenum condition, GLbitfield flags)
+	{
+		flushAllMappings();
+		GLsync sync = proc(condition, flags);
+		writeVarint((uint64_t)GlFunction::FenceSync);
+		writeValue(condition);
+		writeValue(flags);
+		writeHandle(sync);
+		return sync;
+	}
+
+	static void replay(State &state, PFNGLFENCESYNCPROC proc)
+	{
+		GLenum condition = state.read<GLenum>();
+		GLbitfield flags = state.read<GLbitfield>();
+		GLsync sync = proc(condition, flags);
+		state.bind(GlObject::Sync, state.readVarint(), (uint64_t)(uintptr_t)sync);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::ClientWaitSync>
+{
+	static GLenum capture(PFNGLCLIENTWAITSYNCPROC proc, GLsync sync, GLbitfield flags, GLuint64 timeout)
+	{
+		writeVarint((uint64_t)GlFunction::ClientWaitSync);
+		writeHandle(sync);
+		writeValue(flags);
+		writeValue(timeout);
+		return proc(sync, flags, timeout);
+	}
+
+	static void replay(State &state, PFNGLCLIENTWAITSYNCPROC proc)
+	{
+		GLsync sync = (GLsync)(uintptr_t)state.map(GlObject::Sync, state.readVarint());
+		GLbitfield flags = state.read<GLbitfield>();
+		GLuint64 timeout = state.read<GLuint64>();
+		proc(sync, flags, timeout);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::DeleteSync>
+{
+	static void capture(PFNGLDELETESYNCPROC proc, GLsync sync)
+	{
+		writeVarint((uint64_t)GlFunction::DeleteSync);
+		writeHandle(sync);
+		proc(sync);
+	}
+
+	static void replay(State &state, PFNGLDELETESYNCPROC proc)
+	{
+		proc((GLsync)(uintptr_t)state.map(GlObject::Sync, state.readVarint()));
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::ShaderSource>
+{
+	static void capture(PFNGLSHADERSOURCEPROC proc, GLuint shader, GLsizei count, const GLchar *const *strings, const GLint *lengths)
+	{
+		writeVarint((uint64_t)GlFunction::ShaderSource);
+		writeValue(shader);
+		writeVarint((uint64_t)count);
+		for (GLsizei i = 0; i < count; ++i)
+		{
+			size_t length = lengths && lengths[i] >= 0 ? (size_t)lengths[i] : strlen(strings[i]);
+			writeVarint(length);
+			writeBytes(strings[i], length);
+		}
+		proc(shader, count, strings, lengths);
+	}
+
+	static void replay(State &state, PFNGLSHADERSOURCEPROC proc)
+	{
+		GLuint shader = (GLuint)state.map(GlObject::Shader, state.read<GLuint>());
+		GLsizei count = (GLsizei)state.readCount();
+		const GLchar **strings = (const GLchar **)state.scratch((sizeof(GLchar *) + sizeof(GLint)) * (size_t)count);
+		GLint *lengths = (GLint *)(strings + count);
+		for (GLsizei i = 0; i < count; ++i)
+		{
+			lengths[i] = (GLint)state.readCount();
+			strings[i] = (const GLchar *)state.readBytes((uint64_t)lengths[i]);
+		}
+		proc(shader, count, strings, lengths);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::ShaderBinary>
+{
+	static void capture(PFNGLSHADERBINARYPROC proc, GLsizei count, const GLuint *shaders, GLenum format, const void *binary, GLsizei length)
+	{
+		writeVarint((uint64_t)GlFunction::ShaderBinary);
+		writeVarint((uint64_t)count);
+		for (GLsizei i = 0; i < count; ++i)
+			writeValue(shaders[i]);
+		writeValue(format);
+		writeVarint((uint64_t)length);
+		writeBytes(binary, (size_t)length);
+		proc(count, shaders, format, binary, length);
+	}
+
+	static void replay(State &state, PFNGLSHADERBINARYPROC proc)
+	{
+		GLsizei count = (GLsizei)state.readCount();
+		GLuint *shaders = (GLuint *)state.scratch(sizeof(GLuint) * (size_t)count);
+		for (GLsizei i = 0; i < count; ++i)
+			shaders[i] = (GLuint)state.map(GlObject::Shader, state.read<GLuint>());
+		GLenum format = state.read<GLenum>();
+		GLsizei length = (GLsizei)state.readCount();
+		proc(count, shaders, format, state.readBytes((uint64_t)length), length);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::SpecializeShader>
+{
+	static void capture(PFNGLSPECIALIZESHADERPROC proc, GLuint shader, const GLchar *entryPoint, GLuint count, const GLuint *indices, const GLuint *values)
+	{
+		writeVarint((uint64_t)GlFunction::SpecializeShader);
+		writeValue(shader);
+		size_t length = strlen(entryPoint);
+		writeVarint(length);
+		writeBytes(entryPoint, length);
+		writeValue(count);
+		for (GLuint i = 0; i < count; ++i)
+		{
+			writeValue(indices[i]);
+			writeValue(values[i]);
+		}
+		proc(shader, entryPoint, count, indices, values);
+	}
+
+	static void replay(State &state, PFNGLSPECIALIZESHADERPROC proc)
+	{
+		GLuint shader = (GLuint)state.map(GlObject::Shader, state.read<GLuint>());
+		size_t length = state.readCount();
+		std::string entryPoint((const char *)state.readBytes(length), length);
+		GLuint count = (GLuint)state.readCount();
+		GLuint *constants = (GLuint *)state.scratch(2 * sizeof(GLuint) * (size_t)count);
+		for (GLuint i = 0; i < count; ++i)
+		{
+			constants[i] = state.read<GLuint>();
+			constants[count + i] = state.read<GLuint>();
+		}
+		proc(shader, entryPoint.c_str(), count, constants, constants + count);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::VertexAttribPointer>
+{
+	// The pointer is an offset into the bound array buffer, core profiles have no client arrays
+	static void capture(PFNGLVERTEXATTRIBPOINTERPROC proc, GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+	{
+		writeVarint((uint64_t)GlFunction::VertexAttribPointer);
+		writeValue(index);
+		writeValue(size);
+		writeValue(type);
+		writeValue(normalized);
+		writeValue(stride);
+		writeHandle(pointer);
+		proc(index, size, type, normalized, stride, pointer);
+		std::vector<std::pair<GLuint, GLuint>> &attributes = s_VertexArrayBuffers[s_VertexArray];
+		GLuint buffer = s_BufferBindings[GL_ARRAY_BUFFER];
+		auto it = std::find_if(attributes.begin(), attributes.end(),
+			[&](const std::pair<GLuint, GLuint> &attribute) -> bool { return attribute.first == index; });
+		if (it != attributes.end())
+			it->second = buffer;
+		else
+			attributes.push_back({ index, buffer });
+	}
+
+	static void replay(State &state, PFNGLVERTEXATTRIBPOINTERPROC proc)
+	{
+		GLuint index = state.read<GLuint>();
+		GLint size = state.read<GLint>();
+		GLenum type = state.read<GLenum>();
+		GLboolean normalized = state.read<GLboolean>();
+		GLsizei stride = state.read<GLsizei>();
+		const void *pointer = (const void *)(uintptr_t)state.readVarint();
+		proc(index, size, type, normalized, stride, pointer);
+	}
+};
+
+// Queries are issued again, as they may wait for the GPU, into scratch memory
+template <>
+struct GlTrace<GlFunction::GetIntegerv>
+{
+	static void capture(PFNGLGETINTEGERVPROC proc, GLenum pname, GLint *data)
+	{
+		writeVarint((uint64_t)GlFunction::GetIntegerv);
+		writeValue(pname);
+		proc(pname, data);
+	}
+
+	static void replay(State &state, PFNGLGETINTEGERVPROC proc)
+	{
+		proc(state.read<GLenum>(), (GLint *)state.scratch(sizeof(GLint) * 1024));
+	}
+};
+
+template <GlFunction F, GlObject O, typename T>
+struct GlQueryTrace
+{
+	template <typename Proc>
+	static void capture(Proc proc, GLuint name, GLenum pname, T *params)
+	{
+		writeVarint((uint64_t)F);
+		writeValue(name);
+		writeValue(pname);
+		proc(name, pname, params);
+	}
+
+	template <typename Proc>
+	static void replay(State &state, Proc proc)
+	{
+		GLuint name = (GLuint)state.map(O, state.read<GLuint>());
+		GLenum pname = state.read<GLenum>();
+		proc(name, pname, (T *)state.scratch(sizeof(T) * 4));
+	}
+};
+
+template <GlFunction F, GlObject O>
+struct GlInfoLogTrace
+{
+	template <typename Proc>
+	static void capture(Proc proc, GLuint name, GLsizei bufSize, GLsizei *length, GLchar *infoLog)
+	{
+		writeVarint((uint64_t)F);
+		writeValue(name);
+		writeValue(bufSize);
+		proc(name, bufSize, length, infoLog);
+	}
+
+	template <typename Proc>
+	static void replay(State &state, Proc proc)
+	{
+		GLuint name = (GLuint)state.map(O, state.read<GLuint>());
+		GLsizei bufSize = std::clamp(state.read<GLsizei>(), 0, 1 << 20);
+		proc(name, bufSize, null, (GLchar *)state.scratch((size_t)bufSize));
+	}
+};
+
+template <> struct GlTrace<GlFunction::GetProgramiv> : GlQueryTrace<GlFunction::GetProgramiv, GlObject::Program, GLint> { };
+template <> struct GlTrace<GlFunction::GetShaderiv> : GlQueryTrace<GlFunction::GetShaderiv, GlObject::Shader, GLint> { };
+template <> struct GlTrace<GlFunction::GetQueryObjectiv> : GlQueryTrace<GlFunction::GetQueryObjectiv, GlObject::Query, GLint> { };
+template <> struct GlTrace<GlFunction::GetQueryObjectui64v> : GlQueryTrace<GlFunction::GetQueryObjectui64v, GlObject::Query, GLuint64> { };
+template <> struct GlTrace<GlFunction::GetProgramInfoLog> : GlInfoLogTrace<GlFunction::GetProgramInfoLog, GlObject::Program> { };
+template <> struct GlTrace<GlFunction::GetShaderInfoLog> : GlInfoLogTrace<GlFunction::GetShaderInfoLog, GlObject::Shader> { };
+
+template <>
+struct GlTrace<GlFunction::MapBuffer>
+{
+	static void *capture(PFNGLMAPBUFFERPROC proc, GLenum target, GLenum access)
+	{
+		void *pointer = proc(target, access);
+		GLint64 size = 0;
+		if (pointer)
+			gl3wProcs.gl.GetBufferParameteri64v(target, GL_BUFFER_SIZE, &size);
+		writeVarint((uint64_t)GlFunction::MapBuffer);
+		writeValue(target);
+		writeValue(access);
+		writeVarint((uint64_t)size);
+		writeVarint(addMapping(target, pointer, (size_t)size, access != GL_READ_ONLY, false));
+		return pointer;
+	}
+
+	static void replay(State &state, PFNGLMAPBUFFERPROC proc)
+	{
+		GLenum target = state.read<GLenum>();
+		GLenum access = state.read<GLenum>();
+		size_t size = (size_t)state.readVarint();
+		uint64_t id = state.readVarint();
+		void *pointer = proc(target, access);
+		if (id)
+			state.Mappings[id] = { (uint8_t *)pointer, pointer ? size : 0 };
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::MapBufferRange>
+{
+	static void *capture(PFNGLMAPBUFFERRANGEPROC proc, GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+	{
+		void *pointer = proc(target, offset, length, access);
+		writeVarint((uint64_t)GlFunction::MapBufferRange);
+		writeValue(target);
+		writeValue(offset);
+		writeValue(length);
+		writeValue(access);
+		writeVarint(addMapping(target, pointer, (size_t)length, access & GL_MAP_WRITE_BIT, access & GL_MAP_PERSISTENT_BIT));
+		return pointer;
+	}
+
+	static void replay(State &state, PFNGLMAPBUFFERRANGEPROC proc)
+	{
+		GLenum target = state.read<GLenum>();
+		GLintptr offset = state.read<GLintptr>();
+		GLsizeiptr length = state.read<GLsizeiptr>();
+		GLbitfield access = state.read<GLbitfield>();
+		uint64_t id = state.readVarint();
+		void *pointer = proc(target, offset, length, access);
+		if (id)
+			state.Mappings[id] = { (uint8_t *)pointer, pointer ? (size_t)length : 0 };
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::UnmapBuffer> : GlTraceValues<GlFunction::UnmapBuffer>
+{
+	static GLboolean capture(PFNGLUNMAPBUFFERPROC proc, GLenum target)
+	{
+		GLuint buffer = s_BufferBindings[target];
+		auto it = std::find_if(s_Mappings.begin(), s_Mappings.end(),
+			[&](const Mapping &mapping) -> bool { return mapping.Buffer == buffer; });
+		if (it != s_Mappings.end())
+		{
+			if (it->Persistent)
+				flushMapping(*it);
+			else
+				writeMapped(*it, 0, it->Length);
+			s_Mappings.erase(it);
+		}
+		return GlTraceValues::capture(proc, target);
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::ReadPixels>
+{
+	static void capture(PFNGLREADPIXELSPROC proc, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels)
+	{
+		bool packBuffer = s_BufferBindings[GL_PIXEL_PACK_BUFFER] != 0;
+		writeVarint((uint64_t)GlFunction::ReadPixels);
+		writeValue(x);
+		writeValue(y);
+		writeValue(width);
+		writeValue(height);
+		writeValue(format);
+		writeValue(type);
+		writeValue<uint8_t>(packBuffer);
+		writeHandle(packBuffer ? pixels : null);
+		proc(x, y, width, height, format, type, pixels);
+	}
+
+	static void replay(State &state, PFNGLREADPIXELSPROC proc)
+	{
+		GLint x = state.read<GLint>();
+		GLint y = state.read<GLint>();
+		GLsizei width = std::clamp(state.read<GLsizei>(), 0, 1 << 14);
+		GLsizei height = std::clamp(state.read<GLsizei>(), 0, 1 << 14);
+		GLenum format = state.read<GLenum>();
+		GLenum type = state.read<GLenum>();
+		bool packBuffer = state.read<uint8_t>();
+		void *offset = (void *)(uintptr_t)state.readVarint();
+		proc(x, y, width, height, format, type, packBuffer ? offset : state.scratch((size_t)width * (size_t)height * 16));
+	}
+};
+
+template <>
+struct GlTrace<GlFunction::DebugMessageCallback>
+{
+	// Not recorded, the replay has its own
+	static void capture(PFNGLDEBUGMESSAGECALLBACKPROC proc, GLDEBUGPROC callback, const void *userParam)
+	{
+		proc(callback, userParam);
+	}
+
+	static void replay(State &state, PFNGLDEBUGMESSAGECALLBACKPROC proc)
+	{
+		GAME_THROW(Exception("Unexpected glDebugMessageCallback in GL trace"sv, 1));
+	}
+};
+
+template <GlFunction F, typename Proc>
+struct GlCaptureHook;
+
+template <GlFunction F, typename R, typename... Args>
+struct GlCaptureHook<F, R (APIENTRY *)(Args...)>
+{
+	static R APIENTRY call(Args... args)
+	{
+		return GlTrace<F>::capture((R (APIENTRY *)(Args...))s_Originals[(int)F], args...);
+	}
+};
+
+template <GlFunction F, typename Proc>
+void replayCall(State &state)
+{
+	Proc proc = (Proc)state.Procs[(int)F];
+	if (!proc)
+		GAME_THROW(Exception(fmt::format("`{}` is not available on this context", glFunctionName(F))));
+	GlTrace<F>::replay(state, proc);
+}
+
+using ReplayFunction = void (*)(State &state);
+
+const ReplayFunction s_ReplayFunctions[] = {
+#define GAME_GL_CAPTURE_REPLAY(name, kind) &replayCall<GlFunction::name, decltype(gl3wProcs.gl.name)>,
+	GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_CAPTURE_REPLAY)
+#undef GAME_GL_CAPTURE_REPLAY
+};
+
+void writeU32(std::FILE *f, uint32_t v)
+{
+	uint8_t bytes[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+	fwrite(bytes, 1, sizeof(bytes), f);
+}
+
+uint32_t readU32(const uint8_t *bytes)
+{
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+} /* anonymous namespace */
+
+void startGlCapture(int frames, int width, int height)
+{
+	if (s_Capturing)
+		return;
+	s_Trace.clear();
+	s_BufferBindings.clear();
+	s_VertexArrayBuffers.clear();
+	s_VertexArray = 0;
+	s_UniformRanges.clear();
+	s_Mappings.clear();
+	s_CaptureFrames = frames;
+	s_Frames = 0;
+	s_Width = width;
+	s_Height = height;
+#define GAME_GL_CAPTURE_INSTALL(name, kind) \
+	s_Originals[(int)GlFunction::name] = (GL3WglProc)gl3wProcs.gl.name; \
+	if (gl3wProcs.gl.name) \
+		gl3wProcs.gl.name = &GlCaptureHook<GlFunction::name, decltype(gl3wProcs.gl.name)>::call;
+	GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_CAPTURE_INSTALL)
+#undef GAME_GL_CAPTURE_INSTALL
+	s_Capturing = true;
+}
+
+void stopGlCapture()
+{
+	if (!s_Capturing)
+		return;
+#define GAME_GL_CAPTURE_REMOVE(name, kind) \
+	gl3wProcs.gl.name = (decltype(gl3wProcs.gl.name))s_Originals[(int)GlFunction::name];
+	GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_CAPTURE_REMOVE)
+#undef GAME_GL_CAPTURE_REMOVE
+	s_Mappings.clear();
+	s_Capturing = false;
+}
+
+bool glCaptureActive()
+{
+	return s_Capturing;
+}
+
+void glCaptureEndFrame()
+{
+	if (!s_Capturing)
+		return;
+	flushAllMappings();
+	writeVarint(FrameEndRecord);
+	if (++s_Frames >= s_CaptureFrames)
+		stopGlCapture();
+}
+
+int glCaptureFrames()
+{
+	return s_Frames;
+}
+
+// Little endian header of the magic, version, size and frames, then the records
+// until the end of the file, each a varint of the entry point and its arguments
+void writeGlCapture(const char *path)
+{
+	std::FILE *f = fopen(path, "wb");
+	if (!f)
+		GAME_THROW(Exception(fmt::format("Failed to open `{}`", path)));
+	GAME_FINALLY([&]() -> void { fclose(f); });
+	writeU32(f, TraceMagic);
+	writeU32(f, TraceVersion);
+	writeU32(f, (uint32_t)s_Width);
+	writeU32(f, (uint32_t)s_Height);
+	writeU32(f, (uint32_t)s_Frames);
+	fwrite(s_Trace.data(), 1, s_Trace.size(), f);
+	if (ferror(f))
+		GAME_THROW(Exception(fmt::format("Failed to write `{}`", path)));
+}
+
+GlReplay::GlReplay(const char *path) : m_State(std::make_unique<State>())
+{
+	State &state = *m_State;
+	{
+		std::FILE *f = fopen(path, "rb");
+		if (!f)
+			GAME_THROW(Exception(fmt::format("Failed to open `{}`", path)));
+		GAME_FINALLY([&]() -> void { fclose(f); });
+		uint8_t buffer[64 * 1024];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), f)))
+			state.Data.insert(state.Data.end(), buffer, buffer + read);
+		if (ferror(f))
+			GAME_THROW(Exception(fmt::format("Failed to read `{}`", path)));
+	}
+	if (state.Data.size() < TraceHeaderSize || readU32(&state.Data[0]) != TraceMagic)
+		GAME_THROW(Exception(fmt::format("`{}` is not a GL trace", path)));
+	if (readU32(&state.Data[4]) != TraceVersion)
+		GAME_THROW(Exception(fmt::format("`{}` has an unsupported GL trace version", path)));
+	state.Width = (int)readU32(&state.Data[8]);
+	state.Height = (int)readU32(&state.Data[12]);
+	state.Frames = (int)readU32(&state.Data[16]);
+	state.Pos = TraceHeaderSize;
+	state.Frame = 0;
+	state.FrameOffsets.push_back(state.Pos);
+	state.DefaultFramebuffer = 0;
+	state.Calls = 0;
+	state.Unmapped = 0;
+#define GAME_GL_CAPTURE_PROC(name, kind) state.Procs[(int)GlFunction::name] = (GL3WglProc)gl3wProcs.gl.name;
+	GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_CAPTURE_PROC)
+#undef GAME_GL_CAPTURE_PROC
+}
+
+GlReplay::~GlReplay() noexcept
+{
+
+}
+
+int GlReplay::width() const
+{
+	return m_State->Width;
+}
+
+int GlReplay::height() const
+{
+	return m_State->Height;
+}
+
+int GlReplay::frames() const
+{
+	return m_State->Frames;
+}
+
+void GlReplay::setDefaultFramebuffer(GLuint framebuffer)
+{
+	m_State->DefaultFramebuffer = framebuffer;
+}
+
+bool GlReplay::replayFrame()
+{
+	State &state = *m_State;
+	if (state.Pos >= state.Data.size())
+		return false;
+	for (;;)
+	{
+		uint64_t record = state.readVarint();
+		if (record == FrameEndRecord)
+			break;
+		if (record == MappedWriteRecord)
+		{
+			uint64_t id = state.readVarint();
+			uint64_t offset = state.readVarint();
+			uint64_t size = state.readVarint();
+			const uint8_t *bytes = state.readBytes(size);
+			auto it = state.Mappings.find(id);
+			if (it != state.Mappings.end() && it->second.first && offset <= it->second.second && size <= it->second.second - offset)
+				memcpy(it->second.first + offset, bytes, (size_t)size);
+			continue;
+		}
+		if (record >= (uint64_t)GlFunctionCount)
+			GAME_THROW(Exception("GL trace is corrupt"sv, 1));
+		s_ReplayFunctions[record](state);
+		++state.Calls;
+	}
+	++state.Frame;
+	if ((size_t)state.Frame == state.FrameOffsets.size())
+		state.FrameOffsets.push_back(state.Pos);
+	return true;
+}
+
+void GlReplay::rewind(int frame)
+{
+	State &state = *m_State;
+	if (frame < 0 || (size_t)frame >= state.FrameOffsets.size())
+		GAME_THROW(Exception("Can only rewind to frames that were replayed"sv, 1));
+	state.Pos = state.FrameOffsets[frame];
+	state.Frame = frame;
+}
+
+int64_t GlReplay::calls() const
+{
+	return m_State->Calls;
+}
+
+int64_t GlReplay::unmappedNames() const
+{
+	return m_State->Unmapped;
+}
+
+} /* namespace game */
+
+/* end of file */
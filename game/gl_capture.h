@@ -0,0 +1,117 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+GL command stream capture and replay.
+Once capture starts, the gl3w function pointers of the entry points listed in
+`GAME_GL_INTERCEPT_FUNCTIONS` are wrapped to record each call with its
+arguments, and the payloads behind its pointers, such as buffer data and shader
+sources. Object names, including fences, are recorded as the capture saw them and
+mapped to the names the replay context generates.
+
+Writes through mapped buffers are not calls, so mapped ranges are recorded when
+they are unmapped, and persistently mapped ranges are compared with a copy before
+each draw that reads their buffer through the bound vertex array or a range bound
+to a uniform block, recording the blocks that changed. All persistent mappings are also compared before each fence
+and at the end of each frame, which records writes read other ways, such as
+uniform, index, indirect and pixel unpack data, at the latest before the fence
+that guards them. This makes capture slow with many draws from large mapped
+buffers, but it doesn't change what's sent to the driver.
+
+Start the capture before the renderer creates its objects, so that the trace can
+be replayed on a fresh context. It stops by itself after the requested frames.
+Replay needs nothing but a GL 4.4 core context, unless the captured driver took
+the SPIR-V shader path.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_CAPTURE_H
+#define GAME_GL_CAPTURE_H
+
+#include "platform.h"
+
+#include <memory>
+#include <vector>
+
+namespace game {
+
+// Wrap the gl3w pointers, on the thread the context is current on, for the given number of frames
+void startGlCapture(int frames, int width, int height);
+void stopGlCapture();
+bool glCaptureActive();
+
+// Call after each swap, closes the frame in the trace
+void glCaptureEndFrame();
+
+// Frames in the trace so far
+int glCaptureFrames();
+
+// Write the trace after the capture stopped
+void writeGlCapture(const char *path);
+
+class GlReplay
+{
+public:
+	// Reads the whole trace
+	GlReplay(const char *path);
+	~GlReplay() noexcept;
+
+	GlReplay(const GlReplay &other) = delete;
+	GlReplay &operator=(const GlReplay &other) = delete;
+
+	int width() const;
+	int height() const;
+	int frames() const; // In the trace
+
+	// Framebuffer that stands in for the captured default framebuffer, call with the context current
+	void setDefaultFramebuffer(GLuint framebuffer);
+
+	// Issue the calls of the next frame, returns false at the end of the trace
+	bool replayFrame();
+
+	// Continue at an earlier frame, such as after the frame that created the objects
+	void rewind(int frame);
+
+	int64_t calls() const; // Issued so far
+	int64_t unmappedNames() const; // Names used without being generated in the trace
+
+	struct State;
+
+private:
+	std::unique_ptr<State> m_State;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_CAPTURE_H */
+
+/* end of file */
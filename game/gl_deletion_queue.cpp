@@ -0,0 +1,116 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_deletion_queue.h"
+
+#include <algorithm>
+
+namespace game {
+
+GlDeletionQueue::GlDeletionQueue(FrameFence &fence) : m_Fence(fence)
+{
+
+}
+
+GlDeletionQueue::~GlDeletionQueue() noexcept
+{
+	GAME_DEBUG_ASSERT(!pending());
+}
+
+void GlDeletionQueue::queue(Type type, GLuint name)
+{
+	if (!name)
+		return;
+	Pending &pending = m_Pending[type];
+	pending.Frames.push_back(m_Fence.frame());
+	pending.Names.push_back(name);
+}
+
+void GlDeletionQueue::collect()
+{
+	deleteCompleted(m_Fence.completed());
+}
+
+void GlDeletionQueue::flush() noexcept
+{
+	// Deleting objects still in use is valid, it only risks a stall
+	deleteCompleted(m_Fence.frame());
+}
+
+size_t GlDeletionQueue::pending() const
+{
+	size_t res = 0;
+	for (const Pending &pending : m_Pending)
+		res += pending.Names.size();
+	return res;
+}
+
+void GlDeletionQueue::deleteCompleted(int64_t completed) noexcept
+{
+	for (int type = 0; type < TypeCount; ++type)
+	{
+		Pending &pending = m_Pending[type];
+		size_t count = std::upper_bound(pending.Frames.begin(), pending.Frames.end(), completed) - pending.Frames.begin();
+		if (!count)
+			continue;
+		deleteNames((Type)type, pending.Names.data(), count);
+		pending.Frames.erase(pending.Frames.begin(), pending.Frames.begin() + count);
+		pending.Names.erase(pending.Names.begin(), pending.Names.begin() + count);
+	}
+}
+
+void GlDeletionQueue::deleteNames(Type type, const GLuint *names, size_t count) noexcept
+{
+	switch (type)
+	{
+	case Program:
+		for (size_t i = 0; i < count; ++i)
+			glDeleteProgram(names[i]); // No batched call for programs
+		break;
+	case Buffer:
+		glDeleteBuffers((GLsizei)count, names);
+		break;
+	case VertexArray:
+		glDeleteVertexArrays((GLsizei)count, names);
+		break;
+	case Texture:
+		glDeleteTextures((GLsizei)count, names);
+		break;
+	case Framebuffer:
+		glDeleteFramebuffers((GLsizei)count, names);
+		break;
+	default:
+		GAME_DEBUG_ASSERT(false);
+		break;
+	}
+}
+
+} /* namespace game */
+
+/* end of file */
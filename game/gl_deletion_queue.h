@@ -0,0 +1,110 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Deferred, batched deletion of GL objects.
+Deleting an object that queued commands still use may stall the driver,
+so names are queued with the frame in which they were released, and only
+deleted once a fence signaled at the end of that frame has completed.
+Names of the same type that become free together are deleted in a single call.
+
+Frames are fenced through a `FrameFence`, which can be replaced
+to run the queue without a GPU.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_DELETION_QUEUE_H
+#define GAME_GL_DELETION_QUEUE_H
+
+#include "platform.h"
+#include "frame_fence.h"
+
+#include <vector>
+
+namespace game {
+
+class GlDeletionQueue
+{
+public:
+	GlDeletionQueue(FrameFence &fence);
+	~GlDeletionQueue() noexcept;
+
+	GlDeletionQueue(const GlDeletionQueue &other) = delete;
+	GlDeletionQueue &operator=(const GlDeletionQueue &other) = delete;
+
+	// Delete once the GPU is done with the current frame
+	inline void deleteProgram(GLuint program) { queue(Program, program); }
+	inline void deleteBuffer(GLuint buffer) { queue(Buffer, buffer); }
+	inline void deleteVertexArray(GLuint vao) { queue(VertexArray, vao); }
+	inline void deleteTexture(GLuint texture) { queue(Texture, texture); }
+	inline void deleteFramebuffer(GLuint framebuffer) { queue(Framebuffer, framebuffer); }
+
+	// Delete what completed frames released, call after the fence ends a frame
+	void collect();
+
+	// Delete everything now, before the context is destroyed
+	void flush() noexcept;
+
+	// Names waiting for deletion
+	size_t pending() const;
+
+private:
+	enum Type
+	{
+		Program,
+		Buffer,
+		VertexArray,
+		Texture,
+		Framebuffer,
+		TypeCount
+	};
+
+	struct Pending
+	{
+		std::vector<int64_t> Frames; // Increasing
+		std::vector<GLuint> Names;
+	};
+
+	void queue(Type type, GLuint name);
+	void deleteCompleted(int64_t completed) noexcept;
+	static void deleteNames(Type type, const GLuint *names, size_t count) noexcept;
+
+private:
+	FrameFence &m_Fence;
+	Pending m_Pending[TypeCount];
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_DELETION_QUEUE_H */
+
+/* end of file */
@@ -0,0 +1,169 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+GL deletion queue check.
+Drives the deletion queue with a manual frame fence, with the delete entry
+points replaced by functions that record their calls. Checks that names
+are only deleted once their frame completes, in one call per type, and
+that a flush deletes everything still queued.
+
+Usage: game_gl_deletion_queue_check
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "frame_fence.h"
+#include "gl_deletion_queue.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+// Print the failed check, and count it
+bool check(bool condition, std::string_view what, int &failures)
+{
+	if (!condition)
+	{
+		fmt::print("Failed: {}\n", what);
+		++failures;
+	}
+	return condition;
+}
+
+struct DeleteCall
+{
+	std::string_view Function;
+	std::vector<GLuint> Names;
+};
+
+std::vector<DeleteCall> s_DeleteCalls;
+
+void APIENTRY recordDeleteProgram(GLuint program) { s_DeleteCalls.push_back({ "glDeleteProgram"sv, { program } }); }
+void APIENTRY recordDeleteBuffers(GLsizei n, const GLuint *names) { s_DeleteCalls.push_back({ "glDeleteBuffers"sv, { names, names + n } }); }
+void APIENTRY recordDeleteVertexArrays(GLsizei n, const GLuint *names) { s_DeleteCalls.push_back({ "glDeleteVertexArrays"sv, { names, names + n } }); }
+void APIENTRY recordDeleteTextures(GLsizei n, const GLuint *names) { s_DeleteCalls.push_back({ "glDeleteTextures"sv, { names, names + n } }); }
+void APIENTRY recordDeleteFramebuffers(GLsizei n, const GLuint *names) { s_DeleteCalls.push_back({ "glDeleteFramebuffers"sv, { names, names + n } }); }
+
+bool deleted(std::string_view function, std::vector<GLuint> names)
+{
+	for (const DeleteCall &call : s_DeleteCalls)
+		if (call.Function == function && call.Names == names)
+			return true;
+	return false;
+}
+
+// Names are only deleted once their frame completes, in one call per type, and all of them on flush
+int checkDeletionQueue()
+{
+	int failures = 0;
+	gl3wProcs.gl.DeleteProgram = recordDeleteProgram;
+	gl3wProcs.gl.DeleteBuffers = recordDeleteBuffers;
+	gl3wProcs.gl.DeleteVertexArrays = recordDeleteVertexArrays;
+	gl3wProcs.gl.DeleteTextures = recordDeleteTextures;
+	gl3wProcs.gl.DeleteFramebuffers = recordDeleteFramebuffers;
+
+	ManualFrameFence fence;
+	GlDeletionQueue queue(fence);
+	queue.deleteBuffer(1);
+	queue.deleteBuffer(2);
+	queue.deleteTexture(3);
+	queue.deleteBuffer(0); // Ignored
+	fence.endFrame();
+	queue.deleteBuffer(4);
+	queue.deleteProgram(5);
+	queue.deleteVertexArray(6);
+	fence.endFrame();
+	queue.deleteBuffer(7);
+	queue.deleteFramebuffer(8);
+
+	queue.collect();
+	check(s_DeleteCalls.empty(), "deleted before any frame completed"sv, failures);
+	check(queue.pending() == 8, "names not queued"sv, failures);
+
+	fence.complete(0);
+	queue.collect();
+	check(s_DeleteCalls.size() == 2, "completed frame not deleted in one call per type"sv, failures);
+	check(deleted("glDeleteBuffers"sv, { 1, 2 }), "buffers of the completed frame not deleted together"sv, failures);
+	check(deleted("glDeleteTextures"sv, { 3 }), "texture of the completed frame not deleted"sv, failures);
+	check(queue.pending() == 5, "names of frames in flight deleted"sv, failures);
+
+	s_DeleteCalls.clear();
+	queue.collect();
+	check(s_DeleteCalls.empty(), "deleted twice"sv, failures);
+
+	queue.flush();
+	check(s_DeleteCalls.size() == 4, "flush not batched by type"sv, failures);
+	check(deleted("glDeleteBuffers"sv, { 4, 7 }), "buffers in flight not flushed together"sv, failures);
+	check(deleted("glDeleteProgram"sv, { 5 }), "program not flushed"sv, failures);
+	check(deleted("glDeleteVertexArrays"sv, { 6 }), "vertex array not flushed"sv, failures);
+	check(deleted("glDeleteFramebuffers"sv, { 8 }), "framebuffer of the current frame not flushed"sv, failures);
+	check(!queue.pending(), "names left after flush"sv, failures);
+
+	s_DeleteCalls.clear();
+	return failures;
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		if (argc > 1)
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", argv[1])));
+
+		int failures = checkDeletionQueue();
+		fmt::print("Checked the deletion queue, {} failures\n", failures);
+		return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
@@ -29,6 +29,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "gl_exception.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
 namespace game {
 
 namespace /* anonymous */ {
@@ -119,8 +123,35 @@ std::string_view copyString(const std::string_view str) noexcept
 	return std::string_view(buf, str.size());
 }
 
+// First error reported by the debug output callback
+std::atomic<int> s_DebugErrorState; // Empty, writing, or ready
+char s_DebugError[1024];
+
 } /* anonymous namespace */
 
+void recordGlDebugError(const char *message) noexcept
+{
+	int expected = 0;
+	if (!s_DebugErrorState.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+		return; // Keep the first
+	// Truncated, the callback must not fail on long driver messages
+	if (!message)
+		message = "";
+	size_t length = std::min(strlen(message), sizeof(s_DebugError) - 1);
+	memcpy(s_DebugError, message, length);
+	s_DebugError[length] = '\0';
+	s_DebugErrorState.store(2, std::memory_order_release);
+}
+
+void throwIfGlDebugError(const std::string_view file, const int line)
+{
+	if (s_DebugErrorState.load(std::memory_order_acquire) != 2)
+		return;
+	std::string message = fmt::format("OpenGL debug output error\n{}\nFile: {}, line: {}", s_DebugError, file, line);
+	s_DebugErrorState.store(0, std::memory_order_release);
+	GAME_THROW(Exception(message));
+}
+
 GlException::GlException(const GLenum flag, const StringView file, const int line) noexcept 
 	: base("Unknown OpenGL exception"sv, 1),
 	m_Flag(flag), m_File(file), m_Line(line),
@@ -67,9 +67,65 @@ private:
 
 } /* namespace game */
 
+/*
+
+GL error checking policy, selected per build.
+Each `glGetError` may synchronize with the driver, so release builds only check
+at the end of a scope, such as a frame or a resource creation. GL keeps the first
+error flag until it is queried, so the scope check reports the first failing
+scope with its file and line. Define `GAME_GL_ERROR_CHECK` to override.
+
+*/
+
+#define GAME_GL_ERROR_CHECK_DEBUG_OUTPUT 0 // No `glGetError`, scope checks report errors recorded by the KHR_debug callback
+#define GAME_GL_ERROR_CHECK_SCOPE 1 // `glGetError` once per scope, default in release builds
+#define GAME_GL_ERROR_CHECK_CALL 2 // `glGetError` after every call, default in debug builds
+
+#ifndef GAME_GL_ERROR_CHECK
+#ifdef GAME_DEBUG
+#define GAME_GL_ERROR_CHECK GAME_GL_ERROR_CHECK_CALL
+#else
+#define GAME_GL_ERROR_CHECK GAME_GL_ERROR_CHECK_SCOPE
+#endif
+#endif
+
+// Debug output only works reliably on debug contexts
+#if defined(GAME_DEBUG) || (GAME_GL_ERROR_CHECK == GAME_GL_ERROR_CHECK_DEBUG_OUTPUT)
+#define GAME_GL_DEBUG_OUTPUT
+#endif
+#if (GAME_GL_ERROR_CHECK == GAME_GL_ERROR_CHECK_DEBUG_OUTPUT)
+#define GAME_GL_DEBUG_CONTEXT 1
+#else
+#define GAME_GL_DEBUG_CONTEXT 0
+#endif
+
+namespace game {
+
+// Keep the first error message reported by the debug output callback, may be called from any thread
+void recordGlDebugError(const char *message) noexcept;
+
+// Throw the recorded debug output error, if any
+void throwIfGlDebugError(const std::string_view file, const int line);
+
+} /* namespace game */
+
 #define GAME_THROW_GL_ERROR(flag) GAME_THROW(GlException((flag), GAME_CONCAT(__FILE__, sv), __LINE__))
 #define GAME_THROW_IF_GL_ERROR() while (GLenum flag = glGetError()) { GAME_THROW_GL_ERROR(flag); }
 
+// Check after a single call, only with the per call policy
+#if (GAME_GL_ERROR_CHECK == GAME_GL_ERROR_CHECK_CALL)
+#define GAME_CHECK_GL_ERROR() GAME_THROW_IF_GL_ERROR()
+#else
+#define GAME_CHECK_GL_ERROR() do { } while (false)
+#endif
+
+// Check at the end of a scope, covers all calls since the previous check
+#if (GAME_GL_ERROR_CHECK == GAME_GL_ERROR_CHECK_DEBUG_OUTPUT)
+#define GAME_CHECK_GL_ERROR_SCOPE() game::throwIfGlDebugError(GAME_CONCAT(__FILE__, sv), __LINE__)
+#else
+#define GAME_CHECK_GL_ERROR_SCOPE() GAME_THROW_IF_GL_ERROR()
+#endif
+
 #endif /* #ifndef GAME_GL_EXCEPTION_H */
 
 /* end of file */
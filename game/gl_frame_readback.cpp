@@ -0,0 +1,169 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_frame_readback.h"
+#include "gl_exception.h"
+#include "frame_encoder.h"
+
+#include <chrono>
+
+namespace game {
+
+GlFrameReadback::GlFrameReadback(FrameFence &fence) : m_Fence(fence)
+{
+
+}
+
+GlFrameReadback::~GlFrameReadback() noexcept
+{
+	GAME_DEBUG_ASSERT(!m_Slots[0].Buffer);
+}
+
+void GlFrameReadback::setEncoder(std::shared_ptr<FrameEncoder> encoder)
+{
+	while (m_Count)
+		deliver(true);
+	m_Encoder = std::move(encoder);
+	if (!m_Encoder)
+		releaseBuffers();
+}
+
+void GlFrameReadback::read(int width, int height)
+{
+	if (!m_Encoder)
+		return;
+	if (m_Count == SlotCount)
+	{
+		// GPU is far behind, wait for the oldest copy
+		auto start = std::chrono::steady_clock::now();
+		deliver(true);
+		++m_Stats.Stalls;
+		m_Stats.StallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	Slot &slot = m_Slots[(m_First + m_Count) % SlotCount];
+	const size_t size = (size_t)width * height * 4;
+	if (slot.Capacity < size)
+	{
+		// Bound to the pack target only, which nothing else uses
+		if (slot.Buffer)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			GAME_SAFE_GL_DELETE_ONE(glDeleteBuffers, slot.Buffer);
+			slot = { };
+		}
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		GAME_FINALLY([&]() -> void { if (buffer) { GAME_SAFE_GL_DELETE_ONE(glDeleteBuffers, buffer); } });
+		const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, size, null, flags | GL_CLIENT_STORAGE_BIT); // Cached memory for the CPU reads
+		void *memory = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, NULL);
+		GAME_CHECK_GL_ERROR_SCOPE();
+		if (!memory)
+			GAME_THROW(Exception("Failed to map the readback buffer"sv, 1));
+		slot.Memory = (uint8_t *)memory;
+		slot.Capacity = size;
+		slot.Buffer = buffer;
+		buffer = NULL;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, null);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, NULL);
+	GAME_CHECK_GL_ERROR();
+	slot.Frame = m_Fence.frame();
+	slot.Width = width;
+	slot.Height = height;
+	++m_Count;
+}
+
+void GlFrameReadback::collect()
+{
+	if (!m_Count)
+		return;
+	int64_t completed = m_Fence.completed();
+	while (m_Count && m_Slots[m_First].Frame <= completed)
+		deliver(false);
+}
+
+void GlFrameReadback::deliver(bool wait)
+{
+	const Slot &slot = m_Slots[m_First];
+	if (wait)
+		m_Fence.wait(slot.Frame);
+	auto start = std::chrono::steady_clock::now();
+	uint8_t *pixels = m_Encoder->acquire(slot.Width, slot.Height);
+	memcpy(pixels, slot.Memory, (size_t)slot.Width * slot.Height * 4);
+	m_Encoder->submit();
+	m_Stats.CopyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	++m_Stats.Frames;
+	m_Stats.LatencyFrames += m_Fence.frame() - 1 - slot.Frame;
+	m_First = (m_First + 1) % SlotCount;
+	--m_Count;
+}
+
+void GlFrameReadback::release() noexcept
+{
+	try
+	{
+		// Copies of a frame that failed before it was fenced are dropped
+		while (m_Count && m_Slots[m_First].Frame < m_Fence.frame())
+			deliver(true);
+	}
+	catch (...)
+	{
+		// Frames in flight are lost
+	}
+	m_First = 0;
+	m_Count = 0;
+	m_Encoder.reset();
+	releaseBuffers();
+}
+
+void GlFrameReadback::releaseBuffers() noexcept
+{
+	GAME_DEBUG_ASSERT(!m_Count);
+	for (Slot &slot : m_Slots)
+	{
+		if (!slot.Buffer)
+			continue;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, NULL);
+		GAME_SAFE_GL_DELETE_ONE(glDeleteBuffers, slot.Buffer);
+		slot = { };
+	}
+}
+
+} /* namespace game */
+
+/* end of file */
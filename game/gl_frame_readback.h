@@ -0,0 +1,115 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Reads every frame back to the CPU without stalling the pipeline.
+At the end of the frame, the read framebuffer is copied into one of a ring of
+persistently mapped pixel pack buffers, and the pixels are handed to a frame
+encoder some frames later, once the frame fence says the copy is done. A frame
+only waits for the GPU when all buffers are still in flight, counted as a stall.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_FRAME_READBACK_H
+#define GAME_GL_FRAME_READBACK_H
+
+#include "platform.h"
+#include "frame_fence.h"
+
+#include <memory>
+
+namespace game {
+
+class FrameEncoder;
+
+struct GlFrameReadbackStats
+{
+	int64_t Frames; // Delivered to the encoder
+	int64_t LatencyFrames; // Summed over the delivered frames, from the frame read to the frame delivered
+	int64_t Stalls; // Frames that waited for the oldest copy
+	int64_t StallNs;
+	int64_t CopyNs; // From the mapped buffers into the encoder
+};
+
+class GlFrameReadback
+{
+public:
+	GlFrameReadback(FrameFence &fence);
+	~GlFrameReadback() noexcept;
+
+	GlFrameReadback(const GlFrameReadback &other) = delete;
+	GlFrameReadback &operator=(const GlFrameReadback &other) = delete;
+
+	// Deliver the copies in flight to the previous encoder, then read into this one, null stops reading
+	void setEncoder(std::shared_ptr<FrameEncoder> encoder);
+	inline bool active() const { return (bool)m_Encoder; }
+
+	// Copy the read framebuffer, as RGBA, before the frame is fenced
+	void read(int width, int height);
+
+	// Deliver the copies of the completed frames, after the frame is fenced
+	void collect();
+
+	// Delivers the copies in flight, and stops reading
+	void release() noexcept;
+
+	inline const GlFrameReadbackStats &stats() const { return m_Stats; }
+
+private:
+	static const int SlotCount = 3;
+
+	struct Slot
+	{
+		GLuint Buffer;
+		uint8_t *Memory; // Persistently mapped
+		size_t Capacity;
+		int64_t Frame;
+		int Width;
+		int Height;
+	};
+
+	void deliver(bool wait);
+	void releaseBuffers() noexcept;
+
+	FrameFence &m_Fence;
+	std::shared_ptr<FrameEncoder> m_Encoder;
+	Slot m_Slots[SlotCount] = { };
+	int m_First = 0;
+	int m_Count = 0;
+	GlFrameReadbackStats m_Stats = { };
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_FRAME_READBACK_H */
+
+/* end of file */
@@ -0,0 +1,119 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_frame_timer.h"
+#include "gl_exception.h"
+
+namespace game {
+
+GlFrameTimer::GlFrameTimer()
+{
+
+}
+
+GlFrameTimer::~GlFrameTimer() noexcept
+{
+	GAME_DEBUG_ASSERT(!m_Queries[0].Name);
+}
+
+void GlFrameTimer::init()
+{
+	GLuint names[QueryCount];
+	glGenQueries(QueryCount, names);
+	GAME_CHECK_GL_ERROR();
+	for (int i = 0; i < QueryCount; ++i)
+		m_Queries[i] = { names[i], -1, 1.0f };
+	m_First = 0;
+	m_Count = 0;
+	m_Active = false;
+}
+
+void GlFrameTimer::release() noexcept
+{
+	if (!m_Queries[0].Name)
+		return;
+	GLuint names[QueryCount];
+	for (int i = 0; i < QueryCount; ++i)
+		names[i] = m_Queries[i].Name;
+	glDeleteQueries(QueryCount, names);
+	for (Query &query : m_Queries)
+		query = { };
+	m_Count = 0;
+	m_Active = false;
+}
+
+void GlFrameTimer::collect()
+{
+	while (m_Count)
+	{
+		const Query &query = m_Queries[m_First];
+		GLint available = 0;
+		glGetQueryObjectiv(query.Name, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break; // Later queries finish later
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(query.Name, GL_QUERY_RESULT, &ns);
+		m_Latest = { query.Frame, (int64_t)ns, query.RenderScale };
+		m_First = (m_First + 1) % QueryCount;
+		--m_Count;
+	}
+	GAME_CHECK_GL_ERROR();
+}
+
+void GlFrameTimer::begin(float renderScale)
+{
+	if (m_Active)
+		end(); // Previous frame failed before it ended
+	int64_t frame = m_Frame++;
+	if (!m_Queries[0].Name)
+		return;
+	collect();
+	if (m_Count == QueryCount)
+		return; // GPU is far behind, skip timing this frame
+	Query &query = m_Queries[(m_First + m_Count) % QueryCount];
+	query.Frame = frame;
+	query.RenderScale = renderScale;
+	glBeginQuery(GL_TIME_ELAPSED, query.Name);
+	GAME_CHECK_GL_ERROR();
+	m_Active = true;
+}
+
+void GlFrameTimer::end()
+{
+	if (!m_Active)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	GAME_CHECK_GL_ERROR();
+	++m_Count;
+	m_Active = false;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,92 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+GPU time of each frame, from timer queries.
+A `GL_TIME_ELAPSED` query brackets the work of a frame, and finished
+queries are read back on a later frame without waiting for the GPU.
+When all queries in the ring are still pending, the frame is not timed.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_FRAME_TIMER_H
+#define GAME_GL_FRAME_TIMER_H
+
+#include "platform.h"
+#include "renderer.h"
+
+namespace game {
+
+class GlFrameTimer
+{
+public:
+	GlFrameTimer();
+	~GlFrameTimer() noexcept;
+
+	GlFrameTimer(const GlFrameTimer &other) = delete;
+	GlFrameTimer &operator=(const GlFrameTimer &other) = delete;
+
+	void init();
+	void release() noexcept;
+
+	// Bracket the GPU work of a frame, begin also collects the finished queries
+	void begin(float renderScale);
+	void end();
+
+	// Latest finished frame
+	inline const GpuFrameTime &latest() const { return m_Latest; }
+
+private:
+	static const int QueryCount = 8;
+
+	struct Query
+	{
+		GLuint Name;
+		int64_t Frame;
+		float RenderScale;
+	};
+
+	void collect();
+
+	Query m_Queries[QueryCount] = { };
+	int m_First = 0;
+	int m_Count = 0;
+	bool m_Active = false;
+	int64_t m_Frame = 0;
+	GpuFrameTime m_Latest = { -1, 0, 1.0f };
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_FRAME_TIMER_H */
+
+/* end of file */
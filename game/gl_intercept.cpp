@@ -0,0 +1,413 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_intercept.h"
+
+#include <chrono>
+#include <unordered_map>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+enum class GlCallKind
+{
+	Call, // No state is shadowed
+	Set, // The arguments are the state
+	KeyedSet, // The first argument selects the state, such as the bind target
+	Enable,
+	Disable,
+	BindFramebuffer, // Keyed, and `GL_FRAMEBUFFER` sets both the draw and the read binding
+	BindBufferRange, // The indexed range is not shadowed, but the target binding is set too
+};
+
+constexpr GlCallKind kindOf(GlFunction function)
+{
+	switch (function)
+	{
+#define GAME_GL_INTERCEPT_KIND(name, kind) case GlFunction::name: return GlCallKind::kind;
+		GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_INTERCEPT_KIND)
+#undef GAME_GL_INTERCEPT_KIND
+	default:
+		return GlCallKind::Call;
+	}
+}
+
+constexpr std::string_view s_Names[] = {
+#define GAME_GL_INTERCEPT_NAME(name, kind) "gl" #name ""sv,
+	GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_INTERCEPT_NAME)
+#undef GAME_GL_INTERCEPT_NAME
+};
+
+struct FunctionStats
+{
+	int64_t Calls;
+	int64_t Ns;
+	int64_t Redundant;
+	int64_t FrameCalls;
+	int64_t MaxFrameCalls;
+};
+
+// Shadow of one piece of state
+struct StateSlot
+{
+	uint64_t Value;
+	bool Known;
+	int64_t Frame; // Last frame it changed in
+	uint64_t FrameStartValue;
+	bool FrameStartKnown;
+	int64_t FrameChanges;
+	int64_t ChurnFrames;
+	int64_t ChurnChanges;
+};
+
+bool s_Installed;
+GL3WglProc s_Originals[GlFunctionCount];
+FunctionStats s_Stats[GlFunctionCount];
+int64_t s_Frame;
+int64_t s_FrameCalls;
+int64_t s_MaxFrameCalls;
+std::unordered_map<uint64_t, StateSlot> s_State; // By function and key, grows only while new state is seen
+std::vector<uint64_t> s_Changed; // Slots changed in this frame
+
+uint64_t stateKey(GlFunction function, uint64_t key)
+{
+	return ((uint64_t)function << 32) | (key & 0xFFFFFFFF);
+}
+
+template <typename T>
+void hashArg(uint64_t &hash, const T &arg)
+{
+	static_assert(sizeof(T) <= sizeof(uint64_t));
+	uint64_t v = 0;
+	memcpy(&v, &arg, sizeof(T));
+	hash = (hash ^ v) * 0x100000001B3ull;
+	hash ^= hash >> 29;
+}
+
+template <typename... Args>
+uint64_t hashArgs(const Args &...args)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	(hashArg(hash, args), ...);
+	return hash;
+}
+
+// Returns true when the state already had the value
+bool setState(uint64_t key, uint64_t value)
+{
+	StateSlot &slot = s_State[key];
+	if (slot.Known && slot.Value == value)
+		return true;
+	if (slot.Frame != s_Frame || !slot.FrameChanges)
+	{
+		slot.Frame = s_Frame;
+		slot.FrameStartValue = slot.Value;
+		slot.FrameStartKnown = slot.Known;
+		slot.FrameChanges = 0;
+		s_Changed.push_back(key);
+	}
+	slot.Value = value;
+	slot.Known = true;
+	++slot.FrameChanges;
+	return false;
+}
+
+template <typename Key, typename... Rest>
+bool setKeyedState(GlFunction function, const Key &key, const Rest &...rest)
+{
+	return setState(stateKey(function, (uint64_t)key), hashArgs(rest...));
+}
+
+template <GlFunction F, typename... Args>
+bool trackState(const Args &...args)
+{
+	constexpr GlCallKind kind = kindOf(F);
+	if constexpr (kind == GlCallKind::Set)
+	{
+		return setState(stateKey(F, 0), hashArgs(args...));
+	}
+	else if constexpr (kind == GlCallKind::KeyedSet)
+	{
+		return setKeyedState(F, args...);
+	}
+	else if constexpr (kind == GlCallKind::Enable || kind == GlCallKind::Disable)
+	{
+		static_assert(sizeof...(Args) == 1);
+		return setState(stateKey(GlFunction::Enable, (uint64_t)(args, ...)), kind == GlCallKind::Enable);
+	}
+	else if constexpr (kind == GlCallKind::BindFramebuffer)
+	{
+		auto bind = [](GLenum target, GLuint framebuffer) -> bool {
+			if (target != GL_FRAMEBUFFER)
+				return setState(stateKey(F, target), framebuffer);
+			bool draw = setState(stateKey(F, GL_DRAW_FRAMEBUFFER), framebuffer);
+			bool read = setState(stateKey(F, GL_READ_FRAMEBUFFER), framebuffer);
+			return draw && read;
+		};
+		return bind(args...);
+	}
+	else if constexpr (kind == GlCallKind::BindBufferRange)
+	{
+		auto bind = [](GLenum target, GLuint, GLuint buffer, GLintptr, GLsizeiptr) -> bool {
+			setState(stateKey(GlFunction::BindBuffer, target), hashArgs(buffer));
+			return false;
+		};
+		return bind(args...);
+	}
+	else
+	{
+		return false;
+	}
+}
+
+// Binding that deleting objects with the function may reset to zero
+constexpr GlFunction unbinds(GlFunction function)
+{
+	switch (function)
+	{
+	case GlFunction::DeleteBuffers: return GlFunction::BindBuffer;
+	case GlFunction::DeleteFramebuffers: return GlFunction::BindFramebuffer;
+	case GlFunction::DeleteRenderbuffers: return GlFunction::BindRenderbuffer;
+	case GlFunction::DeleteTextures: return GlFunction::BindTexture;
+	case GlFunction::DeleteVertexArrays: return GlFunction::BindVertexArray;
+	default: return GlFunction::Count;
+	}
+}
+
+// Deleting a bound object unbinds it, so names that are generated again can't be taken as bound
+void forgetBindings(GlFunction bind)
+{
+	for (auto &it : s_State)
+		if ((GlFunction)(it.first >> 32) == bind)
+			it.second.Known = false;
+}
+
+template <GlFunction F>
+struct GlCall
+{
+	bool Redundant;
+	std::chrono::steady_clock::time_point Start;
+
+	~GlCall() noexcept
+	{
+		FunctionStats &stats = s_Stats[(int)F];
+		++stats.Calls;
+		++stats.FrameCalls;
+		++s_FrameCalls;
+		stats.Ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+		stats.Redundant += Redundant ? 1 : 0;
+	}
+};
+
+template <GlFunction F, typename Proc>
+struct GlHook;
+
+template <GlFunction F, typename R, typename... Args>
+struct GlHook<F, R (APIENTRY *)(Args...)>
+{
+	static R APIENTRY call(Args... args)
+	{
+		if constexpr (unbinds(F) != GlFunction::Count)
+			forgetBindings(unbinds(F));
+		GlCall<F> record = { trackState<F>(args...), std::chrono::steady_clock::now() };
+		return ((R (APIENTRY *)(Args...))s_Originals[(int)F])(args...);
+	}
+};
+
+std::string enumName(GLenum value)
+{
+	switch (value)
+	{
+	case GL_FRAMEBUFFER_SRGB: return "GL_FRAMEBUFFER_SRGB"s;
+	case GL_SCISSOR_TEST: return "GL_SCISSOR_TEST"s;
+	case GL_BLEND: return "GL_BLEND"s;
+	case GL_DEPTH_TEST: return "GL_DEPTH_TEST"s;
+	case GL_CULL_FACE: return "GL_CULL_FACE"s;
+	case GL_STENCIL_TEST: return "GL_STENCIL_TEST"s;
+	case GL_DEBUG_OUTPUT: return "GL_DEBUG_OUTPUT"s;
+	case GL_DEBUG_OUTPUT_SYNCHRONOUS: return "GL_DEBUG_OUTPUT_SYNCHRONOUS"s;
+	case GL_ARRAY_BUFFER: return "GL_ARRAY_BUFFER"s;
+	case GL_ELEMENT_ARRAY_BUFFER: return "GL_ELEMENT_ARRAY_BUFFER"s;
+	case GL_UNIFORM_BUFFER: return "GL_UNIFORM_BUFFER"s;
+	case GL_PIXEL_PACK_BUFFER: return "GL_PIXEL_PACK_BUFFER"s;
+	case GL_PIXEL_UNPACK_BUFFER: return "GL_PIXEL_UNPACK_BUFFER"s;
+	case GL_DRAW_FRAMEBUFFER: return "GL_DRAW_FRAMEBUFFER"s;
+	case GL_READ_FRAMEBUFFER: return "GL_READ_FRAMEBUFFER"s;
+	case GL_RENDERBUFFER: return "GL_RENDERBUFFER"s;
+	case GL_TEXTURE_2D: return "GL_TEXTURE_2D"s;
+	default: return fmt::format("0x{:04X}", value);
+	}
+}
+
+std::string stateName(uint64_t key)
+{
+	GlFunction function = (GlFunction)(key >> 32);
+	GlCallKind kind = kindOf(function);
+	if (kind == GlCallKind::Set)
+		return std::string(glFunctionName(function));
+	if (kind == GlCallKind::Enable)
+		return fmt::format("glEnable/glDisable({})", enumName((GLenum)key));
+	return fmt::format("{}({})", glFunctionName(function), enumName((GLenum)key));
+}
+
+} /* anonymous namespace */
+
+std::string_view glFunctionName(GlFunction function)
+{
+	return (int)function >= 0 && (int)function < GlFunctionCount ? s_Names[(int)function] : "?"sv;
+}
+
+void installGlIntercept()
+{
+	if (s_Installed)
+		return;
+#define GAME_GL_INTERCEPT_INSTALL(name, kind) \
+	s_Originals[(int)GlFunction::name] = (GL3WglProc)gl3wProcs.gl.name; \
+	if (gl3wProcs.gl.name) \
+		gl3wProcs.gl.name = &GlHook<GlFunction::name, decltype(gl3wProcs.gl.name)>::call;
+	GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_INTERCEPT_INSTALL)
+#undef GAME_GL_INTERCEPT_INSTALL
+	s_Installed = true;
+	resetGlIntercept();
+}
+
+void removeGlIntercept()
+{
+	if (!s_Installed)
+		return;
+#define GAME_GL_INTERCEPT_REMOVE(name, kind) \
+	gl3wProcs.gl.name = (decltype(gl3wProcs.gl.name))s_Originals[(int)GlFunction::name];
+	GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_INTERCEPT_REMOVE)
+#undef GAME_GL_INTERCEPT_REMOVE
+	s_Installed = false;
+}
+
+bool glInterceptInstalled()
+{
+	return s_Installed;
+}
+
+void glInterceptEndFrame()
+{
+	if (!s_Installed)
+		return;
+	for (FunctionStats &stats : s_Stats)
+	{
+		stats.MaxFrameCalls = std::max(stats.MaxFrameCalls, stats.FrameCalls);
+		stats.FrameCalls = 0;
+	}
+	s_MaxFrameCalls = std::max(s_MaxFrameCalls, s_FrameCalls);
+	s_FrameCalls = 0;
+	for (uint64_t key : s_Changed)
+	{
+		StateSlot &slot = s_State[key];
+		if (slot.FrameChanges >= 2 && slot.FrameStartKnown && slot.Known && slot.Value == slot.FrameStartValue)
+		{
+			++slot.ChurnFrames;
+			slot.ChurnChanges += slot.FrameChanges;
+		}
+		slot.FrameChanges = 0;
+	}
+	s_Changed.clear();
+	++s_Frame;
+}
+
+void resetGlIntercept()
+{
+	for (FunctionStats &stats : s_Stats)
+		stats = { };
+	for (auto &it : s_State)
+	{
+		it.second.ChurnFrames = 0;
+		it.second.ChurnChanges = 0;
+	}
+	s_FrameCalls = 0;
+	s_MaxFrameCalls = 0;
+	s_Frame = 0;
+	s_Changed.clear();
+	for (auto &it : s_State)
+		it.second.FrameChanges = 0;
+}
+
+GlInterceptReport glInterceptReport()
+{
+	GlInterceptReport report = { };
+	report.Frames = s_Frame;
+	report.MaxFrameCalls = s_MaxFrameCalls;
+	for (int i = 0; i < GlFunctionCount; ++i)
+	{
+		const FunctionStats &stats = s_Stats[i];
+		if (stats.Calls)
+			report.Calls.push_back({ (GlFunction)i, stats.Calls, stats.Ns, stats.Redundant, stats.MaxFrameCalls });
+	}
+	std::sort(report.Calls.begin(), report.Calls.end(),
+		[](const GlCallStats &a, const GlCallStats &b) -> bool { return a.Ns > b.Ns; });
+	for (const auto &it : s_State)
+	{
+		if (it.second.ChurnFrames)
+			report.Churn.push_back({ stateName(it.first), it.second.ChurnFrames, it.second.ChurnChanges });
+	}
+	std::sort(report.Churn.begin(), report.Churn.end(),
+		[](const GlStateChurn &a, const GlStateChurn &b) -> bool { return a.Changes > b.Changes || (a.Changes == b.Changes && a.State < b.State); });
+	return report;
+}
+
+void writeGlInterceptReport(std::FILE *f, const GlInterceptReport &report)
+{
+	double frames = (double)std::max<int64_t>(report.Frames, 1);
+	int64_t calls = 0;
+	int64_t ns = 0;
+	int64_t redundant = 0;
+	for (const GlCallStats &stats : report.Calls)
+	{
+		calls += stats.Calls;
+		ns += stats.Ns;
+		redundant += stats.Redundant;
+	}
+	fmt::print(f, "GL calls over {} frames: {:.1f} per frame, max {} in a frame, {:.1f} redundant per frame, {:.1f} us per frame in the driver\n",
+		report.Frames, (double)calls / frames, report.MaxFrameCalls, (double)redundant / frames, (double)ns * 1e-3 / frames);
+	fmt::print(f, "function, calls per frame, max per frame, ns per call, us per frame, redundant per frame\n");
+	for (const GlCallStats &stats : report.Calls)
+	{
+		fmt::print(f, "{}, {:.2f}, {}, {:.0f}, {:.2f}, {:.2f}\n",
+			glFunctionName(stats.Function), (double)stats.Calls / frames, stats.MaxFrameCalls,
+			(double)stats.Ns / (double)stats.Calls, (double)stats.Ns * 1e-3 / frames, (double)stats.Redundant / frames);
+	}
+	if (!report.Churn.empty())
+	{
+		fmt::print(f, "State changed and restored within a frame:\n");
+		for (const GlStateChurn &churn : report.Churn)
+			fmt::print(f, "{}, in {} of {} frames, {:.2f} changes per frame\n", churn.State, churn.Frames, report.Frames, (double)churn.Changes / frames);
+	}
+}
+
+} /* namespace game */
+
+/* end of file */
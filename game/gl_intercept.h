@@ -0,0 +1,188 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+GL call interception.
+Once installed, the gl3w function pointers of the entry points listed below
+are replaced with wrappers that count each call, time it on the CPU, and
+flag calls that set state to what it already was, before calling the driver.
+Binds, enables, the program, viewport and scissor are shadowed as they are set,
+starting unknown. State that is changed and then changed back within a frame,
+such as an enable that's toggled off and on again every frame, is reported
+separately, as it's not redundant per call but still costs calls every frame.
+
+Only the entry points in `GAME_GL_INTERCEPT_FUNCTIONS` are wrapped, add new ones
+there when the renderer starts using them. The wrappers are generated from the
+gl3w pointer types, so only the name and the kind of state it sets are listed.
+
+All calls must come from the thread the context is current on, the statistics
+are not synchronized. Read the report once that thread is idle.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_INTERCEPT_H
+#define GAME_GL_INTERCEPT_H
+
+#include "platform.h"
+
+#include <vector>
+
+// Entry point, and the state it sets
+#define GAME_GL_INTERCEPT_FUNCTIONS(X) \
+	X(AttachShader, Call) \
+	X(BeginQuery, Call) \
+	X(BindBuffer, KeyedSet) \
+	X(BindBufferRange, BindBufferRange) \
+	X(BindFramebuffer, BindFramebuffer) \
+	X(BindRenderbuffer, KeyedSet) \
+	X(BindTexture, KeyedSet) \
+	X(BindVertexArray, Set) \
+	X(BlitFramebuffer, Call) \
+	X(BufferData, Call) \
+	X(BufferStorage, Call) \
+	X(CheckFramebufferStatus, Call) \
+	X(ClearBufferfv, Call) \
+	X(ClientWaitSync, Call) \
+	X(CompileShader, Call) \
+	X(CreateProgram, Call) \
+	X(CreateShader, Call) \
+	X(DebugMessageCallback, Call) \
+	X(DeleteBuffers, Call) \
+	X(DeleteFramebuffers, Call) \
+	X(DeleteProgram, Call) \
+	X(DeleteQueries, Call) \
+	X(DeleteRenderbuffers, Call) \
+	X(DeleteShader, Call) \
+	X(DeleteSync, Call) \
+	X(DeleteTextures, Call) \
+	X(DeleteVertexArrays, Call) \
+	X(DetachShader, Call) \
+	X(Disable, Disable) \
+	X(DrawArrays, Call) \
+	X(Enable, Enable) \
+	X(EnableVertexAttribArray, Call) \
+	X(EndQuery, Call) \
+	X(FenceSync, Call) \
+	X(Finish, Call) \
+	X(FramebufferRenderbuffer, Call) \
+	X(FramebufferTexture2D, Call) \
+	X(GenBuffers, Call) \
+	X(GenFramebuffers, Call) \
+	X(GenQueries, Call) \
+	X(GenRenderbuffers, Call) \
+	X(GenTextures, Call) \
+	X(GenVertexArrays, Call) \
+	X(GetError, Call) \
+	X(GetIntegerv, Call) \
+	X(GetProgramInfoLog, Call) \
+	X(GetProgramiv, Call) \
+	X(GetQueryObjectiv, Call) \
+	X(GetQueryObjectui64v, Call) \
+	X(GetShaderInfoLog, Call) \
+	X(GetShaderiv, Call) \
+	X(GetString, Call) \
+	X(GetStringi, Call) \
+	X(LinkProgram, Call) \
+	X(MapBuffer, Call) \
+	X(MapBufferRange, Call) \
+	X(ReadPixels, Call) \
+	X(RenderbufferStorage, Call) \
+	X(Scissor, Set) \
+	X(ShaderBinary, Call) \
+	X(ShaderSource, Call) \
+	X(SpecializeShader, Call) \
+	X(TexStorage2D, Call) \
+	X(UnmapBuffer, Call) \
+	X(UseProgram, Set) \
+	X(VertexAttribPointer, Call) \
+	X(Viewport, Set)
+
+namespace game {
+
+enum class GlFunction : int
+{
+#define GAME_GL_INTERCEPT_ENUM(name, kind) name,
+	GAME_GL_INTERCEPT_FUNCTIONS(GAME_GL_INTERCEPT_ENUM)
+#undef GAME_GL_INTERCEPT_ENUM
+	Count,
+};
+
+constexpr int GlFunctionCount = (int)GlFunction::Count;
+
+// Name of the entry point, with the gl prefix
+std::string_view glFunctionName(GlFunction function);
+
+struct GlCallStats
+{
+	GlFunction Function;
+	int64_t Calls;
+	int64_t Ns; // CPU time in the driver
+	int64_t Redundant; // Set state to what it already was
+	int64_t MaxFrameCalls;
+};
+
+// State that ended frames where it started, after changing within them
+struct GlStateChurn
+{
+	std::string State; // Such as `glEnable(GL_FRAMEBUFFER_SRGB)`
+	int64_t Frames;
+	int64_t Changes;
+};
+
+struct GlInterceptReport
+{
+	int64_t Frames;
+	int64_t MaxFrameCalls; // All entry points
+	std::vector<GlCallStats> Calls; // Entry points that were called, most time first
+	std::vector<GlStateChurn> Churn;
+};
+
+// Wrap the gl3w pointers, after gl3w was initialized on the thread the context is current on
+void installGlIntercept();
+void removeGlIntercept();
+bool glInterceptInstalled();
+
+// Call after each swap, closes the frame in the statistics
+void glInterceptEndFrame();
+
+// Restart the statistics, such as after warming up
+void resetGlIntercept();
+
+GlInterceptReport glInterceptReport();
+
+// Per frame calls, time and redundant calls of each entry point, and the state churn
+void writeGlInterceptReport(std::FILE *f, const GlInterceptReport &report);
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_INTERCEPT_H */
+
+/* end of file */
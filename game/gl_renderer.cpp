@@ -0,0 +1,432 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_renderer.h"
+#include "gl_exception.h"
+#include "vertex_format.h"
+#include "arena.h"
+#include "gl_intercept.h"
+#include "gl_capture.h"
+#include "log.h"
+
+namespace game {
+
+bool ArbSpirV;
+bool ArbSpirVExt;
+bool ExtSwapControlTear;
+
+namespace /* anonymous */ {
+
+#ifdef GAME_GL_DEBUG_OUTPUT
+void APIENTRY debugCallbackGl(
+	GLenum source, GLenum type, GLuint id,
+	GLenum severity, GLsizei length, const GLchar *message,
+	const void *userParam)
+{
+	if (type == GL_DEBUG_TYPE_ERROR)
+		recordGlDebugError(message);
+	switch (severity)
+	{
+	case GL_DEBUG_SEVERITY_HIGH:
+	case GL_DEBUG_SEVERITY_MEDIUM:
+		GAME_LOG_ERROR("GL: {}", message);
+#ifdef GAME_DEBUG
+		flushLog(); // Shown before the break
+#endif
+		GAME_DEBUG_BREAK();
+		break;
+	case GL_DEBUG_SEVERITY_LOW:
+		GAME_LOG_WARNING("GL: {}", message);
+		break;
+	default:
+		GAME_LOG_DEBUG("GL: {}", message);
+	}
+}
+#endif
+
+void checkCompileStatus(GLuint shader)
+{
+	GLint status = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	GAME_CHECK_GL_ERROR_SCOPE();
+	if (!status)
+	{
+		GLint logLength = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+		GAME_CHECK_GL_ERROR();
+
+		std::string log(logLength, 0);
+		glGetShaderInfoLog(shader, logLength, &logLength, &log[0]);
+		GAME_CHECK_GL_ERROR_SCOPE();
+		log.resize(logLength);
+
+		GAME_THROW(Exception(log));
+	}
+}
+
+void checkLinkStatus(GLuint program)
+{
+	GLint status = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	GAME_CHECK_GL_ERROR_SCOPE();
+	if (!status)
+	{
+		GLint logLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		GAME_CHECK_GL_ERROR();
+
+		std::string log(logLength, 0);
+		glGetProgramInfoLog(program, logLength, &logLength, &log[0]);
+		GAME_CHECK_GL_ERROR_SCOPE();
+		log.resize(logLength);
+
+		GAME_THROW(Exception(log));
+	}
+}
+
+void loadShader(GLuint shader, const uint8_t *spv, size_t spvLen, const char *const *glsl, size_t glslLen)
+{
+	if (ArbSpirV && spv)
+	{
+		glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, spv, (GLsizei)spvLen);
+		glSpecializeShader(shader, "main", 0, null, null);
+	}
+	else if (glsl)
+	{
+		GLint len = (GLint)glslLen;
+		glShaderSource(shader, 1, glsl, &len);
+		glCompileShader(shader);
+	}
+	else
+	{
+		throw Exception("No shader loaded");
+	}
+	GAME_CHECK_GL_ERROR();
+	checkCompileStatus(shader);
+}
+
+bool isShaderSpirV(GLuint shader)
+{
+	if (!ArbSpirV)
+		return false;
+	GLint res = 0;
+	glGetShaderiv(shader, GL_SPIR_V_BINARY, &res);
+	GAME_CHECK_GL_ERROR();
+	return res;
+}
+
+#define GAME_LOAD_SHADER(shader, name, ext) \
+	loadShader((shader), \
+		shaders::name::ext::spv, sizeof(shaders::name::ext::spv), \
+		shaders::name::ext::glsl, sizeof(shaders::name::ext::glsl0));
+
+#include "col.vs_6_0.inl"
+#include "col.ps_6_0.inl"
+
+// Uniform block binding of `DrawConstants` in the vertex color program
+constexpr GLuint DrawConstantsBinding = 0;
+
+} /* anonymous namespace */
+
+void initGlContext()
+{
+	GAME_LOG_INFO("OpenGL {}, GLSL {}, vendor: {}, renderer: {}",
+		(const char *)glGetString(GL_VERSION), (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION),
+		(const char *)glGetString(GL_VENDOR), (const char *)glGetString(GL_RENDERER));
+
+#ifdef GAME_GL_DEBUG_OUTPUT
+	glDebugMessageCallback(debugCallbackGl, 0);
+	GAME_CHECK_GL_ERROR();
+#ifdef GAME_DEBUG
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	GAME_CHECK_GL_ERROR();
+#endif
+	glEnable(GL_DEBUG_OUTPUT);
+	GAME_CHECK_GL_ERROR();
+#endif
+
+	std::string extensions; // Logged on one line
+	GLint numExt = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExt);
+	GAME_CHECK_GL_ERROR();
+	for (GLint i = 0; i < numExt; ++i)
+	{
+		const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		GAME_CHECK_GL_ERROR();
+		if (!ext)
+			continue;
+		if (logEnabled(LogLevel::Debug))
+		{
+			extensions += ' ';
+			extensions += ext;
+		}
+		if (!strcmp(ext, "GL_ARB_gl_spirv"))
+			ArbSpirV = true;
+		else if (!strcmp(ext, "GL_ARB_spirv_extensions"))
+			ArbSpirVExt = true;
+		else if (!strcmp(ext, "WGL_EXT_swap_control_tear") || !strcmp(ext, "GLX_EXT_swap_control_tear"))
+			ExtSwapControlTear = true;
+	}
+	GAME_CHECK_GL_ERROR_SCOPE();
+	GAME_LOG_DEBUG("GL extensions:{}", extensions);
+
+	// ARB_gl_spirv and ARB_spirv_extensions are core in GL 4.6
+	GAME_LOG_INFO("ARB_gl_spirv: {}, ARB_spirv_extensions: {}, EXT_swap_control_tear: {}", ArbSpirV, ArbSpirVExt, ExtSwapControlTear);
+
+	if (ArbSpirV)
+	{
+		GAME_DEBUG_ASSERT(glShaderBinary);
+		GAME_DEBUG_ASSERT(glSpecializeShader);
+	}
+}
+
+GlRenderer::GlRenderer(std::function<void()> makeCurrent, std::function<void()> swapBuffers)
+	: m_MakeCurrent(std::move(makeCurrent)), m_SwapBuffers(std::move(swapBuffers)), m_Deletions(m_Fence), m_Resources(m_State, m_Deletions), m_Stream(m_Fence, m_State, m_Deletions), m_Readback(m_Fence)
+{
+
+}
+
+GlRenderer::~GlRenderer() noexcept
+{
+	GAME_DEBUG_ASSERT(!m_ColProgram);
+	GAME_DEBUG_ASSERT(m_Meshes.empty());
+}
+
+void GlRenderer::init()
+{
+	// Context may be current on another thread than the one that created it
+	m_MakeCurrent();
+
+	// Create vertex color program
+	GLuint colProgram = NULL;
+	GAME_FINALLY([&]() -> void { GAME_SAFE_C_DELETE(glDeleteProgram, colProgram); });
+	{
+		GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+		GAME_FINALLY([&]() -> void { GAME_SAFE_C_DELETE(glDeleteShader, vertShader); });
+		GAME_LOAD_SHADER(vertShader, col, vs_6_0);
+
+		GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+		GAME_FINALLY([&]() -> void { GAME_SAFE_C_DELETE(glDeleteShader, fragShader); });
+		GAME_LOAD_SHADER(fragShader, col, ps_6_0);
+
+		GLuint program = glCreateProgram();
+		GAME_FINALLY([&]() -> void { GAME_SAFE_C_DELETE(glDeleteProgram, program); });
+		glAttachShader(program, vertShader);
+		glAttachShader(program, fragShader);
+		glLinkProgram(program);
+		// BUG: Memory access violation if the shaders are detached (and deleted) on AMD with SPIR-V
+		if (!isShaderSpirV(vertShader))
+			glDetachShader(program, vertShader);
+		// BUG: Memory access violation if the shaders are detached (and deleted) on AMD with SPIR-V
+		if (!isShaderSpirV(fragShader))
+			glDetachShader(program, fragShader);
+		GAME_CHECK_GL_ERROR();
+		checkLinkStatus(program);
+
+		colProgram = program;
+		program = NULL;
+	}
+
+	m_ColProgram = m_Resources.adoptProgram(colProgram);
+	colProgram = NULL;
+
+	m_Stream.init(GAME_GL_STREAM_BUFFER_SIZE);
+	m_Timer.init();
+}
+
+void GlRenderer::release() noexcept
+{
+	m_Readback.release();
+	m_Meshes.clear();
+	m_Timer.release();
+	m_Resources.release();
+	m_SceneColor = GlTexture();
+	m_SceneFramebuffer = GlFramebuffer();
+	m_Stream.release();
+	m_Deletions.flush();
+	m_Fence.release();
+	m_ColProgram = GlProgram();
+}
+
+[[nodiscard]] Mesh GlRenderer::createMesh(const float *positions, const float *colors, int vertexCount)
+{
+	// Interleaved, snorm positions when they fit, else half floats, and sRGB colors, 12 bytes per vertex
+	VertexLayout layout;
+	layout.add(0, inSnormRange(positions, (size_t)vertexCount * 4) ? VertexEncoding::Snorm16x4 : VertexEncoding::Half4);
+	layout.add(1, VertexEncoding::Srgb8x4);
+
+	ScratchScope scratch;
+	uint8_t *vertices = scratch.allocate<uint8_t>((size_t)layout.stride() * vertexCount);
+	const float *sources[] = { positions, colors };
+	packVertices(layout, sources, vertexCount, vertices);
+
+	GlMesh mesh = { };
+	mesh.VertexCount = vertexCount;
+	GAME_FINALLY([&]() -> void {
+		m_Resources.destroy(mesh.Buffer);
+		m_Resources.destroy(mesh.Vao);
+	});
+	mesh.Buffer = m_Resources.createBuffer((GLsizeiptr)layout.stride() * vertexCount, vertices, GL_STATIC_DRAW);
+	mesh.Vao = m_Resources.createVertexArray(layout, mesh.Buffer);
+
+	Mesh res = m_Meshes.create(mesh);
+	mesh = { };
+	return res;
+}
+
+void GlRenderer::destroyMesh(Mesh mesh) noexcept
+{
+	const GlMesh *glMesh = m_Meshes.get(mesh);
+	if (!glMesh)
+		return;
+	m_Resources.destroy(glMesh->Buffer);
+	m_Resources.destroy(glMesh->Vao);
+	m_Meshes.destroy(mesh);
+}
+
+void GlRenderer::setFrameCapture(std::shared_ptr<FrameEncoder> encoder)
+{
+	std::unique_lock<std::mutex> lock(m_CaptureMutex);
+	m_NextCapture = std::move(encoder);
+	m_CaptureChanged = true;
+}
+
+void GlRenderer::beginFrame(int width, int height, float renderScale)
+{
+	// Set current context
+	m_MakeCurrent();
+	m_State.resetStats();
+	m_Timer.begin(renderScale);
+	if (m_Upscaled)
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)m_Backbuffer); // Previous frame failed before it ended
+
+	m_FrameWidth = width;
+	m_FrameHeight = height;
+	m_RenderWidth = renderSize(width, renderScale);
+	m_RenderHeight = renderSize(height, renderScale);
+	m_Upscaled = m_RenderWidth != width || m_RenderHeight != height;
+	if (m_Upscaled)
+	{
+		// Sized for the whole frame, so that scale changes don't reallocate it
+		const GlTextureInfo *color = m_Resources.get(m_SceneColor);
+		if (!color || color->Width < width || color->Height < height)
+		{
+			m_Resources.destroy(m_SceneFramebuffer);
+			m_Resources.destroy(m_SceneColor);
+			m_SceneColor = m_Resources.createTexture(GL_SRGB8_ALPHA8, width, height);
+			m_SceneFramebuffer = m_Resources.createFramebuffer(m_SceneColor);
+		}
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_Backbuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_Resources.get(m_SceneFramebuffer)->Name);
+		m_State.enable(GL_SCISSOR_TEST); // Clears only the rendered area
+	}
+	m_State.viewport(0, 0, m_RenderWidth, m_RenderHeight);
+	m_State.scissor(0, 0, m_RenderWidth, m_RenderHeight);
+	GAME_CHECK_GL_ERROR();
+}
+
+void GlRenderer::clear(const float color[4])
+{
+	m_State.disable(GL_FRAMEBUFFER_SRGB); // Clear color is written without sRGB encoding
+	glClearBufferfv(GL_COLOR, 0, color);
+	GAME_CHECK_GL_ERROR();
+}
+
+void GlRenderer::drawMesh(Mesh mesh, const DrawConstants &constants)
+{
+	const GlMesh *glMesh = m_Meshes.get(mesh);
+	if (!glMesh)
+		GAME_THROW(Exception("Invalid mesh"sv, 1));
+
+	// Constants are written through the persistent mapping, and bound at their offset
+	StreamAllocation uniforms = m_Stream.allocateUniforms(sizeof(DrawConstants));
+	memcpy(uniforms.Data, &constants, sizeof(DrawConstants));
+
+	m_State.enable(GL_FRAMEBUFFER_SRGB);
+	m_State.useProgram(m_Resources.get(m_ColProgram)->Name);
+	m_State.bindVertexArray(m_Resources.get(glMesh->Vao)->Name);
+	m_State.bindBufferRange(GL_UNIFORM_BUFFER, DrawConstantsBinding, m_Stream.name(), (GLintptr)uniforms.Offset, sizeof(DrawConstants));
+	glDrawArrays(GL_TRIANGLES, 0, glMesh->VertexCount);
+	GAME_CHECK_GL_ERROR();
+}
+
+void GlRenderer::endFrame()
+{
+	// One check per frame in release builds, before the swap so it can't stall on the present
+	GAME_CHECK_GL_ERROR_SCOPE();
+
+	if (m_Upscaled)
+	{
+		// Bilinear upscale into the frame, copying the sRGB encoded values as they are
+		m_State.disable(GL_SCISSOR_TEST);
+		m_State.disable(GL_FRAMEBUFFER_SRGB);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_Resources.get(m_SceneFramebuffer)->Name);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)m_Backbuffer);
+		glBlitFramebuffer(0, 0, m_RenderWidth, m_RenderHeight, 0, 0, m_FrameWidth, m_FrameHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)m_Backbuffer);
+		m_Upscaled = false;
+	}
+	m_Timer.end();
+
+	// Copy the frame for capture, the copy completes with the fence
+	if (m_CaptureChanged.exchange(false))
+	{
+		std::shared_ptr<FrameEncoder> encoder;
+		{
+			std::unique_lock<std::mutex> lock(m_CaptureMutex);
+			encoder = std::move(m_NextCapture);
+		}
+		m_Readback.setEncoder(std::move(encoder));
+	}
+	if (m_Readback.active())
+	{
+		m_State.disable(GL_FRAMEBUFFER_SRGB); // Read the encoded values as they are
+		m_Readback.read(m_FrameWidth, m_FrameHeight);
+	}
+
+	// Fence the frame, and delete objects released by frames the GPU has finished
+	m_Fence.endFrame();
+	m_Deletions.collect();
+	m_Readback.collect();
+
+	// Keep the CPU from running ahead of the GPU, so input isn't sampled frames before it's shown
+	int maxQueued = m_MaxQueuedFrames;
+	int64_t frame = m_Fence.frame() - 1 - maxQueued;
+	if (maxQueued >= 0 && frame >= 0)
+		m_Fence.wait(frame);
+
+	// Swap
+	m_SwapBuffers();
+	glInterceptEndFrame();
+	glCaptureEndFrame();
+}
+
+} /* namespace game */
+
+/* end of file */
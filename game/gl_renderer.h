@@ -0,0 +1,148 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_RENDERER_H
+#define GAME_GL_RENDERER_H
+
+#include "platform.h"
+#include "renderer.h"
+#include "gl_state_cache.h"
+#include "gl_resources.h"
+#include "gl_deletion_queue.h"
+#include "gl_stream_buffer.h"
+#include "gl_frame_timer.h"
+#include "gl_frame_readback.h"
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#define GAME_GL_MAJOR 4
+#define GAME_GL_MINOR 4
+
+// Each draw takes one uniform offset alignment, up to 256 bytes, so a frame fits 16384 draws
+#define GAME_GL_STREAM_BUFFER_SIZE (4 * 1024 * 1024)
+
+namespace game {
+
+extern bool ArbSpirV;
+extern bool ArbSpirVExt;
+extern bool ExtSwapControlTear; // Some drivers only list the WGL or GLX extension here
+
+// Call once after the context is first made current, detects extensions and enables debug output
+void initGlContext();
+
+class GlRenderer : public Renderer
+{
+public:
+	// The context is owned by the caller, the renderer only makes it current and presents it,
+	// making it current is called on every frame and should return early when it already is
+	GlRenderer(std::function<void()> makeCurrent, std::function<void()> swapBuffers);
+	virtual ~GlRenderer() noexcept;
+
+	[[nodiscard]] virtual std::string_view name() const override { return "gl"sv; }
+
+	virtual void init() override;
+	virtual void release() noexcept override;
+
+	[[nodiscard]] virtual Mesh createMesh(const float *positions, const float *colors, int vertexCount) override;
+	virtual void destroyMesh(Mesh mesh) noexcept override;
+
+	// Below full scale, the scene is rendered into an offscreen target and blitted to the frame
+	virtual void beginFrame(int width, int height, float renderScale) override;
+	virtual void clear(const float color[4]) override;
+	virtual void drawMesh(Mesh mesh, const DrawConstants &constants) override;
+	virtual void endFrame() override;
+
+	[[nodiscard]] virtual GpuFrameTime gpuFrameTime() override { return m_Timer.latest(); }
+
+	// Per-frame vertex and uniform data, valid between init and release,
+	// the constants of each draw are allocated from it
+	inline GlStreamBuffer &streamBuffer() { return m_Stream; }
+
+	// State calls issued and skipped in the last frame
+	inline const GlStateStats &stateStats() const { return m_State.stats(); }
+
+	// Frames the GPU may still be rendering when a frame is swapped, negative for no limit,
+	// zero finishes each frame before its swap, may be changed from any thread
+	inline void setMaxQueuedFrames(int frames) { m_MaxQueuedFrames = frames; }
+	inline int maxQueuedFrames() const { return m_MaxQueuedFrames; }
+
+	// Read every frame back into the encoder from the next frame on, null stops once the frames
+	// in flight are delivered, may be called from any thread
+	void setFrameCapture(std::shared_ptr<FrameEncoder> encoder);
+	inline const GlFrameReadbackStats &frameCaptureStats() const { return m_Readback.stats(); }
+
+private:
+	struct GlMesh
+	{
+		GlBuffer Buffer; // Interleaved vertices
+		GlVertexArray Vao;
+		int VertexCount;
+	};
+
+	std::function<void()> m_MakeCurrent;
+	std::function<void()> m_SwapBuffers;
+
+	GlStateCache m_State;
+	GlFrameFence m_Fence;
+	GlDeletionQueue m_Deletions;
+	GlResources m_Resources;
+	GlStreamBuffer m_Stream;
+	GlFrameTimer m_Timer;
+	GlFrameReadback m_Readback;
+
+	GlProgram m_ColProgram;
+	HandlePool<Mesh, GlMesh> m_Meshes;
+
+	// Scene target at the frame size, rendered into partially below full scale
+	GlTexture m_SceneColor;
+	GlFramebuffer m_SceneFramebuffer;
+	GLint m_Backbuffer = 0; // Framebuffer the context presents, bound when the frame began
+	int m_FrameWidth = 0;
+	int m_FrameHeight = 0;
+	int m_RenderWidth = 0;
+	int m_RenderHeight = 0;
+	bool m_Upscaled = false;
+
+	std::atomic<int> m_MaxQueuedFrames = -1;
+
+	std::mutex m_CaptureMutex;
+	std::shared_ptr<FrameEncoder> m_NextCapture; // Under the mutex
+	std::atomic<bool> m_CaptureChanged = false;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_RENDERER_H */
+
+/* end of file */
@@ -0,0 +1,168 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+GL trace replay.
+Plays a GL command stream, as captured by `game_headless --gl-capture`, on an
+offscreen context as fast as the driver takes it, without game logic or timing.
+The first frame, which creates the objects, is timed on its own. The remaining
+frames are then replayed the given number of times, and their submission time,
+the time until the GPU finished all of them, and the call rate are reported.
+
+Usage: game_gl_replay TRACE [--loops N]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "gl_capture.h"
+#include "egl_context.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+const char *s_Trace = null;
+int s_Loops = 1;
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (arg.substr(0, 2) != "--"sv)
+		{
+			s_Trace = argv[i];
+			continue;
+		}
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--loops"sv)
+			s_Loops = atoi(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (!s_Trace || s_Loops <= 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+// Nearest-rank percentile of sorted samples
+double percentile(const std::vector<double> &sorted, double p)
+{
+	ptrdiff_t rank = (ptrdiff_t)ceil(p * 0.01 * (double)sorted.size());
+	return sorted[std::clamp(rank - 1, (ptrdiff_t)0, (ptrdiff_t)sorted.size() - 1)];
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+
+		EglContext context;
+		GlReplay replay(s_Trace);
+		if (replay.frames() < 2)
+			GAME_THROW(Exception(fmt::format("`{}` needs at least two frames", s_Trace)));
+		context.makeCurrent(replay.width(), replay.height());
+		GLint framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+		replay.setDefaultFramebuffer((GLuint)framebuffer);
+
+		auto setupStart = std::chrono::steady_clock::now();
+		replay.replayFrame();
+		glFinish();
+		auto setupEnd = std::chrono::steady_clock::now();
+		const int64_t setupCalls = replay.calls();
+
+		std::vector<double> frameTimes; // Microseconds of submission
+		frameTimes.reserve((size_t)(replay.frames() - 1) * (size_t)s_Loops);
+		auto start = std::chrono::steady_clock::now();
+		for (int loop = 0; loop < s_Loops; ++loop)
+		{
+			replay.rewind(1);
+			for (;;)
+			{
+				auto frameStart = std::chrono::steady_clock::now();
+				if (!replay.replayFrame())
+					break;
+				auto frameEnd = std::chrono::steady_clock::now();
+				frameTimes.push_back(std::chrono::duration<double, std::micro>(frameEnd - frameStart).count());
+			}
+		}
+		glFinish();
+		auto end = std::chrono::steady_clock::now();
+		const int64_t calls = replay.calls() - setupCalls;
+
+		double total = 0.0;
+		for (double t : frameTimes)
+			total += t;
+		std::sort(frameTimes.begin(), frameTimes.end());
+		double seconds = std::chrono::duration<double>(end - start).count();
+
+		fmt::print("Trace: {}, resolution: {}x{}, frames: {}, loops: {}\n", s_Trace, replay.width(), replay.height(), replay.frames(), s_Loops);
+		fmt::print("Setup: {:.3f} ms, {} calls\n", std::chrono::duration<double, std::milli>(setupEnd - setupStart).count(), setupCalls);
+		fmt::print("Frame submission (us): mean {:.3f}, min {:.3f}, p50 {:.3f}, p90 {:.3f}, p99 {:.3f}, max {:.3f}\n",
+			total / (double)frameTimes.size(), frameTimes.front(),
+			percentile(frameTimes, 50.0), percentile(frameTimes, 90.0), percentile(frameTimes, 99.0),
+			frameTimes.back());
+		fmt::print("Replay: {:.3f} s until finished, {:.1f} frames per second, {:.0f} calls per second, {:.1f} calls per frame\n",
+			seconds, (double)frameTimes.size() / seconds, (double)calls / seconds, (double)calls / (double)frameTimes.size());
+		if (replay.unmappedNames())
+			fmt::print("Names used without being created in the trace: {}\n", replay.unmappedNames());
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
@@ -0,0 +1,217 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_resources.h"
+#include "gl_exception.h"
+
+namespace game {
+
+GlResources::GlResources(GlStateCache &state, GlDeletionQueue &deletions) : m_State(state), m_Deletions(deletions)
+{
+
+}
+
+GlResources::~GlResources() noexcept
+{
+	GAME_DEBUG_ASSERT(m_Programs.empty());
+	GAME_DEBUG_ASSERT(m_Buffers.empty());
+	GAME_DEBUG_ASSERT(m_VertexArrays.empty());
+	GAME_DEBUG_ASSERT(m_Textures.empty());
+	GAME_DEBUG_ASSERT(m_Framebuffers.empty());
+}
+
+[[nodiscard]] GlProgram GlResources::adoptProgram(GLuint program)
+{
+	GAME_DEBUG_ASSERT(program);
+	return m_Programs.create({ program });
+}
+
+[[nodiscard]] GlBuffer GlResources::createBuffer(GLsizeiptr size, const void *data, GLenum usage)
+{
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	GAME_FINALLY([&]() -> void { if (buffer) { m_State.forgetBuffer(buffer); GAME_SAFE_GL_DELETE_ONE(glDeleteBuffers, buffer); } });
+	m_State.bindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, size, data, usage);
+	GAME_CHECK_GL_ERROR();
+	GlBuffer res = m_Buffers.create({ buffer, size });
+	buffer = NULL;
+	return res;
+}
+
+[[nodiscard]] GlVertexArray GlResources::createVertexArray()
+{
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	GAME_FINALLY([&]() -> void { if (vao) { GAME_SAFE_GL_DELETE_ONE(glDeleteVertexArrays, vao); } });
+	GAME_CHECK_GL_ERROR();
+	GlVertexArray res = m_VertexArrays.create({ vao });
+	vao = NULL;
+	return res;
+}
+
+[[nodiscard]] GlVertexArray GlResources::createVertexArray(const VertexLayout &layout, GlBuffer buffer)
+{
+	const GlBufferInfo *bufferInfo = get(buffer);
+	if (!bufferInfo)
+		GAME_THROW(Exception("Invalid vertex buffer"sv, 1));
+	GlVertexArray vao = createVertexArray();
+	GAME_FINALLY([&]() -> void { destroy(vao); });
+	m_State.bindVertexArray(get(vao)->Name);
+	m_State.bindBuffer(GL_ARRAY_BUFFER, bufferInfo->Name);
+	for (int i = 0; i < layout.elementCount(); ++i)
+	{
+		const VertexElement &element = layout.element(i);
+		const void *offset = (const void *)(uintptr_t)element.Offset;
+		const GLsizei stride = (GLsizei)layout.stride();
+		switch (element.Encoding)
+		{
+		case VertexEncoding::Float4:
+			glVertexAttribPointer(element.Location, 4, GL_FLOAT, GL_FALSE, stride, offset);
+			break;
+		case VertexEncoding::Half4:
+			glVertexAttribPointer(element.Location, 4, GL_HALF_FLOAT, GL_FALSE, stride, offset);
+			break;
+		case VertexEncoding::Snorm16x4:
+			glVertexAttribPointer(element.Location, 4, GL_SHORT, GL_TRUE, stride, offset);
+			break;
+		case VertexEncoding::Unorm8x4:
+		case VertexEncoding::Srgb8x4: // Decoded by the shader
+			glVertexAttribPointer(element.Location, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, offset);
+			break;
+		case VertexEncoding::OctSnorm16x2:
+			glVertexAttribPointer(element.Location, 2, GL_SHORT, GL_TRUE, stride, offset);
+			break;
+		}
+		glEnableVertexAttribArray(element.Location);
+	}
+	m_State.bindVertexArray(NULL);
+	GAME_CHECK_GL_ERROR_SCOPE();
+	GlVertexArray res = vao;
+	vao = GlVertexArray();
+	return res;
+}
+
+[[nodiscard]] GlTexture GlResources::createTexture(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	GAME_FINALLY([&]() -> void { if (texture) { GAME_SAFE_GL_DELETE_ONE(glDeleteTextures, texture); } });
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+	glBindTexture(GL_TEXTURE_2D, NULL);
+	GAME_CHECK_GL_ERROR();
+	GlTexture res = m_Textures.create({ texture, internalFormat, width, height });
+	texture = NULL;
+	return res;
+}
+
+[[nodiscard]] GlFramebuffer GlResources::createFramebuffer(GlTexture color)
+{
+	const GlTextureInfo *colorInfo = get(color);
+	if (!colorInfo)
+		GAME_THROW(Exception("Invalid framebuffer color texture"sv, 1));
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	GAME_FINALLY([&]() -> void { if (framebuffer) { GAME_SAFE_GL_DELETE_ONE(glDeleteFramebuffers, framebuffer); } });
+	GLint previous = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorInfo->Name, 0);
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previous);
+	GAME_CHECK_GL_ERROR();
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+		GAME_THROW(Exception("Incomplete framebuffer"sv, 1));
+	GlFramebuffer res = m_Framebuffers.create({ framebuffer, color });
+	framebuffer = NULL;
+	return res;
+}
+
+void GlResources::destroy(GlProgram program) noexcept
+{
+	if (const GlProgramInfo *info = get(program))
+	{
+		m_State.forgetProgram(info->Name);
+		m_Deletions.deleteProgram(info->Name);
+		m_Programs.destroy(program);
+	}
+}
+
+void GlResources::destroy(GlBuffer buffer) noexcept
+{
+	if (const GlBufferInfo *info = get(buffer))
+	{
+		m_State.forgetBuffer(info->Name);
+		m_Deletions.deleteBuffer(info->Name);
+		m_Buffers.destroy(buffer);
+	}
+}
+
+void GlResources::destroy(GlVertexArray vao) noexcept
+{
+	if (const GlVertexArrayInfo *info = get(vao))
+	{
+		m_State.forgetVertexArray(info->Name);
+		m_Deletions.deleteVertexArray(info->Name);
+		m_VertexArrays.destroy(vao);
+	}
+}
+
+void GlResources::destroy(GlTexture texture) noexcept
+{
+	if (const GlTextureInfo *info = get(texture))
+	{
+		m_Deletions.deleteTexture(info->Name);
+		m_Textures.destroy(texture);
+	}
+}
+
+void GlResources::destroy(GlFramebuffer framebuffer) noexcept
+{
+	if (const GlFramebufferInfo *info = get(framebuffer))
+	{
+		m_Deletions.deleteFramebuffer(info->Name);
+		m_Framebuffers.destroy(framebuffer);
+	}
+}
+
+void GlResources::release() noexcept
+{
+	// Framebuffers before the textures attached to them
+	m_Framebuffers.forEach([this](GlFramebuffer framebuffer, GlFramebufferInfo &) -> void { destroy(framebuffer); });
+	m_Textures.forEach([this](GlTexture texture, GlTextureInfo &) -> void { destroy(texture); });
+	m_VertexArrays.forEach([this](GlVertexArray vao, GlVertexArrayInfo &) -> void { destroy(vao); });
+	m_Buffers.forEach([this](GlBuffer buffer, GlBufferInfo &) -> void { destroy(buffer); });
+	m_Programs.forEach([this](GlProgram program, GlProgramInfo &) -> void { destroy(program); });
+}
+
+} /* namespace game */
+
+/* end of file */
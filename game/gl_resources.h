@@ -0,0 +1,144 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+GL objects owned through generational handles.
+Programs, buffers, vertex arrays, textures and framebuffers each live in
+their own pool, with the GL name and the metadata of each object stored
+contiguously. Handles are 32 bits and can be stored in command packets,
+a handle to a deleted object resolves to null instead of a reused name.
+GL names are deleted through the deletion queue, once the GPU is done with them.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_RESOURCES_H
+#define GAME_GL_RESOURCES_H
+
+#include "platform.h"
+#include "handle_pool.h"
+#include "gl_state_cache.h"
+#include "gl_deletion_queue.h"
+#include "vertex_format.h"
+
+namespace game {
+
+typedef Handle<struct GlProgramTag> GlProgram;
+typedef Handle<struct GlBufferTag> GlBuffer;
+typedef Handle<struct GlVertexArrayTag> GlVertexArray;
+typedef Handle<struct GlTextureTag> GlTexture;
+typedef Handle<struct GlFramebufferTag> GlFramebuffer;
+
+struct GlProgramInfo
+{
+	GLuint Name;
+};
+
+struct GlBufferInfo
+{
+	GLuint Name;
+	GLsizeiptr Size;
+};
+
+struct GlVertexArrayInfo
+{
+	GLuint Name;
+};
+
+struct GlTextureInfo
+{
+	GLuint Name;
+	GLenum InternalFormat;
+	GLsizei Width;
+	GLsizei Height;
+};
+
+struct GlFramebufferInfo
+{
+	GLuint Name;
+	GlTexture Color;
+};
+
+class GlResources
+{
+public:
+	// Objects are bound through the state cache, and forgotten by it when deleted
+	GlResources(GlStateCache &state, GlDeletionQueue &deletions);
+	~GlResources() noexcept;
+
+	GlResources(const GlResources &other) = delete;
+	GlResources &operator=(const GlResources &other) = delete;
+
+	// Takes ownership of a linked program once this returns
+	[[nodiscard]] GlProgram adoptProgram(GLuint program);
+
+	// Leaves the buffer bound to the array buffer target
+	[[nodiscard]] GlBuffer createBuffer(GLsizeiptr size, const void *data, GLenum usage);
+	[[nodiscard]] GlVertexArray createVertexArray();
+
+	// Vertex array reading the layout interleaved from the buffer, leaves no vertex array bound
+	[[nodiscard]] GlVertexArray createVertexArray(const VertexLayout &layout, GlBuffer buffer);
+	[[nodiscard]] GlTexture createTexture(GLenum internalFormat, GLsizei width, GLsizei height);
+	[[nodiscard]] GlFramebuffer createFramebuffer(GlTexture color);
+
+	// Stale handles are ignored, the handle is invalid immediately and the name is deleted later
+	void destroy(GlProgram program) noexcept;
+	void destroy(GlBuffer buffer) noexcept;
+	void destroy(GlVertexArray vao) noexcept;
+	void destroy(GlTexture texture) noexcept;
+	void destroy(GlFramebuffer framebuffer) noexcept;
+
+	// Destroy all objects
+	void release() noexcept;
+
+	// Null for stale handles
+	inline const GlProgramInfo *get(GlProgram program) const { return m_Programs.get(program); }
+	inline const GlBufferInfo *get(GlBuffer buffer) const { return m_Buffers.get(buffer); }
+	inline const GlVertexArrayInfo *get(GlVertexArray vao) const { return m_VertexArrays.get(vao); }
+	inline const GlTextureInfo *get(GlTexture texture) const { return m_Textures.get(texture); }
+	inline const GlFramebufferInfo *get(GlFramebuffer framebuffer) const { return m_Framebuffers.get(framebuffer); }
+
+private:
+	GlStateCache &m_State;
+	GlDeletionQueue &m_Deletions;
+
+	HandlePool<GlProgram, GlProgramInfo> m_Programs;
+	HandlePool<GlBuffer, GlBufferInfo> m_Buffers;
+	HandlePool<GlVertexArray, GlVertexArrayInfo> m_VertexArrays;
+	HandlePool<GlTexture, GlTextureInfo> m_Textures;
+	HandlePool<GlFramebuffer, GlFramebufferInfo> m_Framebuffers;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_RESOURCES_H */
+
+/* end of file */
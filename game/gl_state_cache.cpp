@@ -0,0 +1,221 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_state_cache.h"
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr GLuint UnknownName = ~0u;
+constexpr int ElementArrayTarget = 1;
+
+const GLenum s_Caps[] = {
+	GL_FRAMEBUFFER_SRGB,
+	GL_SCISSOR_TEST,
+	GL_DEPTH_TEST,
+	GL_STENCIL_TEST,
+	GL_BLEND,
+	GL_CULL_FACE,
+};
+
+} /* anonymous namespace */
+
+GlStateCache::GlStateCache()
+{
+	invalidate();
+	resetStats();
+}
+
+void GlStateCache::invalidate()
+{
+	m_Program = UnknownName;
+	m_VertexArray = UnknownName;
+	for (GLuint &buffer : m_Buffers)
+		buffer = UnknownName;
+	for (int8_t &cap : m_Caps)
+		cap = -1;
+	m_Viewport = { -1, -1, -1, -1 };
+	m_Scissor = { -1, -1, -1, -1 };
+}
+
+int GlStateCache::bufferTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_ELEMENT_ARRAY_BUFFER: return ElementArrayTarget;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_PIXEL_UNPACK_BUFFER: return 3;
+	}
+	return -1;
+}
+
+int GlStateCache::capIndex(GLenum cap)
+{
+	static_assert(sizeof(s_Caps) / sizeof(s_Caps[0]) == Caps);
+	for (int i = 0; i < Caps; ++i)
+	{
+		if (s_Caps[i] == cap)
+			return i;
+	}
+	return -1;
+}
+
+void GlStateCache::useProgram(GLuint program)
+{
+	if (m_Program == program)
+	{
+		++m_Stats.Skipped;
+		return;
+	}
+	glUseProgram(program);
+	m_Program = program;
+	++m_Stats.Issued;
+}
+
+void GlStateCache::bindVertexArray(GLuint vao)
+{
+	if (m_VertexArray == vao)
+	{
+		++m_Stats.Skipped;
+		return;
+	}
+	glBindVertexArray(vao);
+	m_VertexArray = vao;
+	m_Buffers[ElementArrayTarget] = UnknownName; // Element array binding belongs to the vertex array
+	++m_Stats.Issued;
+}
+
+void GlStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	int i = bufferTarget(target);
+	if (i >= 0 && m_Buffers[i] == buffer)
+	{
+		++m_Stats.Skipped;
+		return;
+	}
+	glBindBuffer(target, buffer);
+	if (i >= 0)
+		m_Buffers[i] = buffer;
+	++m_Stats.Issued;
+}
+
+void GlStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	// Not shadowed, streamed ranges move with every draw
+	glBindBufferRange(target, index, buffer, offset, size);
+	int i = bufferTarget(target);
+	if (i >= 0)
+		m_Buffers[i] = buffer;
+	++m_Stats.Issued;
+}
+
+void GlStateCache::setCap(GLenum cap, bool enabled)
+{
+	int i = capIndex(cap);
+	if (i >= 0 && m_Caps[i] == (int8_t)enabled)
+	{
+		++m_Stats.Skipped;
+		return;
+	}
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	if (i >= 0)
+		m_Caps[i] = (int8_t)enabled;
+	++m_Stats.Issued;
+}
+
+void GlStateCache::enable(GLenum cap)
+{
+	setCap(cap, true);
+}
+
+void GlStateCache::disable(GLenum cap)
+{
+	setCap(cap, false);
+}
+
+void GlStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (m_Viewport.X == x && m_Viewport.Y == y && m_Viewport.Width == width && m_Viewport.Height == height)
+	{
+		++m_Stats.Skipped;
+		return;
+	}
+	glViewport(x, y, width, height);
+	m_Viewport = { x, y, width, height };
+	++m_Stats.Issued;
+}
+
+void GlStateCache::scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (m_Scissor.X == x && m_Scissor.Y == y && m_Scissor.Width == width && m_Scissor.Height == height)
+	{
+		++m_Stats.Skipped;
+		return;
+	}
+	glScissor(x, y, width, height);
+	m_Scissor = { x, y, width, height };
+	++m_Stats.Issued;
+}
+
+void GlStateCache::forgetProgram(GLuint program) noexcept
+{
+	// Stays in use until another program is used, but its name may be reused after that
+	if (program && m_Program == program)
+		m_Program = UnknownName;
+}
+
+void GlStateCache::forgetVertexArray(GLuint vao) noexcept
+{
+	// Deleting resets the binding to zero, but deletion may be deferred
+	if (vao && m_VertexArray == vao)
+	{
+		m_VertexArray = UnknownName;
+		m_Buffers[ElementArrayTarget] = UnknownName;
+	}
+}
+
+void GlStateCache::forgetBuffer(GLuint buffer) noexcept
+{
+	if (!buffer)
+		return;
+	for (GLuint &bound : m_Buffers)
+	{
+		if (bound == buffer)
+			bound = UnknownName;
+	}
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,109 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Shadow of the GL state that the renderer changes per draw.
+Calls that would not change the bound program, vertex array, buffers,
+enables, viewport or scissor are dropped before reaching the driver.
+State starts unknown, so the first call always goes through.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_STATE_CACHE_H
+#define GAME_GL_STATE_CACHE_H
+
+#include "platform.h"
+
+namespace game {
+
+struct GlStateStats
+{
+	int Issued;
+	int Skipped;
+};
+
+class GlStateCache
+{
+public:
+	GlStateCache();
+
+	// Forget all state, call when other code may have changed it
+	void invalidate();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size); // Also binds the target
+	void enable(GLenum cap);
+	void disable(GLenum cap);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	void scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// Call before deleting an object or queueing its deletion, the binding becomes unknown
+	void forgetProgram(GLuint program) noexcept;
+	void forgetVertexArray(GLuint vao) noexcept;
+	void forgetBuffer(GLuint buffer) noexcept;
+
+	// Counters since the last reset, reset at the beginning of each frame
+	inline void resetStats() { m_Stats = { }; }
+	inline const GlStateStats &stats() const { return m_Stats; }
+
+private:
+	static const int BufferTargets = 4; // Array, element array, uniform, pixel unpack
+	static const int Caps = 6;
+
+	struct Rect
+	{
+		GLint X, Y;
+		GLsizei Width, Height;
+	};
+
+	static int bufferTarget(GLenum target);
+	static int capIndex(GLenum cap);
+	void setCap(GLenum cap, bool enabled);
+
+private:
+	GLuint m_Program;
+	GLuint m_VertexArray;
+	GLuint m_Buffers[BufferTargets];
+	int8_t m_Caps[Caps]; // Negative when unknown
+	Rect m_Viewport;
+	Rect m_Scissor;
+
+	GlStateStats m_Stats;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_STATE_CACHE_H */
+
+/* end of file */
@@ -0,0 +1,91 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "gl_stream_buffer.h"
+#include "gl_exception.h"
+
+namespace game {
+
+GlStreamBuffer::GlStreamBuffer(FrameFence &fence, GlStateCache &state, GlDeletionQueue &deletions)
+	: m_State(state), m_Deletions(deletions), m_Ring(fence)
+{
+
+}
+
+GlStreamBuffer::~GlStreamBuffer() noexcept
+{
+	GAME_DEBUG_ASSERT(!m_Buffer);
+}
+
+void GlStreamBuffer::init(size_t capacity)
+{
+	GLint uniformAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	m_UniformAlignment = std::max<size_t>(uniformAlignment, 16);
+	m_Capacity = capacity;
+}
+
+void GlStreamBuffer::create()
+{
+	GAME_DEBUG_ASSERT(m_Capacity);
+
+	// Bound to the copy target only, so it doesn't touch the cached bindings
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	GAME_FINALLY([&]() -> void { if (buffer) { GAME_SAFE_GL_DELETE_ONE(glDeleteBuffers, buffer); } });
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, m_Capacity, null, flags);
+	void *memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_Capacity, flags);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, NULL);
+	GAME_CHECK_GL_ERROR_SCOPE();
+	if (!memory)
+		GAME_THROW(Exception("Failed to map the stream buffer"sv, 1));
+	m_Ring.init((uint8_t *)memory, m_Capacity);
+	m_Buffer = buffer;
+	buffer = NULL;
+}
+
+void GlStreamBuffer::release() noexcept
+{
+	m_Capacity = 0;
+	if (!m_Buffer)
+		return;
+	m_Ring.release();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, NULL);
+	m_State.forgetBuffer(m_Buffer);
+	m_Deletions.deleteBuffer(m_Buffer);
+	m_Buffer = NULL;
+}
+
+} /* namespace game */
+
+/* end of file */
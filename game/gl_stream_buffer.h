@@ -0,0 +1,96 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Persistently mapped GL buffer for streaming per-frame vertex and
+uniform data. The storage is created once with `glBufferStorage` and
+stays mapped coherently, so frames only write through the pointer,
+without `glBufferData` or `glMapBuffer` calls in the frame loop.
+Regions are reused once the GPU has completed the frame that wrote them.
+
+The storage is only created by the first allocation, so a renderer that
+doesn't stream anything doesn't keep a large mapping around, which capture
+tools would otherwise have to watch.
+
+*/
+
+#pragma once
+#ifndef GAME_GL_STREAM_BUFFER_H
+#define GAME_GL_STREAM_BUFFER_H
+
+#include "platform.h"
+#include "stream_ring.h"
+#include "gl_state_cache.h"
+#include "gl_deletion_queue.h"
+
+namespace game {
+
+class GlStreamBuffer
+{
+public:
+	GlStreamBuffer(FrameFence &fence, GlStateCache &state, GlDeletionQueue &deletions);
+	~GlStreamBuffer() noexcept;
+
+	GlStreamBuffer(const GlStreamBuffer &other) = delete;
+	GlStreamBuffer &operator=(const GlStreamBuffer &other) = delete;
+
+	// Set the capacity of the storage, created on first use, call with the context current
+	void init(size_t capacity);
+
+	// Unmap the buffer, and queue its deletion until the GPU is done with the current frame
+	void release() noexcept;
+
+	// Offset of the allocation in the buffer is returned in offset
+	template<typename T>
+	[[nodiscard]] inline T *allocateVertices(size_t count, size_t *offset) { if (!m_Buffer) create(); return m_Ring.allocate<T>(count, offset); }
+	[[nodiscard]] inline StreamAllocation allocateUniforms(size_t size) { if (!m_Buffer) create(); return m_Ring.allocate(size, m_UniformAlignment); }
+
+	// Zero until the first allocation
+	inline GLuint name() const { return m_Buffer; }
+	inline const StreamRing &ring() const { return m_Ring; }
+
+private:
+	void create();
+
+private:
+	GlStateCache &m_State;
+	GlDeletionQueue &m_Deletions;
+	StreamRing m_Ring;
+	GLuint m_Buffer = NULL;
+	size_t m_Capacity = 0;
+	size_t m_UniformAlignment = 256;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_GL_STREAM_BUFFER_H */
+
+/* end of file */
@@ -0,0 +1,177 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Generational handles and the pools behind them.
+A handle is 32 bits, the slot index in the low bits and the generation
+of the slot in the high bits. Destroying an entry bumps the generation
+of its slot, so stale handles fail validation in constant time, without
+following any pointer. Zero is never a valid handle.
+
+Entries are stored in one contiguous array indexed by slot, and freed
+slots are reused before the array grows.
+
+*/
+
+#pragma once
+#ifndef GAME_HANDLE_POOL_H
+#define GAME_HANDLE_POOL_H
+
+#include "platform.h"
+#include "exception.h"
+
+#include <vector>
+#include <type_traits>
+
+namespace game {
+
+constexpr int HandleIndexBits = 20;
+constexpr uint32_t HandleIndexMask = (1u << HandleIndexBits) - 1;
+constexpr uint32_t HandleGenerationMask = (1u << (32 - HandleIndexBits)) - 1;
+
+// Typed by tag, so handles of different pools don't convert into each other
+template<typename TTag>
+class Handle
+{
+public:
+	constexpr Handle() noexcept : m_Value(0) { }
+	constexpr Handle(uint32_t index, uint32_t generation) noexcept
+		: m_Value((generation << HandleIndexBits) | (index & HandleIndexMask)) { }
+
+	static constexpr Handle fromValue(uint32_t value) noexcept { Handle res; res.m_Value = value; return res; }
+	constexpr uint32_t value() const noexcept { return m_Value; }
+
+	constexpr uint32_t index() const noexcept { return m_Value & HandleIndexMask; }
+	constexpr uint32_t generation() const noexcept { return m_Value >> HandleIndexBits; }
+
+	constexpr explicit operator bool() const noexcept { return m_Value != 0; }
+	constexpr bool operator==(Handle other) const noexcept { return m_Value == other.m_Value; }
+	constexpr bool operator!=(Handle other) const noexcept { return m_Value != other.m_Value; }
+
+private:
+	uint32_t m_Value;
+
+};
+
+template<typename THandle, typename T>
+class HandlePool
+{
+public:
+	[[nodiscard]] THandle create(const T &value)
+	{
+		uint32_t index;
+		if (!m_Free.empty())
+		{
+			index = m_Free.back();
+			m_Free.pop_back();
+		}
+		else
+		{
+			if (m_Slots.size() > HandleIndexMask)
+				GAME_THROW(Exception("Handle pool is full"sv, 1));
+			index = (uint32_t)m_Slots.size();
+			m_Slots.push_back({ value, 1, false });
+			m_Free.reserve(m_Slots.size()); // So destroy never allocates
+		}
+		Slot &slot = m_Slots[index];
+		slot.Value = value;
+		slot.Live = true;
+		++m_Size;
+		return THandle(index, slot.Generation);
+	}
+
+	// Invalidates the handle, stale handles are ignored
+	void destroy(THandle handle) noexcept
+	{
+		if (!valid(handle))
+			return;
+		Slot &slot = m_Slots[handle.index()];
+		slot.Value = T();
+		slot.Live = false;
+		// Generation zero is skipped, so no live handle is ever zero
+		slot.Generation = std::max<uint32_t>((slot.Generation + 1) & HandleGenerationMask, 1);
+		m_Free.push_back(handle.index());
+		--m_Size;
+	}
+
+	inline bool valid(THandle handle) const noexcept
+	{
+		uint32_t index = handle.index();
+		return index < m_Slots.size()
+			&& m_Slots[index].Live
+			&& m_Slots[index].Generation == handle.generation();
+	}
+
+	// Null for stale handles
+	inline T *get(THandle handle) noexcept { return valid(handle) ? &m_Slots[handle.index()].Value : null; }
+	inline const T *get(THandle handle) const noexcept { return valid(handle) ? &m_Slots[handle.index()].Value : null; }
+
+	// Call `f(handle, value)` for all live entries
+	template<typename TFunc>
+	void forEach(TFunc &&f)
+	{
+		for (size_t i = 0; i < m_Slots.size(); ++i)
+		{
+			Slot &slot = m_Slots[i];
+			if (slot.Live)
+				f(THandle((uint32_t)i, slot.Generation), slot.Value);
+		}
+	}
+
+	// Destroy all entries, slots keep their generation so old handles stay invalid
+	void clear() noexcept
+	{
+		forEach([this](THandle handle, T &) -> void { destroy(handle); });
+	}
+
+	inline size_t size() const { return m_Size; }
+	inline bool empty() const { return !m_Size; }
+
+private:
+	static_assert(std::is_trivially_copyable_v<THandle>);
+
+	struct Slot
+	{
+		T Value;
+		uint32_t Generation;
+		bool Live;
+	};
+
+	std::vector<Slot> m_Slots;
+	std::vector<uint32_t> m_Free;
+	size_t m_Size = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_HANDLE_POOL_H */
+
+/* end of file */
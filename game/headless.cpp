@@ -0,0 +1,391 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Headless entry point.
+Runs the game loop for a fixed number of frames without a window,
+and reports the frame time distribution on stdout.
+The simulation runs on a manual clock that advances by the frame interval
+each frame, by default one simulation step, so that runs are deterministic.
+With a frame budget, the render scale follows the GPU time, and the
+timings of each measured frame can be written to a trace for
+`game_resolution_replay`.
+The recently profiled scopes can be written to a file after the run, as Chrome
+trace JSON when its name ends with `.json`, or in the binary format otherwise.
+With performance counters, the counted scopes report their cycles, instructions,
+cache and branch misses per frame, over the measured frames.
+With GL interception, the calls into the driver are counted and timed per entry
+point, with redundant state changes and state churn, over the measured frames.
+A GL call budget fails the run when a measured frame makes more calls, for CI.
+The GL calls from renderer creation on can be captured for `game_gl_replay`,
+by default until the last measured frame. Captures take the GLSL shader path,
+so they can be replayed on any GL 4.4 context.
+With frame capture, each measured frame is read back and encoded on the given
+number of threads, to numbered PNG files, a Y4M video, or raw I420 frames,
+following the extension of the file.
+Log records go to stderr, and to a file when given.
+
+Usage: game_headless [--frames N] [--warmup N] [--width W] [--height H] [--renderer null|gl|soft] [--threads N] [--draws N] [--render-thread N] [--jobs N] [--sim-rate N] [--frame-interval US] [--max-queued N] [--frame-budget US] [--timing-trace FILE] [--profile FILE] [--perf-counters N] [--gl-intercept N] [--gl-call-budget N] [--gl-capture FILE] [--gl-capture-frames N] [--frame-capture FILE] [--frame-capture-threads N] [--log FILE]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "game.h"
+#include "null_renderer.h"
+#include "gl_renderer.h"
+#include "soft_renderer.h"
+#include "render_thread.h"
+#include "job_system.h"
+#include "arena.h"
+#include "clock.h"
+#include "resolution_controller.h"
+#include "perf_counters.h"
+#include "gl_intercept.h"
+#include "gl_capture.h"
+#include "frame_encoder.h"
+#include "log.h"
+#ifndef _WIN32
+#include "egl_context.h"
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+int s_Frames = 1000;
+int s_Warmup = 10;
+int s_Threads = 0; // Software renderer workers, zero for one per core
+int s_RenderThread = 0; // Frames in flight on the render thread, zero to render on the main thread
+int s_Jobs = 0; // Job system workers, zero for one per core
+int64_t s_FrameInterval = 0; // Microseconds on the manual clock per frame, zero for one simulation step
+int s_MaxQueued = -1; // Frames the GPU may run behind the swap, negative for no limit
+const char *s_TimingTrace = null;
+const char *s_Profile = null;
+int s_PerfCounters = 0; // Hardware counters on the counted scopes when not zero
+int s_GlIntercept = 0; // Wrap the GL entry points when not zero
+int64_t s_GlCallBudget = 0; // Most GL calls in a measured frame, zero for no limit
+const char *s_GlCapture = null;
+int s_GlCaptureFrames = 0; // Including warmup, zero for all frames
+const char *s_FrameCapture = null;
+int s_FrameCaptureThreads = 2;
+ManualClock s_Clock;
+std::string_view s_RendererName = "null"sv;
+#ifndef _WIN32
+std::unique_ptr<EglContext> s_EglContext;
+#endif
+
+void parseArgs(int argc, char **argv)
+{
+	DisplayWidth = 1280;
+	DisplayHeight = 720;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--frames"sv)
+			s_Frames = atoi(value);
+		else if (arg == "--warmup"sv)
+			s_Warmup = atoi(value);
+		else if (arg == "--width"sv)
+			DisplayWidth = atoi(value);
+		else if (arg == "--height"sv)
+			DisplayHeight = atoi(value);
+		else if (arg == "--renderer"sv)
+			s_RendererName = value;
+		else if (arg == "--threads"sv)
+			s_Threads = atoi(value);
+		else if (arg == "--draws"sv)
+			DrawCount = atoi(value);
+		else if (arg == "--render-thread"sv)
+			s_RenderThread = atoi(value);
+		else if (arg == "--jobs"sv)
+			s_Jobs = atoi(value);
+		else if (arg == "--sim-rate"sv)
+			SimulationRate = atoi(value);
+		else if (arg == "--frame-interval"sv)
+			s_FrameInterval = atoll(value);
+		else if (arg == "--max-queued"sv)
+			s_MaxQueued = atoi(value);
+		else if (arg == "--frame-budget"sv)
+			FrameBudget = atoll(value) * 1000;
+		else if (arg == "--timing-trace"sv)
+			s_TimingTrace = value;
+		else if (arg == "--profile"sv)
+			s_Profile = value;
+		else if (arg == "--perf-counters"sv)
+			s_PerfCounters = atoi(value);
+		else if (arg == "--gl-intercept"sv)
+			s_GlIntercept = atoi(value);
+		else if (arg == "--gl-call-budget"sv)
+			s_GlCallBudget = atoll(value);
+		else if (arg == "--gl-capture"sv)
+			s_GlCapture = value;
+		else if (arg == "--gl-capture-frames"sv)
+			s_GlCaptureFrames = atoi(value);
+		else if (arg == "--frame-capture"sv)
+			s_FrameCapture = value;
+		else if (arg == "--frame-capture-threads"sv)
+			s_FrameCaptureThreads = atoi(value);
+		else if (arg == "--log"sv)
+			setLogFile(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_Frames <= 0 || s_Warmup < 0 || s_Threads < 0 || DrawCount < 0 || s_RenderThread < 0 || s_Jobs < 0 || SimulationRate <= 0 || s_FrameInterval < 0 || FrameBudget < 0 || s_GlCallBudget < 0 || s_GlCaptureFrames < 0 || s_FrameCaptureThreads <= 0 || DisplayWidth <= 0 || DisplayHeight <= 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+std::unique_ptr<Renderer> createRenderer(std::string_view name)
+{
+	if (name == "null"sv)
+		return std::make_unique<NullRenderer>();
+	if (name == "soft"sv)
+		return std::make_unique<SoftRenderer>(s_Threads);
+#ifndef _WIN32
+	if (name == "gl"sv)
+	{
+		s_EglContext = std::make_unique<EglContext>();
+		std::unique_ptr<GlRenderer> renderer = std::make_unique<GlRenderer>(
+			[]() -> void { s_EglContext->makeCurrent(DisplayWidth, DisplayHeight); },
+			[]() -> void { s_EglContext->swapBuffers(); });
+		renderer->setMaxQueuedFrames(s_MaxQueued);
+		if (s_GlIntercept || s_GlCallBudget)
+			installGlIntercept(); // The context is current and gl3w loaded
+		if (s_GlCapture)
+		{
+			// Wraps the interception, before the renderer creates its objects
+			ArbSpirV = false;
+			startGlCapture(s_GlCaptureFrames ? s_GlCaptureFrames : s_Warmup + s_Frames, DisplayWidth, DisplayHeight);
+		}
+		return renderer;
+	}
+#endif
+	GAME_THROW(Exception(fmt::format("Unknown renderer `{}`", name)));
+}
+
+// Nearest-rank percentile of sorted samples
+double percentile(const std::vector<double> &sorted, double p)
+{
+	ptrdiff_t rank = (ptrdiff_t)ceil(p * 0.01 * (double)sorted.size());
+	return sorted[std::clamp(rank - 1, (ptrdiff_t)0, (ptrdiff_t)sorted.size() - 1)];
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		GAME_PROFILE_THREAD("Main");
+		parseArgs(argc, argv);
+
+		std::unique_ptr<Renderer> renderer = createRenderer(s_RendererName);
+		GlRenderer *glRenderer = dynamic_cast<GlRenderer *>(renderer.get());
+		if (s_FrameCapture && !glRenderer)
+			GAME_THROW(Exception("Frame capture needs the gl renderer"sv, 1));
+#ifndef _WIN32
+		GAME_FINALLY([&]() -> void { renderer.reset(); s_EglContext.reset(); stopGlCapture(); removeGlIntercept(); });
+#endif
+		std::unique_ptr<RenderThread> renderThread;
+		if (s_RenderThread)
+		{
+			auto releaseContext = []() -> void {
+#ifndef _WIN32
+				if (s_EglContext)
+					s_EglContext->releaseCurrent();
+#endif
+			};
+			renderThread = std::make_unique<RenderThread>(renderer.get(), releaseContext, s_RenderThread);
+			releaseContext(); // Made current on the render thread
+		}
+
+		JobSystem jobs(s_Jobs);
+
+		std::FILE *trace = null;
+		if (s_TimingTrace)
+		{
+			trace = fopen(s_TimingTrace, "w");
+			if (!trace)
+				GAME_THROW(Exception(fmt::format("Failed to open `{}`", s_TimingTrace)));
+			fmt::print(trace, "cpu_us,gpu_us,gpu_scale\n");
+		}
+		GAME_FINALLY([&]() -> void { if (trace) fclose(trace); });
+
+		auto initStart = std::chrono::steady_clock::now();
+		init(renderThread ? renderThread.get() : renderer.get(), &jobs, &s_Clock);
+		GAME_FINALLY([&]() -> void { release(); });
+		auto initEnd = std::chrono::steady_clock::now();
+
+		const int64_t frameInterval = s_FrameInterval ? s_FrameInterval * 1000 : 1000000000 / SimulationRate;
+		for (int i = 0; i < s_Warmup; ++i)
+		{
+			s_Clock.advance(frameInterval);
+			frame();
+		}
+		if (renderThread && (glInterceptInstalled() || s_FrameCapture))
+			renderThread->flush(); // Statistics are kept, and capture starts, on the thread that renders
+		if (glInterceptInstalled())
+			resetGlIntercept();
+		std::shared_ptr<FrameEncoder> frameCapture;
+		if (s_FrameCapture)
+		{
+			frameCapture = std::make_shared<FrameEncoder>(s_FrameCapture, s_FrameCaptureThreads, (int)((1000000000 + frameInterval / 2) / frameInterval));
+			glRenderer->setFrameCapture(frameCapture);
+		}
+
+		std::vector<double> frameTimes; // Microseconds
+		frameTimes.reserve(s_Frames);
+		std::vector<float> renderScales;
+		renderScales.reserve(s_Frames);
+		if (s_PerfCounters)
+			enablePerfCounters();
+		const ResolutionController &resolution = resolutionController();
+		const int64_t scaleChangesStart = resolution.changes();
+		const int64_t heapStart = heapAllocationCount();
+		const int64_t stepsStart = simulationSteps();
+		for (int i = 0; i < s_Frames; ++i)
+		{
+			renderScales.push_back(resolution.scale());
+			auto frameStart = std::chrono::steady_clock::now();
+			s_Clock.advance(frameInterval);
+			frame();
+			auto frameEnd = std::chrono::steady_clock::now();
+			frameTimes.push_back(std::chrono::duration<double, std::micro>(frameEnd - frameStart).count());
+			const ResolutionSample &sample = resolution.lastSample();
+			if (trace && sample.GpuNs >= 0)
+				fmt::print(trace, "{:.1f},{:.1f},{:.4f}\n", (double)sample.CpuNs * 1e-3, (double)sample.GpuNs * 1e-3, sample.GpuScale);
+		}
+		const int64_t heapAllocations = heapAllocationCount() - heapStart; // On all threads
+		const int64_t steps = simulationSteps() - stepsStart;
+		if (frameCapture)
+		{
+			// One more frame delivers the readbacks still in flight
+			if (renderThread)
+				renderThread->flush();
+			glRenderer->setFrameCapture(null);
+			s_Clock.advance(frameInterval);
+			frame();
+		}
+		if (renderThread)
+			renderThread->flush();
+		if (frameCapture)
+			frameCapture->finish();
+		if (s_Profile)
+			writeProfile(s_Profile, profileCapture());
+		if (s_GlCapture)
+		{
+			stopGlCapture();
+			writeGlCapture(s_GlCapture);
+		}
+
+		double total = 0.0;
+		for (double t : frameTimes)
+			total += t;
+		std::sort(frameTimes.begin(), frameTimes.end());
+
+		fmt::print("Renderer: {}, resolution: {}x{}, draws: {}, frames: {}, warmup: {}, render thread: {}, jobs: {}\n",
+			renderer->name(), DisplayWidth, DisplayHeight, DrawCount, s_Frames, s_Warmup, s_RenderThread, jobs.workerCount());
+		fmt::print("Simulation: {} steps at {} Hz in {} frames\n", steps, SimulationRate, s_Frames);
+		if (FrameBudget)
+		{
+			double scaleTotal = 0.0;
+			for (float scale : renderScales)
+				scaleTotal += scale;
+			fmt::print("Render scale: mean {:.3f}, min {:.3f}, max {:.3f}, changes {}, budget {} us\n",
+				scaleTotal / (double)renderScales.size(), *std::min_element(renderScales.begin(), renderScales.end()),
+				*std::max_element(renderScales.begin(), renderScales.end()), resolution.changes() - scaleChangesStart, FrameBudget / 1000);
+		}
+		fmt::print("Init: {:.3f} ms\n",
+			std::chrono::duration<double, std::milli>(initEnd - initStart).count());
+		fmt::print("Frame time (us): mean {:.3f}, min {:.3f}, p50 {:.3f}, p90 {:.3f}, p99 {:.3f}, max {:.3f}\n",
+			total / (double)frameTimes.size(), frameTimes.front(),
+			percentile(frameTimes, 50.0), percentile(frameTimes, 90.0), percentile(frameTimes, 99.0),
+			frameTimes.back());
+		if (glRenderer)
+		{
+			const GlStateStats &stats = glRenderer->stateStats();
+			fmt::print("GL state calls per frame: issued {}, skipped {}\n", stats.Issued, stats.Skipped);
+		}
+		if (s_GlCapture)
+			fmt::print("GL capture: {} frames written to `{}`\n", glCaptureFrames(), s_GlCapture);
+		if (frameCapture)
+		{
+			const GlFrameReadbackStats &readback = glRenderer->frameCaptureStats();
+			const FrameEncoderStats encoder = frameCapture->stats();
+			const double frames = (double)std::max<int64_t>(readback.Frames, 1);
+			fmt::print("Frame readback: {} frames, latency {:.2f} frames, copy {:.3f} us per frame, stalls {} ({:.3f} ms)\n",
+				readback.Frames, (double)readback.LatencyFrames / frames, (double)readback.CopyNs * 1e-3 / frames,
+				readback.Stalls, (double)readback.StallNs * 1e-6);
+			fmt::print("Frame encoder: {} written to `{}`, {} skipped, {:.1f} MiB, {:.3f} ms per frame on {} threads, stalls {} ({:.3f} ms)\n",
+				encoder.Written, s_FrameCapture, encoder.Skipped, (double)encoder.Bytes / (1024.0 * 1024.0),
+				(double)encoder.EncodeNs * 1e-6 / frames, s_FrameCaptureThreads, encoder.Stalls, (double)encoder.StallNs * 1e-6);
+		}
+		if (heapStart >= 0)
+			fmt::print("Heap allocations: {} in {} frames\n", heapAllocations, s_Frames);
+		if (s_PerfCounters)
+			writePerfReport(stdout, perfReport());
+		if (glInterceptInstalled())
+		{
+			GlInterceptReport report = glInterceptReport();
+			writeGlInterceptReport(stdout, report);
+			if (s_GlCallBudget && report.MaxFrameCalls > s_GlCallBudget)
+				GAME_THROW(Exception(fmt::format("GL call budget exceeded, {} calls in a frame, budget {}", report.MaxFrameCalls, s_GlCallBudget)));
+		}
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
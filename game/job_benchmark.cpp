@@ -0,0 +1,176 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Job system benchmark.
+Measures the scheduling overhead of empty jobs, and the scaling
+of a `parallelFor` workload over an increasing number of workers.
+
+Usage: game_job_benchmark [--threads N] [--jobs N] [--items N] [--repeat N]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "job_system.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+int s_MaxThreads = 0;
+int s_JobCount = 100000;
+int64_t s_ItemCount = 1 << 22;
+int s_Repeat = 5;
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--threads"sv)
+			s_MaxThreads = atoi(value);
+		else if (arg == "--jobs"sv)
+			s_JobCount = atoi(value);
+		else if (arg == "--items"sv)
+			s_ItemCount = atoll(value);
+		else if (arg == "--repeat"sv)
+			s_Repeat = atoi(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_MaxThreads <= 0)
+		s_MaxThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+	if (s_JobCount <= 0 || s_ItemCount <= 0 || s_Repeat <= 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+double elapsedUs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Empty jobs run from worker zero, best of the repeats
+double measureOverhead(JobSystem &jobs)
+{
+	double best = 0.0;
+	for (int r = 0; r < s_Repeat; ++r)
+	{
+		JobCounter counter;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < s_JobCount; ++i)
+			jobs.run([](void *, int64_t, int64_t) -> void { }, null, 0, 0, &counter);
+		jobs.wait(counter);
+		double us = elapsedUs(start);
+		if (!r || us < best)
+			best = us;
+	}
+	return best * 1000.0 / (double)s_JobCount;
+}
+
+// Some arithmetic per item, best of the repeats
+double measureWorkload(JobSystem &jobs, std::vector<float> &data)
+{
+	double best = 0.0;
+	const int64_t grain = std::max<int64_t>(1024, s_ItemCount / ((int64_t)jobs.workerCount() * 16));
+	for (int r = 0; r < s_Repeat; ++r)
+	{
+		auto start = std::chrono::steady_clock::now();
+		jobs.parallelFor(0, s_ItemCount, grain, [&](int64_t begin, int64_t end) -> void {
+			for (int64_t i = begin; i < end; ++i)
+			{
+				float v = data[i];
+				for (int k = 0; k < 16; ++k)
+					v = sqrtf(v * v + 1.0f) * 0.5f;
+				data[i] = v;
+			}
+		});
+		double us = elapsedUs(start);
+		if (!r || us < best)
+			best = us;
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+
+		std::vector<float> data(s_ItemCount);
+		for (int64_t i = 0; i < s_ItemCount; ++i)
+			data[i] = (float)(i & 1023);
+
+		fmt::print("Jobs: {}, items: {}, repeat: {}\n", s_JobCount, s_ItemCount, s_Repeat);
+		fmt::print("threads, overhead (ns/job), workload (ms), speedup, efficiency\n");
+		double single = 0.0;
+		for (int threads = 1; threads <= s_MaxThreads; threads = (threads == s_MaxThreads) ? threads + 1 : std::min(threads * 2, s_MaxThreads))
+		{
+			JobSystem jobs(threads);
+			double overhead = measureOverhead(jobs);
+			double workload = measureWorkload(jobs, data);
+			if (threads == 1)
+				single = workload;
+			double speedup = single / workload;
+			fmt::print("{}, {:.1f}, {:.3f}, {:.2f}, {:.1f}%\n",
+				threads, overhead, workload * 0.001, speedup, speedup * 100.0 / (double)threads);
+		}
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
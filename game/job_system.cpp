@@ -0,0 +1,435 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "job_system.h"
+#include "exception.h"
+#include "profiler.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define GAME_JOB_PAUSE() _mm_pause()
+#else
+#define GAME_JOB_PAUSE() do { } while (false)
+#endif
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr int DequeSize = 4096; // Power of two
+constexpr int RingSize = 4096;
+constexpr int SpinCount = 256; // Attempts to find work before sleeping
+
+thread_local int s_WorkerIndex = -1;
+
+} /* anonymous namespace */
+
+// Chase-Lev deque with a fixed capacity, after Lê et al. 2013
+struct JobSystem::Deque
+{
+	alignas(64) std::atomic<int64_t> Top = 0;
+	alignas(64) std::atomic<int64_t> Bottom = 0;
+	std::atomic<Job *> Items[DequeSize];
+
+	// Owner only, fails when full
+	bool push(Job *job)
+	{
+		int64_t b = Bottom.load(std::memory_order_relaxed);
+		int64_t t = Top.load(std::memory_order_acquire);
+		if (b - t >= DequeSize)
+			return false;
+		Items[b & (DequeSize - 1)].store(job, std::memory_order_relaxed);
+		Bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Owner only
+	Job *pop()
+	{
+		int64_t b = Bottom.load(std::memory_order_relaxed) - 1;
+		Bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = Top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			// Empty
+			Bottom.store(b + 1, std::memory_order_relaxed);
+			return null;
+		}
+		Job *job = Items[b & (DequeSize - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// Last item, race against stealers
+			if (!Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = null;
+			Bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// Any thread
+	Job *steal()
+	{
+		int64_t t = Top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = Bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return null;
+		Job *job = Items[t & (DequeSize - 1)].load(std::memory_order_relaxed);
+		if (!Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return null; // Lost the race
+		return job;
+	}
+
+};
+
+struct JobSystem::Worker
+{
+	Deque Queue;
+	Job Ring[RingSize];
+	uint32_t RingNext = 0;
+	uint32_t Random; // Victim selection
+
+};
+
+JobSystem::JobSystem(int threadCount)
+	: m_WorkerCount(threadCount > 0 ? threadCount : std::max((int)std::thread::hardware_concurrency(), 1))
+{
+	GAME_DEBUG_ASSERT(s_WorkerIndex < 0); // One job system per thread
+	m_Workers.reserve(m_WorkerCount);
+	for (int i = 0; i < m_WorkerCount; ++i)
+	{
+		m_Workers.push_back(std::make_unique<Worker>());
+		m_Workers[i]->Random = 0x9E3779B9u * (uint32_t)(i + 1);
+		for (Job &job : m_Workers[i]->Ring)
+			job.InUse.store(false, std::memory_order_relaxed);
+	}
+	s_WorkerIndex = 0;
+	GAME_FINALLY([&]() -> void {
+		if ((int)m_Threads.size() != m_WorkerCount - 1)
+		{
+			// Failed to start all workers
+			{
+				std::unique_lock<std::mutex> lock(m_SleepMutex);
+				m_Exit = true;
+			}
+			m_SleepCondition.notify_all();
+			for (std::thread &thread : m_Threads)
+				thread.join();
+			s_WorkerIndex = -1;
+		}
+	});
+	m_Threads.reserve(m_WorkerCount - 1);
+	for (int i = 1; i < m_WorkerCount; ++i)
+		m_Threads.emplace_back(&JobSystem::workerMain, this, i);
+}
+
+JobSystem::~JobSystem() noexcept
+{
+	{
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		m_Exit = true;
+	}
+	m_SleepCondition.notify_all();
+	for (std::thread &thread : m_Threads)
+		thread.join();
+	s_WorkerIndex = -1;
+}
+
+int JobSystem::workerIndex()
+{
+	return s_WorkerIndex;
+}
+
+Job *JobSystem::allocateJob()
+{
+	int index = s_WorkerIndex;
+	if (index >= 0)
+	{
+		// Ring slots are free again once their job has run, fall back to the shared pool when all are busy
+		Worker &worker = *m_Workers[index];
+		Job *job = &worker.Ring[worker.RingNext & (RingSize - 1)];
+		if (!job->InUse.load(std::memory_order_acquire))
+		{
+			++worker.RingNext;
+			job->InUse.store(true, std::memory_order_relaxed);
+			job->Shared = false;
+			return job;
+		}
+	}
+	std::unique_lock<std::mutex> lock(m_SharedMutex);
+	if (m_SharedFree.empty())
+	{
+		m_SharedPool.push_back(std::make_unique<Job>());
+		m_SharedFree.push_back(m_SharedPool.back().get());
+	}
+	Job *job = m_SharedFree.back();
+	m_SharedFree.pop_back();
+	job->Shared = true;
+	return job;
+}
+
+void JobSystem::releaseJob(Job *job)
+{
+	if (job->Shared)
+	{
+		std::unique_lock<std::mutex> lock(m_SharedMutex);
+		m_SharedFree.push_back(job);
+	}
+	else
+	{
+		job->InUse.store(false, std::memory_order_release);
+	}
+}
+
+void JobSystem::run(JobFunction function, void *data, int64_t begin, int64_t end, JobCounter *counter, JobCounter *dependency)
+{
+	Job *job = allocateJob();
+	job->Function = function;
+	job->Data = data;
+	job->Begin = begin;
+	job->End = end;
+	job->Counter = counter;
+	if (counter)
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+	if (dependency)
+	{
+		std::unique_lock<std::mutex> lock(dependency->m_Mutex);
+		if (!dependency->done())
+		{
+			dependency->m_Continuations.push_back(job);
+			return;
+		}
+	}
+	push(job);
+}
+
+void JobSystem::push(Job *job)
+{
+	int index = s_WorkerIndex;
+	if (index >= 0)
+	{
+		if (!m_Workers[index]->Queue.push(job))
+		{
+			// Full, run it now
+			execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(m_SharedMutex);
+		m_SharedJobs.push_back(job);
+		m_SharedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Wake a sleeping worker, the fence pairs with the sleeping count increment
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_Sleeping.load(std::memory_order_relaxed))
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			++m_WakeGeneration;
+		}
+		m_SleepCondition.notify_one();
+	}
+}
+
+Job *JobSystem::findJob(int index)
+{
+	if (index >= 0)
+	{
+		if (Job *job = m_Workers[index]->Queue.pop())
+			return job;
+	}
+	if (m_SharedCount.load(std::memory_order_relaxed))
+	{
+		std::unique_lock<std::mutex> lock(m_SharedMutex);
+		if (!m_SharedJobs.empty())
+		{
+			Job *job = m_SharedJobs.front();
+			m_SharedJobs.pop_front();
+			m_SharedCount.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	// Steal, starting from a random victim
+	uint32_t random;
+	if (index >= 0)
+	{
+		uint32_t &state = m_Workers[index]->Random;
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		random = state;
+	}
+	else
+	{
+		random = (uint32_t)(uintptr_t)&random >> 4;
+	}
+	for (int i = 0; i < m_WorkerCount; ++i)
+	{
+		int victim = (int)((random + (uint32_t)i) % (uint32_t)m_WorkerCount);
+		if (victim == index)
+			continue;
+		if (Job *job = m_Workers[victim]->Queue.steal())
+			return job;
+	}
+	return null;
+}
+
+void JobSystem::execute(Job *job)
+{
+	JobFunction function = job->Function;
+	void *data = job->Data;
+	int64_t begin = job->Begin;
+	int64_t end = job->End;
+	JobCounter *counter = job->Counter;
+	releaseJob(job);
+	try
+	{
+		GAME_PROFILE_SCOPE("job");
+		function(data, begin, end);
+	}
+	catch (...)
+	{
+		std::unique_lock<std::mutex> lock(m_ExceptionMutex);
+		if (!m_Exception)
+			m_Exception = std::current_exception();
+	}
+	m_JobCount.fetch_add(1, std::memory_order_relaxed);
+	if (counter)
+		finish(counter);
+}
+
+void JobSystem::finish(JobCounter *counter)
+{
+	int pending = counter->m_Pending.load(std::memory_order_relaxed);
+	while (pending > 1)
+	{
+		if (counter->m_Pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+			return;
+	}
+
+	// Possibly the last job, complete under the lock so that waiters
+	// can't destroy the counter while its continuations are taken
+	std::vector<Job *> continuations;
+	{
+		std::unique_lock<std::mutex> lock(counter->m_Mutex);
+		if (counter->m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			continuations.swap(counter->m_Continuations);
+	}
+	for (Job *job : continuations)
+		push(job);
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+	int index = s_WorkerIndex;
+	int spin = 0;
+	while (!counter.done())
+	{
+		if (Job *job = findJob(index))
+		{
+			execute(job);
+			spin = 0;
+		}
+		else if (++spin < SpinCount)
+		{
+			GAME_JOB_PAUSE();
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// Let the finishing job leave the counter
+	{
+		std::unique_lock<std::mutex> lock(counter.m_Mutex);
+	}
+
+	std::exception_ptr ex;
+	{
+		std::unique_lock<std::mutex> lock(m_ExceptionMutex);
+		ex = m_Exception;
+		m_Exception = null;
+	}
+	if (ex)
+		std::rethrow_exception(ex);
+}
+
+void JobSystem::workerMain(int index)
+{
+	GAME_PROFILE_THREAD("Job");
+	s_WorkerIndex = index;
+	int spin = 0;
+	for (;;)
+	{
+		if (Job *job = findJob(index))
+		{
+			execute(job);
+			spin = 0;
+			continue;
+		}
+		if (++spin < SpinCount)
+		{
+			GAME_JOB_PAUSE();
+			continue;
+		}
+
+		// Sleep until work is pushed, check once more after registering as sleeping
+		int64_t generation;
+		{
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			if (m_Exit)
+				return;
+			generation = m_WakeGeneration;
+		}
+		m_Sleeping.fetch_add(1, std::memory_order_seq_cst);
+		if (Job *job = findJob(index))
+		{
+			m_Sleeping.fetch_sub(1, std::memory_order_relaxed);
+			execute(job);
+			spin = 0;
+			continue;
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			m_SleepCondition.wait(lock, [&]() -> bool { return m_Exit || m_WakeGeneration != generation; });
+		}
+		m_Sleeping.fetch_sub(1, std::memory_order_relaxed);
+		spin = 0;
+	}
+}
+
+} /* namespace game */
+
+/* end of file */
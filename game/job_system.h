@@ -0,0 +1,183 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Job system with fixed worker threads and work-stealing deques.
+Each worker owns a Chase-Lev deque, pushing and popping at the bottom,
+while idle workers steal from the top of the others. Threads that are
+not workers submit through a shared queue, and help out while waiting.
+
+Jobs are counted on a `JobCounter`, which completes when all jobs
+that were run on it have finished. A job may depend on a counter,
+it is only queued once that counter completes.
+
+*/
+
+#pragma once
+#ifndef GAME_JOB_SYSTEM_H
+#define GAME_JOB_SYSTEM_H
+
+#include "platform.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace game {
+
+class JobSystem;
+class JobCounter;
+
+// Runs the range [begin, end), which is empty for plain jobs
+typedef void (*JobFunction)(void *data, int64_t begin, int64_t end);
+
+struct Job
+{
+	JobFunction Function;
+	void *Data;
+	int64_t Begin;
+	int64_t End;
+	JobCounter *Counter;
+	std::atomic<bool> InUse; // Slot of a worker ring
+	bool Shared; // Allocated from the shared pool
+};
+
+class JobCounter
+{
+public:
+	JobCounter() { }
+	~JobCounter() noexcept { GAME_DEBUG_ASSERT(done() && m_Continuations.empty()); }
+	JobCounter(const JobCounter &other) = delete;
+	JobCounter &operator=(const JobCounter &other) = delete;
+
+	// Only destroy the counter after waiting on it, a finishing job may still hold its lock
+	inline bool done() const { return !m_Pending.load(std::memory_order_acquire); }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> m_Pending = 0;
+	std::mutex m_Mutex; // Continuations only
+	std::vector<Job *> m_Continuations;
+
+};
+
+class JobSystem
+{
+public:
+	// The constructing thread is worker zero, zero threads uses one worker per core
+	JobSystem(int threadCount = 0);
+	~JobSystem() noexcept;
+
+	JobSystem(const JobSystem &other) = delete;
+	JobSystem &operator=(const JobSystem &other) = delete;
+
+	// Workers, including the constructing thread
+	inline int workerCount() const { return m_WorkerCount; }
+
+	// Index of the calling worker, or -1 for other threads
+	static int workerIndex();
+
+	// Run a job, optionally after the dependency counter completes
+	void run(JobFunction function, void *data, int64_t begin, int64_t end, JobCounter *counter, JobCounter *dependency = null);
+
+	// Wait for the counter, running jobs meanwhile, rethrows the first exception of any job
+	void wait(JobCounter &counter);
+
+	// Call `f(begin, end)` for consecutive subranges of at most `grain` items,
+	// split at multiples of `grain` from `begin`, and wait for all of them
+	template<typename TFunc>
+	void parallelFor(int64_t begin, int64_t end, int64_t grain, TFunc &&f)
+	{
+		if (begin >= end)
+			return;
+		grain = std::max<int64_t>(grain, 1);
+		if (end - begin <= grain)
+		{
+			f(begin, end);
+			return;
+		}
+		JobCounter counter;
+		auto thunk = [](void *data, int64_t b, int64_t e) -> void { (*(std::remove_reference_t<TFunc> *)data)(b, e); };
+		for (int64_t b = begin; b < end; b += grain)
+			run(thunk, (void *)&f, b, std::min(b + grain, end), &counter);
+		wait(counter);
+	}
+
+	// Jobs executed since construction, for statistics
+	inline int64_t jobCount() const { return m_JobCount.load(std::memory_order_relaxed); }
+
+private:
+	struct Deque;
+	struct Worker;
+
+	void workerMain(int index);
+	Job *allocateJob();
+	void releaseJob(Job *job);
+	void push(Job *job);
+	Job *findJob(int index);
+	void execute(Job *job);
+	void finish(JobCounter *counter);
+
+private:
+	int m_WorkerCount;
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::vector<std::thread> m_Threads;
+
+	// Submissions from threads that are not workers
+	std::mutex m_SharedMutex;
+	std::deque<Job *> m_SharedJobs;
+	std::vector<std::unique_ptr<Job>> m_SharedPool;
+	std::vector<Job *> m_SharedFree;
+	std::atomic<int> m_SharedCount = 0;
+
+	// Sleeping workers
+	std::mutex m_SleepMutex;
+	std::condition_variable m_SleepCondition;
+	std::atomic<int> m_Sleeping = 0;
+	int64_t m_WakeGeneration = 0;
+	bool m_Exit = false;
+
+	std::mutex m_ExceptionMutex;
+	std::exception_ptr m_Exception;
+	std::atomic<int64_t> m_JobCount = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_JOB_SYSTEM_H */
+
+/* end of file */
@@ -0,0 +1,217 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Presentation latency benchmark.
+Runs frames against a simulated display on a manual clock, with a vsync
+grid, a swap chain queue, and a GPU that renders frames one after the
+other, and reports the input-to-photon latency and missed refreshes of:
+- swaps queued up to three deep, frames starting right after the swap,
+- the GPU limited to one frame behind, frames starting right after the swap,
+- each frame finished before its swap, frames starting late for their vsync.
+For the late start, the latency estimated by the scheduler is compared
+against the simulated one.
+
+Usage: game_latency_benchmark [--rate HZ] [--frames N] [--cpu US] [--gpu US]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "latency_scheduler.h"
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+double s_Rate = 60.0;
+int s_Frames = 600;
+int64_t s_Cpu = 3000; // Microseconds per frame, varied by a third, with an occasional spike
+int64_t s_Gpu = 4000;
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--rate"sv)
+			s_Rate = atof(value);
+		else if (arg == "--frames"sv)
+			s_Frames = atoi(value);
+		else if (arg == "--cpu"sv)
+			s_Cpu = atoll(value);
+		else if (arg == "--gpu"sv)
+			s_Gpu = atoll(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_Rate <= 0.0 || s_Frames <= 0 || s_Cpu < 0 || s_Gpu < 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+struct Mode
+{
+	std::string_view Name;
+	int SwapQueue; // Swaps that may be pending before the swap blocks
+	int MaxQueuedFrames; // Frames the GPU may run behind the swap, negative for no limit
+	bool LateStart;
+};
+
+struct Result
+{
+	double LatencyMean; // Microseconds
+	double LatencyMax;
+	int Missed; // Refreshes that repeated the previous frame
+	double EstimateError; // Mean absolute error of the scheduler estimate, late start only
+};
+
+void advanceTo(ManualClock &clock, int64_t time)
+{
+	if (time > clock.now())
+		clock.advance(time - clock.now());
+}
+
+Result run(const Mode &mode)
+{
+	const int64_t interval = (int64_t)(1e9 / s_Rate);
+	ManualClock clock;
+	clock.setSleepOvershoot(100000);
+	LatencyScheduler scheduler(&clock);
+	scheduler.setVsync(0, interval);
+
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int64_t> cpuJitter(-s_Cpu * 333, s_Cpu * 333);
+	std::uniform_int_distribution<int64_t> gpuJitter(-s_Gpu * 333, s_Gpu * 333);
+
+	// First vsync strictly after the time, and when the frame goes on screen
+	auto vsyncAfter = [&](int64_t time) -> int64_t { return (time / interval + 1) * interval; };
+	std::vector<int64_t> gpuDone(s_Frames);
+	std::vector<int64_t> present(s_Frames);
+
+	Result res = { };
+	double estimateError = 0.0;
+	const int warmup = std::min(s_Frames / 10, 60);
+	int measured = 0;
+	for (int i = 0; i < s_Frames; ++i)
+	{
+		if (mode.LateStart)
+		{
+			while (!scheduler.waitForStart())
+			{
+			}
+		}
+		int64_t frame = scheduler.beginFrame();
+		int64_t sample = clock.now();
+
+		// Update and submit, the GPU renders frames in order
+		int64_t cpu = s_Cpu * 1000 + cpuJitter(rng) + (i % 97 == 96 ? s_Cpu * 2000 : 0);
+		clock.advance(cpu);
+		gpuDone[i] = std::max(clock.now(), i ? gpuDone[i - 1] : 0) + s_Gpu * 1000 + gpuJitter(rng);
+
+		// Fence wait before the swap
+		if (mode.MaxQueuedFrames >= 0 && i - mode.MaxQueuedFrames >= 0)
+			advanceTo(clock, gpuDone[i - mode.MaxQueuedFrames]);
+
+		// Shown at the first vsync after it's rendered and swapped, after the previous frame,
+		// and the swap blocks until a buffer frees up, which is when an earlier frame is shown
+		present[i] = vsyncAfter(std::max(gpuDone[i], clock.now()));
+		if (i)
+			present[i] = std::max(present[i], present[i - 1] + interval);
+		if (i - mode.SwapQueue >= 0)
+			advanceTo(clock, present[i - mode.SwapQueue]);
+		int64_t swapTime = clock.now();
+		scheduler.presented(frame, swapTime);
+
+		if (i < warmup)
+			continue;
+		double latency = (double)(present[i] - sample) * 1e-3;
+		res.LatencyMean += latency;
+		res.LatencyMax = std::max(res.LatencyMax, latency);
+		res.Missed += (int)((present[i] - present[i - 1]) / interval) - 1;
+		estimateError += std::abs(scheduler.stats().LatencyLast - latency);
+		++measured;
+	}
+	if (measured)
+	{
+		res.LatencyMean /= (double)measured;
+		res.EstimateError = mode.LateStart ? estimateError / (double)measured : 0.0;
+	}
+	return res;
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+
+		fmt::print("Rate: {} Hz, frames: {}, cpu: {} us, gpu: {} us\n", s_Rate, s_Frames, s_Cpu, s_Gpu);
+		fmt::print("mode, latency mean (ms), latency max (ms), missed refreshes, estimate error (ms)\n");
+		const Mode modes[] = {
+			{ "queued 3, immediate start"sv, 3, -1, false },
+			{ "queued 1, gpu 1 behind, immediate start"sv, 1, 1, false },
+			{ "queued 1, gpu finished, late start"sv, 1, 0, true },
+		};
+		for (const Mode &mode : modes)
+		{
+			Result res = run(mode);
+			fmt::print("{}, {:.2f}, {:.2f}, {}, {:.3f}\n",
+				mode.Name, res.LatencyMean * 1e-3, res.LatencyMax * 1e-3, res.Missed, res.EstimateError * 1e-3);
+		}
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
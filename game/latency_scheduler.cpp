@@ -0,0 +1,161 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "latency_scheduler.h"
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr int64_t InitialMargin = 1000000;
+constexpr int64_t MinMargin = 250000;
+constexpr int64_t MaxMargin = 4000000;
+
+} /* anonymous namespace */
+
+LatencyScheduler::LatencyScheduler(Clock *clock)
+	: m_Clock(clock), m_Margin(InitialMargin)
+{
+
+}
+
+void LatencyScheduler::setVsync(int64_t vsync, int64_t interval)
+{
+	interval = std::max<int64_t>(interval, 0);
+	if (interval != m_Interval)
+	{
+		// Different display mode, the previous targets no longer apply
+		m_Start = -1;
+		m_LastTarget = -1;
+		m_LastPresent = -1;
+	}
+	m_Vsync = vsync;
+	m_Interval = interval;
+}
+
+int64_t LatencyScheduler::vsyncAfter(int64_t time) const
+{
+	if (!m_Interval)
+		return time;
+	int64_t offset = time - m_Vsync;
+	int64_t n = offset >= 0 ? offset / m_Interval + 1 : -((-offset - 1) / m_Interval);
+	return m_Vsync + n * m_Interval;
+}
+
+[[nodiscard]] bool LatencyScheduler::waitForStart(int64_t maxWait)
+{
+	if (!m_Interval)
+		return true;
+	int64_t now = m_Clock->now();
+	if (m_Start < 0)
+	{
+		// Earliest vsync the frame can still make, but never one that an earlier frame already has
+		int64_t lead = m_Cost + m_Margin;
+		int64_t target = vsyncAfter(now + lead - 1);
+		int64_t last = std::max(m_LastTarget, m_LastPresent);
+		if (last >= 0)
+			target = std::max(target, vsyncAfter(last));
+		m_Target = target;
+		m_Start = target - lead;
+	}
+	int64_t wait = m_Start - now;
+	if (wait <= 0)
+		return true;
+	m_Clock->sleep(std::min(wait, std::max<int64_t>(maxWait, 0)));
+	return m_Clock->now() >= m_Start;
+}
+
+int64_t LatencyScheduler::beginFrame()
+{
+	int64_t frame = m_FrameCount++;
+	m_Frames[frame % HistorySize] = { m_Clock->now(), m_Interval ? m_Target : -1 };
+	if (m_Interval && m_Target >= 0)
+		m_LastTarget = m_Target;
+	m_Start = -1;
+	m_Target = -1;
+	return frame;
+}
+
+void LatencyScheduler::presented(int64_t frame, int64_t swapTime)
+{
+	if (frame < 0 || frame >= m_FrameCount || m_FrameCount - frame > HistorySize)
+		return;
+	const Frame &f = m_Frames[frame % HistorySize];
+	if (swapTime < f.Sample)
+		return; // Not the swap of this frame
+
+	// Decaying peak, so one slow frame keeps the start early for a while
+	m_Cost = std::max(swapTime - f.Sample, m_Cost - m_Cost / 32);
+
+	int64_t present = swapTime;
+	bool missed = false;
+	if (m_Interval)
+	{
+		// Shown at the next vsync, unless the previous frame still holds it
+		present = vsyncAfter(swapTime);
+		if (m_LastPresent >= 0)
+			present = std::max(present, m_LastPresent + m_Interval);
+		m_LastPresent = present;
+		missed = f.Target >= 0 && present > f.Target + m_Interval / 2; // Tolerates a drifting vsync grid
+		if (missed)
+			m_Margin = std::min(m_Margin * 2, MaxMargin);
+		else
+			m_Margin = std::max(m_Margin - m_Margin / 256, MinMargin);
+	}
+
+	int i = (int)(m_PresentCount % HistorySize);
+	m_Latencies[i] = present - f.Sample;
+	m_Misses[i] = missed;
+	++m_PresentCount;
+}
+
+LatencyStats LatencyScheduler::stats() const
+{
+	LatencyStats res = { };
+	res.Cost = (double)m_Cost * 1e-3;
+	res.Margin = (double)m_Margin * 1e-3;
+	res.Frames = (int)std::min<int64_t>(m_PresentCount, HistorySize);
+	if (!res.Frames)
+		return res;
+	double sum = 0.0;
+	for (int i = 0; i < res.Frames; ++i)
+	{
+		double latency = (double)m_Latencies[i] * 1e-3;
+		sum += latency;
+		res.LatencyMax = std::max(res.LatencyMax, latency);
+		res.Missed += m_Misses[i] ? 1 : 0;
+	}
+	res.LatencyMean = sum / (double)res.Frames;
+	res.LatencyLast = (double)m_Latencies[(m_PresentCount - 1) % HistorySize] * 1e-3;
+	return res;
+}
+
+} /* namespace game */
+
+/* end of file */
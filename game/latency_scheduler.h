@@ -0,0 +1,135 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Frame scheduling for low latency presentation with vsync.
+Rather than sampling input right after the previous swap, and then
+blocking on the next swap for most of a refresh, each frame starts as
+late as it can while still making its vsync. The start is the target
+vsync minus the frame cost, which is a decaying peak of the time from
+the input sample to the swap returning, and minus a safety margin that
+grows whenever a frame misses its vsync and shrinks slowly otherwise.
+
+Input-to-photon latency is estimated per frame, as the time from the
+input sample to the first vsync after the swap returned. Scanout and
+the latency of the display itself are not included.
+
+All timing goes through a `Clock`, so that the scheduling runs against
+a simulated display on a `ManualClock`.
+
+*/
+
+#pragma once
+#ifndef GAME_LATENCY_SCHEDULER_H
+#define GAME_LATENCY_SCHEDULER_H
+
+#include "platform.h"
+#include "clock.h"
+
+namespace game {
+
+// Over the recent frames, in microseconds
+struct LatencyStats
+{
+	int Frames;
+	double LatencyLast; // Input sample to estimated present
+	double LatencyMean;
+	double LatencyMax;
+	int Missed; // Presented after the targeted vsync
+	double Cost; // Current estimates
+	double Margin;
+};
+
+class LatencyScheduler
+{
+public:
+	LatencyScheduler(Clock *clock);
+
+	// Time of any past or future vsync, and the refresh interval,
+	// zero interval to start frames right away
+	void setVsync(int64_t vsync, int64_t interval);
+	inline int64_t interval() const { return m_Interval; }
+
+	// Sleeps for at most `maxWait`, so the caller can keep handling messages,
+	// returns true once the next frame should start
+	[[nodiscard]] bool waitForStart(int64_t maxWait = 2000000);
+
+	// Call right before sampling input, returns the frame number to report the swap with
+	int64_t beginFrame();
+
+	// The swap of the frame returned at `swapTime`, frames must be reported in order,
+	// frames that are not reported are left out of the statistics
+	void presented(int64_t frame, int64_t swapTime);
+
+	LatencyStats stats() const;
+
+	inline int64_t costNs() const { return m_Cost; }
+	inline int64_t marginNs() const { return m_Margin; }
+
+private:
+	static const int HistorySize = 64;
+
+	struct Frame
+	{
+		int64_t Sample;
+		int64_t Target; // Vsync the frame was started for, or -1
+	};
+
+	// First vsync strictly after the time
+	int64_t vsyncAfter(int64_t time) const;
+
+	Clock *m_Clock;
+	int64_t m_Vsync = 0;
+	int64_t m_Interval = 0;
+
+	int64_t m_Start = -1; // Start of the next frame, or -1 when not yet scheduled
+	int64_t m_Target = -1;
+	int64_t m_LastTarget = -1;
+	int64_t m_LastPresent = -1;
+
+	int64_t m_Cost = 0;
+	int64_t m_Margin;
+
+	// In flight, by frame number
+	Frame m_Frames[HistorySize];
+	int64_t m_FrameCount = 0;
+
+	// Recent presented frames
+	int64_t m_Latencies[HistorySize];
+	bool m_Misses[HistorySize];
+	int64_t m_PresentCount = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_LATENCY_SCHEDULER_H */
+
+/* end of file */
@@ -0,0 +1,378 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "log.h"
+#include "exception.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr std::chrono::milliseconds PollInterval(10);
+constexpr size_t BatchSize = 1 << 16; // Formatted bytes written to the sinks at once
+
+const std::string_view s_LevelNames[] = { "trace"sv, "debug"sv, "info"sv, "warning"sv, "error"sv };
+
+std::mutex s_Mutex;
+std::vector<std::unique_ptr<LogQueue>> s_Queues; // Kept after their thread exits, until the log thread read them
+std::vector<std::unique_ptr<LogQueue>> s_FreeQueues; // Read after their thread exited, for the next thread
+uint32_t s_NextThreadId = 0;
+std::condition_variable s_Condition;
+std::condition_variable s_FlushedCondition;
+int64_t s_FlushRequested = 0;
+int64_t s_Flushed = 0;
+bool s_Wake = false;
+bool s_Exit = false;
+int64_t s_StartNs;
+
+int64_t steadyNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef _WIN32
+std::atomic<uint32_t> s_Sinks = LogDebugger | LogFile;
+std::vector<wchar_t> s_Wide; // Log thread only
+#else
+std::atomic<uint32_t> s_Sinks = LogStderr | LogFile;
+#endif
+std::mutex s_FileMutex;
+std::FILE *s_File = null;
+
+void writeSinks(fmt::memory_buffer &out)
+{
+	if (!out.size())
+		return;
+	const uint32_t sinks = s_Sinks.load(std::memory_order_relaxed);
+	if (sinks & LogStderr)
+		fwrite(out.data(), 1, out.size(), stderr);
+	if (sinks & LogFile)
+	{
+		std::unique_lock<std::mutex> lock(s_FileMutex);
+		if (s_File)
+		{
+			fwrite(out.data(), 1, out.size(), s_File);
+			fflush(s_File);
+		}
+	}
+#ifdef _WIN32
+	if (sinks & LogDebugger)
+	{
+		// One call per batch, the conversion buffer is kept
+		s_Wide.resize(out.size() + 1);
+		int length = MultiByteToWideChar(CP_UTF8, 0, out.data(), (int)out.size(), s_Wide.data(), (int)out.size());
+		if (length)
+		{
+			s_Wide[length] = 0;
+			OutputDebugStringW(s_Wide.data());
+		}
+	}
+#endif
+	out.clear();
+}
+
+struct Cursor
+{
+	LogQueue *Queue;
+	uint64_t Tail;
+	uint64_t Head; // As of the start of the batch
+	LogRecord Record; // Next, when `Tail` is below `Head`
+};
+
+// Skips the padding at the end of the queue, false when no record is left
+bool peek(Cursor &cursor)
+{
+	while (cursor.Tail < cursor.Head)
+	{
+		const size_t offset = (size_t)(cursor.Tail & (LogQueueSize - 1));
+		if (LogQueueSize - offset < sizeof(LogRecord))
+		{
+			cursor.Tail += LogQueueSize - offset;
+			continue;
+		}
+		memcpy(&cursor.Record, &cursor.Queue->Data[offset], sizeof(LogRecord));
+		if (cursor.Record.Format)
+			return true;
+		cursor.Tail += cursor.Record.Size;
+	}
+	cursor.Queue->Tail.store(cursor.Tail, std::memory_order_release);
+	return false;
+}
+
+void format(fmt::memory_buffer &out, const Cursor &cursor)
+{
+	const LogRecord &record = cursor.Record;
+	fmt::format_to(std::back_inserter(out), "[{:.6f}] {:<7} #{} ",
+		(double)(record.Time - s_StartNs) * 1e-9, s_LevelNames[(uint32_t)record.Level], cursor.Queue->ThreadId);
+	const uint8_t *args = &cursor.Queue->Data[(size_t)(cursor.Tail & (LogQueueSize - 1)) + sizeof(LogRecord)];
+	try
+	{
+		record.Format(args, std::string_view(record.Text, record.TextLength), out);
+	}
+	catch (const std::exception &ex)
+	{
+		fmt::format_to(std::back_inserter(out), "<{}: `{}`>", ex.what(), std::string_view(record.Text, record.TextLength));
+	}
+	if (out.size() && out.data()[out.size() - 1] == '\n')
+		out.resize(out.size() - 1); // Records are lines
+	out.push_back('\n');
+}
+
+// Formats the records of all queues so far in time order
+void drain(std::vector<Cursor> &cursors, fmt::memory_buffer &out)
+{
+	for (size_t i = cursors.size(); i--;)
+	{
+		Cursor &cursor = cursors[i];
+		cursor.Tail = cursor.Queue->Tail.load(std::memory_order_relaxed);
+		cursor.Head = cursor.Queue->Head.load(std::memory_order_acquire);
+		if (!peek(cursor))
+			cursors.erase(cursors.begin() + (ptrdiff_t)i);
+	}
+	while (!cursors.empty())
+	{
+		size_t next = 0;
+		for (size_t i = 1; i < cursors.size(); ++i)
+		{
+			if (cursors[i].Record.Time < cursors[next].Record.Time)
+				next = i;
+		}
+		Cursor &cursor = cursors[next];
+		format(out, cursor);
+		cursor.Tail += cursor.Record.Size;
+		cursor.Queue->Tail.store(cursor.Tail, std::memory_order_release);
+		if (out.size() >= BatchSize)
+			writeSinks(out);
+		if (!peek(cursor))
+			cursors.erase(cursors.begin() + (ptrdiff_t)next);
+	}
+}
+
+thread_local bool s_ThreadExited = false; // Trivially destructible, valid until the thread ends
+
+// Retires the queue of the thread when it exits
+struct LogThreadExit
+{
+	~LogThreadExit() noexcept
+	{
+		s_ThreadExited = true;
+		LogThreadQueue = null;
+		if (Queue)
+		{
+			// Recycled sooner than the next poll, threads that exit may be replaced right away
+			Queue->Retired.store(true, std::memory_order_release);
+			logWake();
+		}
+	}
+
+	LogQueue *Queue = null;
+};
+
+thread_local LogThreadExit s_ThreadExit;
+
+void threadMain()
+{
+	GAME_PROFILE_THREAD("Log");
+	fmt::memory_buffer out;
+	std::vector<LogQueue *> queues;
+	std::vector<LogQueue *> retired;
+	std::vector<Cursor> cursors;
+	for (;;)
+	{
+		int64_t flush;
+		bool exit;
+		{
+			std::unique_lock<std::mutex> lock(s_Mutex);
+			s_Condition.wait_for(lock, PollInterval, [&]() -> bool { return s_Wake || s_Exit || s_FlushRequested != s_Flushed; });
+			s_Wake = false;
+			flush = s_FlushRequested;
+			exit = s_Exit;
+			queues.clear();
+			for (const std::unique_ptr<LogQueue> &queue : s_Queues)
+				queues.push_back(queue.get());
+		}
+
+		// Retired before the heads are read, so their last records are drained below
+		retired.clear();
+		for (LogQueue *queue : queues)
+		{
+			if (queue->Retired.load(std::memory_order_acquire))
+				retired.push_back(queue);
+		}
+
+		cursors.clear();
+		for (LogQueue *queue : queues)
+			cursors.push_back({ queue });
+		drain(cursors, out);
+		for (LogQueue *queue : queues)
+		{
+			uint64_t dropped = queue->Dropped.load(std::memory_order_relaxed);
+			if (dropped != queue->Reported)
+			{
+				fmt::format_to(std::back_inserter(out), "[{:.6f}] {:<7} #{} {} records dropped, the queue was full\n",
+					(double)(steadyNs() - s_StartNs) * 1e-9, s_LevelNames[(uint32_t)LogLevel::Warning], queue->ThreadId, dropped - queue->Reported);
+				queue->Reported = dropped;
+			}
+		}
+		writeSinks(out);
+
+		if (!retired.empty())
+		{
+			std::unique_lock<std::mutex> lock(s_Mutex);
+			for (LogQueue *queue : retired)
+			{
+				GAME_DEBUG_ASSERT(queue->Tail.load(std::memory_order_relaxed) == queue->Head.load(std::memory_order_relaxed));
+				auto it = std::find_if(s_Queues.begin(), s_Queues.end(),
+					[&](const std::unique_ptr<LogQueue> &q) -> bool { return q.get() == queue; });
+				s_FreeQueues.push_back(std::move(*it));
+				s_Queues.erase(it);
+			}
+		}
+		{
+			std::unique_lock<std::mutex> lock(s_Mutex);
+			s_Flushed = flush;
+		}
+		s_FlushedCondition.notify_all();
+		if (exit)
+			return;
+	}
+}
+
+// Started with the first record, writes the remaining records when the program exits
+class LogThread
+{
+public:
+	~LogThread() noexcept
+	{
+		{
+			std::unique_lock<std::mutex> lock(s_Mutex);
+			s_Exit = true;
+		}
+		s_Condition.notify_one();
+		if (Thread.joinable())
+			Thread.join();
+		std::unique_lock<std::mutex> lock(s_FileMutex);
+		if (s_File)
+			fclose(s_File);
+		s_File = null;
+	}
+
+	std::thread Thread;
+
+};
+
+LogThread s_Thread; // After the queues, so it stops before they are destroyed
+
+} /* anonymous namespace */
+
+LogQueue *logRegisterThread()
+{
+	if (s_ThreadExited)
+		return null; // Its queue may already be recycled
+
+	std::unique_ptr<LogQueue> queue;
+	{
+		std::unique_lock<std::mutex> lock(s_Mutex);
+		if (!s_FreeQueues.empty())
+		{
+			queue = std::move(s_FreeQueues.back());
+			s_FreeQueues.pop_back();
+		}
+	}
+	if (!queue)
+		queue = std::make_unique<LogQueue>();
+	queue->Head.store(0, std::memory_order_relaxed);
+	queue->Tail.store(0, std::memory_order_relaxed);
+	queue->Dropped.store(0, std::memory_order_relaxed);
+	queue->Retired.store(false, std::memory_order_relaxed);
+	queue->Reported = 0;
+	s_ThreadExit.Queue = queue.get();
+
+	std::unique_lock<std::mutex> lock(s_Mutex);
+	if (!s_NextThreadId)
+		s_StartNs = steadyNs();
+	queue->ThreadId = s_NextThreadId++;
+	s_Queues.push_back(std::move(queue));
+	if (!s_Thread.Thread.joinable() && !s_Exit)
+		s_Thread.Thread = std::thread(threadMain);
+	LogThreadQueue = s_Queues.back().get();
+	return LogThreadQueue;
+}
+
+void logWake()
+{
+	{
+		std::unique_lock<std::mutex> lock(s_Mutex);
+		s_Wake = true;
+	}
+	s_Condition.notify_one();
+}
+
+void setLogSinks(uint32_t sinks)
+{
+	s_Sinks = sinks;
+}
+
+void setLogFile(const char *path)
+{
+	std::FILE *f = null;
+	if (path)
+	{
+		f = fopen(path, "w");
+		if (!f)
+			GAME_THROW(Exception(fmt::format("Failed to open `{}`", path)));
+	}
+	flushLog(); // Records before the call don't go to the new file
+	std::unique_lock<std::mutex> lock(s_FileMutex);
+	if (s_File)
+		fclose(s_File);
+	s_File = f;
+}
+
+void flushLog()
+{
+	std::unique_lock<std::mutex> lock(s_Mutex);
+	if (!s_Thread.Thread.joinable() || s_Exit)
+		return;
+	int64_t request = ++s_FlushRequested;
+	s_Condition.notify_one();
+	s_FlushedCondition.wait(lock, [&]() -> bool { return s_Flushed >= request; });
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,299 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Asynchronous logger.
+`GAME_LOG_INFO("format {}", args...)` copies the arguments into a byte queue
+owned by the calling thread, without a lock and without formatting them. A
+background thread formats the records of all threads in time order, and writes
+them to the sinks, the debugger, stderr, and a file, a batch at a time.
+
+Numbers, enums, pointers and strings are copied as they are, strings by value,
+so they may be temporaries. Other types are formatted on the calling thread.
+Format strings are not copied, and must be literals. When the queue of a thread
+is full, its records are dropped and counted, so logging never waits. When a
+thread exits, its queue is recycled for the next thread once its records are
+written, so memory is bounded by the threads logging at about the same time.
+
+Levels below `GAME_LOG_LEVEL` compile out entirely, including their arguments.
+By default that keeps debug records in debug builds, and info and above in
+release builds.
+
+*/
+
+#pragma once
+#ifndef GAME_LOG_H
+#define GAME_LOG_H
+
+#include "platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <tuple>
+#include <type_traits>
+
+#define GAME_LOG_LEVEL_TRACE 0
+#define GAME_LOG_LEVEL_DEBUG 1
+#define GAME_LOG_LEVEL_INFO 2
+#define GAME_LOG_LEVEL_WARNING 3
+#define GAME_LOG_LEVEL_ERROR 4
+#define GAME_LOG_LEVEL_NONE 5
+
+#ifndef GAME_LOG_LEVEL
+#ifdef GAME_DEBUG
+#define GAME_LOG_LEVEL GAME_LOG_LEVEL_DEBUG
+#else
+#define GAME_LOG_LEVEL GAME_LOG_LEVEL_INFO
+#endif
+#endif
+
+namespace game {
+
+enum class LogLevel : uint32_t
+{
+	Trace = GAME_LOG_LEVEL_TRACE,
+	Debug = GAME_LOG_LEVEL_DEBUG,
+	Info = GAME_LOG_LEVEL_INFO,
+	Warning = GAME_LOG_LEVEL_WARNING,
+	Error = GAME_LOG_LEVEL_ERROR,
+};
+
+// Whether records of the level are compiled in, to skip building their arguments
+constexpr bool logEnabled(LogLevel level)
+{
+	return (uint32_t)level >= GAME_LOG_LEVEL;
+}
+
+// Sink flags
+constexpr uint32_t LogDebugger = 0x1; // Only on Windows
+constexpr uint32_t LogStderr = 0x2;
+constexpr uint32_t LogFile = 0x4; // When a file is open
+
+// Bytes per thread, a power of two, records up to half of it fit
+constexpr size_t LogQueueSize = 1 << 17;
+
+typedef void (*LogFormatFunction)(const uint8_t *args, std::string_view format, fmt::memory_buffer &out);
+
+struct LogRecord
+{
+	uint32_t Size; // Including the arguments, a multiple of 8
+	LogLevel Level;
+	LogFormatFunction Format; // Null for the padding up to the end of the queue
+	const char *Text; // Format string
+	size_t TextLength;
+	int64_t Time; // Steady clock nanoseconds
+};
+
+static_assert(sizeof(LogRecord) % 8 == 0);
+
+struct LogQueue
+{
+	uint8_t Data[LogQueueSize];
+	std::atomic<uint64_t> Head; // Bytes written by the owning thread
+	std::atomic<uint64_t> Tail; // Bytes read by the log thread
+	std::atomic<uint64_t> Dropped; // Records that didn't fit
+	std::atomic<bool> Retired; // The owning thread exited, recycled once read
+	uint64_t Reported; // Dropped records reported, log thread only
+	uint32_t ThreadId;
+};
+
+// Queue of the calling thread, null until its first record, and once it exits
+inline thread_local LogQueue *LogThreadQueue = null;
+
+// Null when the thread is exiting, its records are dropped
+LogQueue *logRegisterThread();
+
+// Wakes the log thread before its next poll
+void logWake();
+
+// Where records are written, by default the debugger on Windows and stderr elsewhere
+void setLogSinks(uint32_t sinks);
+
+// Open a file to write the records to from now on, null closes it
+void setLogFile(const char *path);
+
+// Block until the records logged so far on any thread are written
+void flushLog();
+
+// Argument storage, strings are copied with their length and read back as views
+struct LogStringArg
+{
+	typedef std::string_view Decoded;
+	static size_t size(std::string_view value) { return sizeof(uint32_t) + value.size(); }
+	static void write(uint8_t *&p, std::string_view value)
+	{
+		uint32_t length = (uint32_t)value.size();
+		memcpy(p, &length, sizeof(length));
+		memcpy(p + sizeof(length), value.data(), length);
+		p += sizeof(length) + length;
+	}
+	static Decoded read(const uint8_t *&p)
+	{
+		uint32_t length;
+		memcpy(&length, p, sizeof(length));
+		std::string_view res((const char *)p + sizeof(length), length);
+		p += sizeof(length) + length;
+		return res;
+	}
+};
+
+template <typename T, typename = void>
+struct LogArg
+{
+	// Formatted on the calling thread
+	typedef std::string_view Decoded;
+	static size_t size(const T &value) { return sizeof(uint32_t) + fmt::formatted_size("{}", value); }
+	static void write(uint8_t *&p, const T &value)
+	{
+		uint32_t length = (uint32_t)(size(value) - sizeof(uint32_t));
+		memcpy(p, &length, sizeof(length));
+		fmt::format_to(p + sizeof(length), "{}", value);
+		p += sizeof(length) + length;
+	}
+	static Decoded read(const uint8_t *&p) { return LogStringArg::read(p); }
+};
+
+template <typename T>
+struct LogArg<T, std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>
+	|| (std::is_pointer_v<T> && !std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, char>)>>
+{
+	typedef std::conditional_t<std::is_pointer_v<T>, const void *, T> Stored;
+	typedef typename std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::common_type<Stored>>::type Decoded;
+	static size_t size(const T &value) { return sizeof(Stored); }
+	static void write(uint8_t *&p, const T &value)
+	{
+		Stored stored = (Stored)value;
+		memcpy(p, &stored, sizeof(stored));
+		p += sizeof(stored);
+	}
+	static Decoded read(const uint8_t *&p)
+	{
+		Stored stored;
+		memcpy(&stored, p, sizeof(stored));
+		p += sizeof(stored);
+		return (Decoded)stored;
+	}
+};
+
+template <> struct LogArg<const char *> : LogStringArg
+{
+	static size_t size(const char *value) { return LogStringArg::size(value ? value : ""); }
+	static void write(uint8_t *&p, const char *value) { LogStringArg::write(p, value ? value : ""); }
+};
+template <> struct LogArg<char *> : LogArg<const char *> { };
+template <> struct LogArg<std::string_view> : LogStringArg { };
+template <> struct LogArg<std::string> : LogStringArg { };
+
+template <typename... Args>
+void logFormat(const uint8_t *args, std::string_view format, fmt::memory_buffer &out)
+{
+	// Braced initializers are evaluated in order
+	std::tuple<typename LogArg<std::decay_t<Args>>::Decoded...> values { LogArg<std::decay_t<Args>>::read(args)... };
+	std::apply([&](auto &...v) -> void { fmt::vformat_to(std::back_inserter(out), format, fmt::make_format_args(v...)); }, values);
+}
+
+template <typename... Args>
+void logWrite(LogLevel level, std::string_view format, const Args &...args)
+{
+	LogQueue *queue = LogThreadQueue;
+	if (!queue)
+	{
+		queue = logRegisterThread();
+		if (!queue)
+			return;
+	}
+	const size_t size = (sizeof(LogRecord) + (LogArg<std::decay_t<Args>>::size(args) + ... + 0) + 7) & ~(size_t)7;
+
+	// Records are contiguous, the end of the queue is padded when one doesn't fit before it
+	uint64_t head = queue->Head.load(std::memory_order_relaxed);
+	const size_t offset = (size_t)(head & (LogQueueSize - 1));
+	const size_t padding = offset + size > LogQueueSize ? LogQueueSize - offset : 0;
+	if (size > LogQueueSize / 2 || head + padding + size - queue->Tail.load(std::memory_order_acquire) > LogQueueSize)
+	{
+		queue->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (padding >= sizeof(LogRecord))
+	{
+		LogRecord pad = { (uint32_t)padding };
+		memcpy(&queue->Data[offset], &pad, sizeof(pad));
+	}
+	head += padding;
+
+	LogRecord record = {
+		(uint32_t)size, level, &logFormat<std::decay_t<Args>...>, format.data(), format.size(),
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+	};
+	uint8_t *p = &queue->Data[head & (LogQueueSize - 1)];
+	memcpy(p, &record, sizeof(record));
+	p += sizeof(record);
+	(LogArg<std::decay_t<Args>>::write(p, args), ...);
+	queue->Head.store(head + size, std::memory_order_release);
+
+	// The log thread polls, only wake it when it matters
+	if (level >= LogLevel::Warning || head + size - queue->Tail.load(std::memory_order_relaxed) > LogQueueSize / 2)
+		logWake();
+}
+
+} /* namespace game */
+
+#if GAME_LOG_LEVEL <= GAME_LOG_LEVEL_TRACE
+#define GAME_LOG_TRACE(...) ::game::logWrite(::game::LogLevel::Trace, __VA_ARGS__)
+#else
+#define GAME_LOG_TRACE(...) do { } while (false)
+#endif
+
+#if GAME_LOG_LEVEL <= GAME_LOG_LEVEL_DEBUG
+#define GAME_LOG_DEBUG(...) ::game::logWrite(::game::LogLevel::Debug, __VA_ARGS__)
+#else
+#define GAME_LOG_DEBUG(...) do { } while (false)
+#endif
+
+#if GAME_LOG_LEVEL <= GAME_LOG_LEVEL_INFO
+#define GAME_LOG_INFO(...) ::game::logWrite(::game::LogLevel::Info, __VA_ARGS__)
+#else
+#define GAME_LOG_INFO(...) do { } while (false)
+#endif
+
+#if GAME_LOG_LEVEL <= GAME_LOG_LEVEL_WARNING
+#define GAME_LOG_WARNING(...) ::game::logWrite(::game::LogLevel::Warning, __VA_ARGS__)
+#else
+#define GAME_LOG_WARNING(...) do { } while (false)
+#endif
+
+#if GAME_LOG_LEVEL <= GAME_LOG_LEVEL_ERROR
+#define GAME_LOG_ERROR(...) ::game::logWrite(::game::LogLevel::Error, __VA_ARGS__)
+#else
+#define GAME_LOG_ERROR(...) do { } while (false)
+#endif
+
+#endif /* #ifndef GAME_LOG_H */
+
+/* end of file */
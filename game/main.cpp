@@ -37,12 +37,25 @@ This is it.
 #include "win32_exception.h"
 #include "gl_exception.h"
 #include "message_box.h"
+#include "game.h"
+#include "gl_renderer.h"
+#include "render_thread.h"
+#include "job_system.h"
+#include "clock.h"
+#include "frame_pacer.h"
+#include "latency_scheduler.h"
+#include "resolution_controller.h"
+#include "perf_counters.h"
+#include "frame_encoder.h"
+#include "log.h"
 
 #include <shellapi.h>
+#include <dwmapi.h>
 #include <GL/wglext.h>
 
-#define GAME_GL_MAJOR 4
-#define GAME_GL_MINOR 4
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 namespace game {
 
@@ -55,13 +68,8 @@ HGLRC MainGlContext;
 int ArgC;
 char **ArgV;
 
-bool ArbSpirV;
-bool ArbSpirVExt;
-
 bool DisplayFullscreen;
 bool DisplayBorderless;
-int DisplayWidth;
-int DisplayHeight;
 
 namespace /* anonymous */ {
 
@@ -85,223 +93,36 @@ bool s_GameInit;
 bool s_InternalLoop;
 bool s_InGameLoop;
 
-void checkCompileStatus(GLuint shader)
-{
-	GLint status;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-	GAME_THROW_IF_GL_ERROR();
-	if (!status)
-	{
-		GLint logLength = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-		GAME_THROW_IF_GL_ERROR();
-
-		std::string log(logLength, 0);
-		glGetShaderInfoLog(shader, logLength, &logLength, &log[0]);
-		GAME_THROW_IF_GL_ERROR();
-		log.resize(logLength);
-
-		GAME_THROW(Exception(log));
-	}
-}
-
-void checkLinkStatus(GLuint program)
-{
-	GLint status;
-	glGetProgramiv(program, GL_LINK_STATUS, &status);
-	GAME_THROW_IF_GL_ERROR();
-	if (!status)
-	{
-		GLint logLength = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-		GAME_THROW_IF_GL_ERROR();
-
-		std::string log(logLength, 0);
-		glGetProgramInfoLog(program, logLength, &logLength, &log[0]);
-		GAME_THROW_IF_GL_ERROR();
-		log.resize(logLength);
-
-		GAME_THROW(Exception(log));
-	}
-}
-
-void loadShader(GLuint shader, const uint8_t *spv, size_t spvLen, const char *const *glsl, size_t glslLen)
-{
-	if (ArbSpirV && spv)
-	{
-		glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, spv, (GLsizei)spvLen);
-		glSpecializeShader(shader, "main", 0, null, null);
-	}
-	else if (glsl)
-	{
-		GLint len = (GLint)glslLen;
-		glShaderSource(shader, 1, glsl, &len);
-		glCompileShader(shader);
-	}
-	else
-	{
-		throw Exception("No shader loaded");
-	}
-	GAME_THROW_IF_GL_ERROR();
-	checkCompileStatus(shader);
-}
-
-bool isShaderSpirV(GLuint shader)
-{
-	if (!ArbSpirV)
-		return false;
-	GLint res;
-	glGetShaderiv(shader, GL_SPIR_V_BINARY, &res);
-	GAME_THROW_IF_GL_ERROR();
-	return res;
-}
-
-#define GAME_LOAD_SHADER(shader, name, ext) \
-	loadShader((shader), \
-		shaders::name::ext::spv, sizeof(shaders::name::ext::spv), \
-		shaders::name::ext::glsl, sizeof(shaders::name::ext::glsl0));
-
-#include "col.vs_6_0.inl"
-#include "col.ps_6_0.inl"
-
-GLuint s_ColProgram;
-GLuint s_TriBuffers[2];
-GLuint s_TriVao;
-
-void init()
-{
-	// Create vertex color program
-	GLuint colProgram = NULL;
-	GAME_FINALLY([&]() -> void { GAME_SAFE_C_DELETE(glDeleteProgram, colProgram); });
-	{
-		GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-		GAME_FINALLY([&]() -> void { GAME_SAFE_C_DELETE(glDeleteShader, vertShader); });
-		GAME_LOAD_SHADER(vertShader, col, vs_6_0);
-
-		GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-		GAME_FINALLY([&]() -> void { GAME_SAFE_C_DELETE(glDeleteShader, fragShader); });
-		GAME_LOAD_SHADER(fragShader, col, ps_6_0);
-
-		GLuint program = glCreateProgram();
-		GAME_FINALLY([&]() -> void { GAME_SAFE_C_DELETE(glDeleteProgram, program); });
-		glAttachShader(program, vertShader);
-		glAttachShader(program, fragShader);
-		glLinkProgram(program);
-		// BUG: Memory access violation if the shaders are detached (and deleted) on AMD with SPIR-V
-		if (!isShaderSpirV(vertShader))
-			glDetachShader(program, vertShader);
-		// BUG: Memory access violation if the shaders are detached (and deleted) on AMD with SPIR-V
-		if (!isShaderSpirV(fragShader))
-			glDetachShader(program, fragShader);
-		GAME_THROW_IF_GL_ERROR();
-		checkLinkStatus(program);
-
-		colProgram = program;
-		program = NULL;
-	}
-
-	GLuint triBuffers[2];
-	glGenBuffers(2, triBuffers);
-	GAME_FINALLY([&]() -> void { GAME_SAFE_GL_DELETE_ALL(glDeleteBuffers, triBuffers); });
-	GLuint triVao;
-	glGenVertexArrays(1, &triVao);
-	GAME_FINALLY([&]() -> void { GAME_SAFE_GL_DELETE_ONE(glDeleteVertexArrays, triVao); });
-	{
-		static const GLfloat positions[] = {
-			0.25f, -0.25f, 0.5f, 1.0f,
-			-0.25f, -0.25f, 0.5f, 1.0f,
-			0.25f, 0.25f, 0.5f, 1.0f,
-		};
-
-		static const GLfloat colors[] = {
-			1.0f, 0.0f, 0.0f, 1.0f,
-			0.0f, 1.0f, 0.0f, 1.0f,
-			0.0f, 0.0f, 1.0f, 1.0f,
-		};
-
-		glBindVertexArray(triVao);
-
-		glBindBuffer(GL_ARRAY_BUFFER, triBuffers[0]);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, null);
-		glEnableVertexAttribArray(0);
-
-		glBindBuffer(GL_ARRAY_BUFFER, triBuffers[1]);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(colors), colors, GL_STATIC_DRAW);
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, null);
-		glEnableVertexAttribArray(1);
-
-		glBindBuffer(GL_ARRAY_BUFFER, NULL);
-		glBindVertexArray(NULL);
-
-		GAME_THROW_IF_GL_ERROR();
-	}
-
-	s_ColProgram = colProgram;
-	colProgram = NULL;
-	s_TriBuffers[0] = triBuffers[0];
-	s_TriBuffers[1] = triBuffers[1];
-	triBuffers[0] = NULL;
-	triBuffers[1] = NULL;
-	s_TriVao = triVao;
-	triVao = NULL;
-	s_GameInit = true;
-}
-
-void update()
-{
-	
-}
-
-void render()
-{
-	// Set current context
-	GAME_THROW_LAST_ERROR_IF(!wglMakeCurrent(MainDeviceContext, MainGlContext));
-	glViewport(0, 0, DisplayWidth, DisplayHeight);
-	glScissor(0, 0, DisplayWidth, DisplayHeight);
-
-	// Clear background
-	static const GLfloat bg[4] = { 0.0f, 0.125f, 0.25f, 1.0f };
-	glClearBufferfv(GL_COLOR, 0, bg);
-	GAME_THROW_IF_GL_ERROR();
-
-	// Draw triangle
-	glEnable(GL_FRAMEBUFFER_SRGB); 
-	glUseProgram(s_ColProgram);
-	glBindVertexArray(s_TriVao);
-	glDrawArrays(GL_TRIANGLES, 0, 3);
-	glDisable(GL_FRAMEBUFFER_SRGB); 
-	GAME_THROW_IF_GL_ERROR();
-
-	// Swap
-	GAME_THROW_LAST_ERROR_IF(!SwapBuffers(MainDeviceContext));
-}
-
-void release()
-{
-	s_GameInit = false;
-	GAME_SAFE_GL_DELETE_ALL(glDeleteBuffers, s_TriBuffers);
-	GAME_SAFE_GL_DELETE_ONE(glDeleteVertexArrays, s_TriVao);
-	GAME_SAFE_C_DELETE(glDeleteProgram, s_ColProgram);
-}
+// Paces the fixed simulation steps, independent of the refresh rate
+SteadyClock s_Clock;
+
+// Frames are paced to the display refresh rate when vsync is off, so the loop doesn't spin
+FramePacer s_Pacer(&s_Clock);
+bool s_Vsync = true;
+int s_VsyncInterval = 1; // Adaptive vsync, -1, when supported
+PFNWGLSWAPINTERVALEXTPROC s_WglSwapIntervalEXT;
+std::atomic<int> s_SwapInterval = 1; // Requested, applied on the render thread before the next swap
+int s_AppliedSwapInterval = 1; // Render thread only
+
+// With vsync on, frames start as late as the measured frame cost allows, so input is sampled close to the present
+LatencyScheduler s_Latency(&s_Clock);
+bool s_LowLatency = true;
+bool s_DynamicResolution = true; // Render scale follows the GPU time, to hold the refresh rate
+GlRenderer *s_GlRenderer;
+bool s_FrameCapture = false; // Every frame is read back and written to capture.y4m
+std::mutex s_SwapMutex;
+int64_t s_SwapCount; // Swaps that returned, and when the last one did, under the mutex
+int64_t s_SwapTime;
+int64_t s_ReportedSwaps;
+int64_t s_LatencyTitleTime;
 
 void wmCreate(HWND hwnd);
 void wmDestroy();
 void loop();
-
-void APIENTRY debugCallbackGl(
-	GLenum source, GLenum type, GLuint id,
-	GLenum severity, GLsizei length, const GLchar *message,
-	const void *userParam)
-{
-	GAME_DEBUG_OUTPUT_LF(message);
-	switch (severity)
-	{
-	case GL_DEBUG_SEVERITY_HIGH:
-	case GL_DEBUG_SEVERITY_MEDIUM:
-		GAME_DEBUG_BREAK();
-	}
-}
+void applyPacing();
+double refreshRate();
+void updateVsync();
+void reportLatency();
 
 #define RETHROW_WND_PROC_EXCEPTION() if (s_WindowProcException) \
 	{ \
@@ -317,7 +138,7 @@ LRESULT CALLBACK windowProc(_In_ HWND hwnd, _In_ UINT uMsg, _In_ WPARAM wParam,
 	try
 	{
 		GAME_DEBUG_ASSERT(!hwnd || !MainWindow || MainWindow == hwnd); // Only one window, for now
-		// GAME_DEBUG_FORMAT("Message: {}\n", uMsg);
+		// GAME_LOG_TRACE("Message: {}", uMsg);
 		switch(uMsg)
 		{
 		case WM_CREATE:
@@ -352,7 +173,7 @@ LRESULT CALLBACK windowProc(_In_ HWND hwnd, _In_ UINT uMsg, _In_ WPARAM wParam,
 			{
 				rect->right += 32;
 			}
-			GAME_DEBUG_FORMAT("Resolution: {}x{} ({})\n"sv, DisplayWidth, DisplayHeight, 
+			GAME_LOG_INFO("Resolution: {}x{} ({})"sv, DisplayWidth, DisplayHeight,
 				DisplayBorderless ? "Borderless"sv : (DisplayFullscreen ? "Fullscreen"sv : "Windowed"sv));
 			return res;
 		}
@@ -382,10 +203,39 @@ LRESULT CALLBACK windowProc(_In_ HWND hwnd, _In_ UINT uMsg, _In_ WPARAM wParam,
 					s_ReqDisplayHeight = 0;
 					s_ReqDisplayChange = true;
 					break;
+				case 'V':
+					s_Vsync = !s_Vsync;
+					applyPacing();
+					break;
+				case 'L':
+					s_LowLatency = !s_LowLatency;
+					applyPacing();
+					break;
+				case 'R':
+					s_DynamicResolution = !s_DynamicResolution;
+					applyPacing();
+					break;
+				case 'C':
+					s_FrameCapture = !s_FrameCapture;
+					if (s_GlRenderer)
+						s_GlRenderer->setFrameCapture(s_FrameCapture ? std::make_shared<FrameEncoder>("capture.y4m"sv, 2, (int)(refreshRate() + 0.5)) : null);
+					break;
+#ifdef GAME_PROFILE
+				case 'P':
+					writeProfile("profile.json", profileCapture());
+					break;
+#endif
 				case 'H':
 					showMessageBox("Keys:"
 						"\n- F: Switch between fullscreen and windowed mode"
 						"\n- B: Toggle borderless fullscreen"
+						"\n- V: Toggle vsync, frames are paced to the display refresh rate when off"
+						"\n- L: Toggle late frame starts for lower latency with vsync, the window title shows the estimated latency"
+						"\n- R: Toggle dynamic resolution, the render scale drops when the GPU can't keep up with the refresh rate"
+						"\n- C: Start or stop capturing every frame to capture.y4m"
+#ifdef GAME_PROFILE
+						"\n- P: Write the recent scopes of all threads to profile.json, for chrome://tracing"
+#endif
 						""sv, "Game Help"sv, MessageBoxStyle::Message);
 					break;
 				}
@@ -491,6 +341,19 @@ void registerClass(wchar_t *className, WNDPROC wndProc)
 	GAME_THROW_LAST_ERROR_IF(!RegisterClassW(&wndClass));
 }
 
+bool hasExtension(const char *extensions, std::string_view name)
+{
+	std::string_view list = extensions ? extensions : "";
+	for (size_t i = list.find(name); i != std::string_view::npos; i = list.find(name, i + 1))
+	{
+		// Whole names only
+		size_t end = i + name.size();
+		if ((i == 0 || list[i - 1] == ' ') && (end == list.size() || list[end] == ' '))
+			return true;
+	}
+	return false;
+}
+
 void wmCreate(HWND hwnd)
 {
 	// Create dummy window for context
@@ -553,7 +416,7 @@ void wmCreate(HWND hwnd)
 	const int contextAttribs[] = {
 		WGL_CONTEXT_MAJOR_VERSION_ARB, GAME_GL_MAJOR,
 		WGL_CONTEXT_MINOR_VERSION_ARB, GAME_GL_MINOR,
-		WGL_CONTEXT_FLAGS_ARB, WGL_CONTEXT_FORWARD_COMPATIBLE_BIT_ARB,
+		WGL_CONTEXT_FLAGS_ARB, WGL_CONTEXT_FORWARD_COMPATIBLE_BIT_ARB | (GAME_GL_DEBUG_CONTEXT ? WGL_CONTEXT_DEBUG_BIT_ARB : 0),
 		WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
 		0, 0
 	};
@@ -564,61 +427,40 @@ void wmCreate(HWND hwnd)
 	MainGlContext = hglrc;
 	GAME_THROW_IF_GL_ERROR(); // Should not happen, but flush it anyway!
 
-	GAME_DEBUG_FORMAT("OpenGL {}, GLSL {}\nVendor: {}, Renderer: {}\n",
-		glGetString(GL_VERSION), glGetString(GL_SHADING_LANGUAGE_VERSION),
-		glGetString(GL_VENDOR), glGetString(GL_RENDERER));
-
-#ifdef GAME_DEBUG
-	glDebugMessageCallback(debugCallbackGl, 0);
-	GAME_THROW_IF_GL_ERROR();
-	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-	GAME_THROW_IF_GL_ERROR();
-	glEnable(GL_DEBUG_OUTPUT);
-	GAME_THROW_IF_GL_ERROR();
-#endif
-
 	PFNWGLGETEXTENSIONSSTRINGARBPROC wglGetExtensionsStringARB = (PFNWGLGETEXTENSIONSSTRINGARBPROC)wglGetProcAddress("wglGetExtensionsStringARB");
 	if (!wglGetExtensionsStringARB)
 		throw Exception("Missing function `wglGetExtensionsStringARB`.");
 
 	const char *wglExtensions = wglGetExtensionsStringARB(hdc);
-	GAME_THROW_IF_GL_ERROR();
-	GAME_DEBUG_FORMAT("WGL extensions: {}\nGL extensions:",
-		wglExtensions);
-	GLint numExt;
-	glGetIntegerv(GL_NUM_EXTENSIONS, &numExt);
-	GAME_THROW_IF_GL_ERROR();
-	for (GLint i = 0; i < numExt; ++i)
-	{
-		const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
-		GAME_THROW_IF_GL_ERROR();
-		GAME_DEBUG_FORMAT(" {}", ext);
-		if (!strcmp(ext, "GL_ARB_gl_spirv"))
-			ArbSpirV = true;
-		else if (!strcmp(ext, "GL_ARB_spirv_extensions"))
-			ArbSpirVExt = true;
-	}
-	GAME_DEBUG_OUTPUT("\n");
-
-	GAME_DEBUG_FORMAT("ARB_gl_spirv: {}\n", ArbSpirV); // GL 4.6
-	GAME_DEBUG_FORMAT("ARB_spirv_extensions: {}\n", ArbSpirVExt); // GL 4.6
+	GAME_CHECK_GL_ERROR();
+	GAME_LOG_DEBUG("WGL extensions: {}", wglExtensions);
 
-	if (ArbSpirV)
-	{
-		GAME_DEBUG_ASSERT(glShaderBinary);
-		GAME_DEBUG_ASSERT(glSpecializeShader);
-	}
+	initGlContext();
 
-	PFNWGLSWAPINTERVALEXTPROC wglSwapIntervalEXT = (PFNWGLSWAPINTERVALEXTPROC)wglGetProcAddress("wglSwapIntervalEXT");
-	if (!wglSwapIntervalEXT)
+	s_WglSwapIntervalEXT = (PFNWGLSWAPINTERVALEXTPROC)wglGetProcAddress("wglSwapIntervalEXT");
+	if (!s_WglSwapIntervalEXT)
 		throw Exception("Missing function `wglSwapIntervalEXT`.");
 
-	if (!wglSwapIntervalEXT(1))
+	// Adaptive vsync tears a late frame instead of holding it for another refresh,
+	// the extension may be listed in either the WGL or the GL extensions
+	if (hasExtension(wglExtensions, "WGL_EXT_swap_control_tear"sv) || ExtSwapControlTear)
+		s_VsyncInterval = -1;
+	GAME_LOG_INFO("Swap interval: {}", s_VsyncInterval);
+
+	if (!s_WglSwapIntervalEXT(s_VsyncInterval))
 		GAME_THROW(Exception("Failed to enable vsync"));
+	s_SwapInterval = s_VsyncInterval;
+	s_AppliedSwapInterval = s_VsyncInterval;
 }
 
 void wmDestroy()
 {
+	if (s_GameInit)
+	{
+		// Release on the render thread while the context still exists
+		s_GameInit = false;
+		release();
+	}
 	if (MainDeviceContext)
 	{
 		ReleaseDC(MainWindow, MainDeviceContext);
@@ -711,6 +553,94 @@ void applyDisplay()
 	}
 }
 
+void applyPacing()
+{
+	s_SwapInterval = s_Vsync ? s_VsyncInterval : 0;
+	if (s_Vsync)
+	{
+		// Presentation blocks on the swap
+		s_Pacer.setInterval(0);
+	}
+	else
+	{
+		s_Pacer.setRefreshRelative(refreshRate());
+	}
+
+	// Late starts only work when the GPU finishes each frame before its swap,
+	// otherwise let it run one frame behind
+	if (s_GlRenderer)
+		s_GlRenderer->setMaxQueuedFrames(s_Vsync && s_LowLatency ? 0 : 1);
+	FrameBudget = s_DynamicResolution ? (int64_t)(1e9 / refreshRate()) : 0;
+	updateVsync();
+}
+
+double refreshRate()
+{
+	int refresh = MainDeviceContext ? GetDeviceCaps(MainDeviceContext, VREFRESH) : 0;
+	return refresh > 1 ? (double)refresh : 60.0; // Zero and one are the hardware default
+}
+
+// Performance counter ticks to nanoseconds, as the steady clock converts them
+int64_t qpcToNs(int64_t ticks, int64_t frequency)
+{
+	return (ticks / frequency) * 1000000000 + (ticks % frequency) * 1000000000 / frequency;
+}
+
+// Vsync timing of the display on the steady clock, for the latency scheduler
+void updateVsync()
+{
+	if (!s_Vsync || !s_LowLatency)
+	{
+		s_Latency.setVsync(0, 0);
+		return;
+	}
+	DWM_TIMING_INFO info = { };
+	info.cbSize = sizeof(info);
+	LARGE_INTEGER frequency;
+	if (SUCCEEDED(DwmGetCompositionTimingInfo(NULL, &info)) && info.qpcRefreshPeriod
+		&& QueryPerformanceFrequency(&frequency))
+	{
+		s_Latency.setVsync(qpcToNs((int64_t)info.qpcVBlank, frequency.QuadPart),
+			qpcToNs((int64_t)info.qpcRefreshPeriod, frequency.QuadPart));
+	}
+	else
+	{
+		// Not composited, a swap that waited for vsync returned shortly after one
+		std::unique_lock<std::mutex> lock(s_SwapMutex);
+		s_Latency.setVsync(s_SwapTime, (int64_t)(1e9 / refreshRate()));
+	}
+}
+
+// Feed the swaps back to the scheduler, and show the estimated latency in the title
+void reportLatency()
+{
+	int64_t swapCount;
+	int64_t swapTime;
+	{
+		std::unique_lock<std::mutex> lock(s_SwapMutex);
+		swapCount = s_SwapCount;
+		swapTime = s_SwapTime;
+	}
+	if (swapCount != s_ReportedSwaps)
+	{
+		// One swap per frame, in order
+		s_Latency.presented(swapCount - 1, swapTime);
+		s_ReportedSwaps = swapCount;
+	}
+	updateVsync();
+
+	int64_t now = s_Clock.now();
+	if (now - s_LatencyTitleTime >= 500000000)
+	{
+		s_LatencyTitleTime = now;
+		LatencyStats stats = s_Latency.stats();
+		std::string title = fmt::format("Game - latency {:.1f} ms, frame cost {:.1f} ms, missed {}/{}{}, render scale {:.2f}",
+			stats.LatencyMean * 1e-3, stats.Cost * 1e-3, stats.Missed, stats.Frames,
+			s_Vsync && s_LowLatency ? ", late start"sv : ""sv, resolutionController().scale());
+		SetWindowTextA(MainWindow, title.c_str());
+	}
+}
+
 void setCmdLine(PWSTR lpCmdLine)
 { 
 	// Convert command line to UTF-8 argv
@@ -749,12 +679,72 @@ void setCmdLine(PWSTR lpCmdLine)
 
 void loop()
 {
+	GAME_PROFILE_COUNTED_SCOPE("loop");
 	s_InGameLoop = true;
-	update();
-	render();
+	s_Latency.beginFrame(); // Input is sampled by the frame
+	frame();
+	reportLatency();
 	s_InGameLoop = false; // Not called in case of exception inside loop, on purpose
 }
 
+// Errors flagged after the one that was thrown, call on the thread the context is current on,
+// false when glGetError doesn't reset
+bool pollGlErrors(GLenum lastFlag, std::vector<GLenum> &flags)
+{
+	int guardCount = 0;
+	while (GLenum flag = glGetError())
+	{
+		if (flag != lastFlag)
+		{
+			flags.push_back(flag);
+			lastFlag = flag;
+		}
+		else
+		{
+			++guardCount;
+			if (guardCount > 4096)
+				return false;
+		}
+	}
+	return true;
+}
+
+// Show the exception and the errors flagged after it, from the render thread while it owns the context,
+// false on critical failure
+bool showGlException(const GlException &ex, std::string_view title, RenderThread *renderThread)
+{
+	showMessageBox(ex.what(), title, MessageBoxStyle::Error);
+	std::vector<GLenum> flags;
+	bool reset = true;
+	if (renderThread)
+	{
+		try
+		{
+			renderThread->invoke([&]() -> void { reset = pollGlErrors(ex.flag(), flags); });
+		}
+		catch (...)
+		{
+			// Failure of a frame that was in flight, the errors were polled regardless
+		}
+	}
+	else if (wglGetCurrentContext())
+	{
+		reset = pollGlErrors(ex.flag(), flags);
+	}
+	for (GLenum flag : flags)
+	{
+		GlException ex2(flag, ex.file(), ex.line());
+		showMessageBox(ex2.what(), title, MessageBoxStyle::Error);
+	}
+	if (!reset)
+	{
+		// Critical failure
+		// glGetError not resetting
+		GAME_DEBUG_BREAK();
+	}
+	return reset;
+}
+
 int main()
 {
 	try
@@ -765,6 +755,8 @@ int main()
 			_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+			GAME_PROFILE_THREAD("Main");
+
 			// Cmd line
 			game::setCmdLine(GetCommandLineW());
 			GAME_FINALLY([&]() -> void { delete[](char *)ArgV; ArgV = null; });
@@ -811,8 +803,38 @@ int main()
 			ShowWindow(MainWindow, SW_SHOWNORMAL);
 			// ShowCursor(FALSE);
 
-			init();
-			GAME_FINALLY([&]() -> void { release(); });
+			// Renderer on the main window context, submitting from the render thread
+			GlRenderer glRenderer(
+				[]() -> void {
+					if (wglGetCurrentContext() != MainGlContext)
+						GAME_THROW_LAST_ERROR_IF(!wglMakeCurrent(MainDeviceContext, MainGlContext));
+				},
+				[]() -> void {
+					if (s_AppliedSwapInterval != s_SwapInterval)
+					{
+						s_AppliedSwapInterval = s_SwapInterval;
+						GAME_THROW_LAST_ERROR_IF(!s_WglSwapIntervalEXT(s_AppliedSwapInterval));
+					}
+					GAME_THROW_LAST_ERROR_IF(!SwapBuffers(MainDeviceContext));
+					int64_t swapTime = s_Clock.now();
+					std::unique_lock<std::mutex> lock(s_SwapMutex);
+					++s_SwapCount;
+					s_SwapTime = swapTime;
+				});
+			s_GlRenderer = &glRenderer;
+			GAME_FINALLY([&]() -> void { s_GlRenderer = null; });
+			applyPacing();
+			RenderThread renderer(&glRenderer, []() -> void { wglMakeCurrent(NULL, NULL); });
+
+			// Hand the context over to the render thread
+			GAME_THROW_LAST_ERROR_IF(!wglMakeCurrent(NULL, NULL));
+
+			// Workers for the game loop, the message thread is worker zero
+			JobSystem jobs;
+
+			init(&renderer, &jobs, &s_Clock);
+			s_GameInit = true;
+			GAME_FINALLY([&]() -> void { if (s_GameInit) { s_GameInit = false; release(); } });
 
 			// Message loop
 			do
@@ -831,39 +853,24 @@ int main()
 					{
 						// Display change requested, only apply inbetween complete frames
 						applyDisplay();
+						applyPacing(); // The refresh rate may have changed
+					}
+					else if (s_Vsync && s_LowLatency && !s_Latency.waitForStart())
+					{
+						// Not yet time to start the frame, handle the messages that came in meanwhile
 					}
 					else
 					{
 						loop();
 						s_LastException = false;
+						s_Pacer.wait();
 					}
 				}
 				catch (GlException &ex)
 				{
 					s_LastException = true;
-					showMessageBox(ex.what(), "Game Exception"sv, MessageBoxStyle::Error);
-					GLenum lastFlag = ex.flag();
-					int guardCount = 0;
-					while (GLenum flag = glGetError())
-					{
-						if (flag != lastFlag)
-						{
-							GlException ex2(flag, ex.file(), ex.line());
-							showMessageBox(ex2.what(), "Game Exception"sv, MessageBoxStyle::Error);
-							lastFlag = ex2.flag();
-						}
-						else
-						{
-							++guardCount;
-							if (guardCount > 4096)
-							{
-								// Critical failure
-								// Message box not shown, glGetError not resetting
-								GAME_DEBUG_BREAK();
-								return EXIT_FAILURE;
-							}
-						}
-					}
+					if (!showGlException(ex, "Game Exception"sv, &renderer))
+						return EXIT_FAILURE;
 				}
 				catch (Exception &ex)
 				{
@@ -884,29 +891,8 @@ int main()
 	}
 	catch (GlException &ex)
 	{
-		showMessageBox(ex.what(), "Fatal Game Exception"sv, MessageBoxStyle::Error);
-		GLenum lastFlag = ex.flag();
-		int guardCount = 0;
-		while (GLenum flag = glGetError())
-		{
-			if (flag != lastFlag)
-			{
-				GlException ex2(flag, ex.file(), ex.line());
-				showMessageBox(ex2.what(), "Fatal Game Exception"sv, MessageBoxStyle::Error);
-				lastFlag = ex2.flag();
-			}
-			else
-			{
-				++guardCount;
-				if (guardCount > 4096)
-				{
-					// Critical failure
-					// Message box not shown, glGetError not resetting
-					GAME_DEBUG_BREAK();
-					return EXIT_FAILURE;
-				}
-			}
-		}
+		// The render thread is gone, and released the context, unless it failed before the hand over
+		showGlException(ex, "Fatal Game Exception"sv, null);
 	}
 	catch (Exception &ex)
 	{
@@ -0,0 +1,233 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Math library benchmark.
+Measures the points per second transformed by a matrix with the scalar
+storage types, with `Vec4` one point at a time, and with the x8 batches
+on structure of arrays, and the matrix products per second.
+
+Usage: game_math_benchmark [--points N] [--repeat N]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "simd_math.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+int64_t s_PointCount = 1 << 20;
+int s_Repeat = 5;
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--points"sv)
+			s_PointCount = atoll(value);
+		else if (arg == "--repeat"sv)
+			s_Repeat = atoi(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_PointCount <= 0 || s_Repeat <= 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+struct Points
+{
+	// Array of structures
+	std::vector<Float3> In;
+	std::vector<Float4> Out;
+
+	// Structure of arrays
+	std::vector<float> X, Y, Z;
+	std::vector<float> OutX, OutY, OutZ, OutW;
+};
+
+void fillPoints(Points &points)
+{
+	points.In.resize(s_PointCount);
+	points.Out.resize(s_PointCount);
+	points.X.resize(s_PointCount);
+	points.Y.resize(s_PointCount);
+	points.Z.resize(s_PointCount);
+	points.OutX.resize(s_PointCount);
+	points.OutY.resize(s_PointCount);
+	points.OutZ.resize(s_PointCount);
+	points.OutW.resize(s_PointCount);
+	for (int64_t i = 0; i < s_PointCount; ++i)
+	{
+		float t = (float)i * 0.001f;
+		Float3 p = { sinf(t) * 10.0f, cosf(t * 1.3f) * 10.0f, -5.0f - (float)(i & 255) * 0.1f };
+		points.In[i] = p;
+		points.X[i] = p.X;
+		points.Y[i] = p.Y;
+		points.Z[i] = p.Z;
+	}
+}
+
+// Best of the repeats, in seconds
+template<typename TFunc>
+double measure(TFunc &&f)
+{
+	double best = 0.0;
+	for (int r = 0; r < s_Repeat; ++r)
+	{
+		auto start = std::chrono::steady_clock::now();
+		f();
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!r || s < best)
+			best = s;
+	}
+	return best;
+}
+
+// Relative to the magnitude of the value, the batch path may fuse the multiply and add
+const float s_Epsilon = 1e-4f;
+
+float difference(float a, float b)
+{
+	return fabsf(a - b) / std::max(1.0f, fabsf(a));
+}
+
+// Largest difference between the outputs of the Vec4 and the batch transform
+float compare(const Points &points)
+{
+	float res = 0.0f;
+	for (int64_t i = 0; i < s_PointCount; ++i)
+	{
+		const Float4 &a = points.Out[i];
+		res = std::max(res, difference(a.X, points.OutX[i]));
+		res = std::max(res, difference(a.Y, points.OutY[i]));
+		res = std::max(res, difference(a.Z, points.OutZ[i]));
+		res = std::max(res, difference(a.W, points.OutW[i]));
+	}
+	return res;
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+
+		Points points;
+		fillPoints(points);
+
+		const Mat4 viewProj = Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f)
+			* Mat4::rotation(Quat::fromAxisAngle({ 0.0f, 1.0f, 0.0f }, 0.3f))
+			* Mat4::translation({ 1.0f, -2.0f, -3.0f });
+		const Float4x4 viewProjScalar = viewProj.float4x4();
+
+		fmt::print("Points: {}, repeat: {}\n", s_PointCount, s_Repeat);
+		fmt::print("transform, million points per second\n");
+
+		double scalar = measure([&]() -> void {
+			for (int64_t i = 0; i < s_PointCount; ++i)
+			{
+				const Float3 &p = points.In[i];
+				points.Out[i] = viewProjScalar * Float4 { p.X, p.Y, p.Z, 1.0f };
+			}
+		});
+		fmt::print("scalar Float4x4, {:.1f}\n", (double)s_PointCount / scalar * 1e-6);
+
+		double vec4 = measure([&]() -> void {
+			for (int64_t i = 0; i < s_PointCount; ++i)
+				points.Out[i] = (viewProj * Vec4(points.In[i], 1.0f)).float4();
+		});
+		fmt::print("Vec4, {:.1f}\n", (double)s_PointCount / vec4 * 1e-6);
+
+		double batch = measure([&]() -> void {
+			transformPoints(viewProj, points.X.data(), points.Y.data(), points.Z.data(),
+				points.OutX.data(), points.OutY.data(), points.OutZ.data(), points.OutW.data(), s_PointCount);
+		});
+		fmt::print("Vec3x8 batch, {:.1f}\n", (double)s_PointCount / batch * 1e-6);
+		const float maxDifference = compare(points);
+		fmt::print("Max difference to Vec4: {}\n", maxDifference);
+		if (!(maxDifference <= s_Epsilon))
+		{
+			fmt::print(stderr, "FAIL: batch transform differs from Vec4 by {}, more than {}\n", maxDifference, s_Epsilon);
+			return EXIT_FAILURE;
+		}
+
+		// Chained products, each depends on the previous one, rotations keep the values bounded
+		const int64_t products = s_PointCount / 16;
+		const Mat4 rotation = Mat4::rotation(Quat::fromAxisAngle({ 0.6f, 0.0f, 0.8f }, 0.01f));
+		const Float4x4 rotationScalar = rotation.float4x4();
+		Float4x4 chainScalar = Float4x4::identity();
+		double mulScalar = measure([&]() -> void {
+			for (int64_t i = 0; i < products; ++i)
+				chainScalar = rotationScalar * chainScalar;
+		});
+		Mat4 chain = Mat4::identity();
+		double mulSimd = measure([&]() -> void {
+			for (int64_t i = 0; i < products; ++i)
+				chain = rotation * chain;
+		});
+		fmt::print("product, million per second\n");
+		fmt::print("scalar Float4x4, {:.1f}\n", (double)products / mulScalar * 1e-6);
+		fmt::print("Mat4, {:.1f}\n", (double)products / mulSimd * 1e-6);
+		fmt::print("Chain checksum: {} {}\n", chainScalar.Columns[0].X, chain.Columns[0].x());
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
@@ -0,0 +1,97 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "null_renderer.h"
+#include "exception.h"
+
+namespace game {
+
+NullRenderer::NullRenderer()
+{
+
+}
+
+NullRenderer::~NullRenderer() noexcept
+{
+
+}
+
+void NullRenderer::init()
+{
+
+}
+
+void NullRenderer::release() noexcept
+{
+	m_MeshVertexCounts.clear();
+}
+
+[[nodiscard]] Mesh NullRenderer::createMesh(const float *positions, const float *colors, int vertexCount)
+{
+	GAME_DEBUG_ASSERT(positions && colors && vertexCount > 0);
+	return m_MeshVertexCounts.create(vertexCount);
+}
+
+void NullRenderer::destroyMesh(Mesh mesh) noexcept
+{
+	m_MeshVertexCounts.destroy(mesh);
+}
+
+void NullRenderer::beginFrame(int width, int height, float renderScale)
+{
+	GAME_DEBUG_ASSERT(!m_InFrame);
+	m_InFrame = true;
+	m_RenderScale = renderScale;
+}
+
+void NullRenderer::clear(const float color[4])
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+}
+
+void NullRenderer::drawMesh(Mesh mesh, const DrawConstants &constants)
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+	const int *vertexCount = m_MeshVertexCounts.get(mesh);
+	if (!vertexCount)
+		GAME_THROW(Exception("Invalid mesh"sv, 1));
+	++m_DrawCount;
+	m_VertexCount += *vertexCount;
+}
+
+void NullRenderer::endFrame()
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+	m_InFrame = false;
+	++m_FrameCount;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,88 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Renderer that does nothing.
+Used to measure the CPU cost of the game loop without any driver.
+
+*/
+
+#pragma once
+#ifndef GAME_NULL_RENDERER_H
+#define GAME_NULL_RENDERER_H
+
+#include "platform.h"
+#include "renderer.h"
+
+#include <vector>
+
+namespace game {
+
+class NullRenderer : public Renderer
+{
+public:
+	NullRenderer();
+	virtual ~NullRenderer() noexcept;
+
+	[[nodiscard]] virtual std::string_view name() const override { return "null"sv; }
+
+	virtual void init() override;
+	virtual void release() noexcept override;
+
+	[[nodiscard]] virtual Mesh createMesh(const float *positions, const float *colors, int vertexCount) override;
+	virtual void destroyMesh(Mesh mesh) noexcept override;
+
+	virtual void beginFrame(int width, int height, float renderScale) override;
+	virtual void clear(const float color[4]) override;
+	virtual void drawMesh(Mesh mesh, const DrawConstants &constants) override;
+	virtual void endFrame() override;
+
+	// Frames take no time
+	[[nodiscard]] virtual GpuFrameTime gpuFrameTime() override { return { m_FrameCount - 1, 0, m_RenderScale }; }
+
+	inline int64_t frameCount() const { return m_FrameCount; }
+	inline int64_t drawCount() const { return m_DrawCount; }
+	inline int64_t vertexCount() const { return m_VertexCount; }
+
+private:
+	HandlePool<Mesh, int> m_MeshVertexCounts;
+	bool m_InFrame = false;
+	int64_t m_FrameCount = 0;
+	float m_RenderScale = 1.0f;
+	int64_t m_DrawCount = 0;
+	int64_t m_VertexCount = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_NULL_RENDERER_H */
+
+/* end of file */
@@ -0,0 +1,148 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Frame pacing benchmark.
+Runs frames of simulated work on the steady clock, paced to a target
+rate by each wait mode, and reports the frame time spread, how late
+frames start, and the processor time spent waiting.
+
+Usage: game_pacing_benchmark [--rate HZ] [--frames N] [--work US]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "frame_pacer.h"
+
+#include <ctime>
+#include <cstdlib>
+#include <random>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+double s_Rate = 120.0;
+int s_Frames = 240;
+int64_t s_Work = 2000; // Microseconds of work per frame, varied by a quarter
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--rate"sv)
+			s_Rate = atof(value);
+		else if (arg == "--frames"sv)
+			s_Frames = atoi(value);
+		else if (arg == "--work"sv)
+			s_Work = atoll(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_Rate <= 0.0 || s_Frames <= 0 || s_Work < 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+// Busy work, as a frame would be
+void work(SteadyClock &clock, int64_t ns)
+{
+	int64_t end = clock.now() + ns;
+	while (clock.now() < end)
+	{
+	}
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+		SteadyClock clock;
+
+		fmt::print("Rate: {} Hz, frames: {}, work: {} us\n", s_Rate, s_Frames, s_Work);
+		fmt::print("mode, frame mean (us), frame stddev (us), late mean (us), late max (us), spin margin (us), wait processor time (%)\n");
+		const std::pair<std::string_view, PacingWait> modes[] = {
+			{ "hybrid"sv, PacingWait::Hybrid },
+			{ "sleep"sv, PacingWait::Sleep },
+			{ "spin"sv, PacingWait::Spin },
+		};
+		for (const auto &mode : modes)
+		{
+			FramePacer pacer(&clock, mode.second);
+			pacer.setRate(s_Rate);
+			std::mt19937 rng(1);
+			std::uniform_int_distribution<int64_t> jitter(-s_Work * 250, s_Work * 250);
+
+			int64_t workTotal = 0;
+			int64_t wallStart = clock.now();
+			std::clock_t cpuStart = std::clock();
+			for (int i = 0; i < s_Frames; ++i)
+			{
+				int64_t ns = s_Work * 1000 + jitter(rng);
+				work(clock, ns);
+				workTotal += ns;
+				pacer.wait();
+			}
+			double cpu = (double)(std::clock() - cpuStart) / (double)CLOCKS_PER_SEC * 1e9;
+			double wait = (double)(clock.now() - wallStart - workTotal);
+
+			FramePacingStats stats = pacer.stats();
+			fmt::print("{}, {:.1f}, {:.1f}, {:.1f}, {:.1f}, {:.1f}, {:.1f}\n",
+				mode.first, stats.FrameMean, stats.FrameStdDev, stats.LateMean, stats.LateMax,
+				(double)pacer.spinMarginNs() * 1e-3, std::max(cpu - (double)workTotal, 0.0) / wait * 100.0);
+		}
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
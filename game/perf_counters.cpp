@@ -0,0 +1,300 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "perf_counters.h"
+#include "exception.h"
+
+#include <memory>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr int MaxScopes = 32; // Distinct counted scope names per thread
+
+struct ScopeTotals
+{
+	const char *Name;
+	int64_t Calls;
+	int64_t Frames;
+	int64_t Values[PerfCounterCount];
+	int64_t LastFrame;
+	int64_t FrameCycles; // In `LastFrame` so far
+	int64_t MaxFrameCycles;
+};
+
+struct PerfThread
+{
+	int Fds[PerfCounterCount] = { -1, -1, -1, -1 };
+	int Slots[PerfCounterCount] = { -1, -1, -1, -1 }; // Position in the group read, or -1
+	int Opened = 0;
+
+	std::mutex Mutex; // Uncontended, except while reporting
+	ScopeTotals Scopes[MaxScopes];
+	int ScopeCount = 0;
+
+	~PerfThread() noexcept
+	{
+#ifdef __linux__
+		for (int fd : Fds)
+			if (fd >= 0)
+				close(fd);
+#endif
+	}
+};
+
+std::mutex s_Mutex;
+std::vector<std::unique_ptr<PerfThread>> s_Threads;
+int64_t s_FirstFrame;
+thread_local PerfThread *s_Thread;
+thread_local bool s_ThreadFailed;
+
+#ifdef __linux__
+
+int openCounter(uint32_t type, uint64_t config, int group)
+{
+	perf_event_attr attr = { };
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = group < 0; // The group starts together once complete
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+// Counters of the calling thread, the cycles lead the group and are required
+PerfThread *openThread(std::string &error)
+{
+	std::unique_ptr<PerfThread> thread = std::make_unique<PerfThread>();
+	static const uint64_t configs[PerfCounterCount] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+	int leader = openCounter(PERF_TYPE_HARDWARE, configs[0], -1);
+	if (leader < 0)
+	{
+		int code = errno;
+		error = fmt::format("Failed to open the cycle counter: {}{}", strerror(code),
+			code == ENOENT || code == EOPNOTSUPP ? " (no hardware counters, as in most virtual machines)"sv
+			: code == EACCES || code == EPERM ? " (see /proc/sys/kernel/perf_event_paranoid)"sv : ""sv);
+		return null;
+	}
+	thread->Fds[0] = leader;
+	thread->Slots[0] = thread->Opened++;
+	for (int i = 1; i < PerfCounterCount; ++i)
+	{
+		// Optional, not every processor counts everything
+		int fd = openCounter(PERF_TYPE_HARDWARE, configs[i], leader);
+		if (fd >= 0)
+		{
+			thread->Fds[i] = fd;
+			thread->Slots[i] = thread->Opened++;
+		}
+	}
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+	std::unique_lock<std::mutex> lock(s_Mutex);
+	s_Threads.push_back(std::move(thread));
+	return s_Threads.back().get();
+}
+
+#else
+
+PerfThread *openThread(std::string &error)
+{
+	error = "Performance counters are only supported on Linux"s;
+	return null;
+}
+
+#endif
+
+PerfThread *thread()
+{
+	if (s_Thread || s_ThreadFailed)
+		return s_Thread;
+	std::string error;
+	s_Thread = openThread(error);
+	s_ThreadFailed = !s_Thread; // Scopes on this thread go uncounted
+	return s_Thread;
+}
+
+} /* anonymous namespace */
+
+void enablePerfCounters()
+{
+	if (!s_Thread)
+	{
+		std::string error;
+		s_Thread = openThread(error);
+		if (!s_Thread)
+			GAME_THROW(Exception(error));
+		s_ThreadFailed = false;
+	}
+	{
+		std::unique_lock<std::mutex> lock(s_Mutex);
+		s_FirstFrame = ProfileFrameCount.load(std::memory_order_relaxed);
+	}
+	PerfCountersEnabled.store(true, std::memory_order_relaxed);
+}
+
+bool perfSample(PerfSample &sample)
+{
+	PerfThread *t = thread();
+	if (!t)
+		return false;
+#ifdef __linux__
+	uint64_t data[3 + PerfCounterCount];
+	ssize_t size = (ssize_t)((3 + t->Opened) * sizeof(uint64_t));
+	if (read(t->Fds[0], data, (size_t)size) != size)
+		return false;
+	sample.Enabled = (int64_t)data[1];
+	sample.Running = (int64_t)data[2];
+	for (int i = 0; i < PerfCounterCount; ++i)
+		sample.Values[i] = t->Slots[i] >= 0 ? (int64_t)data[3 + t->Slots[i]] : -1;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void perfAccumulate(const char *name, const PerfSample &begin, const PerfSample &end)
+{
+	PerfThread *t = s_Thread;
+	if (!t)
+		return;
+
+	// Scale up for the time the group was not scheduled on the counters
+	int64_t enabled = end.Enabled - begin.Enabled;
+	int64_t running = end.Running - begin.Running;
+	double scale = running > 0 && running < enabled ? (double)enabled / (double)running : 1.0;
+	int64_t frame = ProfileFrameCount.load(std::memory_order_relaxed);
+
+	std::unique_lock<std::mutex> lock(t->Mutex);
+	ScopeTotals *scope = null;
+	for (int i = 0; i < t->ScopeCount && !scope; ++i)
+		if (t->Scopes[i].Name == name)
+			scope = &t->Scopes[i];
+	if (!scope)
+	{
+		if (t->ScopeCount == MaxScopes)
+			return;
+		scope = &t->Scopes[t->ScopeCount++];
+		*scope = { };
+		scope->Name = name;
+		scope->LastFrame = -1;
+	}
+	int64_t delta[PerfCounterCount];
+	for (int i = 0; i < PerfCounterCount; ++i)
+	{
+		delta[i] = end.Values[i] >= 0 ? (int64_t)((double)(end.Values[i] - begin.Values[i]) * scale) : -1;
+		scope->Values[i] = delta[i] >= 0 ? scope->Values[i] + delta[i] : -1;
+	}
+	++scope->Calls;
+	if (frame != scope->LastFrame)
+	{
+		++scope->Frames;
+		scope->LastFrame = frame;
+		scope->FrameCycles = 0;
+	}
+	scope->FrameCycles += delta[(int)PerfCounter::Cycles];
+	scope->MaxFrameCycles = std::max(scope->MaxFrameCycles, scope->FrameCycles);
+}
+
+PerfReport perfReport()
+{
+	PerfReport report = { };
+	std::unique_lock<std::mutex> lock(s_Mutex);
+	report.Frames = ProfileFrameCount.load(std::memory_order_relaxed) - s_FirstFrame;
+	for (const std::unique_ptr<PerfThread> &t : s_Threads)
+	{
+		std::unique_lock<std::mutex> threadLock(t->Mutex);
+		for (int i = 0; i < t->ScopeCount; ++i)
+		{
+			const ScopeTotals &totals = t->Scopes[i];
+			auto it = std::find_if(report.Scopes.begin(), report.Scopes.end(),
+				[&](const PerfScopeStats &stats) -> bool { return stats.Name == totals.Name; });
+			if (it == report.Scopes.end())
+			{
+				PerfScopeStats stats = { totals.Name };
+				report.Scopes.push_back(stats);
+				it = report.Scopes.end() - 1;
+			}
+
+			// Same name on several threads, such as jobs
+			it->Calls += totals.Calls;
+			it->Frames = std::max(it->Frames, totals.Frames);
+			for (int j = 0; j < PerfCounterCount; ++j)
+				it->Values[j] = totals.Values[j] >= 0 && it->Values[j] >= 0 ? it->Values[j] + totals.Values[j] : -1;
+			it->MaxFrameCycles = std::max(it->MaxFrameCycles, totals.MaxFrameCycles);
+		}
+	}
+	return report;
+}
+
+void writePerfReport(std::FILE *f, const PerfReport &report)
+{
+	fmt::print(f, "Perf counters over {} frames, per frame, including nested scopes:\n", report.Frames);
+	fmt::print(f, "scope, calls, cycles, cycles max, instructions, IPC, LLC misses, per 1k instructions, branch misses, per 1k instructions\n");
+	double frames = (double)std::max<int64_t>(report.Frames, 1);
+	for (const PerfScopeStats &scope : report.Scopes)
+	{
+		auto perFrame = [&](PerfCounter counter) -> std::string {
+			int64_t value = scope.Values[(int)counter];
+			return value >= 0 ? fmt::format("{:.0f}", (double)value / frames) : "n/a"s;
+		};
+		auto ratio = [&](PerfCounter numerator, PerfCounter denominator, double unit) -> std::string {
+			int64_t n = scope.Values[(int)numerator];
+			int64_t d = scope.Values[(int)denominator];
+			return n >= 0 && d > 0 ? fmt::format("{:.3f}", (double)n * unit / (double)d) : "n/a"s;
+		};
+		fmt::print(f, "{}, {:.2f}, {}, {}, {}, {}, {}, {}, {}, {}\n",
+			scope.Name, (double)scope.Calls / frames, perFrame(PerfCounter::Cycles), scope.MaxFrameCycles,
+			perFrame(PerfCounter::Instructions), ratio(PerfCounter::Instructions, PerfCounter::Cycles, 1.0),
+			perFrame(PerfCounter::CacheMisses), ratio(PerfCounter::CacheMisses, PerfCounter::Instructions, 1000.0),
+			perFrame(PerfCounter::BranchMisses), ratio(PerfCounter::BranchMisses, PerfCounter::Instructions, 1000.0));
+	}
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,147 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Hardware performance counters on profiled scopes.
+`GAME_PROFILE_COUNTED_SCOPE("name")` is a profiled scope that also reads the
+cycles, instructions, last level cache misses and branch misses of the calling
+thread when it begins and ends, and adds the difference to the totals of the
+scope name on that thread. The report merges the threads by name, and divides
+by the frames marked with `GAME_PROFILE_FRAME()` to give numbers per frame.
+Counts are inclusive of nested scopes.
+
+Counting is off until `enablePerfCounters()`, after which each thread opens its
+counters as a group through `perf_event_open` when it first enters a counted
+scope. Reading a group is a system call, so counted scopes belong around whole
+subsystems, not inner loops. Counts are scaled up when the kernel had to
+multiplex the group with other counters.
+
+Only available on Linux, with a hardware PMU that the kernel lets user space
+count on, see `/proc/sys/kernel/perf_event_paranoid`.
+
+*/
+
+#pragma once
+#ifndef GAME_PERF_COUNTERS_H
+#define GAME_PERF_COUNTERS_H
+
+#include "platform.h"
+#include "profiler.h"
+
+#include <atomic>
+#include <vector>
+
+namespace game {
+
+enum class PerfCounter : int
+{
+	Cycles,
+	Instructions,
+	CacheMisses, // Last level
+	BranchMisses,
+};
+
+constexpr int PerfCounterCount = 4;
+
+// Counter values of the calling thread, negative for counters it couldn't open
+struct PerfSample
+{
+	int64_t Values[PerfCounterCount];
+	int64_t Enabled; // Nanoseconds the group was enabled and actually counting
+	int64_t Running;
+};
+
+inline std::atomic<bool> PerfCountersEnabled = false;
+
+// Opens the counters of the calling thread right away, throws when they are not available
+void enablePerfCounters();
+
+// Returns false when the calling thread has no counters
+bool perfSample(PerfSample &sample);
+
+// Adds the difference to the totals of the name on the calling thread
+void perfAccumulate(const char *name, const PerfSample &begin, const PerfSample &end);
+
+class PerfScope
+{
+public:
+	inline PerfScope(const char *name) : m_Name(name)
+	{
+		m_Active = PerfCountersEnabled.load(std::memory_order_relaxed) && perfSample(m_Begin);
+	}
+
+	inline ~PerfScope() noexcept
+	{
+		PerfSample end;
+		if (m_Active && perfSample(end))
+			perfAccumulate(m_Name, m_Begin, end);
+	}
+
+	PerfScope(const PerfScope &) = delete;
+	PerfScope &operator=(const PerfScope &) = delete;
+
+private:
+	const char *m_Name;
+	bool m_Active;
+	PerfSample m_Begin;
+
+};
+
+struct PerfScopeStats
+{
+	std::string Name;
+	int64_t Calls;
+	int64_t Frames; // Frames in which the scope ended at least once
+	int64_t Values[PerfCounterCount]; // Totals, negative when not counted
+	int64_t MaxFrameCycles; // Most cycles spent in the scope within one frame
+};
+
+struct PerfReport
+{
+	int64_t Frames; // Marked since counting was enabled
+	std::vector<PerfScopeStats> Scopes; // In order of first use
+};
+
+PerfReport perfReport();
+
+// Per frame counts, instructions per cycle, and misses per thousand instructions of each scope
+void writePerfReport(std::FILE *f, const PerfReport &report);
+
+} /* namespace game */
+
+#ifdef GAME_PROFILE
+#define GAME_PROFILE_COUNTED_SCOPE(name) GAME_PROFILE_SCOPE(name); ::game::PerfScope GAME_CONCAT(perfScope__, __COUNTER__)(name)
+#else
+#define GAME_PROFILE_COUNTED_SCOPE(name) do { } while (false)
+#endif
+
+#endif /* #ifndef GAME_PERF_COUNTERS_H */
+
+/* end of file */
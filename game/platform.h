@@ -80,6 +80,9 @@ constexpr decltype(nullptr) null = nullptr;
 // Ideally, assign them as `constexpr std::string_view`.
 #include <string>
 #include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
 using namespace std::string_literals;
 using namespace std::string_view_literals;
 
@@ -123,10 +126,16 @@ using namespace std::string_view_literals;
 #define GAME_RELEASE_ASSERT(cond) do { if (!(cond)) GAME_RELEASE_BREAK(); } while (false)
 #define GAME_RELEASE_VERIFY(cond) do { if (!(cond)) GAME_RELEASE_BREAK(); } while (false)
 
+#ifndef _MSC_VER
+#define sprintf_s snprintf
+#endif
+
 #ifdef GAME_DEBUG
 #define GAME_DEBUG_BREAK() debug_break()
 #define GAME_DEBUG_ASSERT(cond) do { if (!(cond)) GAME_DEBUG_BREAK(); } while (false)
 #define GAME_DEBUG_VERIFY(cond) do { if (!(cond)) GAME_DEBUG_BREAK(); } while (false)
+// Synchronous, so an exception is shown before the break, log with `GAME_LOG_*` from log.h otherwise
+#ifdef _WIN32
 #define GAME_DEBUG_OUTPUT(str) do { \
 		auto s = (str); \
 		std::string_view sv = s; \
@@ -154,6 +163,19 @@ using namespace std::string_view_literals;
 		wstr[wlen + 1] = 0; \
 		OutputDebugStringW(wstr); \
 	} while (false)
+#else
+#define GAME_DEBUG_OUTPUT(str) do { \
+		auto s = (str); \
+		std::string_view sv = s; \
+		fwrite(sv.data(), 1, sv.size(), stderr); \
+	} while (false)
+#define GAME_DEBUG_OUTPUT_LF(str) do { \
+		auto s = (str); \
+		std::string_view sv = s; \
+		fwrite(sv.data(), 1, sv.size(), stderr); \
+		fputc('\n', stderr); \
+	} while (false)
+#endif
 #define GAME_THROW(ex) do { auto ex_ = (ex); GAME_DEBUG_OUTPUT_LF(ex_.what()); debug_break(); throw ex_; } while (false)
 #else
 #define GAME_DEBUG_BREAK() do { } while (false)
@@ -164,60 +186,6 @@ using namespace std::string_view_literals;
 #define GAME_THROW(ex) do { throw ex; } while (false)
 #endif
 
-#define GAME_OUTPUT_DEBUG_BUFFER (_ALLOCA_S_THRESHOLD / 4)
-
-namespace game {
-
-struct OutputDebugContainer
-{
-public:
-	typedef char value_type;
-
-private:
-	char m_Buffer[GAME_OUTPUT_DEBUG_BUFFER];
-	int m_Length = 0;
-
-	void flush()
-	{
-		int len = m_Length;
-		if (m_Buffer[len - 1] & 0x80)
-		{
-			// Last character may be incomplete
-			--len;
-			while (m_Buffer[len] & 0x40)
-				--len;
-		}
-		GAME_DEBUG_OUTPUT(std::string_view(m_Buffer, len));
-		int remain = m_Length - len;
-		for (int i = 0; i < remain; ++i)
-			m_Buffer[i] = m_Buffer[len + i];
-		m_Length = remain;
-	}
-
-public:
-	GAME_FORCE_INLINE void push_back(char c)
-	{
-		m_Buffer[m_Length] = c;
-		++m_Length;
-		if (m_Length >= sizeof(m_Buffer))
-			flush();
-	}
-
-	GAME_FORCE_INLINE ~OutputDebugContainer()
-	{
-		if (m_Length)
-			GAME_DEBUG_OUTPUT(std::string_view(m_Buffer, m_Length));
-	}
-};
-
-}
-
-#ifdef GAME_DEBUG
-#define GAME_DEBUG_FORMAT(format, ...) ([&]() -> void { fmt::format_to(std::back_insert_iterator(OutputDebugContainer()), format, __VA_ARGS__); })()
-#else
-#define GAME_DEBUG_FORMAT(format, ...) do { } while (false)
-#endif
-
 #define GAME_SAFE_C_DELETE(del, ptr) if (ptr) \
 	{ \
 		del(ptr); \
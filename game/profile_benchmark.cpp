@@ -0,0 +1,209 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Profiler overhead benchmark.
+Runs a loop with a trivial body, bare, with a profiled scope around the
+body, and reading the time stamp twice, on one or more threads at once,
+and reports the cost of a scope as the difference per iteration, along
+with the part of it that is spent reading the time. Virtual machines may
+trap the time stamp counter, which makes it far slower than on hardware.
+Then captures the result and reports the
+size per event of the Chrome trace and the binary format, checking that
+the binary format reads back to the same capture.
+
+Usage: game_profile_benchmark [--iterations N] [--threads N]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+int64_t s_Iterations = 10000000;
+int s_Threads = 1;
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--iterations"sv)
+			s_Iterations = atoll(value);
+		else if (arg == "--threads"sv)
+			s_Threads = atoi(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_Iterations <= 0 || s_Threads <= 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+#ifdef GAME_PROFILE
+
+volatile int64_t s_Sink;
+
+void bare()
+{
+	for (int64_t i = 0; i < s_Iterations; ++i)
+		s_Sink = i;
+}
+
+void ticks()
+{
+	for (int64_t i = 0; i < s_Iterations; ++i)
+	{
+		s_Sink = profileTicks();
+		s_Sink = profileTicks();
+	}
+}
+
+void scoped()
+{
+	for (int64_t i = 0; i < s_Iterations; ++i)
+	{
+		GAME_PROFILE_SCOPE("iteration");
+		s_Sink = i;
+	}
+}
+
+// Nanoseconds per iteration, the slowest thread
+double run(void (*loop)())
+{
+	std::vector<double> times(s_Threads);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < s_Threads; ++t)
+	{
+		threads.emplace_back([&times, loop, t]() -> void {
+			GAME_PROFILE_THREAD("Benchmark");
+			auto start = std::chrono::steady_clock::now();
+			loop();
+			times[t] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+	return *std::max_element(times.begin(), times.end()) / (double)s_Iterations;
+}
+
+bool sameCapture(const ProfileCapture &a, const ProfileCapture &b)
+{
+	if (a.Names != b.Names || a.Threads.size() != b.Threads.size())
+		return false;
+	for (size_t i = 0; i < a.Threads.size(); ++i)
+	{
+		const ProfileCapture::Thread &x = a.Threads[i];
+		const ProfileCapture::Thread &y = b.Threads[i];
+		if (x.Id != y.Id || x.Name != y.Name || x.Events.size() != y.Events.size())
+			return false;
+		for (size_t j = 0; j < x.Events.size(); ++j)
+		{
+			const ProfileCapture::Event &e = x.Events[j];
+			const ProfileCapture::Event &f = y.Events[j];
+			if (e.Time != f.Time || e.Type != f.Type || (e.Type != ProfileEventType::End && e.Name != f.Name))
+				return false;
+		}
+	}
+	return true;
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+
+#ifdef GAME_PROFILE
+		fmt::print("Iterations: {}, threads: {}, buffer: {} events per thread\n", s_Iterations, s_Threads, ProfileBufferSize);
+		double bareNs = run(bare);
+		double ticksNs = run(ticks);
+		double scopedNs = run(scoped);
+		fmt::print("Bare: {:.2f} ns, scoped: {:.2f} ns, per scope: {:.2f} ns, of which reading the time: {:.2f} ns\n",
+			bareNs, scopedNs, scopedNs - bareNs, ticksNs - bareNs);
+
+		ProfileCapture capture = profileCapture();
+		size_t events = 0;
+		for (const ProfileCapture::Thread &thread : capture.Threads)
+			events += thread.Events.size();
+
+		std::FILE *json = tmpfile();
+		std::FILE *binary = tmpfile();
+		if (!json || !binary)
+			GAME_THROW(Exception("Failed to create a temporary file"sv, 1));
+		GAME_FINALLY([&]() -> void { fclose(json); fclose(binary); });
+		writeChromeTrace(json, capture);
+		writeProfileBinary(binary, capture);
+		long jsonSize = ftell(json);
+		long binarySize = ftell(binary);
+		rewind(binary);
+		bool same = sameCapture(capture, readProfileBinary(binary));
+		fmt::print("Captured {} events, json: {:.1f} bytes per event, binary: {:.1f} bytes per event, read back: {}\n",
+			events, (double)jsonSize / (double)events, (double)binarySize / (double)events, same ? "same"sv : "different"sv);
+		return same ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+		fmt::print("Built with GAME_NO_PROFILE, scopes compile to nothing\n");
+		return EXIT_SUCCESS;
+#endif
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
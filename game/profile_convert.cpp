@@ -0,0 +1,100 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Profile converter.
+Reads a profile in the binary format, as written by `game_headless --profile`,
+and writes it as Chrome trace JSON, for chrome://tracing or Perfetto.
+
+Usage: game_profile_convert INPUT OUTPUT
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "profiler.h"
+
+#include <cstdlib>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		if (argc != 3)
+			GAME_THROW(Exception("Usage: game_profile_convert INPUT OUTPUT"sv, 1));
+
+		ProfileCapture capture;
+		{
+			std::FILE *f = fopen(argv[1], "rb");
+			if (!f)
+				GAME_THROW(Exception(fmt::format("Failed to open `{}`", argv[1])));
+			GAME_FINALLY([&]() -> void { fclose(f); });
+			capture = readProfileBinary(f);
+		}
+
+		std::FILE *f = fopen(argv[2], "w");
+		if (!f)
+			GAME_THROW(Exception(fmt::format("Failed to open `{}`", argv[2])));
+		GAME_FINALLY([&]() -> void { fclose(f); });
+		writeChromeTrace(f, capture);
+		if (ferror(f))
+			GAME_THROW(Exception(fmt::format("Failed to write `{}`", argv[2])));
+
+		size_t events = 0;
+		for (const ProfileCapture::Thread &thread : capture.Threads)
+			events += thread.Events.size();
+		fmt::print("Converted {} events on {} threads\n", events, capture.Threads.size());
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
@@ -0,0 +1,355 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "profiler.h"
+#include "exception.h"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+std::mutex s_Mutex;
+std::vector<std::unique_ptr<ProfileBuffer>> s_Buffers; // Kept after their thread exits, so the capture still has them
+
+// Time stamp counter and steady clock read together at the first event, to convert ticks to nanoseconds
+int64_t s_CalibrationTicks;
+int64_t s_CalibrationNs;
+
+constexpr uint32_t BinaryMagic = 0x46525047; // GPRF
+constexpr uint32_t BinaryVersion = 1;
+
+int64_t steadyNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Nanoseconds per tick, measured over at least a few milliseconds since the first event
+double tickPeriod()
+{
+#ifdef GAME_PROFILE_TSC
+	int64_t ns = steadyNs();
+	if (ns - s_CalibrationNs < 10000000)
+	{
+		std::this_thread::sleep_for(std::chrono::nanoseconds(10000000 - (ns - s_CalibrationNs)));
+		ns = steadyNs();
+	}
+	int64_t ticks = profileTicks();
+	return ticks > s_CalibrationTicks ? (double)(ns - s_CalibrationNs) / (double)(ticks - s_CalibrationTicks) : 1.0;
+#else
+	return 1.0;
+#endif
+}
+
+void writeJsonString(std::FILE *f, std::string_view str)
+{
+	fputc('"', f);
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			fputc('\\', f);
+			fputc(c, f);
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			fmt::print(f, "\\u{:04x}", (int)c);
+		}
+		else
+		{
+			fputc(c, f);
+		}
+	}
+	fputc('"', f);
+}
+
+void writeU32(std::FILE *f, uint32_t v)
+{
+	uint8_t bytes[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+	fwrite(bytes, 1, sizeof(bytes), f);
+}
+
+void writeVarint(std::FILE *f, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		fputc((int)(v & 0x7F) | 0x80, f);
+		v >>= 7;
+	}
+	fputc((int)v, f);
+}
+
+uint32_t readU32(std::FILE *f)
+{
+	uint8_t bytes[4];
+	if (fread(bytes, 1, sizeof(bytes), f) != sizeof(bytes))
+		GAME_THROW(Exception("Truncated profile"sv, 1));
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+uint64_t readVarint(std::FILE *f)
+{
+	uint64_t v = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int c = fgetc(f);
+		if (c == EOF)
+			GAME_THROW(Exception("Truncated profile"sv, 1));
+		v |= (uint64_t)(c & 0x7F) << shift;
+		if (!(c & 0x80))
+			return v;
+	}
+	GAME_THROW(Exception("Invalid profile"sv, 1));
+}
+
+} /* anonymous namespace */
+
+ProfileBuffer *profileRegisterThread()
+{
+	std::unique_ptr<ProfileBuffer> buffer = std::make_unique<ProfileBuffer>();
+	std::unique_lock<std::mutex> lock(s_Mutex);
+	if (s_Buffers.empty())
+	{
+		s_CalibrationTicks = profileTicks();
+		s_CalibrationNs = steadyNs();
+	}
+	buffer->ThreadId = (uint32_t)s_Buffers.size();
+	s_Buffers.push_back(std::move(buffer));
+	ProfileThreadBuffer = s_Buffers.back().get();
+	return ProfileThreadBuffer;
+}
+
+ProfileCapture profileCapture()
+{
+	std::unique_lock<std::mutex> lock(s_Mutex);
+	ProfileCapture capture;
+	std::unordered_map<std::string_view, uint32_t> names;
+	auto intern = [&](const char *name) -> uint32_t {
+		auto it = names.find(name);
+		if (it != names.end())
+			return it->second;
+		uint32_t index = (uint32_t)capture.Names.size();
+		capture.Names.push_back(name);
+		names[name] = index;
+		return index;
+	};
+
+	struct RawEvent
+	{
+		int64_t Ticks;
+		const char *Name;
+		ProfileEventType Type;
+	};
+	std::vector<std::vector<RawEvent>> threads(s_Buffers.size());
+	int64_t origin = INT64_MAX;
+	for (size_t i = 0; i < s_Buffers.size(); ++i)
+	{
+		ProfileBuffer &buffer = *s_Buffers[i];
+		std::vector<RawEvent> &events = threads[i];
+		uint64_t head = buffer.Head.load(std::memory_order_acquire);
+		uint64_t begin = head > ProfileBufferSize ? head - ProfileBufferSize : 0;
+		events.reserve((size_t)(head - begin));
+		for (uint64_t j = begin; j < head; ++j)
+		{
+			const ProfileBuffer::Event &event = buffer.Events[j & (ProfileBufferSize - 1)];
+			events.push_back({ event.Time.load(std::memory_order_relaxed), event.Name.load(std::memory_order_relaxed), event.Type.load(std::memory_order_relaxed) });
+		}
+
+		// The owning thread may have lapped the copy, and may be writing the slot after the new head
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t lapped = buffer.Head.load(std::memory_order_relaxed);
+		if (lapped + 1 > begin + ProfileBufferSize)
+			events.erase(events.begin(), events.begin() + (ptrdiff_t)std::min<uint64_t>(lapped + 1 - ProfileBufferSize - begin, events.size()));
+		if (!events.empty())
+			origin = std::min(origin, events.front().Ticks);
+	}
+
+	double period = tickPeriod();
+	for (size_t i = 0; i < s_Buffers.size(); ++i)
+	{
+		const ProfileBuffer &buffer = *s_Buffers[i];
+		ProfileCapture::Thread thread;
+		thread.Id = buffer.ThreadId;
+		const char *threadName = buffer.ThreadName.load(std::memory_order_relaxed);
+		thread.Name = threadName ? intern(threadName) : ProfileCapture::NoName;
+		thread.Events.reserve(threads[i].size());
+		int depth = 0;
+		for (const RawEvent &event : threads[i])
+		{
+			if (event.Type == ProfileEventType::End)
+			{
+				if (!depth)
+					continue; // Began before the oldest kept event
+				--depth;
+			}
+			else if (event.Type == ProfileEventType::Begin)
+			{
+				++depth;
+			}
+			int64_t time = (int64_t)((double)(event.Ticks - origin) * period);
+			thread.Events.push_back({ time, event.Name ? intern(event.Name) : 0, event.Type });
+		}
+		capture.Threads.push_back(std::move(thread));
+	}
+	return capture;
+}
+
+void writeChromeTrace(std::FILE *f, const ProfileCapture &capture)
+{
+	fmt::print(f, "{{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	bool first = true;
+	auto separate = [&]() -> void {
+		fputs(first ? "\n" : ",\n", f);
+		first = false;
+	};
+	for (const ProfileCapture::Thread &thread : capture.Threads)
+	{
+		if (thread.Name != ProfileCapture::NoName)
+		{
+			separate();
+			fmt::print(f, "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":", thread.Id);
+			writeJsonString(f, capture.Names[thread.Name]);
+			fputs("}}", f);
+		}
+		for (const ProfileCapture::Event &event : thread.Events)
+		{
+			// Microseconds, with nanoseconds as the fraction
+			separate();
+			switch (event.Type)
+			{
+			case ProfileEventType::Begin:
+				fputs("{\"name\":", f);
+				writeJsonString(f, capture.Names[event.Name]);
+				fmt::print(f, ",\"ph\":\"B\",\"ts\":{}.{:03},\"pid\":1,\"tid\":{}}}", event.Time / 1000, event.Time % 1000, thread.Id);
+				break;
+			case ProfileEventType::End:
+				fmt::print(f, "{{\"ph\":\"E\",\"ts\":{}.{:03},\"pid\":1,\"tid\":{}}}", event.Time / 1000, event.Time % 1000, thread.Id);
+				break;
+			case ProfileEventType::Frame:
+				fputs("{\"name\":", f);
+				writeJsonString(f, capture.Names[event.Name]);
+				fmt::print(f, ",\"ph\":\"i\",\"s\":\"g\",\"ts\":{}.{:03},\"pid\":1,\"tid\":{}}}", event.Time / 1000, event.Time % 1000, thread.Id);
+				break;
+			}
+		}
+	}
+	fputs("\n]}\n", f);
+}
+
+// Little endian, names first, then each thread with its events as a varint of
+// the nanoseconds since the previous event and a varint of the name and type
+void writeProfileBinary(std::FILE *f, const ProfileCapture &capture)
+{
+	writeU32(f, BinaryMagic);
+	writeU32(f, BinaryVersion);
+	writeU32(f, (uint32_t)capture.Names.size());
+	for (const std::string &name : capture.Names)
+	{
+		writeU32(f, (uint32_t)name.size());
+		fwrite(name.data(), 1, name.size(), f);
+	}
+	writeU32(f, (uint32_t)capture.Threads.size());
+	for (const ProfileCapture::Thread &thread : capture.Threads)
+	{
+		writeU32(f, thread.Id);
+		writeU32(f, thread.Name);
+		writeU32(f, (uint32_t)thread.Events.size());
+		int64_t time = 0;
+		for (const ProfileCapture::Event &event : thread.Events)
+		{
+			writeVarint(f, (uint64_t)(event.Time - time));
+			time = event.Time;
+			uint64_t name = event.Type == ProfileEventType::End ? 0 : (uint64_t)event.Name + 1;
+			writeVarint(f, (name << 2) | (uint64_t)event.Type);
+		}
+	}
+}
+
+ProfileCapture readProfileBinary(std::FILE *f)
+{
+	if (readU32(f) != BinaryMagic)
+		GAME_THROW(Exception("Not a profile"sv, 1));
+	if (readU32(f) != BinaryVersion)
+		GAME_THROW(Exception("Unsupported profile version"sv, 1));
+	ProfileCapture capture;
+	uint32_t nameCount = readU32(f);
+	for (uint32_t i = 0; i < nameCount; ++i)
+	{
+		std::string name(readU32(f), '\0');
+		if (fread(name.data(), 1, name.size(), f) != name.size())
+			GAME_THROW(Exception("Truncated profile"sv, 1));
+		capture.Names.push_back(std::move(name));
+	}
+	uint32_t threadCount = readU32(f);
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		ProfileCapture::Thread thread;
+		thread.Id = readU32(f);
+		thread.Name = readU32(f);
+		if (thread.Name != ProfileCapture::NoName && thread.Name >= nameCount)
+			GAME_THROW(Exception("Invalid profile"sv, 1));
+		uint32_t eventCount = readU32(f);
+		int64_t time = 0;
+		for (uint32_t j = 0; j < eventCount; ++j)
+		{
+			time += (int64_t)readVarint(f);
+			uint64_t v = readVarint(f);
+			ProfileEventType type = (ProfileEventType)(v & 3);
+			uint64_t name = v >> 2;
+			if (type > ProfileEventType::Frame || (type != ProfileEventType::End && (!name || name > nameCount)))
+				GAME_THROW(Exception("Invalid profile"sv, 1));
+			thread.Events.push_back({ time, name ? (uint32_t)(name - 1) : 0, type });
+		}
+		capture.Threads.push_back(std::move(thread));
+	}
+	return capture;
+}
+
+void writeProfile(const char *path, const ProfileCapture &capture)
+{
+	std::FILE *f = fopen(path, "wb");
+	if (!f)
+		GAME_THROW(Exception(fmt::format("Failed to open `{}`", path)));
+	GAME_FINALLY([&]() -> void { fclose(f); });
+	std::string_view p = path;
+	if (p.size() >= 5 && p.substr(p.size() - 5) == ".json"sv)
+		writeChromeTrace(f, capture);
+	else
+		writeProfileBinary(f, capture);
+	if (ferror(f))
+		GAME_THROW(Exception(fmt::format("Failed to write `{}`", path)));
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,207 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+CPU scope profiler.
+`GAME_PROFILE_SCOPE("name")` records the begin and end time of the enclosing
+scope into a ring buffer owned by the calling thread, so recording takes no
+lock and never allocates after the first event of a thread. Each thread keeps
+the latest `ProfileBufferSize` events, older events are overwritten.
+`GAME_PROFILE_FRAME()` marks the start of a frame, and `GAME_PROFILE_THREAD`
+names the calling thread in the capture.
+
+Times are read from the time stamp counter where there is one, which is
+assumed to be invariant and in sync across cores, and are converted to
+nanoseconds against the steady clock when captured.
+
+A capture copies the buffers of all threads, and can be written as Chrome
+trace JSON, for chrome://tracing or Perfetto, or as a compact binary that
+`game_profile_convert` turns into JSON later. Capturing while other threads
+record is safe, events that were overwritten during the copy are dropped.
+
+Names must be string literals, or otherwise outlive the capture.
+Building with `GAME_NO_PROFILE` compiles the macros out entirely.
+
+*/
+
+#pragma once
+#ifndef GAME_PROFILER_H
+#define GAME_PROFILER_H
+
+#include "platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#if !defined(GAME_NO_PROFILE)
+#define GAME_PROFILE
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define GAME_PROFILE_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GAME_PROFILE_TSC
+#endif
+
+namespace game {
+
+enum class ProfileEventType : uint32_t
+{
+	Begin,
+	End,
+	Frame,
+};
+
+// Events per thread, a power of two
+constexpr size_t ProfileBufferSize = 1 << 16;
+
+struct ProfileBuffer
+{
+	// Written relaxed by the owning thread only, published through `Head`
+	struct Event
+	{
+		std::atomic<int64_t> Time;
+		std::atomic<const char *> Name;
+		std::atomic<ProfileEventType> Type;
+	};
+
+	Event Events[ProfileBufferSize];
+	std::atomic<uint64_t> Head; // Events recorded since the thread started
+	std::atomic<const char *> ThreadName;
+	uint32_t ThreadId;
+};
+
+// Buffer of the calling thread, null until its first event
+inline thread_local ProfileBuffer *ProfileThreadBuffer = null;
+
+ProfileBuffer *profileRegisterThread();
+
+GAME_FORCE_INLINE ProfileBuffer *profileThreadBuffer()
+{
+	ProfileBuffer *buffer = ProfileThreadBuffer;
+	return buffer ? buffer : profileRegisterThread();
+}
+
+GAME_FORCE_INLINE int64_t profileTicks()
+{
+#ifdef GAME_PROFILE_TSC
+	return (int64_t)__rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+GAME_FORCE_INLINE void profileRecord(ProfileEventType type, const char *name)
+{
+	ProfileBuffer *buffer = profileThreadBuffer();
+	uint64_t head = buffer->Head.load(std::memory_order_relaxed);
+	ProfileBuffer::Event &event = buffer->Events[head & (ProfileBufferSize - 1)];
+	event.Time.store(profileTicks(), std::memory_order_relaxed);
+	event.Name.store(name, std::memory_order_relaxed);
+	event.Type.store(type, std::memory_order_relaxed);
+	buffer->Head.store(head + 1, std::memory_order_release);
+}
+
+class ProfileScope
+{
+public:
+	GAME_FORCE_INLINE ProfileScope(const char *name) { profileRecord(ProfileEventType::Begin, name); }
+	GAME_FORCE_INLINE ~ProfileScope() noexcept { profileRecord(ProfileEventType::End, null); }
+
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope &operator=(const ProfileScope &) = delete;
+
+};
+
+// Frames marked since the start
+inline std::atomic<int64_t> ProfileFrameCount = 0;
+
+inline void profileFrame()
+{
+	ProfileFrameCount.fetch_add(1, std::memory_order_relaxed);
+	profileRecord(ProfileEventType::Frame, "Frame");
+}
+
+inline void profileThread(const char *name)
+{
+	profileThreadBuffer()->ThreadName.store(name, std::memory_order_relaxed);
+}
+
+// Copy of the recorded events, with names interned by their text
+struct ProfileCapture
+{
+	struct Event
+	{
+		int64_t Time; // Nanoseconds since the oldest event in the capture
+		uint32_t Name; // Index into `Names`, unused for the end of a scope
+		ProfileEventType Type;
+	};
+
+	struct Thread
+	{
+		uint32_t Id;
+		uint32_t Name; // Index into `Names`, or `NoName`
+		std::vector<Event> Events;
+	};
+
+	static const uint32_t NoName = ~0u;
+
+	std::vector<std::string> Names;
+	std::vector<Thread> Threads;
+};
+
+// Snapshot of all threads, the ends of scopes that began before the oldest kept event are left out
+ProfileCapture profileCapture();
+
+void writeChromeTrace(std::FILE *f, const ProfileCapture &capture);
+void writeProfileBinary(std::FILE *f, const ProfileCapture &capture);
+ProfileCapture readProfileBinary(std::FILE *f);
+
+// Writes Chrome trace JSON when the path ends with `.json`, or the binary format otherwise
+void writeProfile(const char *path, const ProfileCapture &capture);
+
+} /* namespace game */
+
+#ifdef GAME_PROFILE
+#define GAME_PROFILE_SCOPE(name) ::game::ProfileScope GAME_CONCAT(profileScope__, __COUNTER__)(name)
+#define GAME_PROFILE_FRAME() ::game::profileFrame()
+#define GAME_PROFILE_THREAD(name) ::game::profileThread(name)
+#else
+#define GAME_PROFILE_SCOPE(name) do { } while (false)
+#define GAME_PROFILE_FRAME() do { } while (false)
+#define GAME_PROFILE_THREAD(name) do { } while (false)
+#endif
+
+#endif /* #ifndef GAME_PROFILER_H */
+
+/* end of file */
@@ -0,0 +1,102 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "render_queue.h"
+
+namespace game {
+
+RenderQueue::RenderQueue(int bufferCount)
+{
+	resize(bufferCount);
+}
+
+void RenderQueue::resize(int bufferCount)
+{
+	GAME_DEBUG_ASSERT(bufferCount > 0);
+	m_Buffers.resize(bufferCount);
+}
+
+void RenderQueue::sort(LinearArena &frameArena)
+{
+	// Merge in buffer order, the sort is stable so the result does not depend on timing
+	size_t count = 0;
+	for (const CommandBuffer &buffer : m_Buffers)
+		count += buffer.packets().size();
+	m_Sorted = frameArena.allocate<DrawPacket>(count);
+	m_SortedCount = count;
+	DrawPacket *sorted = m_Sorted;
+	for (const CommandBuffer &buffer : m_Buffers)
+		sorted = std::copy(buffer.packets().begin(), buffer.packets().end(), sorted);
+	if (count < 2)
+		return;
+
+	// Least significant digit first, 8 bits per pass, histograms for all passes in one read
+	size_t histograms[8][256] = { };
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (int pass = 0; pass < 8; ++pass)
+			++histograms[pass][(m_Sorted[i].Key >> (pass * 8)) & 0xFF];
+	}
+	ScratchScope scratch;
+	DrawPacket *src = m_Sorted;
+	DrawPacket *dst = scratch.allocate<DrawPacket>(count);
+	for (int pass = 0; pass < 8; ++pass)
+	{
+		size_t *histogram = histograms[pass];
+		const int shift = pass * 8;
+		if (histogram[(src[0].Key >> shift) & 0xFF] == count)
+			continue; // Same digit everywhere, typically the layer and program bits
+		size_t offset = 0;
+		for (int i = 0; i < 256; ++i)
+		{
+			size_t c = histogram[i];
+			histogram[i] = offset;
+			offset += c;
+		}
+		for (size_t i = 0; i < count; ++i)
+			dst[histogram[(src[i].Key >> shift) & 0xFF]++] = src[i];
+		std::swap(src, dst);
+	}
+	if (src != m_Sorted)
+		std::copy(src, src + count, m_Sorted);
+}
+
+void RenderQueue::submit(Renderer *renderer)
+{
+	for (size_t i = 0; i < m_SortedCount; ++i)
+		renderer->drawMesh(m_Sorted[i].DrawMesh, m_Sorted[i].Constants);
+	m_Sorted = null;
+	m_SortedCount = 0;
+	for (CommandBuffer &buffer : m_Buffers)
+		buffer.reset();
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,125 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Sort-keyed render command queue.
+Draws are recorded as packets with a 64-bit sort key into per-thread
+command buffers, so scene traversal can run on any number of threads.
+Once per frame the buffers are merged, radix sorted on the key, and
+submitted in a single pass on the renderer thread.
+
+Key layout, most significant first:
+layer (8 bits), program (8 bits), mesh index (24 bits), depth (24 bits).
+Sorting groups draws by program and vertex array within a layer.
+
+*/
+
+#pragma once
+#ifndef GAME_RENDER_QUEUE_H
+#define GAME_RENDER_QUEUE_H
+
+#include "platform.h"
+#include "renderer.h"
+#include "arena.h"
+
+#include <vector>
+
+namespace game {
+
+struct DrawPacket
+{
+	uint64_t Key;
+	Mesh DrawMesh;
+	DrawConstants Constants;
+};
+
+// Depth in [0, 1], quantized to the key depth bits, smaller draws first
+inline uint32_t depthKey(float depth)
+{
+	float d = std::min(std::max(depth, 0.0f), 1.0f);
+	return (uint32_t)(d * (float)((1 << 24) - 1));
+}
+
+inline uint64_t makeSortKey(uint8_t layer, uint8_t program, Mesh mesh, uint32_t depth)
+{
+	GAME_DEBUG_ASSERT(depth < (1u << 24));
+	static_assert(HandleIndexBits <= 24);
+	return ((uint64_t)layer << 56)
+		| ((uint64_t)program << 48)
+		| ((uint64_t)mesh.index() << 24)
+		| (uint64_t)(depth & 0xFFFFFF);
+}
+
+// Recorded by a single thread at a time
+class CommandBuffer
+{
+public:
+	inline void draw(uint64_t key, Mesh mesh, const DrawConstants &constants) { m_Packets.push_back({ key, mesh, constants }); }
+	inline void reset() { m_Packets.clear(); }
+
+	inline const std::vector<DrawPacket> &packets() const { return m_Packets; }
+
+private:
+	std::vector<DrawPacket> m_Packets;
+
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue(int bufferCount = 1);
+
+	// One buffer per recording thread, valid until the next resize
+	void resize(int bufferCount);
+	inline int bufferCount() const { return (int)m_Buffers.size(); }
+	inline CommandBuffer &buffer(int i) { return m_Buffers[i]; }
+
+	// Merge and sort all recorded packets, call after recording has finished,
+	// the sorted packets are allocated from the arena and valid until it is reset
+	void sort(LinearArena &frameArena);
+
+	// Submit the sorted packets to the renderer and reset the buffers, on the renderer thread
+	void submit(Renderer *renderer);
+
+	inline const DrawPacket *sorted() const { return m_Sorted; }
+	inline size_t sortedCount() const { return m_SortedCount; }
+
+private:
+	std::vector<CommandBuffer> m_Buffers;
+	DrawPacket *m_Sorted = null;
+	size_t m_SortedCount = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_RENDER_QUEUE_H */
+
+/* end of file */
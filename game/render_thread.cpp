@@ -0,0 +1,247 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "render_thread.h"
+#include "exception.h"
+#include "perf_counters.h"
+
+namespace game {
+
+RenderThread::RenderThread(Renderer *renderer, std::function<void()> releaseContext, int framesInFlight)
+	: m_Renderer(renderer), m_ReleaseContext(std::move(releaseContext)), m_FramesInFlight(std::max(framesInFlight, 1))
+{
+	m_Frames.resize(m_FramesInFlight + 1);
+	m_Tasks.resize(m_Frames.size() * 2); // A frame and a resource call per buffer
+	m_Thread = std::thread(&RenderThread::threadMain, this);
+}
+
+RenderThread::~RenderThread() noexcept
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Exit = true;
+	}
+	m_TaskCondition.notify_one();
+	m_Thread.join();
+}
+
+void RenderThread::threadMain()
+{
+	GAME_PROFILE_THREAD("Render");
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_TaskCondition.wait(lock, [&]() -> bool { return m_Exit || m_TaskCount; });
+			if (!m_TaskCount)
+				return; // Exit once all work is done
+			task = std::move(m_Tasks[m_TaskHead]);
+			m_TaskHead = (m_TaskHead + 1) % m_Tasks.size();
+			--m_TaskCount;
+		}
+		std::exception_ptr ex;
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			ex = std::current_exception();
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			if (ex && !m_Exception)
+				m_Exception = ex;
+			++m_TasksDone;
+		}
+		m_DoneCondition.notify_all();
+	}
+}
+
+void RenderThread::post(std::function<void()> task)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_TaskCount == m_Tasks.size())
+		{
+			// Full, unroll into a larger ring
+			std::vector<std::function<void()>> tasks(m_Tasks.size() * 2);
+			for (size_t i = 0; i < m_TaskCount; ++i)
+				tasks[i] = std::move(m_Tasks[(m_TaskHead + i) % m_Tasks.size()]);
+			m_Tasks.swap(tasks);
+			m_TaskHead = 0;
+		}
+		m_Tasks[(m_TaskHead + m_TaskCount) % m_Tasks.size()] = std::move(task);
+		++m_TaskCount;
+		++m_TasksPosted;
+	}
+	m_TaskCondition.notify_one();
+}
+
+void RenderThread::invoke(std::function<void()> task)
+{
+	post(std::move(task));
+	flush();
+}
+
+void RenderThread::flush()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_DoneCondition.wait(lock, [&]() -> bool { return m_TasksDone == m_TasksPosted; });
+	}
+	rethrow();
+}
+
+void RenderThread::rethrow()
+{
+	std::exception_ptr ex;
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		ex = m_Exception;
+		m_Exception = null;
+	}
+	if (ex)
+		std::rethrow_exception(ex);
+}
+
+void RenderThread::init()
+{
+	invoke([this]() -> void { m_Renderer->init(); });
+}
+
+void RenderThread::release() noexcept
+{
+	try
+	{
+		invoke([this]() -> void {
+			GAME_FINALLY([&]() -> void { m_ReleaseContext(); });
+			m_Renderer->release();
+		});
+	}
+	catch (...)
+	{
+		// Nothing left to report to
+	}
+}
+
+[[nodiscard]] Mesh RenderThread::createMesh(const float *positions, const float *colors, int vertexCount)
+{
+	Mesh mesh;
+	invoke([&]() -> void { mesh = m_Renderer->createMesh(positions, colors, vertexCount); });
+	return mesh;
+}
+
+void RenderThread::destroyMesh(Mesh mesh) noexcept
+{
+	try
+	{
+		// After the frames that still draw it
+		post([this, mesh]() -> void { m_Renderer->destroyMesh(mesh); });
+	}
+	catch (...)
+	{
+		GAME_DEBUG_BREAK();
+	}
+}
+
+void RenderThread::beginFrame(int width, int height, float renderScale)
+{
+	GAME_DEBUG_ASSERT(!m_InFrame);
+	{
+		// The buffer of this frame is free once the frame that used it last is done
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_DoneCondition.wait(lock, [&]() -> bool { return m_FramesDone >= m_FrameIndex - m_FramesInFlight; });
+	}
+	rethrow();
+	Frame &frame = m_Frames[m_FrameIndex % m_Frames.size()];
+	frame.Width = width;
+	frame.Height = height;
+	frame.RenderScale = renderScale;
+	frame.Commands.clear();
+	m_InFrame = true;
+}
+
+void RenderThread::clear(const float color[4])
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+	FrameCommand command = { Mesh(), { color[0], color[1], color[2], color[3] }, { } };
+	m_Frames[m_FrameIndex % m_Frames.size()].Commands.push_back(command);
+}
+
+void RenderThread::drawMesh(Mesh mesh, const DrawConstants &constants)
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+	if (!mesh)
+		GAME_THROW(Exception("Invalid mesh"sv, 1));
+	m_Frames[m_FrameIndex % m_Frames.size()].Commands.push_back({ mesh, { }, constants });
+}
+
+void RenderThread::endFrame()
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+	m_InFrame = false;
+	Frame *frame = &m_Frames[m_FrameIndex % m_Frames.size()];
+	++m_FrameIndex;
+	post([this, frame]() -> void {
+		GAME_FINALLY([&]() -> void {
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			++m_FramesDone;
+		});
+		replayFrame(*frame);
+	});
+}
+
+void RenderThread::replayFrame(Frame &frame)
+{
+	GAME_PROFILE_COUNTED_SCOPE("replayFrame");
+	m_Renderer->beginFrame(frame.Width, frame.Height, frame.RenderScale);
+	for (const FrameCommand &command : frame.Commands)
+	{
+		if (command.Draw)
+			m_Renderer->drawMesh(command.Draw, command.Constants);
+		else
+			m_Renderer->clear(command.ClearColor);
+	}
+	m_Renderer->endFrame();
+	GpuFrameTime gpuTime = m_Renderer->gpuFrameTime();
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_GpuFrameTime = gpuTime;
+}
+
+[[nodiscard]] GpuFrameTime RenderThread::gpuFrameTime()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	return m_GpuFrameTime;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,143 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Runs another renderer on a dedicated render thread.
+Frames are recorded on the calling thread into one of several frame
+buffers, and replayed on the render thread, so the next frame can
+update while the previous one is submitted and presented.
+Resource calls are executed on the render thread in order with
+the frames, and block until done when they return a result.
+
+*/
+
+#pragma once
+#ifndef GAME_RENDER_THREAD_H
+#define GAME_RENDER_THREAD_H
+
+#include "platform.h"
+#include "renderer.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace game {
+
+class RenderThread : public Renderer
+{
+public:
+	// The renderer is owned by the caller, and only used from the render thread while this exists.
+	// The context is released on the render thread after the renderer is released,
+	// it must not be current on any other thread when the renderer is initialized.
+	RenderThread(Renderer *renderer, std::function<void()> releaseContext, int framesInFlight = 2);
+	virtual ~RenderThread() noexcept;
+
+	RenderThread(const RenderThread &other) = delete;
+	RenderThread &operator=(const RenderThread &other) = delete;
+
+	[[nodiscard]] virtual std::string_view name() const override { return m_Renderer->name(); }
+
+	virtual void init() override;
+	virtual void release() noexcept override;
+
+	[[nodiscard]] virtual Mesh createMesh(const float *positions, const float *colors, int vertexCount) override;
+	virtual void destroyMesh(Mesh mesh) noexcept override;
+
+	// Waits only when all frame buffers are in flight
+	virtual void beginFrame(int width, int height, float renderScale) override;
+	virtual void clear(const float color[4]) override;
+	virtual void drawMesh(Mesh mesh, const DrawConstants &constants) override;
+	virtual void endFrame() override;
+
+	// As of the last frame replayed on the render thread
+	[[nodiscard]] virtual GpuFrameTime gpuFrameTime() override;
+
+	// Wait until all queued work is done
+	void flush();
+
+	// Run a task on the render thread, where the context is current, after the queued work, and wait for it
+	void invoke(std::function<void()> task);
+
+	inline int framesInFlight() const { return m_FramesInFlight; }
+
+private:
+	struct FrameCommand
+	{
+		Mesh Draw; // Invalid for clear
+		float ClearColor[4];
+		DrawConstants Constants;
+	};
+
+	struct Frame
+	{
+		int Width;
+		int Height;
+		float RenderScale;
+		std::vector<FrameCommand> Commands;
+	};
+
+	void threadMain();
+	void post(std::function<void()> task);
+	void rethrow();
+	void replayFrame(Frame &frame);
+
+private:
+	Renderer *m_Renderer;
+	std::function<void()> m_ReleaseContext;
+	int m_FramesInFlight;
+
+	std::vector<Frame> m_Frames; // Frames in flight, plus the one being recorded
+	int64_t m_FrameIndex = 0; // Frame being recorded
+	int64_t m_FramesDone = 0;
+	GpuFrameTime m_GpuFrameTime = { -1, 0, 1.0f }; // Under the mutex
+	bool m_InFrame = false;
+
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_TaskCondition;
+	std::condition_variable m_DoneCondition;
+	std::vector<std::function<void()>> m_Tasks; // Ring, grows when full
+	size_t m_TaskHead = 0; // Next task to run
+	size_t m_TaskCount = 0;
+	int64_t m_TasksPosted = 0;
+	int64_t m_TasksDone = 0;
+	std::exception_ptr m_Exception; // First failure on the render thread, rethrown on the calling thread
+	bool m_Exit = false;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_RENDER_THREAD_H */
+
+/* end of file */
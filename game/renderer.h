@@ -0,0 +1,103 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Rendering backend interface used by the game loop.
+The game does not talk to GL directly, so the same
+`init()`, `update()`, `render()`, `release()` sequence
+runs against a GL context, or against no GPU at all.
+
+*/
+
+#pragma once
+#ifndef GAME_RENDERER_H
+#define GAME_RENDERER_H
+
+#include "platform.h"
+#include "handle_pool.h"
+
+namespace game {
+
+// Opaque mesh handle, the default handle is never a valid mesh
+typedef Handle<struct MeshTag> Mesh;
+
+// GPU time of a completed frame, measured some frames after it was submitted
+struct GpuFrameTime
+{
+	int64_t Frame; // Frames since init, -1 until the first measurement
+	int64_t Ns;
+	float RenderScale; // That the frame was rendered at
+};
+
+// Per-draw constants of the vertex color program, laid out as its constant block
+struct DrawConstants
+{
+	float Offset[4]; // Added to the clip space positions of the mesh
+};
+
+// Size the scene is rendered at, the scale is clamped so it never exceeds the frame size
+inline int renderSize(int size, float scale)
+{
+	return std::clamp((int)((float)size * scale + 0.5f), 1, std::max(size, 1));
+}
+
+class Renderer
+{
+public:
+	virtual ~Renderer() noexcept { }
+
+	// Name of the backend, for reporting
+	[[nodiscard]] virtual std::string_view name() const = 0;
+
+	// Create and destroy the backend programs
+	virtual void init() = 0;
+	virtual void release() noexcept = 0;
+
+	// Create a triangle list mesh from float4 positions and float4 linear colors
+	[[nodiscard]] virtual Mesh createMesh(const float *positions, const float *colors, int vertexCount) = 0;
+	virtual void destroyMesh(Mesh mesh) noexcept = 0;
+
+	// Frame, must be called in order, the scene is rendered at the render scale
+	// of the frame size, and upscaled to the frame size when it ends
+	virtual void beginFrame(int width, int height, float renderScale) = 0;
+	virtual void clear(const float color[4]) = 0;
+	virtual void drawMesh(Mesh mesh, const DrawConstants &constants) = 0; // Vertex color program, sRGB output
+	virtual void endFrame() = 0;
+
+	// Most recent measurement
+	[[nodiscard]] virtual GpuFrameTime gpuFrameTime() = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_RENDERER_H */
+
+/* end of file */
@@ -0,0 +1,131 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "resolution_controller.h"
+
+#include <cmath>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+constexpr float ScaleStep = 1.0f / 64.0f; // Scales are quantized, so the viewport doesn't change on every measurement
+constexpr double IntegralLimit = 4.0;
+constexpr double MaxCorrection = 0.5; // Of the pixel count, per measurement
+
+} /* anonymous namespace */
+
+ResolutionController::ResolutionController(int64_t budgetNs, float minScale, float maxScale)
+	: m_Budget(std::max<int64_t>(budgetNs, 0)), m_Kp(0.5f), m_Ki(0.05f), m_Kd(0.05f), m_Target(0.85f), m_Band(0.15f)
+{
+	setScaleRange(minScale, maxScale);
+}
+
+void ResolutionController::setBudget(int64_t ns)
+{
+	m_Budget = std::max<int64_t>(ns, 0);
+	if (!m_Budget)
+		reset();
+}
+
+void ResolutionController::setScaleRange(float minScale, float maxScale)
+{
+	m_MaxScale = std::clamp(maxScale, ScaleStep, 1.0f);
+	m_MinScale = std::clamp(minScale, ScaleStep, m_MaxScale);
+	reset();
+}
+
+void ResolutionController::setGains(float kp, float ki, float kd)
+{
+	m_Kp = kp;
+	m_Ki = ki;
+	m_Kd = kd;
+}
+
+void ResolutionController::setTarget(float target, float band)
+{
+	m_Target = std::clamp(target, 0.1f, 1.0f);
+	m_Band = std::clamp(band, 0.0f, 0.5f);
+}
+
+void ResolutionController::reset()
+{
+	m_Scale = m_MaxScale;
+	m_Area = (double)m_MaxScale * m_MaxScale;
+	m_Integral = 0.0;
+	m_LastError = 0.0;
+}
+
+float ResolutionController::update(const ResolutionSample &sample)
+{
+	m_LastSample = sample;
+	if (!m_Budget || sample.GpuNs < 0 || sample.GpuScale <= 0.0f)
+		return m_Scale;
+
+	// Positive when there is time to spare at the current scale
+	double projected = (double)sample.GpuNs * ((double)m_Scale * m_Scale) / ((double)sample.GpuScale * sample.GpuScale);
+	double target = (double)m_Target * (double)m_Budget;
+	double error = std::clamp((target - projected) / target, -1.0, 1.0);
+	double derivative = error - m_LastError;
+	m_LastError = error;
+
+	if (std::abs(error) <= m_Band)
+	{
+		// Close enough
+		m_Integral *= 0.9;
+		return m_Scale;
+	}
+	if (error < 0.0 && sample.CpuNs >= 0 && (double)sample.CpuNs >= projected)
+	{
+		// CPU bound
+		m_Integral = 0.0;
+		return m_Scale;
+	}
+
+	// No windup against the scale limits
+	const double minArea = (double)m_MinScale * m_MinScale;
+	const double maxArea = (double)m_MaxScale * m_MaxScale;
+	if (!(error > 0.0 && m_Area >= maxArea) && !(error < 0.0 && m_Area <= minArea))
+		m_Integral = std::clamp(m_Integral + error, -IntegralLimit, IntegralLimit);
+
+	double correction = m_Kp * error + m_Ki * m_Integral + m_Kd * derivative;
+	m_Area = std::clamp(m_Area * (1.0 + std::clamp(correction, -MaxCorrection, MaxCorrection)), minArea, maxArea);
+
+	float scale = std::clamp(std::round((float)sqrt(m_Area) / ScaleStep) * ScaleStep, m_MinScale, m_MaxScale);
+	if (scale != m_Scale)
+	{
+		m_Scale = scale;
+		++m_Changes;
+	}
+	return m_Scale;
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,125 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Dynamic resolution controller.
+Picks the render scale of each frame from the measured frame timings,
+so that the GPU time of a frame stays inside the frame budget.
+GPU time is assumed to follow the number of pixels rendered, so each
+measurement, which arrives some frames late, is first projected from
+the scale it was rendered at to the current scale.
+
+The pixel count is corrected by a PID term on the error relative to a
+target somewhat under the budget. Within a band around the target the
+scale holds and the integral bleeds off, so that timing noise doesn't
+keep the resolution moving. The scale is only lowered while the GPU is
+slower than the CPU, as fewer pixels won't speed up a CPU bound frame.
+
+The controller only sees numbers, so the same code runs on live timings
+and on recorded traces.
+
+*/
+
+#pragma once
+#ifndef GAME_RESOLUTION_CONTROLLER_H
+#define GAME_RESOLUTION_CONTROLLER_H
+
+#include "platform.h"
+
+namespace game {
+
+// Timings of one frame
+struct ResolutionSample
+{
+	int64_t CpuNs; // Of this frame, or -1 when unknown
+	int64_t GpuNs; // Of a recent frame, or -1 when there is no new measurement
+	float GpuScale; // Render scale of the frame the GPU time was measured on
+};
+
+class ResolutionController
+{
+public:
+	// A zero budget keeps the maximum scale
+	ResolutionController(int64_t budgetNs = 0, float minScale = 0.5f, float maxScale = 1.0f);
+
+	void setBudget(int64_t ns);
+	inline int64_t budget() const { return m_Budget; }
+
+	void setScaleRange(float minScale, float maxScale);
+	inline float minScale() const { return m_MinScale; }
+	inline float maxScale() const { return m_MaxScale; }
+
+	// Gains on the error relative to the target, per measurement
+	void setGains(float kp, float ki, float kd);
+	inline float kp() const { return m_Kp; }
+	inline float ki() const { return m_Ki; }
+	inline float kd() const { return m_Kd; }
+
+	// Fraction of the budget to aim for, and the relative error within which the scale holds
+	void setTarget(float target, float band);
+	inline float target() const { return m_Target; }
+	inline float band() const { return m_Band; }
+
+	// Feed the timings of a frame, returns the render scale for the next frame
+	float update(const ResolutionSample &sample);
+	inline float scale() const { return m_Scale; }
+
+	// Start over at the maximum scale
+	void reset();
+
+	inline const ResolutionSample &lastSample() const { return m_LastSample; }
+
+	// Times the scale changed since construction
+	inline int64_t changes() const { return m_Changes; }
+
+private:
+	int64_t m_Budget;
+	float m_MinScale;
+	float m_MaxScale;
+	float m_Kp;
+	float m_Ki;
+	float m_Kd;
+	float m_Target;
+	float m_Band;
+
+	float m_Scale;
+	double m_Area; // Fraction of the pixels, unquantized
+	double m_Integral = 0.0;
+	double m_LastError = 0.0;
+	ResolutionSample m_LastSample = { -1, -1, 1.0f };
+	int64_t m_Changes = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_RESOLUTION_CONTROLLER_H */
+
+/* end of file */
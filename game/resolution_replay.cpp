@@ -0,0 +1,197 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Dynamic resolution replay.
+Runs the resolution controller over a recorded timing trace, as written
+by `game_headless --timing-trace`, to tune it offline. Each measured GPU
+time is turned into the cost of the frame at full scale, assuming GPU
+time follows the pixel count, and replayed at the scale the controller
+picks, arriving the given number of frames later as the timer queries do.
+Reports the render scale, the scale changes, and the frames over budget.
+
+Usage: game_resolution_replay TRACE [--budget US] [--latency N] [--min-scale F] [--max-scale F] [--kp F] [--ki F] [--kd F] [--target F] [--band F]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "resolution_controller.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+struct TraceFrame
+{
+	double CpuUs;
+	double FullGpuUs; // At full scale
+};
+
+const char *s_Trace = null;
+int64_t s_Budget = 16667; // Microseconds
+int s_Latency = 2; // Frames until a GPU time is measured
+float s_MinScale = 0.5f;
+float s_MaxScale = 1.0f;
+float s_Kp = -1.0f; // Negative for the controller defaults
+float s_Ki = -1.0f;
+float s_Kd = -1.0f;
+float s_Target = -1.0f;
+float s_Band = -1.0f;
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (arg.substr(0, 2) != "--"sv)
+		{
+			s_Trace = argv[i];
+			continue;
+		}
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--budget"sv)
+			s_Budget = atoll(value);
+		else if (arg == "--latency"sv)
+			s_Latency = atoi(value);
+		else if (arg == "--min-scale"sv)
+			s_MinScale = (float)atof(value);
+		else if (arg == "--max-scale"sv)
+			s_MaxScale = (float)atof(value);
+		else if (arg == "--kp"sv)
+			s_Kp = (float)atof(value);
+		else if (arg == "--ki"sv)
+			s_Ki = (float)atof(value);
+		else if (arg == "--kd"sv)
+			s_Kd = (float)atof(value);
+		else if (arg == "--target"sv)
+			s_Target = (float)atof(value);
+		else if (arg == "--band"sv)
+			s_Band = (float)atof(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (!s_Trace || s_Budget <= 0 || s_Latency < 0 || s_MinScale <= 0.0f || s_MaxScale < s_MinScale)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+std::vector<TraceFrame> loadTrace(const char *path)
+{
+	std::FILE *f = fopen(path, "r");
+	if (!f)
+		GAME_THROW(Exception(fmt::format("Failed to open `{}`", path)));
+	GAME_FINALLY([&]() -> void { fclose(f); });
+	std::vector<TraceFrame> frames;
+	char line[256];
+	while (fgets(line, sizeof(line), f))
+	{
+		double cpu, gpu, scale;
+		if (sscanf(line, "%lf,%lf,%lf", &cpu, &gpu, &scale) != 3 || gpu < 0.0 || scale <= 0.0)
+			continue; // Header
+		frames.push_back({ cpu, gpu / (scale * scale) });
+	}
+	if (frames.empty())
+		GAME_THROW(Exception(fmt::format("No frames in `{}`", path)));
+	return frames;
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+		std::vector<TraceFrame> frames = loadTrace(s_Trace);
+
+		ResolutionController controller(s_Budget * 1000, s_MinScale, s_MaxScale);
+		controller.setGains(s_Kp >= 0.0f ? s_Kp : controller.kp(), s_Ki >= 0.0f ? s_Ki : controller.ki(), s_Kd >= 0.0f ? s_Kd : controller.kd());
+		controller.setTarget(s_Target > 0.0f ? s_Target : controller.target(), s_Band >= 0.0f ? s_Band : controller.band());
+
+		// GPU time and scale of each replayed frame, measured `s_Latency` frames later
+		std::vector<double> gpuUs(frames.size());
+		std::vector<float> scales(frames.size());
+		double scaleTotal = 0.0, gpuTotal = 0.0, fullTotal = 0.0;
+		float scaleMin = s_MaxScale;
+		int overBudget = 0, overBudgetFull = 0;
+		for (size_t i = 0; i < frames.size(); ++i)
+		{
+			scales[i] = controller.scale();
+			gpuUs[i] = frames[i].FullGpuUs * (double)scales[i] * (double)scales[i];
+			scaleTotal += scales[i];
+			scaleMin = std::min(scaleMin, scales[i]);
+			gpuTotal += gpuUs[i];
+			fullTotal += frames[i].FullGpuUs;
+			overBudget += gpuUs[i] > (double)s_Budget ? 1 : 0;
+			overBudgetFull += frames[i].FullGpuUs > (double)s_Budget ? 1 : 0;
+
+			ResolutionSample sample = { (int64_t)(frames[i].CpuUs * 1000.0), -1, 1.0f };
+			if (i >= (size_t)s_Latency)
+			{
+				size_t measured = i - s_Latency;
+				sample.GpuNs = (int64_t)(gpuUs[measured] * 1000.0);
+				sample.GpuScale = scales[measured];
+			}
+			controller.update(sample);
+		}
+
+		double count = (double)frames.size();
+		fmt::print("Trace: {}, frames: {}, budget: {} us, latency: {} frames\n", s_Trace, frames.size(), s_Budget, s_Latency);
+		fmt::print("GPU time (us): mean {:.1f} at full scale, {:.1f} replayed\n", fullTotal / count, gpuTotal / count);
+		fmt::print("Frames over budget: {} at full scale, {} replayed\n", overBudgetFull, overBudget);
+		fmt::print("Render scale: mean {:.3f}, min {:.3f}, changes {}\n", scaleTotal / count, scaleMin, controller.changes());
+		fmt::print("Controller: kp {}, ki {}, kd {}, target {}, band {}\n", controller.kp(), controller.ki(), controller.kd(), controller.target(), controller.band());
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
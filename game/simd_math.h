@@ -0,0 +1,707 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Math types for the engine.
+`Float3`, `Float4` and `Float4x4` are plain storage types with constexpr
+scalar operations, for constants and for data layouts. `Vec4`, `Mat4` and
+`Quat` are the types to compute with, backed by one SIMD register per
+vector, on SSE (with SSE4.1 and FMA when available), NEON, or scalar code.
+
+`Float8` holds eight lanes, one AVX register or two SSE or NEON registers.
+The x8 types store eight vectors as structure of arrays, to transform
+points in batches, one component of eight points per register.
+
+Matrices are column major, and transform column vectors, as in GL.
+
+*/
+
+#pragma once
+#ifndef GAME_SIMD_MATH_H
+#define GAME_SIMD_MATH_H
+
+#include "platform.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GAME_MATH_SSE
+#define GAME_MATH_SSE41
+#define GAME_MATH_AVX
+#if defined(__FMA__) || defined(_MSC_VER)
+#define GAME_MATH_FMA
+#endif
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define GAME_MATH_SSE
+#define GAME_MATH_SSE41
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GAME_MATH_SSE
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define GAME_MATH_NEON
+#endif
+
+namespace game {
+
+/*
+
+Storage types
+
+*/
+
+struct Float3
+{
+	float X, Y, Z;
+
+	constexpr Float3 operator+(const Float3 &o) const { return { X + o.X, Y + o.Y, Z + o.Z }; }
+	constexpr Float3 operator-(const Float3 &o) const { return { X - o.X, Y - o.Y, Z - o.Z }; }
+	constexpr Float3 operator*(float s) const { return { X * s, Y * s, Z * s }; }
+	constexpr Float3 operator-() const { return { -X, -Y, -Z }; }
+	constexpr bool operator==(const Float3 &o) const { return X == o.X && Y == o.Y && Z == o.Z; }
+	constexpr bool operator!=(const Float3 &o) const { return !(*this == o); }
+};
+
+constexpr float dot(const Float3 &a, const Float3 &b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+constexpr Float3 cross(const Float3 &a, const Float3 &b) { return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X }; }
+
+struct Float4
+{
+	float X, Y, Z, W;
+
+	constexpr Float4 operator+(const Float4 &o) const { return { X + o.X, Y + o.Y, Z + o.Z, W + o.W }; }
+	constexpr Float4 operator-(const Float4 &o) const { return { X - o.X, Y - o.Y, Z - o.Z, W - o.W }; }
+	constexpr Float4 operator*(float s) const { return { X * s, Y * s, Z * s, W * s }; }
+	constexpr Float4 operator-() const { return { -X, -Y, -Z, -W }; }
+	constexpr bool operator==(const Float4 &o) const { return X == o.X && Y == o.Y && Z == o.Z && W == o.W; }
+	constexpr bool operator!=(const Float4 &o) const { return !(*this == o); }
+};
+
+constexpr float dot(const Float4 &a, const Float4 &b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z + a.W * b.W; }
+
+struct Float4x4
+{
+	Float4 Columns[4];
+
+	static constexpr Float4x4 identity()
+	{
+		return { { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f }, { 0.f, 0.f, 0.f, 1.f } } };
+	}
+
+	constexpr Float4 operator*(const Float4 &v) const
+	{
+		return Columns[0] * v.X + Columns[1] * v.Y + Columns[2] * v.Z + Columns[3] * v.W;
+	}
+
+	constexpr Float4x4 operator*(const Float4x4 &o) const
+	{
+		return { { *this * o.Columns[0], *this * o.Columns[1], *this * o.Columns[2], *this * o.Columns[3] } };
+	}
+};
+
+/*
+
+Vec4
+
+*/
+
+class Vec4
+{
+public:
+#if defined(GAME_MATH_SSE)
+	typedef __m128 Native;
+#elif defined(GAME_MATH_NEON)
+	typedef float32x4_t Native;
+#else
+	struct Native { float V[4]; };
+#endif
+
+	Vec4() = default;
+	GAME_FORCE_INLINE Vec4(Native v) : m_V(v) { }
+	GAME_FORCE_INLINE explicit Vec4(float s) : m_V(splat(s)) { }
+	GAME_FORCE_INLINE Vec4(float x, float y, float z, float w) : m_V(set(x, y, z, w)) { }
+	GAME_FORCE_INLINE Vec4(const Float4 &v) : Vec4(v.X, v.Y, v.Z, v.W) { }
+	GAME_FORCE_INLINE Vec4(const Float3 &v, float w) : Vec4(v.X, v.Y, v.Z, w) { }
+
+	static GAME_FORCE_INLINE Vec4 zero() { return Vec4(0.0f); }
+
+	// Unaligned
+	static GAME_FORCE_INLINE Vec4 load(const float *p)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_loadu_ps(p);
+#elif defined(GAME_MATH_NEON)
+		return vld1q_f32(p);
+#else
+		return Vec4(p[0], p[1], p[2], p[3]);
+#endif
+	}
+
+	GAME_FORCE_INLINE void store(float *p) const
+	{
+#if defined(GAME_MATH_SSE)
+		_mm_storeu_ps(p, m_V);
+#elif defined(GAME_MATH_NEON)
+		vst1q_f32(p, m_V);
+#else
+		memcpy(p, m_V.V, sizeof(m_V.V));
+#endif
+	}
+
+	GAME_FORCE_INLINE Float4 float4() const
+	{
+		float v[4];
+		store(v);
+		return { v[0], v[1], v[2], v[3] };
+	}
+	GAME_FORCE_INLINE Float3 float3() const { Float4 res = float4(); return { res.X, res.Y, res.Z }; }
+
+	GAME_FORCE_INLINE float x() const
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_cvtss_f32(m_V);
+#elif defined(GAME_MATH_NEON)
+		return vgetq_lane_f32(m_V, 0);
+#else
+		return m_V.V[0];
+#endif
+	}
+
+	GAME_FORCE_INLINE float y() const { return shuffle<1, 1, 1, 1>().x(); }
+	GAME_FORCE_INLINE float z() const { return shuffle<2, 2, 2, 2>().x(); }
+	GAME_FORCE_INLINE float w() const { return shuffle<3, 3, 3, 3>().x(); }
+
+	GAME_FORCE_INLINE Native native() const { return m_V; }
+
+	// Lanes of this vector, in the given order
+	template<int X, int Y, int Z, int W>
+	GAME_FORCE_INLINE Vec4 shuffle() const
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_shuffle_ps(m_V, m_V, _MM_SHUFFLE(W, Z, Y, X));
+#elif defined(GAME_MATH_NEON)
+		float32x4_t r = vdupq_n_f32(vgetq_lane_f32(m_V, X));
+		r = vsetq_lane_f32(vgetq_lane_f32(m_V, Y), r, 1);
+		r = vsetq_lane_f32(vgetq_lane_f32(m_V, Z), r, 2);
+		return vsetq_lane_f32(vgetq_lane_f32(m_V, W), r, 3);
+#else
+		return Vec4(m_V.V[X], m_V.V[Y], m_V.V[Z], m_V.V[W]);
+#endif
+	}
+
+	GAME_FORCE_INLINE Vec4 splatX() const { return shuffle<0, 0, 0, 0>(); }
+	GAME_FORCE_INLINE Vec4 splatY() const { return shuffle<1, 1, 1, 1>(); }
+	GAME_FORCE_INLINE Vec4 splatZ() const { return shuffle<2, 2, 2, 2>(); }
+	GAME_FORCE_INLINE Vec4 splatW() const { return shuffle<3, 3, 3, 3>(); }
+
+	// Replace the w lane
+	GAME_FORCE_INLINE Vec4 withW(float w) const
+	{
+#if defined(GAME_MATH_SSE41)
+		return _mm_blend_ps(m_V, _mm_set1_ps(w), 8);
+#elif defined(GAME_MATH_NEON)
+		return vsetq_lane_f32(w, m_V, 3);
+#else
+		Float4 v = float4();
+		return Vec4(v.X, v.Y, v.Z, w);
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 operator+(Vec4 a, Vec4 b)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_add_ps(a.m_V, b.m_V);
+#elif defined(GAME_MATH_NEON)
+		return vaddq_f32(a.m_V, b.m_V);
+#else
+		return Vec4(a.m_V.V[0] + b.m_V.V[0], a.m_V.V[1] + b.m_V.V[1], a.m_V.V[2] + b.m_V.V[2], a.m_V.V[3] + b.m_V.V[3]);
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 operator-(Vec4 a, Vec4 b)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_sub_ps(a.m_V, b.m_V);
+#elif defined(GAME_MATH_NEON)
+		return vsubq_f32(a.m_V, b.m_V);
+#else
+		return Vec4(a.m_V.V[0] - b.m_V.V[0], a.m_V.V[1] - b.m_V.V[1], a.m_V.V[2] - b.m_V.V[2], a.m_V.V[3] - b.m_V.V[3]);
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 operator*(Vec4 a, Vec4 b)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_mul_ps(a.m_V, b.m_V);
+#elif defined(GAME_MATH_NEON)
+		return vmulq_f32(a.m_V, b.m_V);
+#else
+		return Vec4(a.m_V.V[0] * b.m_V.V[0], a.m_V.V[1] * b.m_V.V[1], a.m_V.V[2] * b.m_V.V[2], a.m_V.V[3] * b.m_V.V[3]);
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 operator/(Vec4 a, Vec4 b)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_div_ps(a.m_V, b.m_V);
+#elif defined(GAME_MATH_NEON)
+		return vdivq_f32(a.m_V, b.m_V);
+#else
+		return Vec4(a.m_V.V[0] / b.m_V.V[0], a.m_V.V[1] / b.m_V.V[1], a.m_V.V[2] / b.m_V.V[2], a.m_V.V[3] / b.m_V.V[3]);
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 operator*(Vec4 a, float s) { return a * Vec4(s); }
+	GAME_FORCE_INLINE friend Vec4 operator*(float s, Vec4 a) { return a * Vec4(s); }
+	GAME_FORCE_INLINE friend Vec4 operator/(Vec4 a, float s) { return a / Vec4(s); }
+	GAME_FORCE_INLINE Vec4 operator-() const { return zero() - *this; }
+
+	GAME_FORCE_INLINE Vec4 &operator+=(Vec4 o) { return *this = *this + o; }
+	GAME_FORCE_INLINE Vec4 &operator-=(Vec4 o) { return *this = *this - o; }
+	GAME_FORCE_INLINE Vec4 &operator*=(Vec4 o) { return *this = *this * o; }
+	GAME_FORCE_INLINE Vec4 &operator*=(float s) { return *this = *this * s; }
+
+	// a * b + c, fused when available
+	GAME_FORCE_INLINE friend Vec4 madd(Vec4 a, Vec4 b, Vec4 c)
+	{
+#if defined(GAME_MATH_FMA)
+		return _mm_fmadd_ps(a.m_V, b.m_V, c.m_V);
+#elif defined(GAME_MATH_NEON)
+		return vfmaq_f32(c.m_V, a.m_V, b.m_V);
+#else
+		return a * b + c;
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 min(Vec4 a, Vec4 b)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_min_ps(a.m_V, b.m_V);
+#elif defined(GAME_MATH_NEON)
+		return vminq_f32(a.m_V, b.m_V);
+#else
+		return Vec4(std::min(a.m_V.V[0], b.m_V.V[0]), std::min(a.m_V.V[1], b.m_V.V[1]), std::min(a.m_V.V[2], b.m_V.V[2]), std::min(a.m_V.V[3], b.m_V.V[3]));
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 max(Vec4 a, Vec4 b)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_max_ps(a.m_V, b.m_V);
+#elif defined(GAME_MATH_NEON)
+		return vmaxq_f32(a.m_V, b.m_V);
+#else
+		return Vec4(std::max(a.m_V.V[0], b.m_V.V[0]), std::max(a.m_V.V[1], b.m_V.V[1]), std::max(a.m_V.V[2], b.m_V.V[2]), std::max(a.m_V.V[3], b.m_V.V[3]));
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 sqrt(Vec4 a)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_sqrt_ps(a.m_V);
+#elif defined(GAME_MATH_NEON)
+		return vsqrtq_f32(a.m_V);
+#else
+		return Vec4(sqrtf(a.m_V.V[0]), sqrtf(a.m_V.V[1]), sqrtf(a.m_V.V[2]), sqrtf(a.m_V.V[3]));
+#endif
+	}
+
+	// Dot products, splat in all lanes
+	GAME_FORCE_INLINE friend Vec4 dot4(Vec4 a, Vec4 b)
+	{
+#if defined(GAME_MATH_SSE41)
+		return _mm_dp_ps(a.m_V, b.m_V, 0xFF);
+#elif defined(GAME_MATH_NEON)
+		return Vec4(vaddvq_f32(vmulq_f32(a.m_V, b.m_V)));
+#else
+		Vec4 m = a * b;
+		Vec4 s = m + m.shuffle<1, 0, 3, 2>();
+		return s + s.shuffle<2, 3, 0, 1>();
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Vec4 dot3(Vec4 a, Vec4 b)
+	{
+#if defined(GAME_MATH_SSE41)
+		return _mm_dp_ps(a.m_V, b.m_V, 0x7F);
+#else
+		Vec4 m = a * b;
+		return m.splatX() + m.splatY() + m.splatZ();
+#endif
+	}
+
+	// Cross product of the xyz lanes, w is zero
+	GAME_FORCE_INLINE friend Vec4 cross3(Vec4 a, Vec4 b)
+	{
+		Vec4 r = a * b.shuffle<1, 2, 0, 3>() - a.shuffle<1, 2, 0, 3>() * b;
+		return r.shuffle<1, 2, 0, 3>();
+	}
+
+	GAME_FORCE_INLINE friend float length3(Vec4 a) { return sqrt(dot3(a, a)).x(); }
+	GAME_FORCE_INLINE friend Vec4 normalize3(Vec4 a) { return a / sqrt(dot3(a, a)); }
+	GAME_FORCE_INLINE friend Vec4 normalize4(Vec4 a) { return a / sqrt(dot4(a, a)); }
+
+	// Linear interpolation, t in all lanes
+	GAME_FORCE_INLINE friend Vec4 lerp(Vec4 a, Vec4 b, float t) { return madd(b - a, Vec4(t), a); }
+
+private:
+	static GAME_FORCE_INLINE Native splat(float s)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_set1_ps(s);
+#elif defined(GAME_MATH_NEON)
+		return vdupq_n_f32(s);
+#else
+		return { { s, s, s, s } };
+#endif
+	}
+
+	static GAME_FORCE_INLINE Native set(float x, float y, float z, float w)
+	{
+#if defined(GAME_MATH_SSE)
+		return _mm_setr_ps(x, y, z, w);
+#elif defined(GAME_MATH_NEON)
+		const float v[4] = { x, y, z, w };
+		return vld1q_f32(v);
+#else
+		return { { x, y, z, w } };
+#endif
+	}
+
+	Native m_V;
+
+};
+
+/*
+
+Quat
+
+*/
+
+class Quat
+{
+public:
+	Quat() = default;
+	GAME_FORCE_INLINE explicit Quat(Vec4 xyzw) : m_V(xyzw) { }
+	GAME_FORCE_INLINE Quat(float x, float y, float z, float w) : m_V(x, y, z, w) { }
+
+	static GAME_FORCE_INLINE Quat identity() { return Quat(0.0f, 0.0f, 0.0f, 1.0f); }
+
+	// Axis must be normalized, angle in radians
+	static GAME_FORCE_INLINE Quat fromAxisAngle(const Float3 &axis, float angle)
+	{
+		float s = sinf(angle * 0.5f);
+		return Quat(axis.X * s, axis.Y * s, axis.Z * s, cosf(angle * 0.5f));
+	}
+
+	GAME_FORCE_INLINE Vec4 vec4() const { return m_V; }
+
+	GAME_FORCE_INLINE Quat conjugate() const { return Quat(m_V * Vec4(-1.0f, -1.0f, -1.0f, 1.0f)); }
+	GAME_FORCE_INLINE Quat normalized() const { return Quat(normalize4(m_V)); }
+
+	// Applies b first, then a
+	GAME_FORCE_INLINE friend Quat operator*(Quat a, Quat b)
+	{
+		// xyz = aw * bv + bw * av + av x bv, w = aw * bw - av . bv
+		Vec4 aw = a.m_V.splatW();
+		Vec4 v = madd(aw, b.m_V, madd(b.m_V.splatW(), a.m_V, cross3(a.m_V, b.m_V)));
+		float w = a.m_V.w() * b.m_V.w() - dot3(a.m_V, b.m_V).x();
+		return Quat(v.withW(w));
+	}
+
+	// Rotate the xyz lanes, w is zero
+	GAME_FORCE_INLINE Vec4 rotate(Vec4 v) const
+	{
+		// v + 2w (q x v) + 2 q x (q x v)
+		Vec4 t = cross3(m_V, v) * 2.0f;
+		return (v + madd(m_V.splatW(), t, cross3(m_V, t))).withW(0.0f);
+	}
+
+	// Normalized linear interpolation along the shortest arc
+	GAME_FORCE_INLINE friend Quat nlerp(Quat a, Quat b, float t)
+	{
+		Vec4 bv = dot4(a.m_V, b.m_V).x() < 0.0f ? -b.m_V : b.m_V;
+		return Quat(normalize4(lerp(a.m_V, bv, t)));
+	}
+
+private:
+	Vec4 m_V;
+
+};
+
+/*
+
+Mat4
+
+*/
+
+class Mat4
+{
+public:
+	Vec4 Columns[4];
+
+	Mat4() = default;
+	GAME_FORCE_INLINE Mat4(Vec4 c0, Vec4 c1, Vec4 c2, Vec4 c3) : Columns { c0, c1, c2, c3 } { }
+	GAME_FORCE_INLINE Mat4(const Float4x4 &m) : Mat4(m.Columns[0], m.Columns[1], m.Columns[2], m.Columns[3]) { }
+
+	GAME_FORCE_INLINE Float4x4 float4x4() const
+	{
+		return { { Columns[0].float4(), Columns[1].float4(), Columns[2].float4(), Columns[3].float4() } };
+	}
+
+	static GAME_FORCE_INLINE Mat4 identity() { return Float4x4::identity(); }
+
+	static GAME_FORCE_INLINE Mat4 translation(const Float3 &t)
+	{
+		return Mat4(Vec4(1.0f, 0.0f, 0.0f, 0.0f), Vec4(0.0f, 1.0f, 0.0f, 0.0f), Vec4(0.0f, 0.0f, 1.0f, 0.0f), Vec4(t, 1.0f));
+	}
+
+	static GAME_FORCE_INLINE Mat4 scale(const Float3 &s)
+	{
+		return Mat4(Vec4(s.X, 0.0f, 0.0f, 0.0f), Vec4(0.0f, s.Y, 0.0f, 0.0f), Vec4(0.0f, 0.0f, s.Z, 0.0f), Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+
+	// Quaternion must be normalized
+	static GAME_FORCE_INLINE Mat4 rotation(Quat q)
+	{
+		Float4 v = q.vec4().float4();
+		float xx = v.X * v.X, yy = v.Y * v.Y, zz = v.Z * v.Z;
+		float xy = v.X * v.Y, xz = v.X * v.Z, yz = v.Y * v.Z;
+		float wx = v.W * v.X, wy = v.W * v.Y, wz = v.W * v.Z;
+		return Mat4(
+			Vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f),
+			Vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f),
+			Vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f),
+			Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+
+	// Right handed, GL clip space with depth in [-1, 1], vertical field of view in radians
+	static GAME_FORCE_INLINE Mat4 perspective(float fovY, float aspect, float zNear, float zFar)
+	{
+		float f = 1.0f / tanf(fovY * 0.5f);
+		float range = 1.0f / (zNear - zFar);
+		return Mat4(
+			Vec4(f / aspect, 0.0f, 0.0f, 0.0f),
+			Vec4(0.0f, f, 0.0f, 0.0f),
+			Vec4(0.0f, 0.0f, (zFar + zNear) * range, -1.0f),
+			Vec4(0.0f, 0.0f, 2.0f * zFar * zNear * range, 0.0f));
+	}
+
+	GAME_FORCE_INLINE friend Vec4 operator*(const Mat4 &m, Vec4 v)
+	{
+		Vec4 r = m.Columns[0] * v.splatX();
+		r = madd(m.Columns[1], v.splatY(), r);
+		r = madd(m.Columns[2], v.splatZ(), r);
+		return madd(m.Columns[3], v.splatW(), r);
+	}
+
+	GAME_FORCE_INLINE friend Mat4 operator*(const Mat4 &a, const Mat4 &b)
+	{
+		return Mat4(a * b.Columns[0], a * b.Columns[1], a * b.Columns[2], a * b.Columns[3]);
+	}
+
+	GAME_FORCE_INLINE Mat4 transposed() const
+	{
+#if defined(GAME_MATH_SSE)
+		__m128 c0 = Columns[0].native(), c1 = Columns[1].native(), c2 = Columns[2].native(), c3 = Columns[3].native();
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		return Mat4(c0, c1, c2, c3);
+#else
+		Float4x4 m = float4x4();
+		return Mat4(
+			Vec4(m.Columns[0].X, m.Columns[1].X, m.Columns[2].X, m.Columns[3].X),
+			Vec4(m.Columns[0].Y, m.Columns[1].Y, m.Columns[2].Y, m.Columns[3].Y),
+			Vec4(m.Columns[0].Z, m.Columns[1].Z, m.Columns[2].Z, m.Columns[3].Z),
+			Vec4(m.Columns[0].W, m.Columns[1].W, m.Columns[2].W, m.Columns[3].W));
+#endif
+	}
+
+};
+
+/*
+
+Float8
+
+*/
+
+class Float8
+{
+public:
+	Float8() = default;
+#if defined(GAME_MATH_AVX)
+	GAME_FORCE_INLINE Float8(__m256 v) : m_V(v) { }
+	GAME_FORCE_INLINE explicit Float8(float s) : m_V(_mm256_set1_ps(s)) { }
+#else
+	GAME_FORCE_INLINE Float8(Vec4 lo, Vec4 hi) : m_Lo(lo), m_Hi(hi) { }
+	GAME_FORCE_INLINE explicit Float8(float s) : m_Lo(s), m_Hi(s) { }
+#endif
+
+	// Unaligned
+	static GAME_FORCE_INLINE Float8 load(const float *p)
+	{
+#if defined(GAME_MATH_AVX)
+		return _mm256_loadu_ps(p);
+#else
+		return Float8(Vec4::load(p), Vec4::load(p + 4));
+#endif
+	}
+
+	GAME_FORCE_INLINE void store(float *p) const
+	{
+#if defined(GAME_MATH_AVX)
+		_mm256_storeu_ps(p, m_V);
+#else
+		m_Lo.store(p);
+		m_Hi.store(p + 4);
+#endif
+	}
+
+#if defined(GAME_MATH_AVX)
+#define GAME_MATH_FLOAT8_OP(op, avx) \
+	GAME_FORCE_INLINE friend Float8 op(Float8 a, Float8 b) { return avx(a.m_V, b.m_V); }
+#else
+#define GAME_MATH_FLOAT8_OP(op, avx) \
+	GAME_FORCE_INLINE friend Float8 op(Float8 a, Float8 b) { return Float8(op(a.m_Lo, b.m_Lo), op(a.m_Hi, b.m_Hi)); }
+#endif
+
+	GAME_MATH_FLOAT8_OP(operator+, _mm256_add_ps)
+	GAME_MATH_FLOAT8_OP(operator-, _mm256_sub_ps)
+	GAME_MATH_FLOAT8_OP(operator*, _mm256_mul_ps)
+	GAME_MATH_FLOAT8_OP(operator/, _mm256_div_ps)
+	GAME_MATH_FLOAT8_OP(min, _mm256_min_ps)
+	GAME_MATH_FLOAT8_OP(max, _mm256_max_ps)
+
+#undef GAME_MATH_FLOAT8_OP
+
+	GAME_FORCE_INLINE friend Float8 madd(Float8 a, Float8 b, Float8 c)
+	{
+#if defined(GAME_MATH_AVX) && defined(GAME_MATH_FMA)
+		return _mm256_fmadd_ps(a.m_V, b.m_V, c.m_V);
+#elif defined(GAME_MATH_AVX)
+		return _mm256_add_ps(_mm256_mul_ps(a.m_V, b.m_V), c.m_V);
+#else
+		return Float8(madd(a.m_Lo, b.m_Lo, c.m_Lo), madd(a.m_Hi, b.m_Hi, c.m_Hi));
+#endif
+	}
+
+	GAME_FORCE_INLINE friend Float8 sqrt(Float8 a)
+	{
+#if defined(GAME_MATH_AVX)
+		return _mm256_sqrt_ps(a.m_V);
+#else
+		return Float8(sqrt(a.m_Lo), sqrt(a.m_Hi));
+#endif
+	}
+
+private:
+#if defined(GAME_MATH_AVX)
+	__m256 m_V;
+#else
+	Vec4 m_Lo;
+	Vec4 m_Hi;
+#endif
+
+};
+
+/*
+
+x8 batches
+
+*/
+
+struct Vec3x8
+{
+	Float8 X, Y, Z;
+
+	static GAME_FORCE_INLINE Vec3x8 load(const float *x, const float *y, const float *z) { return { Float8::load(x), Float8::load(y), Float8::load(z) }; }
+	GAME_FORCE_INLINE void store(float *x, float *y, float *z) const { X.store(x); Y.store(y); Z.store(z); }
+};
+
+struct Vec4x8
+{
+	Float8 X, Y, Z, W;
+
+	static GAME_FORCE_INLINE Vec4x8 load(const float *x, const float *y, const float *z, const float *w) { return { Float8::load(x), Float8::load(y), Float8::load(z), Float8::load(w) }; }
+	GAME_FORCE_INLINE void store(float *x, float *y, float *z, float *w) const { X.store(x); Y.store(y); Z.store(z); W.store(w); }
+};
+
+GAME_FORCE_INLINE Float8 dot(const Vec3x8 &a, const Vec3x8 &b) { return madd(a.X, b.X, madd(a.Y, b.Y, a.Z * b.Z)); }
+
+// Matrix broadcast to eight lanes per element, splat once per batch loop
+struct Mat4x8
+{
+	Float8 M[4][4]; // Column, row
+
+	GAME_FORCE_INLINE Mat4x8(const Mat4 &m)
+	{
+		Float4x4 f = m.float4x4();
+		for (int c = 0; c < 4; ++c)
+		{
+			const Float4 &col = f.Columns[c];
+			M[c][0] = Float8(col.X);
+			M[c][1] = Float8(col.Y);
+			M[c][2] = Float8(col.Z);
+			M[c][3] = Float8(col.W);
+		}
+	}
+};
+
+// Transform eight points with w = 1
+GAME_FORCE_INLINE Vec4x8 transformPoints(const Mat4x8 &m, const Vec3x8 &p)
+{
+	auto row = [&](int r) { return madd(m.M[0][r], p.X, madd(m.M[1][r], p.Y, madd(m.M[2][r], p.Z, m.M[3][r]))); };
+	return { row(0), row(1), row(2), row(3) };
+}
+
+// Transform points stored as arrays of x, y and z, with w = 1
+inline void transformPoints(const Mat4 &m, const float *x, const float *y, const float *z,
+	float *outX, float *outY, float *outZ, float *outW, size_t count)
+{
+	const Mat4x8 m8(m);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		transformPoints(m8, Vec3x8::load(x + i, y + i, z + i)).store(outX + i, outY + i, outZ + i, outW + i);
+	for (; i < count; ++i)
+	{
+		Float4 r = (m * Vec4(x[i], y[i], z[i], 1.0f)).float4();
+		outX[i] = r.X;
+		outY[i] = r.Y;
+		outZ[i] = r.Z;
+		outW[i] = r.W;
+	}
+}
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_SIMD_MATH_H */
+
+/* end of file */
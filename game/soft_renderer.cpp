@@ -0,0 +1,882 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "soft_renderer.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GAME_SOFT_SSE2
+#endif
+
+namespace game {
+
+struct SoftRenderer::Primitive
+{
+	int32_t MinX, MinY, MaxX, MaxY; // Pixel bounds, exclusive maximum
+	int32_t A[3], B[3]; // Edge function steps per pixel
+	int64_t C[3]; // Edge function at pixel (0, 0), including the fill rule bias
+	float Planes[5][3]; // 1/w and color/w, value at (MinX, MinY), x step, y step
+	uint32_t ClearColor;
+	bool Clear;
+};
+
+namespace /* anonymous */ {
+
+constexpr int SubPixelBits = 4;
+constexpr int SubPixel = 1 << SubPixelBits;
+constexpr int TileShift = 6;
+constexpr int TileSize = 1 << TileShift;
+constexpr int MaxCoord = 1 << 14; // Maximum window coordinate after guard band clipping, keeps partial edge functions within 32 bits
+
+enum Phase
+{
+	SetupPhase = 1,
+	RasterPhase = 2,
+	UpscalePhase = 3,
+};
+
+constexpr int UpscaleRowBlock = 16;
+
+// Interpolate RGBA8 by an 8 bit weight, two channels at a time
+inline uint32_t lerpRgba8(uint32_t a, uint32_t b, uint32_t f)
+{
+	uint32_t rb = (((a & 0xFF00FF) * (256 - f) + (b & 0xFF00FF) * f) >> 8) & 0xFF00FF;
+	uint32_t ga = ((((a >> 8) & 0xFF00FF) * (256 - f) + ((b >> 8) & 0xFF00FF) * f) >> 8) & 0xFF00FF;
+	return rb | (ga << 8);
+}
+
+// Source texel and weight of the next one for bilinear filtering, at texel centers
+inline void upscaleTap(int dst, int dstSize, int srcSize, int32_t &src, uint32_t &weight)
+{
+	int64_t pos = (((int64_t)dst * 2 + 1) * srcSize * 256) / ((int64_t)dstSize * 2) - 128; // 8 bit fixed point
+	pos = std::clamp<int64_t>(pos, 0, (int64_t)(srcSize - 1) * 256);
+	src = (int32_t)(pos >> 8);
+	weight = src + 1 < srcSize ? (uint32_t)(pos & 0xFF) : 0;
+}
+
+/*
+
+Lanes
+
+*/
+
+#if defined(__AVX2__)
+
+constexpr int Lanes = 8;
+typedef __m256i VecI;
+typedef __m256 VecF;
+
+GAME_FORCE_INLINE VecI setI(int32_t v) { return _mm256_set1_epi32(v); }
+GAME_FORCE_INLINE VecI iotaI() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+GAME_FORCE_INLINE VecI addI(VecI a, VecI b) { return _mm256_add_epi32(a, b); }
+GAME_FORCE_INLINE VecI mulLanesI(int32_t a) { return _mm256_mullo_epi32(_mm256_set1_epi32(a), iotaI()); }
+GAME_FORCE_INLINE VecI andI(VecI a, VecI b) { return _mm256_and_si256(a, b); }
+GAME_FORCE_INLINE VecI orI(VecI a, VecI b) { return _mm256_or_si256(a, b); }
+GAME_FORCE_INLINE VecI andNotI(VecI mask, VecI a) { return _mm256_andnot_si256(mask, a); }
+GAME_FORCE_INLINE VecI gtI(VecI a, VecI b) { return _mm256_cmpgt_epi32(a, b); }
+GAME_FORCE_INLINE VecI shlI(VecI a, int n) { return _mm256_slli_epi32(a, n); }
+GAME_FORCE_INLINE bool anyI(VecI mask) { return !_mm256_testz_si256(mask, mask); }
+GAME_FORCE_INLINE VecI loadI(const uint32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+GAME_FORCE_INLINE void storeI(uint32_t *p, VecI v) { _mm256_storeu_si256((__m256i *)p, v); }
+GAME_FORCE_INLINE VecI lutI(const int32_t *lut, VecI idx) { return _mm256_i32gather_epi32(lut, idx, 4); }
+
+GAME_FORCE_INLINE VecF setF(float v) { return _mm256_set1_ps(v); }
+GAME_FORCE_INLINE VecF iotaF() { return _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+GAME_FORCE_INLINE VecF addF(VecF a, VecF b) { return _mm256_add_ps(a, b); }
+GAME_FORCE_INLINE VecF mulF(VecF a, VecF b) { return _mm256_mul_ps(a, b); }
+GAME_FORCE_INLINE VecF divF(VecF a, VecF b) { return _mm256_div_ps(a, b); }
+GAME_FORCE_INLINE VecF clamp01F(VecF a) { return _mm256_min_ps(_mm256_max_ps(a, _mm256_setzero_ps()), _mm256_set1_ps(1.f)); }
+GAME_FORCE_INLINE VecI roundI(VecF a) { return _mm256_cvttps_epi32(_mm256_add_ps(a, _mm256_set1_ps(0.5f))); } // Positive only
+
+#elif defined(GAME_SOFT_SSE2)
+
+constexpr int Lanes = 4;
+typedef __m128i VecI;
+typedef __m128 VecF;
+
+GAME_FORCE_INLINE VecI setI(int32_t v) { return _mm_set1_epi32(v); }
+GAME_FORCE_INLINE VecI iotaI() { return _mm_setr_epi32(0, 1, 2, 3); }
+GAME_FORCE_INLINE VecI addI(VecI a, VecI b) { return _mm_add_epi32(a, b); }
+GAME_FORCE_INLINE VecI mulLanesI(int32_t a) { return _mm_setr_epi32(0, a, a * 2, a * 3); }
+GAME_FORCE_INLINE VecI andI(VecI a, VecI b) { return _mm_and_si128(a, b); }
+GAME_FORCE_INLINE VecI orI(VecI a, VecI b) { return _mm_or_si128(a, b); }
+GAME_FORCE_INLINE VecI andNotI(VecI mask, VecI a) { return _mm_andnot_si128(mask, a); }
+GAME_FORCE_INLINE VecI gtI(VecI a, VecI b) { return _mm_cmpgt_epi32(a, b); }
+GAME_FORCE_INLINE VecI shlI(VecI a, int n) { return _mm_slli_epi32(a, n); }
+GAME_FORCE_INLINE bool anyI(VecI mask) { return _mm_movemask_epi8(mask) != 0; }
+GAME_FORCE_INLINE VecI loadI(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+GAME_FORCE_INLINE void storeI(uint32_t *p, VecI v) { _mm_storeu_si128((__m128i *)p, v); }
+GAME_FORCE_INLINE VecI lutI(const int32_t *lut, VecI idx)
+{
+	alignas(16) int32_t i[4];
+	_mm_store_si128((__m128i *)i, idx);
+	return _mm_setr_epi32(lut[i[0]], lut[i[1]], lut[i[2]], lut[i[3]]);
+}
+
+GAME_FORCE_INLINE VecF setF(float v) { return _mm_set1_ps(v); }
+GAME_FORCE_INLINE VecF iotaF() { return _mm_setr_ps(0.f, 1.f, 2.f, 3.f); }
+GAME_FORCE_INLINE VecF addF(VecF a, VecF b) { return _mm_add_ps(a, b); }
+GAME_FORCE_INLINE VecF mulF(VecF a, VecF b) { return _mm_mul_ps(a, b); }
+GAME_FORCE_INLINE VecF divF(VecF a, VecF b) { return _mm_div_ps(a, b); }
+GAME_FORCE_INLINE VecF clamp01F(VecF a) { return _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.f)); }
+GAME_FORCE_INLINE VecI roundI(VecF a) { return _mm_cvttps_epi32(_mm_add_ps(a, _mm_set1_ps(0.5f))); } // Positive only
+
+#else
+
+constexpr int Lanes = 1;
+typedef int32_t VecI;
+typedef float VecF;
+
+GAME_FORCE_INLINE VecI setI(int32_t v) { return v; }
+GAME_FORCE_INLINE VecI iotaI() { return 0; }
+GAME_FORCE_INLINE VecI addI(VecI a, VecI b) { return a + b; }
+GAME_FORCE_INLINE VecI mulLanesI(int32_t a) { return 0; }
+GAME_FORCE_INLINE VecI andI(VecI a, VecI b) { return a & b; }
+GAME_FORCE_INLINE VecI orI(VecI a, VecI b) { return a | b; }
+GAME_FORCE_INLINE VecI andNotI(VecI mask, VecI a) { return ~mask & a; }
+GAME_FORCE_INLINE VecI gtI(VecI a, VecI b) { return a > b ? -1 : 0; }
+GAME_FORCE_INLINE VecI shlI(VecI a, int n) { return (int32_t)((uint32_t)a << n); }
+GAME_FORCE_INLINE bool anyI(VecI mask) { return mask != 0; }
+GAME_FORCE_INLINE VecI loadI(const uint32_t *p) { return (int32_t)*p; }
+GAME_FORCE_INLINE void storeI(uint32_t *p, VecI v) { *p = (uint32_t)v; }
+GAME_FORCE_INLINE VecI lutI(const int32_t *lut, VecI idx) { return lut[idx]; }
+
+GAME_FORCE_INLINE VecF setF(float v) { return v; }
+GAME_FORCE_INLINE VecF iotaF() { return 0.f; }
+GAME_FORCE_INLINE VecF addF(VecF a, VecF b) { return a + b; }
+GAME_FORCE_INLINE VecF mulF(VecF a, VecF b) { return a * b; }
+GAME_FORCE_INLINE VecF divF(VecF a, VecF b) { return a / b; }
+GAME_FORCE_INLINE VecF clamp01F(VecF a) { return std::min(std::max(a, 0.f), 1.f); }
+GAME_FORCE_INLINE VecI roundI(VecF a) { return (int32_t)(a + 0.5f); } // Positive only
+
+#endif
+
+/*
+
+Color
+
+*/
+
+constexpr int SrgbLutBits = 12;
+constexpr int SrgbLutSize = 1 << SrgbLutBits;
+
+// Linear to 8-bit sRGB, indexed by the linear value in 12 bits
+const int32_t *srgbLut()
+{
+	static const std::array<int32_t, SrgbLutSize> lut = []() -> std::array<int32_t, SrgbLutSize> {
+		std::array<int32_t, SrgbLutSize> res;
+		for (int i = 0; i < SrgbLutSize; ++i)
+		{
+			double c = (double)i / (double)(SrgbLutSize - 1);
+			double s = c <= 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055;
+			res[i] = (int32_t)floor(s * 255.0 + 0.5);
+		}
+		return res;
+	}();
+	return lut.data();
+}
+
+uint32_t packUnorm(const float color[4])
+{
+	uint32_t res = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		float c = std::min(std::max(color[i], 0.f), 1.f);
+		res |= (uint32_t)(c * 255.f + 0.5f) << (i * 8);
+	}
+	return res;
+}
+
+/*
+
+Clipping
+
+*/
+
+struct ClipVertex
+{
+	float P[4];
+	float C[4];
+};
+
+constexpr int ClipPlanes = 7;
+constexpr int MaxClipVertices = 3 + ClipPlanes;
+constexpr float MinClipW = 1e-5f;
+
+// Signed distance to the clip planes, guard band on x and y, exact on z
+GAME_FORCE_INLINE float clipDistance(const ClipVertex &v, int plane, float guardBand)
+{
+	switch (plane)
+	{
+	case 0: return v.P[3] * guardBand - v.P[0];
+	case 1: return v.P[3] * guardBand + v.P[0];
+	case 2: return v.P[3] * guardBand - v.P[1];
+	case 3: return v.P[3] * guardBand + v.P[1];
+	case 4: return v.P[3] - v.P[2];
+	case 5: return v.P[3] + v.P[2];
+	default: return v.P[3] - MinClipW;
+	}
+}
+
+GAME_FORCE_INLINE int clipCode(const ClipVertex &v, float guardBand)
+{
+	int code = 0;
+	for (int p = 0; p < ClipPlanes; ++p)
+		code |= (clipDistance(v, p, guardBand) < 0.f) << p;
+	return code;
+}
+
+// Sutherland-Hodgman against the planes in the mask, returns the number of polygon vertices
+int clipPolygon(ClipVertex *poly, int count, int planes, float guardBand)
+{
+	ClipVertex temp[MaxClipVertices];
+	ClipVertex *src = poly;
+	ClipVertex *dst = temp;
+	for (int p = 0; p < ClipPlanes && count >= 3; ++p)
+	{
+		if (!(planes & (1 << p)))
+			continue;
+		int res = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			const ClipVertex &a = src[i];
+			const ClipVertex &b = src[(i + 1) % count];
+			float da = clipDistance(a, p, guardBand);
+			float db = clipDistance(b, p, guardBand);
+			if (da >= 0.f)
+				dst[res++] = a;
+			if ((da >= 0.f) != (db >= 0.f))
+			{
+				float t = da / (da - db);
+				ClipVertex &v = dst[res++];
+				for (int j = 0; j < 4; ++j)
+				{
+					v.P[j] = a.P[j] + (b.P[j] - a.P[j]) * t;
+					v.C[j] = a.C[j] + (b.C[j] - a.C[j]) * t;
+				}
+			}
+		}
+		count = res;
+		std::swap(src, dst);
+	}
+	if (src != poly)
+	{
+		for (int i = 0; i < count; ++i)
+			poly[i] = src[i];
+	}
+	return count;
+}
+
+/*
+
+Setup
+
+*/
+
+struct SetupContext
+{
+	int Width;
+	int Height;
+	int TilesX;
+	float GuardBand;
+	std::vector<SoftRenderer::Primitive> *Primitives;
+	std::vector<uint32_t> *Bins; // Per tile
+};
+
+void binPrimitive(const SetupContext &ctx, const SoftRenderer::Primitive &prim, uint32_t index)
+{
+	int tx0 = prim.MinX >> TileShift;
+	int ty0 = prim.MinY >> TileShift;
+	int tx1 = (prim.MaxX - 1) >> TileShift;
+	int ty1 = (prim.MaxY - 1) >> TileShift;
+	for (int ty = ty0; ty <= ty1; ++ty)
+	{
+		int64_t y0 = std::max(ty << TileShift, prim.MinY);
+		int64_t y1 = std::min((ty + 1) << TileShift, prim.MaxY) - 1;
+		for (int tx = tx0; tx <= tx1; ++tx)
+		{
+			// Skip tiles outside of any edge
+			int64_t x0 = std::max(tx << TileShift, prim.MinX);
+			int64_t x1 = std::min((tx + 1) << TileShift, prim.MaxX) - 1;
+			bool outside = false;
+			for (int e = 0; e < 3 && !outside; ++e)
+			{
+				int64_t emax = prim.C[e]
+					+ (int64_t)prim.A[e] * (prim.A[e] > 0 ? x1 : x0)
+					+ (int64_t)prim.B[e] * (prim.B[e] > 0 ? y1 : y0);
+				outside = emax < 0;
+			}
+			if (!outside)
+				ctx.Bins[ty * ctx.TilesX + tx].push_back(index);
+		}
+	}
+}
+
+void setupTriangle(const SetupContext &ctx, const ClipVertex *v0, const ClipVertex *v1, const ClipVertex *v2)
+{
+	const ClipVertex *v[3] = { v0, v1, v2 };
+
+	// Snap window coordinates
+	int64_t x[3], y[3];
+	float q[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		q[i] = 1.f / v[i]->P[3];
+		float xw = (v[i]->P[0] * q[i] + 1.f) * 0.5f * (float)ctx.Width;
+		float yw = (v[i]->P[1] * q[i] + 1.f) * 0.5f * (float)ctx.Height;
+		x[i] = (int64_t)floor(xw * (float)SubPixel + 0.5f);
+		y[i] = (int64_t)floor(yw * (float)SubPixel + 0.5f);
+	}
+
+	// No face culling, flip to counter-clockwise
+	int64_t area = (y[0] - y[1]) * x[2] + (x[1] - x[0]) * y[2] + (x[0] * y[1] - y[0] * x[1]);
+	if (!area)
+		return;
+	if (area < 0)
+	{
+		std::swap(v[1], v[2]);
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(q[1], q[2]);
+		area = -area;
+	}
+
+	// Pixel bounds, pixel centers are at half pixel offsets
+	const int64_t half = SubPixel / 2;
+	SoftRenderer::Primitive prim;
+	prim.MinX = (int32_t)std::max<int64_t>((std::min({ x[0], x[1], x[2] }) - half + SubPixel - 1) >> SubPixelBits, 0);
+	prim.MinY = (int32_t)std::max<int64_t>((std::min({ y[0], y[1], y[2] }) - half + SubPixel - 1) >> SubPixelBits, 0);
+	prim.MaxX = (int32_t)std::min<int64_t>(((std::max({ x[0], x[1], x[2] }) - half) >> SubPixelBits) + 1, ctx.Width);
+	prim.MaxY = (int32_t)std::min<int64_t>(((std::max({ y[0], y[1], y[2] }) - half) >> SubPixelBits) + 1, ctx.Height);
+	if (prim.MinX >= prim.MaxX || prim.MinY >= prim.MaxY)
+		return;
+
+	// Edge functions, edge e is opposite to vertex e
+	int64_t c[3];
+	for (int e = 0; e < 3; ++e)
+	{
+		int i = (e + 1) % 3;
+		int j = (e + 2) % 3;
+		int64_t a = y[i] - y[j];
+		int64_t b = x[j] - x[i];
+		prim.A[e] = (int32_t)(a * SubPixel);
+		prim.B[e] = (int32_t)(b * SubPixel);
+		c[e] = (a + b) * half + x[i] * y[j] - y[i] * x[j];
+		bool topLeft = a > 0 || (a == 0 && b < 0);
+		prim.C[e] = c[e] - (topLeft ? 0 : 1);
+	}
+
+	// Perspective correct attribute planes, relative to the minimum corner
+	double values[5][3];
+	for (int i = 0; i < 3; ++i)
+	{
+		values[0][i] = q[i];
+		for (int j = 0; j < 4; ++j)
+			values[j + 1][i] = (double)v[i]->C[j] * (double)q[i];
+	}
+	double invArea = 1.0 / (double)area;
+	double e0[3];
+	for (int e = 0; e < 3; ++e)
+		e0[e] = (double)(c[e] + (int64_t)prim.A[e] * prim.MinX + (int64_t)prim.B[e] * prim.MinY) * invArea;
+	for (int k = 0; k < 5; ++k)
+	{
+		double p = 0.0, dx = 0.0, dy = 0.0;
+		for (int e = 0; e < 3; ++e)
+		{
+			p += values[k][e] * e0[e];
+			dx += values[k][e] * (double)prim.A[e] * invArea;
+			dy += values[k][e] * (double)prim.B[e] * invArea;
+		}
+		prim.Planes[k][0] = (float)p;
+		prim.Planes[k][1] = (float)dx;
+		prim.Planes[k][2] = (float)dy;
+	}
+	prim.ClearColor = 0;
+	prim.Clear = false;
+
+	uint32_t index = (uint32_t)ctx.Primitives->size();
+	ctx.Primitives->push_back(prim);
+	binPrimitive(ctx, prim, index);
+}
+
+void processTriangle(const SetupContext &ctx, const float *positions, const float *colors, const DrawConstants &constants)
+{
+	ClipVertex poly[MaxClipVertices];
+	int codeAnd = ~0;
+	int codeOr = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		// Vertex shader offsets the position, and passes color through
+		for (int j = 0; j < 4; ++j)
+		{
+			poly[i].P[j] = positions[i * 4 + j] + constants.Offset[j];
+			poly[i].C[j] = colors[i * 4 + j];
+		}
+		int code = clipCode(poly[i], ctx.GuardBand);
+		codeAnd &= code;
+		codeOr |= code;
+	}
+	if (codeAnd)
+		return; // Outside
+	int count = 3;
+	if (codeOr)
+		count = clipPolygon(poly, count, codeOr, ctx.GuardBand);
+	for (int i = 2; i < count; ++i)
+		setupTriangle(ctx, &poly[0], &poly[i - 1], &poly[i]);
+}
+
+/*
+
+Raster
+
+*/
+
+void clearTile(uint32_t *pixels, int stride, int x0, int y0, int x1, int y1, uint32_t color)
+{
+	for (int y = y0; y < y1; ++y)
+	{
+		uint32_t *row = pixels + (ptrdiff_t)y * stride;
+		for (int x = x0; x < x1; ++x)
+			row[x] = color;
+	}
+}
+
+void rasterizeTriangle(uint32_t *pixels, int stride, int tx0, int ty0, int tx1, int ty1, const SoftRenderer::Primitive &prim)
+{
+	int x0 = std::max(tx0, prim.MinX);
+	int y0 = std::max(ty0, prim.MinY);
+	int x1 = std::min(tx1, prim.MaxX);
+	int y1 = std::min(ty1, prim.MaxY);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	// Classify edges over the covered part of the tile,
+	// partially covering edges are within 32 bits in this range
+	int partial[3];
+	int partialCount = 0;
+	for (int e = 0; e < 3; ++e)
+	{
+		int64_t a = prim.A[e];
+		int64_t b = prim.B[e];
+		int64_t emax = prim.C[e] + a * (a > 0 ? x1 - 1 : x0) + b * (b > 0 ? y1 - 1 : y0);
+		if (emax < 0)
+			return;
+		int64_t emin = prim.C[e] + a * (a > 0 ? x0 : x1 - 1) + b * (b > 0 ? y0 : y1 - 1);
+		if (emin < 0)
+			partial[partialCount++] = e;
+	}
+
+	VecI laneA[3];
+	for (int i = 0; i < partialCount; ++i)
+		laneA[i] = mulLanesI(prim.A[partial[i]]);
+
+	// Whole lanes are loaded and stored, start on a lane boundary so they stay
+	// within the tile, tiles are aligned, the next tile may be rasterized meanwhile
+	const int xs = x0 & ~(Lanes - 1);
+
+	const int32_t *lut = srgbLut();
+	const VecI iota = iotaI();
+	const VecF lutScale = setF((float)(SrgbLutSize - 1));
+	const VecF alphaScale = setF(255.f);
+	const VecF fiota = iotaF();
+	VecF dx[5];
+	for (int k = 0; k < 5; ++k)
+		dx[k] = setF(prim.Planes[k][1]);
+
+	for (int y = y0; y < y1; ++y)
+	{
+		uint32_t *row = pixels + (ptrdiff_t)y * stride;
+
+		int32_t edge[3];
+		for (int i = 0; i < partialCount; ++i)
+		{
+			int e = partial[i];
+			edge[i] = (int32_t)(prim.C[e] + (int64_t)prim.A[e] * xs + (int64_t)prim.B[e] * y);
+		}
+
+		float ry = (float)(y - prim.MinY);
+		float rowBase[5];
+		for (int k = 0; k < 5; ++k)
+			rowBase[k] = prim.Planes[k][0] + prim.Planes[k][2] * ry;
+
+		for (int x = xs; x < x1; x += Lanes)
+		{
+			VecI mask = andI(gtI(setI(x1 - x), iota), gtI(iota, setI(x0 - x - 1)));
+			for (int i = 0; i < partialCount; ++i)
+			{
+				mask = andI(mask, gtI(addI(setI(edge[i]), laneA[i]), setI(-1)));
+				edge[i] += prim.A[partial[i]] * Lanes;
+			}
+			if (!anyI(mask))
+				continue;
+
+			// Interpolate
+			VecF rx = addF(setF((float)(x - prim.MinX)), fiota);
+			VecF attr[5];
+			for (int k = 0; k < 5; ++k)
+				attr[k] = addF(setF(rowBase[k]), mulF(dx[k], rx));
+			VecF w = divF(setF(1.f), attr[0]);
+
+			// Output merger, sRGB encode on color, alpha stays linear
+			VecI r = lutI(lut, roundI(mulF(clamp01F(mulF(attr[1], w)), lutScale)));
+			VecI g = lutI(lut, roundI(mulF(clamp01F(mulF(attr[2], w)), lutScale)));
+			VecI b = lutI(lut, roundI(mulF(clamp01F(mulF(attr[3], w)), lutScale)));
+			VecI a = roundI(mulF(clamp01F(mulF(attr[4], w)), alphaScale));
+			VecI color = orI(orI(r, shlI(g, 8)), orI(shlI(b, 16), shlI(a, 24)));
+			VecI old = loadI(&row[x]);
+			storeI(&row[x], orI(andI(mask, color), andNotI(mask, old)));
+		}
+	}
+}
+
+} /* anonymous namespace */
+
+SoftRenderer::SoftRenderer(int threadCount)
+	: m_ThreadCount(threadCount > 0 ? threadCount : std::max((int)std::thread::hardware_concurrency(), 1)),
+	m_NextTile(0)
+{
+	m_Primitives.resize(m_ThreadCount);
+	GAME_FINALLY([&]() -> void {
+		if ((int)m_Threads.size() != m_ThreadCount - 1)
+		{
+			// Failed to start all workers
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Exit = true;
+			}
+			m_StartCondition.notify_all();
+			for (std::thread &thread : m_Threads)
+				thread.join();
+		}
+	});
+	m_Threads.reserve(m_ThreadCount - 1);
+	for (int i = 1; i < m_ThreadCount; ++i)
+		m_Threads.emplace_back(&SoftRenderer::workerMain, this, i);
+}
+
+SoftRenderer::~SoftRenderer() noexcept
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Exit = true;
+	}
+	m_StartCondition.notify_all();
+	for (std::thread &thread : m_Threads)
+		thread.join();
+}
+
+void SoftRenderer::init()
+{
+	srgbLut();
+}
+
+void SoftRenderer::release() noexcept
+{
+	m_Meshes.clear();
+}
+
+[[nodiscard]] Mesh SoftRenderer::createMesh(const float *positions, const float *colors, int vertexCount)
+{
+	GAME_DEBUG_ASSERT(positions && colors && vertexCount > 0);
+	SoftMesh mesh;
+	mesh.Positions.assign(positions, positions + (ptrdiff_t)vertexCount * 4);
+	mesh.Colors.assign(colors, colors + (ptrdiff_t)vertexCount * 4);
+	mesh.VertexCount = vertexCount;
+	return m_Meshes.create(mesh);
+}
+
+void SoftRenderer::destroyMesh(Mesh mesh) noexcept
+{
+	GAME_DEBUG_ASSERT(!m_InFrame);
+	m_Meshes.destroy(mesh);
+}
+
+void SoftRenderer::beginFrame(int width, int height, float renderScale)
+{
+	GAME_DEBUG_ASSERT(!m_InFrame);
+	if (width <= 0 || height <= 0 || width > MaxCoord || height > MaxCoord)
+		GAME_THROW(Exception("Invalid framebuffer size"sv, 1));
+	m_OutputWidth = width;
+	m_OutputHeight = height;
+	m_RenderScale = renderScale;
+	int renderWidth = renderSize(width, renderScale);
+	int renderHeight = renderSize(height, renderScale);
+	bool upscaled = renderWidth != width || renderHeight != height;
+	if (upscaled && (!m_Upscaled || renderWidth != m_Width || width != m_OutputStride || (int)m_Output.size() != width * height))
+	{
+		// Only reallocates when the frame size grows
+		m_OutputStride = width;
+		m_Output.resize((size_t)width * height);
+		m_UpscaleColumns.resize((size_t)width * 2);
+		for (int x = 0; x < width; ++x)
+		{
+			uint32_t weight;
+			upscaleTap(x, width, renderWidth, m_UpscaleColumns[(size_t)x * 2], weight);
+			m_UpscaleColumns[(size_t)x * 2 + 1] = (int32_t)weight;
+		}
+	}
+	m_Upscaled = upscaled;
+	width = renderWidth;
+	height = renderHeight;
+	if (width != m_Width || height != m_Height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_Stride = (width + Lanes - 1) & ~(Lanes - 1); // Whole lanes can be read and written at the end of a row
+		m_TilesX = (width + TileSize - 1) >> TileShift;
+		m_TilesY = (height + TileSize - 1) >> TileShift;
+		m_Pixels.assign((size_t)m_Stride * height, 0);
+		m_Bins.resize((size_t)m_ThreadCount * m_TilesX * m_TilesY);
+	}
+	m_Commands.clear();
+	m_PrimitiveCount = 0;
+	m_InFrame = true;
+}
+
+void SoftRenderer::clear(const float color[4])
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+	m_Commands.push_back({ Mesh(), packUnorm(color), m_PrimitiveCount, { } });
+	++m_PrimitiveCount;
+}
+
+void SoftRenderer::drawMesh(Mesh mesh, const DrawConstants &constants)
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+	const SoftMesh *softMesh = m_Meshes.get(mesh);
+	if (!softMesh)
+		GAME_THROW(Exception("Invalid mesh"sv, 1));
+	int triangles = softMesh->VertexCount / 3;
+	m_Commands.push_back({ mesh, 0, m_PrimitiveCount, constants });
+	m_PrimitiveCount += triangles;
+	m_TriangleCount += triangles;
+}
+
+void SoftRenderer::endFrame()
+{
+	GAME_DEBUG_ASSERT(m_InFrame);
+	m_InFrame = false;
+	auto start = std::chrono::steady_clock::now();
+	runPhase(SetupPhase);
+	m_NextTile = 0;
+	runPhase(RasterPhase);
+	if (m_Upscaled)
+	{
+		m_NextTile = 0;
+		runPhase(UpscalePhase);
+	}
+	int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	m_GpuFrameTime = { m_FrameIndex++, ns, m_RenderScale };
+}
+
+void SoftRenderer::workerMain(int worker)
+{
+	int64_t generation = 0;
+	for (;;)
+	{
+		int phase;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_StartCondition.wait(lock, [&]() -> bool { return m_Exit || m_Generation != generation; });
+			if (m_Exit)
+				return;
+			generation = m_Generation;
+			phase = m_Phase;
+		}
+		std::exception_ptr ex;
+		try
+		{
+			if (phase == SetupPhase)
+				setupPrimitives(worker);
+			else if (phase == RasterPhase)
+				rasterizeTiles(worker);
+			else
+				upscaleRows(worker);
+		}
+		catch (...)
+		{
+			ex = std::current_exception();
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			if (ex && !m_WorkerException)
+				m_WorkerException = ex;
+			if (!--m_Pending)
+				m_DoneCondition.notify_one();
+		}
+	}
+}
+
+void SoftRenderer::runPhase(int phase)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Phase = phase;
+		m_Pending = m_ThreadCount - 1;
+		++m_Generation;
+	}
+	m_StartCondition.notify_all();
+
+	// Calling thread is worker zero
+	std::exception_ptr ex;
+	try
+	{
+		if (phase == SetupPhase)
+			setupPrimitives(0);
+		else if (phase == RasterPhase)
+			rasterizeTiles(0);
+		else
+			upscaleRows(0);
+	}
+	catch (...)
+	{
+		ex = std::current_exception();
+	}
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_DoneCondition.wait(lock, [&]() -> bool { return !m_Pending; });
+	if (!ex && m_WorkerException)
+		ex = m_WorkerException;
+	m_WorkerException = null;
+	if (ex)
+		std::rethrow_exception(ex);
+}
+
+void SoftRenderer::setupPrimitives(int worker)
+{
+	const int tileCount = m_TilesX * m_TilesY;
+	std::vector<Primitive> &primitives = m_Primitives[worker];
+	std::vector<uint32_t> *bins = &m_Bins[(size_t)worker * tileCount];
+	primitives.clear();
+	for (int t = 0; t < tileCount; ++t)
+		bins[t].clear();
+
+	SetupContext ctx;
+	ctx.Width = m_Width;
+	ctx.Height = m_Height;
+	ctx.TilesX = m_TilesX;
+	ctx.GuardBand = std::min(64.f, (float)(MaxCoord * 2) / (float)std::max(m_Width, m_Height) - 1.f);
+	ctx.Primitives = &primitives;
+	ctx.Bins = bins;
+
+	// Contiguous range of the frame primitives, so that the tiles see them in order
+	int64_t begin = m_PrimitiveCount * worker / m_ThreadCount;
+	int64_t end = m_PrimitiveCount * (worker + 1) / m_ThreadCount;
+	if (begin >= end)
+		return;
+	size_t c = std::upper_bound(m_Commands.begin(), m_Commands.end(), begin,
+		[](int64_t i, const Command &command) -> bool { return i < command.First; }) - m_Commands.begin() - 1;
+	for (int64_t i = begin; i < end; ++c)
+	{
+		const Command &command = m_Commands[c];
+		int64_t last = std::min(end, c + 1 < m_Commands.size() ? m_Commands[c + 1].First : m_PrimitiveCount);
+		if (!command.Draw)
+		{
+			Primitive prim = { };
+			prim.MaxX = m_Width;
+			prim.MaxY = m_Height;
+			prim.ClearColor = command.ClearColor;
+			prim.Clear = true;
+			uint32_t index = (uint32_t)primitives.size();
+			primitives.push_back(prim);
+			for (int t = 0; t < tileCount; ++t)
+				bins[t].push_back(index);
+		}
+		else
+		{
+			const SoftMesh &mesh = *m_Meshes.get(command.Draw); // Meshes are not destroyed during a frame
+			for (int64_t tri = i - command.First; tri < last - command.First; ++tri)
+				processTriangle(ctx, &mesh.Positions[tri * 12], &mesh.Colors[tri * 12], command.Constants);
+		}
+		i = last;
+	}
+}
+
+void SoftRenderer::rasterizeTiles(int worker)
+{
+	const int tileCount = m_TilesX * m_TilesY;
+	for (int t = m_NextTile++; t < tileCount; t = m_NextTile++)
+	{
+		int tx0 = (t % m_TilesX) << TileShift;
+		int ty0 = (t / m_TilesX) << TileShift;
+		int tx1 = std::min(tx0 + TileSize, m_Width);
+		int ty1 = std::min(ty0 + TileSize, m_Height);
+		for (int w = 0; w < m_ThreadCount; ++w)
+		{
+			const std::vector<Primitive> &primitives = m_Primitives[w];
+			for (uint32_t index : m_Bins[(size_t)w * tileCount + t])
+			{
+				const Primitive &prim = primitives[index];
+				if (prim.Clear)
+					clearTile(m_Pixels.data(), m_Stride, tx0, ty0, tx1, ty1, prim.ClearColor);
+				else
+					rasterizeTriangle(m_Pixels.data(), m_Stride, tx0, ty0, tx1, ty1, prim);
+			}
+		}
+	}
+}
+
+void SoftRenderer::upscaleRows(int worker)
+{
+	const int blockCount = (m_OutputHeight + UpscaleRowBlock - 1) / UpscaleRowBlock;
+	for (int b = m_NextTile++; b < blockCount; b = m_NextTile++)
+	{
+		int y1 = std::min((b + 1) * UpscaleRowBlock, m_OutputHeight);
+		for (int y = b * UpscaleRowBlock; y < y1; ++y)
+		{
+			int32_t sy;
+			uint32_t fy;
+			upscaleTap(y, m_OutputHeight, m_Height, sy, fy);
+			const uint32_t *row0 = &m_Pixels[(size_t)sy * m_Stride];
+			const uint32_t *row1 = fy ? row0 + m_Stride : row0;
+			uint32_t *dst = &m_Output[(size_t)y * m_OutputStride];
+			for (int x = 0; x < m_OutputWidth; ++x)
+			{
+				int32_t sx = m_UpscaleColumns[(size_t)x * 2];
+				uint32_t fx = (uint32_t)m_UpscaleColumns[(size_t)x * 2 + 1];
+				int32_t sx1 = sx + (fx ? 1 : 0);
+				uint32_t top = lerpRgba8(row0[sx], row0[sx1], fx);
+				uint32_t bottom = lerpRgba8(row1[sx], row1[sx1], fx);
+				dst[x] = lerpRgba8(top, bottom, fy);
+			}
+		}
+	}
+}
+
+} /* namespace game */
+
+/* end of file */
@@ -0,0 +1,167 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Software renderer implementing the vertex color pipeline on the CPU.
+Deterministic reference output, independent of the number of threads.
+
+Triangles are clipped in homogeneous space, set up and binned
+into tiles by all workers, then each tile is rasterized by a single
+worker using fixed point edge functions, so primitive order is kept.
+The framebuffer is RGBA8 with sRGB encoding on draw, rows stored
+from the bottom up, matching what `glReadPixels` returns.
+Frames rendered below the frame size are upscaled bilinearly by all
+workers, one block of rows at a time. The time spent in `endFrame`
+is reported as the GPU frame time.
+
+*/
+
+#pragma once
+#ifndef GAME_SOFT_RENDERER_H
+#define GAME_SOFT_RENDERER_H
+
+#include "platform.h"
+#include "renderer.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+namespace game {
+
+class SoftRenderer : public Renderer
+{
+public:
+	// Zero threads uses one worker per core, including the calling thread
+	SoftRenderer(int threadCount = 0);
+	virtual ~SoftRenderer() noexcept;
+
+	[[nodiscard]] virtual std::string_view name() const override { return "soft"sv; }
+
+	virtual void init() override;
+	virtual void release() noexcept override;
+
+	[[nodiscard]] virtual Mesh createMesh(const float *positions, const float *colors, int vertexCount) override;
+	virtual void destroyMesh(Mesh mesh) noexcept override;
+
+	virtual void beginFrame(int width, int height, float renderScale) override;
+	virtual void clear(const float color[4]) override;
+	virtual void drawMesh(Mesh mesh, const DrawConstants &constants) override;
+	virtual void endFrame() override;
+
+	[[nodiscard]] virtual GpuFrameTime gpuFrameTime() override { return m_GpuFrameTime; }
+
+	// Framebuffer of the last completed frame at the frame size, stride in pixels
+	inline const uint32_t *pixels() const { return m_Upscaled ? m_Output.data() : m_Pixels.data(); }
+	inline int width() const { return m_OutputWidth; }
+	inline int height() const { return m_OutputHeight; }
+	inline int stride() const { return m_Upscaled ? m_OutputStride : m_Stride; }
+
+	inline int threadCount() const { return m_ThreadCount; }
+	inline int64_t triangleCount() const { return m_TriangleCount; }
+
+public:
+	struct Primitive;
+
+private:
+	struct SoftMesh
+	{
+		std::vector<float> Positions;
+		std::vector<float> Colors;
+		int VertexCount;
+	};
+
+	struct Command
+	{
+		Mesh Draw; // Invalid for clear
+		uint32_t ClearColor;
+		int64_t First; // First primitive in the frame
+		DrawConstants Constants;
+	};
+
+	void workerMain(int worker);
+	void runPhase(int phase);
+	void setupPrimitives(int worker);
+	void rasterizeTiles(int worker);
+	void upscaleRows(int worker);
+
+private:
+	int m_ThreadCount;
+	std::vector<std::thread> m_Threads;
+	std::mutex m_Mutex;
+	std::condition_variable m_StartCondition;
+	std::condition_variable m_DoneCondition;
+	int m_Phase = 0;
+	int64_t m_Generation = 0;
+	int m_Pending = 0;
+	bool m_Exit = false;
+	std::exception_ptr m_WorkerException;
+	std::atomic<int> m_NextTile; // Or row block when upscaling
+
+	HandlePool<Mesh, SoftMesh> m_Meshes;
+
+	std::vector<Command> m_Commands;
+	int64_t m_PrimitiveCount = 0; // Clears and input triangles of the frame
+	std::vector<std::vector<Primitive>> m_Primitives; // Per worker, in order
+	std::vector<std::vector<uint32_t>> m_Bins; // Per worker and tile, indices into the worker primitives
+
+	// Render target, at the render scale
+	std::vector<uint32_t> m_Pixels;
+	int m_Width = 0;
+	int m_Height = 0;
+	int m_Stride = 0;
+	int m_TilesX = 0;
+	int m_TilesY = 0;
+	bool m_InFrame = false;
+
+	// Upscaled to the frame size, when the render scale is below one
+	std::vector<uint32_t> m_Output;
+	std::vector<int32_t> m_UpscaleColumns; // Per output column, source column and 8 bit weight of the next
+	int m_OutputWidth = 0;
+	int m_OutputHeight = 0;
+	int m_OutputStride = 0;
+	float m_RenderScale = 1.0f;
+	bool m_Upscaled = false;
+
+	GpuFrameTime m_GpuFrameTime = { -1, 0, 1.0f };
+	int64_t m_FrameIndex = 0;
+
+	int64_t m_TriangleCount = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_SOFT_RENDERER_H */
+
+/* end of file */
@@ -0,0 +1,112 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "stream_ring.h"
+#include "exception.h"
+
+namespace game {
+
+StreamRing::StreamRing(FrameFence &fence) : m_Fence(fence)
+{
+
+}
+
+void StreamRing::init(uint8_t *memory, size_t capacity)
+{
+	GAME_DEBUG_ASSERT(memory && capacity);
+	m_Memory = memory;
+	m_Capacity = capacity;
+	m_Head = 0;
+	m_Tail = 0;
+	m_Regions.clear();
+	m_Regions.reserve(16);
+}
+
+void StreamRing::release() noexcept
+{
+	m_Memory = null;
+	m_Capacity = 0;
+	m_Regions.clear();
+}
+
+[[nodiscard]] StreamAllocation StreamRing::allocate(size_t size, size_t alignment)
+{
+	GAME_DEBUG_ASSERT(m_Memory);
+	GAME_DEBUG_ASSERT(alignment && !(alignment & (alignment - 1)));
+	if (size > m_Capacity)
+		GAME_THROW(Exception("Stream allocation larger than the ring"sv, 1));
+
+	// Align, and skip to the start when the allocation would straddle the end
+	uint64_t position = m_Head;
+	size_t offset = (size_t)(position % m_Capacity);
+	size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+	if (aligned + size > m_Capacity)
+		aligned = m_Capacity;
+	position += aligned - offset;
+	if (aligned == m_Capacity)
+		aligned = 0;
+
+	// Make room by reclaiming completed frames, waiting for the oldest one if needed
+	if (position + size - m_Tail > m_Capacity)
+	{
+		reclaim(m_Fence.completed());
+		while (position + size - m_Tail > m_Capacity)
+		{
+			if (m_Regions.empty() || m_Regions.front().Frame >= m_Fence.frame())
+				GAME_THROW(Exception("Stream ring is too small for one frame"sv, 1));
+			++m_WaitCount;
+			m_Fence.wait(m_Regions.front().Frame);
+			reclaim(m_Fence.completed());
+		}
+	}
+
+	// Track the end of the current frame
+	m_Head = position + size;
+	int64_t frame = m_Fence.frame();
+	if (!m_Regions.empty() && m_Regions.back().Frame == frame)
+		m_Regions.back().End = m_Head;
+	else
+		m_Regions.push_back({ frame, m_Head });
+
+	return { m_Memory + aligned, aligned };
+}
+
+void StreamRing::reclaim(int64_t completed)
+{
+	size_t count = 0;
+	while (count < m_Regions.size() && m_Regions[count].Frame <= completed)
+		m_Tail = m_Regions[count++].End;
+	if (count == m_Regions.size())
+		m_Tail = m_Head; // Also drops padding after the last allocation
+	m_Regions.erase(m_Regions.begin(), m_Regions.begin() + count);
+}
+
+} /* namespace game */
+
+/* end of file */
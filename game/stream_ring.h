@@ -0,0 +1,109 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Ring allocator for data streamed to the GPU every frame.
+Allocations are carved from the head of a fixed block of memory,
+and the space used by a frame is only reused once the fence for that
+frame has completed. When the ring is full, the allocator waits on the
+oldest frame in flight.
+
+The ring only manages offsets in memory owned by its backend,
+either a persistently mapped GL buffer or plain memory.
+
+*/
+
+#pragma once
+#ifndef GAME_STREAM_RING_H
+#define GAME_STREAM_RING_H
+
+#include "platform.h"
+#include "frame_fence.h"
+
+#include <vector>
+
+namespace game {
+
+struct StreamAllocation
+{
+	uint8_t *Data;
+	size_t Offset; // From the start of the memory block
+};
+
+class StreamRing
+{
+public:
+	// Frames are fenced by the caller
+	StreamRing(FrameFence &fence);
+
+	void init(uint8_t *memory, size_t capacity);
+	void release() noexcept;
+
+	// Alignment is of the offset, and must be a power of two, throws when the current frame alone doesn't fit
+	[[nodiscard]] StreamAllocation allocate(size_t size, size_t alignment);
+
+	template<typename T>
+	[[nodiscard]] inline T *allocate(size_t count, size_t *offset) { StreamAllocation res = allocate(sizeof(T) * count, alignof(T)); *offset = res.Offset; return (T *)res.Data; }
+
+	inline size_t capacity() const { return m_Capacity; }
+
+	// Bytes allocated by frames that may still be in flight, including alignment padding
+	inline size_t used() const { return (size_t)(m_Head - m_Tail); }
+
+	// Number of times allocation waited on the GPU
+	inline int64_t waitCount() const { return m_WaitCount; }
+
+private:
+	struct Region
+	{
+		int64_t Frame;
+		uint64_t End; // Head position after the last allocation of the frame
+	};
+
+	void reclaim(int64_t completed);
+
+private:
+	FrameFence &m_Fence;
+	uint8_t *m_Memory = null;
+	size_t m_Capacity = 0;
+
+	// Positions increase forever, the offset is the position modulo the capacity
+	uint64_t m_Head = 0;
+	uint64_t m_Tail = 0;
+	std::vector<Region> m_Regions; // Frames in flight, oldest first
+	int64_t m_WaitCount = 0;
+
+};
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_STREAM_RING_H */
+
+/* end of file */
@@ -0,0 +1,259 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Stream ring benchmark.
+Drives the stream ring over plain memory with a manual frame fence, first
+checking that allocations are aligned, wrap around the end of the ring,
+never overlap frames still in flight, and that a full ring waits on the
+oldest frame in flight. Then reports the cost of an allocation, with the
+GPU lagging a few frames behind.
+
+Usage: game_stream_ring_benchmark [--capacity BYTES] [--allocations N] [--frames N]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "frame_fence.h"
+#include "stream_ring.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+size_t s_Capacity = 1 << 20;
+int s_Allocations = 1000; // Per frame
+int s_Frames = 1000;
+constexpr int64_t Latency = 2; // Frames the GPU lags behind, while benchmarking
+volatile uint8_t s_Sink; // Keeps the writes to the allocations
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--capacity"sv)
+			s_Capacity = (size_t)atoll(value);
+		else if (arg == "--allocations"sv)
+			s_Allocations = atoi(value);
+		else if (arg == "--frames"sv)
+			s_Frames = atoi(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_Capacity < 4096 || s_Allocations <= 0 || s_Frames <= 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+// Print the failed check, and count it
+bool check(bool condition, std::string_view what, int &failures)
+{
+	if (!condition)
+	{
+		if (failures < 10)
+			fmt::print("Failed: {}\n", what);
+		++failures;
+	}
+	return condition;
+}
+
+struct Written
+{
+	size_t Offset;
+	size_t Size;
+	uint8_t Pattern;
+};
+
+struct FrameWrites
+{
+	int64_t Frame;
+	std::vector<Written> Allocations;
+};
+
+// Random sizes and alignments, with the GPU completing frames at random,
+// each allocation is filled with a pattern that must survive until its frame completes
+int checkRing()
+{
+	int failures = 0;
+	ManualFrameFence fence;
+	std::vector<uint8_t> memory(s_Capacity);
+	StreamRing ring(fence);
+	ring.init(memory.data(), memory.size());
+
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<size_t> sizeDist(1, s_Capacity / 64);
+	std::uniform_int_distribution<int> alignDist(0, 8); // 1 to 256 bytes
+	std::uniform_int_distribution<int> countDist(1, 16);
+	std::uniform_int_distribution<int> completeDist(0, 4);
+
+	std::deque<FrameWrites> inFlight; // Frames with allocations that haven't completed, oldest first
+	auto verify = [&](int64_t completed) -> void {
+		while (!inFlight.empty() && inFlight.front().Frame <= completed)
+		{
+			for (const Written &written : inFlight.front().Allocations)
+			{
+				bool intact = true;
+				for (size_t i = 0; i < written.Size; ++i)
+					intact = intact && memory[written.Offset + i] == written.Pattern;
+				check(intact, "allocation overwritten before its frame completed"sv, failures);
+			}
+			inFlight.pop_front();
+		}
+	};
+
+	int64_t wraps = 0;
+	size_t lastOffset = 0;
+	int64_t waitCount = 0;
+	for (int frame = 0; frame < s_Frames; ++frame)
+	{
+		FrameWrites writes = { fence.frame() };
+		int count = countDist(rng);
+		for (int i = 0; i < count; ++i)
+		{
+			size_t size = sizeDist(rng);
+			size_t alignment = (size_t)1 << alignDist(rng);
+			std::vector<int64_t> expected; // Frames a wait would complete, oldest first
+			for (const FrameWrites &f : inFlight)
+				expected.push_back(f.Frame);
+
+			StreamAllocation res = ring.allocate(size, alignment);
+
+			check(!(res.Offset & (alignment - 1)), "offset not aligned"sv, failures);
+			check(res.Data == memory.data() + res.Offset, "pointer doesn't match the offset"sv, failures);
+			check(res.Offset + size <= s_Capacity, "allocation straddles the end"sv, failures);
+			if (res.Offset < lastOffset)
+				++wraps;
+			lastOffset = res.Offset + size;
+
+			// Each wait completes exactly the next oldest frame in flight
+			int64_t waits = ring.waitCount() - waitCount;
+			waitCount = ring.waitCount();
+			if (waits)
+			{
+				if (check(waits <= (int64_t)expected.size(), "waited on a frame that wasn't in flight"sv, failures))
+					check(fence.completed() == expected[(size_t)waits - 1], "didn't wait on the oldest frame in flight"sv, failures);
+				verify(fence.completed());
+			}
+
+			uint8_t pattern = (uint8_t)(frame * 31 + i * 7 + 1);
+			memset(res.Data, pattern, size);
+			writes.Allocations.push_back({ res.Offset, size, pattern });
+		}
+		inFlight.push_back(std::move(writes));
+		fence.endFrame();
+
+		// The GPU completes a few frames at a time, and stalls for longer than the ring holds at times
+		if (frame % 64 < 24)
+			continue;
+		int64_t target = std::min(fence.completed() + completeDist(rng), fence.frame() - 1);
+		if (target > fence.completed())
+		{
+			verify(target);
+			fence.complete(target);
+		}
+	}
+	check(wraps > 0, "allocations never wrapped around"sv, failures);
+	check(waitCount > 0, "allocation never waited on the GPU"sv, failures);
+
+	fmt::print("Checked {} frames, {} wraps, {} waits, {} failures\n", s_Frames, wraps, waitCount, failures);
+	return failures;
+}
+
+// Small allocations, the GPU completing frames a fixed number of frames late
+double measureAllocate(int64_t &waits)
+{
+	ManualFrameFence fence;
+	std::vector<uint8_t> memory(s_Capacity);
+	StreamRing ring(fence);
+	ring.init(memory.data(), memory.size());
+
+	const size_t sizes[] = { 64, 48, 256, 16, 128, 96, 32, 192 };
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < s_Frames; ++frame)
+	{
+		for (int i = 0; i < s_Allocations; ++i)
+		{
+			StreamAllocation res = ring.allocate(sizes[i & 7], 16);
+			res.Data[0] = (uint8_t)i;
+		}
+		fence.endFrame();
+		if (fence.frame() > Latency)
+			fence.complete(fence.frame() - 1 - Latency);
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	s_Sink = memory[0];
+	waits = ring.waitCount();
+	return ns / ((double)s_Frames * (double)s_Allocations);
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+
+		fmt::print("Capacity: {} bytes, allocations: {} per frame, frames: {}\n", s_Capacity, s_Allocations, s_Frames);
+		int failures = checkRing();
+		int64_t waits;
+		double ns = measureAllocate(waits);
+		fmt::print("Allocate: {:.2f} ns, {} waits with the GPU {} frames behind\n", ns, waits, Latency);
+		return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
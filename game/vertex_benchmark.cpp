@@ -0,0 +1,260 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Vertex packer benchmark.
+Checks that the half, snorm16 and unorm8 packers produce the same bytes
+as the scalar reference conversions, and fails the run on a mismatch.
+Then measures the vertices per second converted from float streams into
+several interleaved layouts, and the resulting bytes per vertex.
+
+Usage: game_vertex_benchmark [--vertices N] [--repeat N]
+
+*/
+
+#include "platform.h"
+#include "exception.h"
+#include "vertex_format.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace game {
+
+namespace /* anonymous */ {
+
+int64_t s_VertexCount = 1 << 20;
+int s_Repeat = 5;
+
+void parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+			GAME_THROW(Exception(fmt::format("Missing value for argument `{}`", arg)));
+		const char *value = argv[++i];
+		if (arg == "--vertices"sv)
+			s_VertexCount = atoll(value);
+		else if (arg == "--repeat"sv)
+			s_Repeat = atoi(value);
+		else
+			GAME_THROW(Exception(fmt::format("Unknown argument `{}`", arg)));
+	}
+	if (s_VertexCount <= 0 || s_Repeat <= 0)
+		GAME_THROW(Exception("Invalid arguments"sv, 1));
+}
+
+struct Streams
+{
+	std::vector<float> Positions; // float4
+	std::vector<float> Colors; // float4
+	std::vector<float> Normals; // float3
+};
+
+void fillStreams(Streams &streams)
+{
+	streams.Positions.resize(s_VertexCount * 4);
+	streams.Colors.resize(s_VertexCount * 4);
+	streams.Normals.resize(s_VertexCount * 3);
+	for (int64_t i = 0; i < s_VertexCount; ++i)
+	{
+		float t = (float)i * 0.001f;
+		float *p = &streams.Positions[i * 4];
+		p[0] = sinf(t);
+		p[1] = cosf(t * 1.3f);
+		p[2] = 0.5f;
+		p[3] = 1.0f;
+		float *c = &streams.Colors[i * 4];
+		c[0] = (float)(i & 255) / 255.0f;
+		c[1] = (float)((i >> 8) & 255) / 255.0f;
+		c[2] = 0.25f;
+		c[3] = 1.0f;
+		float *n = &streams.Normals[i * 3];
+		n[0] = sinf(t) * cosf(t * 0.7f);
+		n[1] = sinf(t) * sinf(t * 0.7f);
+		n[2] = cosf(t);
+	}
+}
+
+// Limits, rounding ties, subnormals and specials, then random bit patterns and random values around [-1, 1]
+std::vector<float> checkValues(bool nan)
+{
+	std::vector<float> values = {
+		0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 2.0f, -2.0f,
+		65504.0f, -65504.0f, 65519.99f, 65520.0f, -65520.0f, 1e-8f, -1e-8f,
+		6.1035156e-5f, 6.0975552e-5f, 5.9604645e-8f, 2.9802322e-8f, INFINITY, -INFINITY,
+	};
+	for (int i = 0; i < 256; ++i)
+		values.push_back(((float)i + 0.5f) / 255.0f);
+	for (int i = -1024; i < 1024; ++i)
+		values.push_back(((float)i + 0.5f) / 32767.0f);
+	uint32_t state = 0x9E3779B9u;
+	auto next = [&]() -> uint32_t {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	};
+	for (int i = 0; i < (1 << 16); ++i)
+	{
+		uint32_t bits = next();
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		if (value != value && !nan)
+			value = 0.0f;
+		values.push_back(value);
+		values.push_back((float)(next() >> 8) * (3.0f / (float)(1 << 24)) - 1.5f);
+	}
+	if (nan)
+		values.push_back(NAN);
+	values.resize((values.size() + 3) & ~(size_t)3);
+	return values;
+}
+
+// Pack through the layout and through the scalar reference, and count the values with different bytes
+template<typename T, typename Reference>
+int64_t checkPacker(std::string_view name, VertexEncoding encoding, const std::vector<float> &values, Reference reference)
+{
+	VertexLayout layout;
+	layout.add(0, encoding);
+	GAME_DEBUG_ASSERT(layout.stride() == 4 * sizeof(T));
+	const int64_t vertexCount = (int64_t)values.size() / 4;
+	std::vector<uint8_t> packed((size_t)layout.stride() * vertexCount);
+	const float *sources[1] = { values.data() };
+	packVertices(layout, sources, vertexCount, packed.data());
+
+	int64_t mismatches = 0;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		T expected = reference(values[i]);
+		if (memcmp(&packed[i * sizeof(T)], &expected, sizeof(T)))
+		{
+			if (!mismatches)
+			{
+				T actual;
+				memcpy(&actual, &packed[i * sizeof(T)], sizeof(T));
+				uint32_t bits;
+				memcpy(&bits, &values[i], sizeof(bits));
+				fmt::print(stderr, "FAIL: {} packs {} ({:#010x}) as {:#x}, reference {:#x}\n",
+					name, values[i], bits, (uint32_t)(std::make_unsigned_t<T>)actual, (uint32_t)(std::make_unsigned_t<T>)expected);
+			}
+			++mismatches;
+		}
+	}
+	fmt::print("{}, {} values, {} mismatches\n", name, values.size(), mismatches);
+	return mismatches;
+}
+
+// Best of the repeats, in vertices per second
+double measure(const VertexLayout &layout, const float *const *sources, std::vector<uint8_t> &dst)
+{
+	dst.resize((size_t)layout.stride() * s_VertexCount);
+	double best = 0.0;
+	for (int r = 0; r < s_Repeat; ++r)
+	{
+		auto start = std::chrono::steady_clock::now();
+		packVertices(layout, sources, s_VertexCount, dst.data());
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!r || s < best)
+			best = s;
+	}
+	return (double)s_VertexCount / best;
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		parseArgs(argc, argv);
+
+		// NaN clamps differently in the vector min and max, only the half encoding defines it
+		const std::vector<float> halfValues = checkValues(true);
+		const std::vector<float> normValues = checkValues(false);
+		int64_t mismatches = 0;
+		mismatches += checkPacker<uint16_t>("half4"sv, VertexEncoding::Half4, halfValues, floatToHalf);
+		mismatches += checkPacker<int16_t>("snorm16x4"sv, VertexEncoding::Snorm16x4, normValues, floatToSnorm16);
+		mismatches += checkPacker<uint8_t>("unorm8x4"sv, VertexEncoding::Unorm8x4, normValues, floatToUnorm8);
+		if (mismatches)
+			return EXIT_FAILURE;
+
+		Streams streams;
+		fillStreams(streams);
+		std::vector<uint8_t> dst;
+
+		struct Case
+		{
+			std::string_view Name;
+			VertexLayout Layout;
+			const float *Sources[3];
+		};
+		Case cases[4];
+		cases[0] = { "float4 position, float4 color"sv, VertexLayout(), { streams.Positions.data(), streams.Colors.data() } };
+		cases[0].Layout.add(0, VertexEncoding::Float4).add(1, VertexEncoding::Float4);
+		cases[1] = { "half4 position, srgb8 color"sv, VertexLayout(), { streams.Positions.data(), streams.Colors.data() } };
+		cases[1].Layout.add(0, VertexEncoding::Half4).add(1, VertexEncoding::Srgb8x4);
+		cases[2] = { "snorm16 position, srgb8 color"sv, VertexLayout(), { streams.Positions.data(), streams.Colors.data() } };
+		cases[2].Layout.add(0, VertexEncoding::Snorm16x4).add(1, VertexEncoding::Srgb8x4);
+		cases[3] = { "snorm16 position, unorm8 color, oct normal"sv, VertexLayout(), { streams.Positions.data(), streams.Colors.data(), streams.Normals.data() } };
+		cases[3].Layout.add(0, VertexEncoding::Snorm16x4).add(1, VertexEncoding::Unorm8x4).add(2, VertexEncoding::OctSnorm16x2);
+
+		fmt::print("Vertices: {}, repeat: {}\n", s_VertexCount, s_Repeat);
+		fmt::print("layout, bytes per vertex, million vertices per second\n");
+		for (const Case &c : cases)
+		{
+			double rate = measure(c.Layout, c.Sources, dst);
+			fmt::print("{}, {}, {:.1f}\n", c.Name, c.Layout.stride(), rate * 1e-6);
+		}
+		return EXIT_SUCCESS;
+	}
+	catch (Exception &ex)
+	{
+		fmt::print(stderr, "Fatal Game Exception\n{}\n", ex.what());
+	}
+	catch (...)
+	{
+		fmt::print(stderr, "Fatal Game Exception\nA system exception occured.\n");
+	}
+	return EXIT_FAILURE;
+}
+
+} /* anonymous namespace */
+
+} /* namespace game */
+
+int main(int argc, char **argv)
+{
+	return game::main(argc, argv);
+}
+
+/* end of file */
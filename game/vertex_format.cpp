@@ -0,0 +1,350 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "vertex_format.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GAME_VERTEX_SSE2
+#endif
+
+namespace game {
+
+namespace /* anonymous */ {
+
+// Smallest float bucket, values below encode to zero
+constexpr uint32_t SrgbBucketBase = (127 - 14) << 23;
+constexpr int SrgbBucketShift = 16; // Seven mantissa bits per bucket, spans at most two codes
+constexpr int SrgbBucketCount = (((127 << 23) - SrgbBucketBase) >> SrgbBucketShift) + 1;
+
+// Linear values halfway between consecutive sRGB codes, and the code at the start of each bucket
+struct SrgbTable
+{
+	SrgbTable()
+	{
+		for (int i = 0; i < 255; ++i)
+		{
+			double c = ((double)i + 0.5) / 255.0;
+			Thresholds[i] = (float)(c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+		}
+		Thresholds[255] = INFINITY;
+		for (int b = 0; b < SrgbBucketCount; ++b)
+		{
+			uint32_t bits = SrgbBucketBase + ((uint32_t)b << SrgbBucketShift);
+			float value;
+			memcpy(&value, &bits, sizeof(value));
+			int code = 0;
+			while (value >= Thresholds[code])
+				++code;
+			Buckets[b] = (uint8_t)code;
+		}
+	}
+
+	float Thresholds[256];
+	uint8_t Buckets[SrgbBucketCount];
+};
+
+const SrgbTable s_SrgbTable;
+
+GAME_FORCE_INLINE uint8_t encodeSrgb(float value)
+{
+	// Bucket by the float bits, then one comparison against the next threshold, NaN encodes as zero
+	const float lo = 1.0f / 16384.0f;
+	value = value > lo ? value : lo;
+	value = value < 1.0f ? value : 1.0f;
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	int code = s_SrgbTable.Buckets[(bits - SrgbBucketBase) >> SrgbBucketShift];
+	return (uint8_t)(code + (value >= s_SrgbTable.Thresholds[code]));
+}
+
+GAME_FORCE_INLINE uint8_t encodeUnorm8(float value)
+{
+	return (uint8_t)std::nearbyint(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+}
+
+GAME_FORCE_INLINE int16_t encodeSnorm16(float value)
+{
+	return (int16_t)std::nearbyint(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+#ifdef GAME_VERTEX_SSE2
+
+// Four floats to half, round to nearest even, in the low 16 bits of each lane
+GAME_FORCE_INLINE __m128i halfLanes(__m128 f)
+{
+	const __m128i signMask = _mm_set1_epi32((int)0x80000000u);
+	const __m128i halfMax = _mm_set1_epi32((127 + 16) << 23); // Rounds to infinity from here
+	const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+	const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+	const __m128i normalBias = _mm_set1_epi32(0xFFF - ((127 - 15) << 23));
+
+	__m128 sign = _mm_and_ps(_mm_castsi128_ps(signMask), f);
+	__m128 absF = _mm_andnot_ps(_mm_castsi128_ps(signMask), f);
+	__m128i absI = _mm_castps_si128(absF);
+	__m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+	__m128i isRegular = _mm_cmpgt_epi32(halfMax, absI);
+	__m128i special = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7C00));
+
+	// Subnormal results, rounded by the float addition
+	__m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absI);
+	__m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+	// Normal results, rebias the exponent and round the mantissa to nearest even
+	__m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absI, 31 - 13), 31);
+	__m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absI, normalBias), mantissaOdd), 13);
+
+	__m128i regular = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+	__m128i res = _mm_or_si128(_mm_and_si128(isRegular, regular), _mm_andnot_si128(isRegular, special));
+	return _mm_or_si128(res, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+#endif
+
+void packFloat4(const float *src, int64_t count, uint8_t *dst, uint32_t stride)
+{
+	for (int64_t v = 0; v < count; ++v, src += 4, dst += stride)
+		memcpy(dst, src, sizeof(float) * 4);
+}
+
+void packHalf4(const float *src, int64_t count, uint8_t *dst, uint32_t stride)
+{
+	for (int64_t v = 0; v < count; ++v, src += 4, dst += stride)
+	{
+#ifdef GAME_VERTEX_SSE2
+		__m128i h = halfLanes(_mm_loadu_ps(src));
+		_mm_storel_epi64((__m128i *)dst, _mm_packs_epi32(h, h)); // Negative halves are sign extended, and pack exactly
+#else
+		uint16_t h[4] = { floatToHalf(src[0]), floatToHalf(src[1]), floatToHalf(src[2]), floatToHalf(src[3]) };
+		memcpy(dst, h, sizeof(h));
+#endif
+	}
+}
+
+void packSnorm16x4(const float *src, int64_t count, uint8_t *dst, uint32_t stride)
+{
+#ifdef GAME_VERTEX_SSE2
+	const __m128 lo = _mm_set1_ps(-1.0f);
+	const __m128 hi = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(32767.0f);
+#endif
+	for (int64_t v = 0; v < count; ++v, src += 4, dst += stride)
+	{
+#ifdef GAME_VERTEX_SSE2
+		__m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), lo), hi);
+		__m128i i = _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+		_mm_storel_epi64((__m128i *)dst, _mm_packs_epi32(i, i));
+#else
+		int16_t s[4] = { encodeSnorm16(src[0]), encodeSnorm16(src[1]), encodeSnorm16(src[2]), encodeSnorm16(src[3]) };
+		memcpy(dst, s, sizeof(s));
+#endif
+	}
+}
+
+void packUnorm8x4(const float *src, int64_t count, uint8_t *dst, uint32_t stride)
+{
+#ifdef GAME_VERTEX_SSE2
+	const __m128 scale = _mm_set1_ps(255.0f);
+#endif
+	for (int64_t v = 0; v < count; ++v, src += 4, dst += stride)
+	{
+#ifdef GAME_VERTEX_SSE2
+		__m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		__m128i i = _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+		i = _mm_packs_epi32(i, i);
+		int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+		memcpy(dst, &packed, sizeof(packed));
+#else
+		uint8_t u[4] = { encodeUnorm8(src[0]), encodeUnorm8(src[1]), encodeUnorm8(src[2]), encodeUnorm8(src[3]) };
+		memcpy(dst, u, sizeof(u));
+#endif
+	}
+}
+
+void packSrgb8x4(const float *src, int64_t count, uint8_t *dst, uint32_t stride)
+{
+	for (int64_t v = 0; v < count; ++v, src += 4, dst += stride)
+	{
+		dst[0] = encodeSrgb(src[0]);
+		dst[1] = encodeSrgb(src[1]);
+		dst[2] = encodeSrgb(src[2]);
+		dst[3] = encodeUnorm8(src[3]);
+	}
+}
+
+void packOctSnorm16x2(const float *src, int64_t count, uint8_t *dst, uint32_t stride)
+{
+	for (int64_t v = 0; v < count; ++v, src += 3, dst += stride)
+	{
+		// Project onto the octahedron, and fold the lower half over the diagonals
+		float l1 = fabsf(src[0]) + fabsf(src[1]) + fabsf(src[2]);
+		float inv = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+		float x = src[0] * inv;
+		float y = src[1] * inv;
+		if (src[2] < 0.0f)
+		{
+			float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = fx;
+			y = fy;
+		}
+		int16_t s[2] = { encodeSnorm16(x), encodeSnorm16(y) };
+		memcpy(dst, s, sizeof(s));
+	}
+}
+
+} /* anonymous namespace */
+
+int encodedSize(VertexEncoding encoding)
+{
+	switch (encoding)
+	{
+	case VertexEncoding::Float4:
+		return 16;
+	case VertexEncoding::Half4:
+	case VertexEncoding::Snorm16x4:
+		return 8;
+	case VertexEncoding::Unorm8x4:
+	case VertexEncoding::Srgb8x4:
+	case VertexEncoding::OctSnorm16x2:
+		return 4;
+	}
+	GAME_DEBUG_ASSERT(false);
+	return 0;
+}
+
+int sourceComponents(VertexEncoding encoding)
+{
+	return encoding == VertexEncoding::OctSnorm16x2 ? 3 : 4;
+}
+
+VertexLayout &VertexLayout::add(uint32_t location, VertexEncoding encoding)
+{
+	GAME_DEBUG_ASSERT(m_ElementCount < MaxElements);
+	m_Elements[m_ElementCount++] = { location, encoding, m_Stride };
+	m_Stride += (uint32_t)encodedSize(encoding); // All sizes are multiples of four
+	return *this;
+}
+
+void packVertices(const VertexLayout &layout, const float *const *sources, int64_t vertexCount, void *dst)
+{
+	// One pass per element, each reads its source linearly and writes at the stride
+	const uint32_t stride = layout.stride();
+	for (int e = 0; e < layout.elementCount(); ++e)
+	{
+		const VertexElement &element = layout.element(e);
+		uint8_t *out = (uint8_t *)dst + element.Offset;
+		switch (element.Encoding)
+		{
+		case VertexEncoding::Float4:
+			packFloat4(sources[e], vertexCount, out, stride);
+			break;
+		case VertexEncoding::Half4:
+			packHalf4(sources[e], vertexCount, out, stride);
+			break;
+		case VertexEncoding::Snorm16x4:
+			packSnorm16x4(sources[e], vertexCount, out, stride);
+			break;
+		case VertexEncoding::Unorm8x4:
+			packUnorm8x4(sources[e], vertexCount, out, stride);
+			break;
+		case VertexEncoding::Srgb8x4:
+			packSrgb8x4(sources[e], vertexCount, out, stride);
+			break;
+		case VertexEncoding::OctSnorm16x2:
+			packOctSnorm16x2(sources[e], vertexCount, out, stride);
+			break;
+		}
+	}
+}
+
+bool inSnormRange(const float *values, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!(fabsf(values[i]) <= 1.0f))
+			return false;
+	}
+	return true;
+}
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t f;
+	memcpy(&f, &value, sizeof(f));
+	uint32_t sign = f & 0x80000000u;
+	f ^= sign;
+	uint32_t res;
+	if (f >= ((127 + 16) << 23))
+	{
+		// Infinity or NaN
+		res = f > 0x7F800000u ? 0x7E00 : 0x7C00;
+	}
+	else if (f < ((127 - 14) << 23))
+	{
+		// Subnormal or zero, the float addition rounds the mantissa
+		const uint32_t magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+		float magic;
+		memcpy(&magic, &magicBits, sizeof(magic));
+		float sum;
+		memcpy(&sum, &f, sizeof(sum));
+		sum += magic;
+		memcpy(&res, &sum, sizeof(res));
+		res -= magicBits;
+	}
+	else
+	{
+		uint32_t mantissaOdd = (f >> 13) & 1;
+		f += 0xFFF - ((127 - 15) << 23);
+		f += mantissaOdd;
+		res = f >> 13;
+	}
+	return (uint16_t)(res | (sign >> 16));
+}
+
+uint8_t linearToSrgb8(float value)
+{
+	return encodeSrgb(value);
+}
+
+int16_t floatToSnorm16(float value)
+{
+	return encodeSnorm16(value);
+}
+
+uint8_t floatToUnorm8(float value)
+{
+	return encodeUnorm8(value);
+}
+
+} /* namespace game */
+
+/* end of file */
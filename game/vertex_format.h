@@ -0,0 +1,106 @@
+/*
+
+Copyright (C) 2021  Jan BOON (Kaetemi) <jan.boon@kaetemi.be>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+
+Vertex layout description, and packer for interleaved quantized vertices.
+A layout lists the encoded attributes of one vertex in order, the packer
+converts float source streams into one interleaved stream in that layout.
+
+Colors are encoded to sRGB in 8 bits, and decoded by the vertex shader,
+which keeps 8 bits per channel precise in the darks. Normals are mapped
+onto an octahedron, and stored in two 16-bit components.
+
+*/
+
+#pragma once
+#ifndef GAME_VERTEX_FORMAT_H
+#define GAME_VERTEX_FORMAT_H
+
+#include "platform.h"
+
+namespace game {
+
+enum class VertexEncoding : uint8_t
+{
+	Float4, // 16 bytes
+	Half4, // 8 bytes
+	Snorm16x4, // 8 bytes, source clamped to [-1, 1]
+	Unorm8x4, // 4 bytes, source clamped to [0, 1]
+	Srgb8x4, // 4 bytes, linear color, alpha is not sRGB encoded
+	OctSnorm16x2, // 4 bytes, unit normal from 3 floats
+};
+
+// Encoded bytes, and floats per source vertex
+int encodedSize(VertexEncoding encoding);
+int sourceComponents(VertexEncoding encoding);
+
+struct VertexElement
+{
+	uint32_t Location;
+	VertexEncoding Encoding;
+	uint32_t Offset;
+};
+
+class VertexLayout
+{
+public:
+	static const int MaxElements = 8;
+
+	// Elements are placed in order, at four byte aligned offsets
+	VertexLayout &add(uint32_t location, VertexEncoding encoding);
+
+	inline int elementCount() const { return m_ElementCount; }
+	inline const VertexElement &element(int i) const { return m_Elements[i]; }
+	inline uint32_t stride() const { return m_Stride; }
+
+private:
+	VertexElement m_Elements[MaxElements];
+	int m_ElementCount = 0;
+	uint32_t m_Stride = 0;
+
+};
+
+// Pack vertices from one tightly packed float stream per element, in element order
+void packVertices(const VertexLayout &layout, const float *const *sources, int64_t vertexCount, void *dst);
+
+// Whether all values are in [-1, 1], so snorm encoding loses no range
+bool inSnormRange(const float *values, size_t count);
+
+// Reference conversions, also used outside the vectorized loops
+uint16_t floatToHalf(float value);
+uint8_t linearToSrgb8(float value);
+int16_t floatToSnorm16(float value);
+uint8_t floatToUnorm8(float value);
+
+} /* namespace game */
+
+#endif /* #ifndef GAME_VERTEX_FORMAT_H */
+
+/* end of file */